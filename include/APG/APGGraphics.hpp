@@ -3,12 +3,15 @@
 
 // Include all APG graphics files
 #include "APG/graphics/AnimatedSprite.hpp"
+#include "APG/graphics/AnimationSystem.hpp"
+#include "APG/graphics/AssetCache.hpp"
 #include "APG/graphics/Buffer.hpp"
 #include "APG/graphics/Camera.hpp"
 #include "APG/graphics/GLError.hpp"
 #include "APG/graphics/IndexBufferObject.hpp"
 #include "APG/graphics/Mesh.hpp"
 #include "APG/graphics/PackedTexture.hpp"
+#include "APG/graphics/SDLQuadBatch.hpp"
 #include "APG/graphics/ShaderProgram.hpp"
 #include "APG/graphics/Sprite.hpp"
 #include "APG/graphics/SpriteBase.hpp"
@@ -30,9 +30,25 @@
 
 // Include all APG net files.
 #include "net/Socket.hpp"
+#include "net/BufferView.hpp"
+#include "net/BitStream.hpp"
+#include "net/BufferPool.hpp"
 #include "net/ByteBuffer.hpp"
+#include "net/ChainedBuffer.hpp"
+#include "net/CompressedFramer.hpp"
+#include "net/MessageFramer.hpp"
 #include "net/NetUtil.hpp"
 #include "net/NativeSocket.hpp"
+#include "net/NativeResolver.hpp"
+#include "net/NativeEventLoop.hpp"
+#include "net/NativeShardedAcceptor.hpp"
+#include "net/NativeConnector.hpp"
 #include "net/SDLSocket.hpp"
+#include "net/Snapshot.hpp"
+#include "net/SnapshotReplication.hpp"
+#include "net/SocketStats.hpp"
+#include "net/StringView.hpp"
+#include "net/TimingWheel.hpp"
+#include "net/UDPEndpoint.hpp"
 
 #endif /* INCLUDE_APG_APGNET_HPP_ */
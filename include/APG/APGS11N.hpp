@@ -30,6 +30,7 @@
 
 // include all APG S11N files
 
+#include "s11n/Binary.hpp"
 #include "s11n/JSON.hpp"
 
 #endif
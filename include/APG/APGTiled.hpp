@@ -7,6 +7,8 @@
 #include "APG/tiled/PackedTmxRenderer.hpp"
 #include "APG/tiled/GLTmxRenderer.hpp"
 #include "APG/tiled/SDLTmxRenderer.hpp"
+#include "APG/tiled/TiledObject.hpp"
+#include "APG/tiled/TiledObjectGroup.hpp"
 
 
 #endif
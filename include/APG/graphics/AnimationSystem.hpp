@@ -0,0 +1,190 @@
+#ifndef INCLUDE_APG_GRAPHICS_ANIMATIONSYSTEM_HPP_
+#define INCLUDE_APG_GRAPHICS_ANIMATIONSYSTEM_HPP_
+
+#ifndef APG_NO_SDL
+#ifndef APG_NO_GL
+
+#include <cstddef>
+#include <cstdint>
+
+#include <vector>
+
+#include "APG/graphics/SpriteBase.hpp"
+#include "APG/graphics/AnimatedSprite.hpp"
+
+namespace APG {
+
+struct UVRect {
+	float u1;
+	float v1;
+	float u2;
+	float v2;
+};
+
+/**
+ * Updates large numbers of animations in one pass.
+ *
+ * Animation state is stored as a structure of arrays, and each animation's frames are flattened into a table of
+ * frame end times (honouring per-frame durations) and a table of UV rects. updateAll() advances every animation
+ * with a branch-free loop over contiguous arrays which the compiler can vectorise, then writes the current UV rect
+ * of every animation into a single contiguous array which can be read directly by renderers.
+ *
+ * Frames are sampled when an animation is added, so frames must not change their UVs afterwards.
+ *
+ * Handles are indices into the system and are valid until clear() is called.
+ */
+class AnimationSystem {
+public:
+	using handle_type = uint32_t;
+
+	explicit AnimationSystem(uint32_t expectedAnimations = 0u);
+	~AnimationSystem() = default;
+
+	/**
+	 * Adds an animation where each frame has its own duration.
+	 * @param frames the frames of the animation; all must have the same texture and size.
+	 * @param frameDurations the length of each frame in seconds, one per frame.
+	 */
+	handle_type add(const std::vector<SpriteBase *> &frames, const std::vector<float> &frameDurations,
+	        AnimationMode mode = AnimationMode::LOOP);
+
+	/**
+	 * Adds an animation where every frame lasts for frameDuration seconds.
+	 */
+	handle_type add(const std::vector<SpriteBase *> &frames, float frameDuration,
+	        AnimationMode mode = AnimationMode::LOOP);
+
+	/**
+	 * Advances every animation by deltaTime seconds and updates the UV array.
+	 */
+	void updateAll(float deltaTime);
+
+	/**
+	 * Restarts the given animation from its first frame (or last frame if reversed).
+	 */
+	void reset(handle_type handle);
+
+	void setAnimationMode(handle_type handle, AnimationMode mode);
+
+	AnimationMode getAnimationMode(handle_type handle) const {
+		return modes[handle];
+	}
+
+	uint32_t getCurrentFrame(handle_type handle) const {
+		return currentFrames[handle];
+	}
+
+	const UVRect &getUVs(handle_type handle) const {
+		return uvs[handle];
+	}
+
+	/**
+	 * @return a pointer to size() contiguous UV rects, one per animation, indexed by handle.
+	 */
+	const UVRect *getUVData() const {
+		return uvs.data();
+	}
+
+	Texture *getTexture(handle_type handle) const {
+		return textures[handle];
+	}
+
+	int32_t getWidth(handle_type handle) const {
+		return widths[handle];
+	}
+
+	int32_t getHeight(handle_type handle) const {
+		return heights[handle];
+	}
+
+	size_t size() const {
+		return times.size();
+	}
+
+	void clear();
+
+private:
+	// per animation state
+	std::vector<float> times;
+	std::vector<float> periods;
+	std::vector<float> inversePeriods;
+	std::vector<float> durations;
+	std::vector<float> mirrors;
+
+	std::vector<uint32_t> firstFrames;
+	std::vector<uint32_t> frameCounts;
+	std::vector<uint32_t> currentFrames;
+	std::vector<uint8_t> reversed;
+
+	std::vector<AnimationMode> modes;
+
+	std::vector<Texture *> textures;
+	std::vector<int32_t> widths;
+	std::vector<int32_t> heights;
+
+	// output, one per animation
+	std::vector<UVRect> uvs;
+
+	// per frame tables; an animation's frames are frameEndTimes[firstFrames[i]] up to frameCounts[i] entries later
+	std::vector<float> frameEndTimes;
+	std::vector<UVRect> frameUVs;
+
+	void applyMode(handle_type handle);
+};
+
+/**
+ * A sprite which draws the current frame of an animation in an AnimationSystem, allowing animations
+ * managed by a system to be used anywhere a SpriteBase is expected (e.g. SpriteBatch::draw).
+ */
+class AnimationSystemSprite final : public SpriteBase {
+public:
+	explicit AnimationSystemSprite(const AnimationSystem *system, AnimationSystem::handle_type handle) :
+			system{system},
+			handle{handle} {
+	}
+
+	~AnimationSystemSprite() override = default;
+
+	Texture *getTexture() const override {
+		return system->getTexture(handle);
+	}
+
+	int32_t getWidth() const override {
+		return system->getWidth(handle);
+	}
+
+	int32_t getHeight() const override {
+		return system->getHeight(handle);
+	}
+
+	float getU1() const override {
+		return system->getUVs(handle).u1;
+	}
+
+	float getV1() const override {
+		return system->getUVs(handle).v1;
+	}
+
+	float getU2() const override {
+		return system->getUVs(handle).u2;
+	}
+
+	float getV2() const override {
+		return system->getUVs(handle).v2;
+	}
+
+	AnimationSystem::handle_type getHandle() const {
+		return handle;
+	}
+
+private:
+	const AnimationSystem *system;
+	AnimationSystem::handle_type handle;
+};
+
+}
+
+#endif
+#endif
+
+#endif
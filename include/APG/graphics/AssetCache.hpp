@@ -0,0 +1,158 @@
+#ifndef INCLUDE_APG_GRAPHICS_ASSETCACHE_HPP_
+#define INCLUDE_APG_GRAPHICS_ASSETCACHE_HPP_
+
+#ifndef APG_NO_SDL
+#ifndef APG_NO_GL
+
+#include <cstddef>
+#include <cstdint>
+
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "spdlog/spdlog.h"
+
+#include "APG/graphics/Texture.hpp"
+#include "APG/graphics/Tileset.hpp"
+
+namespace Tmx {
+class Tileset;
+}
+
+namespace APG {
+
+/**
+ * A central cache for textures and tilesets loaded from files.
+ *
+ * Assets are handed out as shared_ptrs, which act as reference-counted handles. Loads are deduplicated both by path
+ * and by file contents, so the same image loaded through two different paths is only uploaded once. A file is only
+ * read for deduplication if a cached asset of the same kind came from a file of the same size, and it's then compared
+ * byte-for-byte against that asset's source file before the asset is shared.
+ *
+ * The cache tracks the approximate GPU memory (uploaded texture data) and CPU memory (preserved surfaces) used by
+ * each asset. When either budget is exceeded, assets which are only referenced by the cache are evicted in
+ * least-recently-used order. Assets still referenced elsewhere are never evicted, so the budget can be exceeded
+ * if everything in the cache is in use. A budget of 0 means unlimited.
+ *
+ * Not thread safe; like all GL resources, use from the thread which owns the GL context.
+ */
+class AssetCache {
+public:
+	struct Stats {
+		size_t residentGPUBytes = 0u;
+		size_t residentCPUBytes = 0u;
+		size_t assetCount = 0u;
+
+		uint64_t hits = 0u;
+		uint64_t misses = 0u;
+		uint64_t evictions = 0u;
+
+		double hitRate() const {
+			const auto total = hits + misses;
+			return total == 0u ? 0.0 : static_cast<double>(hits) / static_cast<double>(total);
+		}
+	};
+
+	/**
+	 * The cache shared by all of APG's renderers.
+	 */
+	static AssetCache &getDefault();
+
+	explicit AssetCache(size_t gpuBudgetBytes = 0u, size_t cpuBudgetBytes = 0u);
+	~AssetCache() = default;
+
+	AssetCache(const AssetCache &other) = delete;
+	AssetCache &operator=(const AssetCache &other) = delete;
+
+	std::shared_ptr<Texture> loadTexture(const std::string &fileName);
+
+	std::shared_ptr<Tileset> loadTileset(const std::string &fileName, Tmx::Tileset *tileset);
+	std::shared_ptr<Tileset> loadTileset(const std::string &fileName, int32_t tileWidth, int32_t tileHeight,
+	        int32_t spacing = 0);
+
+	/**
+	 * Sets the memory budgets, in bytes, and immediately evicts anything which can be evicted to meet them.
+	 */
+	void setBudget(size_t gpuBudgetBytes, size_t cpuBudgetBytes);
+
+	/**
+	 * Evicts unreferenced assets in LRU order until the cache is within budget.
+	 * Called automatically after each load.
+	 * @return the number of assets evicted.
+	 */
+	size_t trim();
+
+	/**
+	 * Evicts every asset which is only referenced by the cache, regardless of budget.
+	 * @return the number of assets evicted.
+	 */
+	size_t purgeUnused();
+
+	const Stats &getStats() const {
+		return stats;
+	}
+
+	void resetHitStats() {
+		stats.hits = stats.misses = stats.evictions = 0u;
+	}
+
+private:
+	struct Entry {
+		std::shared_ptr<Texture> asset;
+
+		// every path key which refers to this entry
+		std::vector<std::string> pathKeys;
+		std::string contentKey;
+
+		// the file the asset was loaded from, which later loads are compared against
+		std::string sourceFile;
+
+		size_t gpuBytes = 0u;
+		size_t cpuBytes = 0u;
+	};
+
+	using entry_list = std::list<Entry>;
+
+	// most recently used at the front
+	entry_list entries;
+
+	std::unordered_map<std::string, entry_list::iterator> pathIndex;
+	// keyed on asset kind and file size; several different files can share a key
+	std::unordered_multimap<std::string, entry_list::iterator> contentIndex;
+
+	size_t gpuBudget;
+	size_t cpuBudget;
+
+	Stats stats;
+
+	std::shared_ptr<spdlog::logger> logger;
+
+	template<typename T, typename Loader>
+	std::shared_ptr<T> load(const std::string &kindKey, const std::string &fileName, Loader &&loader);
+
+	bool overBudget() const;
+
+	void touch(entry_list::iterator it);
+
+	void evict(entry_list::iterator it);
+
+	/**
+	 * @return false if the file couldn't be opened.
+	 */
+	static bool getFileSize(const std::string &fileName, uint64_t &size);
+
+	/**
+	 * @return true if both files could be read and have identical contents.
+	 */
+	static bool fileContentsEqual(const std::string &first, const std::string &second);
+};
+
+}
+
+#endif
+#endif
+
+#endif
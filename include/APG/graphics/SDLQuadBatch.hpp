@@ -0,0 +1,86 @@
+#ifndef INCLUDE_APG_GRAPHICS_SDLQUADBATCH_HPP_
+#define INCLUDE_APG_GRAPHICS_SDLQUADBATCH_HPP_
+
+#ifndef APG_NO_SDL
+
+#include <cstddef>
+
+#include <vector>
+
+#include "APG/SDL.hpp"
+#include "APG/SXXDL.hpp"
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+#define APG_SDL_HAS_RENDER_GEOMETRY
+#endif
+
+namespace APG {
+
+/**
+ * Accumulates textured quads for an SDL_Renderer and submits them in as few calls as possible.
+ *
+ * Quads are grouped by texture; on SDL 2.0.18 and later each texture's quads are submitted with a single
+ * SDL_RenderGeometry call, and on older versions they fall back to one SDL_RenderCopy per quad.
+ *
+ * Quads using the same texture are drawn in the order they were added, but no ordering is guaranteed between
+ * quads with different textures, so overlapping quads should use the same texture or be flushed in between.
+ *
+ * Storage is kept between flushes, so a batch which is reused every frame won't allocate once warmed up.
+ */
+class SDLQuadBatch {
+public:
+	explicit SDLQuadBatch(const SXXDL::renderer_ptr &renderer);
+	~SDLQuadBatch() = default;
+
+	SDLQuadBatch(const SDLQuadBatch &other) = delete;
+	SDLQuadBatch &operator=(const SDLQuadBatch &other) = delete;
+
+	/**
+	 * Queues srcRect of texture to be drawn at dstRect when the batch is flushed.
+	 */
+	void add(SDL_Texture *texture, const SDL_Rect &srcRect, const SDL_Rect &dstRect);
+
+	/**
+	 * Draws every queued quad and empties the batch.
+	 * @return false if an SDL error occurred; the batch is emptied regardless.
+	 */
+	bool flush();
+
+	void clear();
+
+	size_t getQuadCount() const {
+		return quadCount;
+	}
+
+private:
+	struct Bucket {
+		SDL_Texture *texture = nullptr;
+
+		float inverseWidth = 0.0f;
+		float inverseHeight = 0.0f;
+
+#ifdef APG_SDL_HAS_RENDER_GEOMETRY
+		std::vector<SDL_Vertex> vertices;
+		std::vector<int> indices;
+#else
+		std::vector<SDL_Rect> srcRects;
+		std::vector<SDL_Rect> dstRects;
+#endif
+	};
+
+	const SXXDL::renderer_ptr &renderer;
+
+	// only a handful of textures are used at once, so a linear search is faster than a map here
+	std::vector<Bucket> buckets;
+	size_t lastBucket = 0u;
+
+	size_t quadCount = 0u;
+
+	Bucket &getBucket(SDL_Texture *texture);
+};
+
+}
+
+#endif
+
+#endif
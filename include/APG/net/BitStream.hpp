@@ -0,0 +1,82 @@
+#ifndef INCLUDE_APG_NET_BITSTREAM_HPP_
+#define INCLUDE_APG_NET_BITSTREAM_HPP_
+
+#include <cstdint>
+
+#include "BufferView.hpp"
+#include "ByteBuffer.hpp"
+
+namespace APG {
+
+/**
+ * Packs values of arbitrary bit widths onto the end of a ByteBuffer, least significant bit first. The output is
+ * byte oriented, so it's the same on every platform regardless of endianness.
+ *
+ * Bits are only written to the buffer a whole byte at a time; flush() writes the final partial byte, and is
+ * called automatically on destruction.
+ */
+class BitWriter {
+public:
+	explicit BitWriter(ByteBuffer &buffer);
+	~BitWriter();
+
+	BitWriter(const BitWriter &other) = delete;
+	BitWriter &operator=(const BitWriter &other) = delete;
+
+	/**
+	 * Writes the lowest `bits` bits of value, where bits is between 1 and 32.
+	 */
+	void writeBits(uint32_t value, uint32_t bits);
+
+	void writeBool(bool value) {
+		writeBits(value ? 1u : 0u, 1u);
+	}
+
+	/**
+	 * Writes value using 6, 10, 18 or 34 bits depending on its magnitude; small values are cheap.
+	 */
+	void writeVarUInt(uint32_t value);
+
+	/**
+	 * Pads to a whole byte with zeros and writes any remaining bits to the buffer.
+	 */
+	void flush();
+
+	uint32_t getBitsWritten() const {
+		return bitsWritten;
+	}
+
+private:
+	ByteBuffer &buffer;
+
+	uint64_t scratch = 0u;
+	uint32_t scratchBits = 0u;
+
+	uint32_t bitsWritten = 0u;
+};
+
+/**
+ * Reads values written by a BitWriter from a view of the written bytes. Reads past the end fail and leave the
+ * reader positioned at the end, so a malformed stream can be detected by checking every return value.
+ */
+class BitReader {
+public:
+	explicit BitReader(const BufferView &view);
+
+	bool readBits(uint32_t &value, uint32_t bits);
+	bool readBool(bool &value);
+	bool readVarUInt(uint32_t &value);
+
+	uint32_t getBitsRemaining() const {
+		return totalBits - bitPosition;
+	}
+
+private:
+	const uint8_t *data;
+	uint32_t totalBits;
+	uint32_t bitPosition = 0u;
+};
+
+}
+
+#endif
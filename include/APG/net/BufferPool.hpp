@@ -0,0 +1,99 @@
+#ifndef INCLUDE_APG_NET_BUFFERPOOL_HPP_
+#define INCLUDE_APG_NET_BUFFERPOOL_HPP_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace APG {
+
+/**
+ * A process-wide pool of recycled memory blocks used for the storage of every ByteBuffer (and so every socket
+ * buffer, send queue and message). Requests are rounded up to a power of two capacity class between
+ * MIN_CLASS_SIZE and MAX_CLASS_SIZE; larger requests bypass the pool.
+ *
+ * Each thread keeps a small cache of free blocks per class which it uses without locking; when a thread's cache
+ * overflows, half of it is moved to a shared pool which other threads refill from. Blocks freed on one thread can
+ * be reused by another. Once buffers have grown to their working size, steady-state networking makes no heap
+ * allocations for buffer storage.
+ *
+ * Define APG_NO_BUFFER_POOL to allocate buffer storage directly instead.
+ */
+class BufferPool {
+public:
+	static constexpr const size_t MIN_CLASS_SIZE = 64u;
+	static constexpr const size_t MAX_CLASS_SIZE = 1024u * 1024u;
+	static constexpr const uint32_t CLASS_COUNT = 15u;
+
+	struct Stats {
+		// blocks which had to be allocated from the heap because none were free
+		uint64_t heapAllocations;
+
+		// blocks handed out from a thread cache or the shared pool
+		uint64_t reuses;
+
+		// blocks returned to the pool
+		uint64_t releases;
+
+		// requests too large to be pooled
+		uint64_t unpooledAllocations;
+
+		// blocks and bytes currently allocated from the heap by the pool, free or in use
+		uint64_t blocksOwned;
+		uint64_t bytesOwned;
+	};
+
+	/**
+	 * @return a block of at least size bytes, which must be returned with release() using the same size.
+	 */
+	static void *acquire(size_t size);
+	static void release(void *block, size_t size);
+
+	/**
+	 * @return the capacity actually reserved for a request of the given size.
+	 */
+	static size_t getClassSize(size_t size);
+
+	static Stats getStats();
+
+	/**
+	 * Frees every block cached by the calling thread and in the shared pool back to the heap.
+	 */
+	static void trim();
+};
+
+/**
+ * A stateless allocator which allocates from BufferPool.
+ */
+template<typename T>
+class PoolAllocator {
+public:
+	using value_type = T;
+
+	PoolAllocator() noexcept = default;
+
+	template<typename U>
+	PoolAllocator(const PoolAllocator<U> &) noexcept {
+	}
+
+	T *allocate(size_t count) {
+		return static_cast<T *>(BufferPool::acquire(count * sizeof(T)));
+	}
+
+	void deallocate(T *ptr, size_t count) noexcept {
+		BufferPool::release(ptr, count * sizeof(T));
+	}
+};
+
+template<typename T, typename U>
+bool operator==(const PoolAllocator<T> &, const PoolAllocator<U> &) {
+	return true;
+}
+
+template<typename T, typename U>
+bool operator!=(const PoolAllocator<T> &, const PoolAllocator<U> &) {
+	return false;
+}
+
+}
+
+#endif
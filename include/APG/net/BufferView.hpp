@@ -0,0 +1,40 @@
+#ifndef INCLUDE_APG_NET_BUFFERVIEW_HPP_
+#define INCLUDE_APG_NET_BUFFERVIEW_HPP_
+
+#include <cstdint>
+
+namespace APG {
+
+/**
+ * A non-owning view of a contiguous range of bytes, used to pass data around without copying it.
+ *
+ * A view is only valid for as long as the memory it points to; views of a ByteBuffer are invalidated by anything
+ * which might reallocate the buffer, such as writing past its capacity, resize() or clear().
+ */
+struct BufferView {
+	const uint8_t *data = nullptr;
+	uint32_t length = 0u;
+
+	BufferView() = default;
+
+	BufferView(const uint8_t *data, uint32_t length) :
+			data{data},
+			length{length} {
+	}
+
+	bool empty() const {
+		return length == 0u;
+	}
+
+	const uint8_t *begin() const {
+		return data;
+	}
+
+	const uint8_t *end() const {
+		return data + length;
+	}
+};
+
+}
+
+#endif
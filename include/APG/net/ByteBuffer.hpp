@@ -38,7 +38,14 @@
 
 #include <vector>
 #include <memory>
+#include <new>
 #include <string>
+#include <type_traits>
+#include <utility>
+
+#include "APG/net/BufferView.hpp"
+#include "APG/net/BufferPool.hpp"
+#include "APG/net/StringView.hpp"
 
 #ifdef BB_UTILITY
 #include <iostream>
@@ -51,6 +58,58 @@ namespace APG {
 namespace bb {
 #endif
 
+/**
+ * An allocator which default-initialises elements instead of value-initialising them, so resizing a vector of
+ * bytes leaves the new bytes uninitialised rather than zeroing them. Only used for ByteBuffer's own storage, so
+ * sockets can reserve space to receive into without paying to clear it first; see ByteBuffer::prepareWrite.
+ */
+template<typename T, typename Base = std::allocator<T>>
+class DefaultInitAllocator : public Base {
+public:
+	template<typename U>
+	struct rebind {
+		using other = DefaultInitAllocator<U, typename std::allocator_traits<Base>::template rebind_alloc<U>>;
+	};
+
+	using Base::Base;
+
+	template<typename U>
+	void construct(U *ptr) noexcept(std::is_nothrow_default_constructible<U>::value) {
+		::new (static_cast<void *>(ptr)) U;
+	}
+
+	template<typename U, typename... Args>
+	void construct(U *ptr, Args &&... args) {
+		std::allocator_traits<Base>::construct(static_cast<Base &>(*this), ptr, std::forward<Args>(args)...);
+	}
+};
+
+// Resizing a byte_vector zeroes new bytes, as with any std::vector
+#ifndef APG_NO_BUFFER_POOL
+using byte_vector = std::vector<uint8_t, PoolAllocator<uint8_t>>;
+#else
+using byte_vector = std::vector<uint8_t>;
+#endif
+
+/**
+ * Maps signed values to unsigned so that values close to 0 have few significant bits: 0, -1, 1, -2 → 0, 1, 2, 3.
+ */
+inline uint32_t zigzagEncode(int32_t value) {
+	return (static_cast<uint32_t>(value) << 1u) ^ static_cast<uint32_t>(value >> 31);
+}
+
+inline uint64_t zigzagEncode(int64_t value) {
+	return (static_cast<uint64_t>(value) << 1u) ^ static_cast<uint64_t>(value >> 63);
+}
+
+inline int32_t zigzagDecode(uint32_t value) {
+	return static_cast<int32_t>((value >> 1u) ^ (~(value & 1u) + 1u));
+}
+
+inline int64_t zigzagDecode(uint64_t value) {
+	return static_cast<int64_t>((value >> 1u) ^ (~(value & 1u) + 1u));
+}
+
 class ByteBuffer {
 public:
 	explicit ByteBuffer(uint32_t size = BB_DEFAULT_SIZE);
@@ -60,30 +119,31 @@ public:
 	uint32_t bytesRemaining(); // Number of uint8_ts from the current read position till the end of the buffer
 	void clear(); // Clear our the vector and reset read and write positions
 	std::unique_ptr<ByteBuffer> clone(); // Return a new instance of a ByteBuffer with the exact same contents and the same state (rpos, wpos)
-	//ByteBuffer compact(); // TODO?
+	void cloneInto(ByteBuffer &target) const; // As clone, but copies into an existing buffer, reusing its storage
+	void compact(); // Discard everything before the read position, moving unread bytes to the start of the buffer
 	bool equals(ByteBuffer* other); // Compare if the contents are equivalent
-	void resize(uint32_t newSize);
-	uint32_t size(); // Size of internal vector
-
-	// Basic Searching (Linear)
-	template<typename T> int32_t find(T key, uint32_t start = 0) {
-		int32_t ret = -1;
-		uint32_t len = buf.size();
-		for (uint32_t i = start; i < len; i++) {
-			T data = read<T>(i);
-			// Wasn't actually found, bounds of buffer were exceeded
-			if ((key != 0) && (data == 0))
-				break;
-
-			// Key was found in array
-			if (data == key) {
-				ret = (int32_t) i;
-				break;
-			}
-		}
-		return ret;
+	void resize(uint32_t newSize); // New bytes are zeroed
+	uint32_t size() const; // Size of internal vector
+
+	// View of the whole buffer, as sent by Socket::send(); invalidated by anything which reallocates the buffer
+	BufferView view() const {
+		return BufferView(buf.data(), static_cast<uint32_t>(buf.size()));
 	}
 
+	// Searching
+	// Finds the first occurrence of key's bytes at or after start, using memchr to skip to candidates.
+	// Returns -1 if not found. Zero bytes in the buffer are searched like any other.
+	template<typename T> int32_t find(T key, uint32_t start = 0) const {
+		static_assert(std::is_trivially_copyable<T>::value, "ByteBuffer::find needs a trivially copyable key");
+
+		uint8_t pattern[sizeof(T)];
+		memcpy(pattern, &key, sizeof(T));
+
+		return findBytes(pattern, sizeof(T), start);
+	}
+
+	int32_t findBytes(const uint8_t* pattern, uint32_t len, uint32_t start = 0) const;
+
 	// Replacement
 	void replace(uint8_t key, uint8_t rep, uint32_t start = 0, bool firstOccuranceOnly = false);
 
@@ -94,7 +154,40 @@ public:
 	uint8_t get() const; // Relative get method. Reads the uint8_t at the buffers current position then increments the position
 	uint8_t get(uint32_t index) const; // Absolute get method. Read uint8_t at index
 
-	void getBytes(uint8_t* buf, uint32_t len) const; // Absolute read into array buf of length len
+	void getBytes(uint8_t* buf, uint32_t len) const; // Relative read into array buf of length len
+
+	// Bulk relative read of count values of type T in host byte order with a single copy.
+	// Returns false without reading anything if fewer than count values remain.
+	template<typename T> bool getArray(T* values, uint32_t count) const {
+		static_assert(std::is_trivially_copyable<T>::value, "ByteBuffer::getArray needs a trivially copyable type");
+
+		const size_t len = sizeof(T) * count;
+		if (rpos + len > buf.size())
+			return false;
+
+		memcpy(values, buf.data() + rpos, len);
+		rpos += len;
+		return true;
+	}
+
+	// Explicit byte order relative reads, for protocols shared with machines of any endianness
+	uint16_t getUInt16LE() const;
+	uint16_t getUInt16BE() const;
+	uint32_t getUInt32LE() const;
+	uint32_t getUInt32BE() const;
+	uint64_t getUInt64LE() const;
+	uint64_t getUInt64BE() const;
+	float getFloatLE() const;
+	float getFloatBE() const;
+	double getDoubleLE() const;
+	double getDoubleBE() const;
+
+	// Relative reads of LEB128 varints (zigzag encoded for signed values), as written by putVar*.
+	// Return false and leave the read position unchanged if the varint is incomplete or malformed.
+	bool getVarUInt32(uint32_t &value) const;
+	bool getVarUInt64(uint64_t &value) const;
+	bool getVarInt32(int32_t &value) const;
+	bool getVarInt64(int64_t &value) const;
 
 	char getChar() const; // Relative
 	char getChar(uint32_t index) const; // Absolute
@@ -129,13 +222,49 @@ public:
 	std::string getStringByLength(size_t length) const;
 	std::string getStringByLength(size_t length, uint32_t index) const;
 
+	// Zero-copy Reads
+	// These return views pointing directly into the buffer instead of copies. A view stays valid until the buffer's
+	// contents move: anything which may reallocate (writing past capacity, resize(), clear()), compact(), or a
+	// Socket receiving into or discarding from this buffer. Reading never invalidates views.
+
+	// Relative view of the next length bytes. Returns an empty view without moving the read position if fewer
+	// than length bytes remain.
+	BufferView getView(uint32_t length) const;
+	BufferView getView(uint32_t length, uint32_t index) const; // Absolute
+
+	// Relative view of the characters up to the next '\0', moving the read position past the '\0'.
+	// If there's no '\0', the view runs to the end of the buffer.
+	StringView getStringViewByNullCharacter() const;
+
+	// Relative view of the next length characters; empty without moving the read position if fewer remain.
+	StringView getStringViewByLength(uint32_t length) const;
+
+	// Length Prefixed Strings
+	// Strings are written as a LEB128 varint byte length followed by the bytes, with no terminator, so a string
+	// under 128 bytes costs one byte of overhead and can be read without searching.
+
+	void putLengthPrefixedString(const char* str, uint32_t len);
+	void putLengthPrefixedString(const std::string &str);
+	void putLengthPrefixedString(const StringView &str);
+
+	// Writes the number of strings as a varint, then each string
+	void putLengthPrefixedStrings(const std::vector<std::string> &strs);
+
+	// Relative reads. Return false without moving the read position if the string is incomplete or malformed.
+	bool getLengthPrefixedString(StringView &str) const;
+	bool getLengthPrefixedString(std::string &str) const; // Copies, reusing str's capacity
+
+	// Reads a list written by putLengthPrefixedStrings into views, reusing strs' capacity
+	bool getLengthPrefixedStrings(std::vector<StringView> &strs) const;
+
 	// Write
 
 	void put(ByteBuffer* src); // Relative write of the entire contents of another ByteBuffer (src)
 	void put(uint8_t b); // Relative write
 	void put(uint8_t b, uint32_t index); // Absolute write at index
-	void putBytes(uint8_t* b, uint32_t len); // Relative write
-	void putBytes(uint8_t* b, uint32_t len, uint32_t index); // Absolute write starting at index
+	void putBytes(const uint8_t* b, uint32_t len); // Relative write
+	void putBytes(const uint8_t* b, uint32_t len, uint32_t index); // Absolute write starting at index
+	void insertBytes(const uint8_t* b, uint32_t len, uint32_t index); // Inserts at index, moving later bytes (and positions past index) along
 	void putChar(char value); // Relative
 	void putChar(char value, uint32_t index); // Absolute
 	void putDouble(double value);
@@ -161,6 +290,54 @@ public:
 	void putString(const std::string &str);
 	void putString(const std::string &str, uint32_t index);
 
+	// Bulk relative write of count values of type T in host byte order with a single copy
+	template<typename T> void putArray(const T* values, uint32_t count) {
+		static_assert(std::is_trivially_copyable<T>::value, "ByteBuffer::putArray needs a trivially copyable type");
+
+		putBytes(reinterpret_cast<const uint8_t*>(values), sizeof(T) * count);
+	}
+
+	template<typename T, typename Alloc> void putArray(const std::vector<T, Alloc> &values) {
+		putArray(values.data(), static_cast<uint32_t>(values.size()));
+	}
+
+	// Explicit byte order relative writes
+	void putUInt16LE(uint16_t value);
+	void putUInt16BE(uint16_t value);
+	void putUInt32LE(uint32_t value);
+	void putUInt32BE(uint32_t value);
+	void putUInt64LE(uint64_t value);
+	void putUInt64BE(uint64_t value);
+	void putFloatLE(float value);
+	void putFloatBE(float value);
+	void putDoubleLE(double value);
+	void putDoubleBE(double value);
+
+	// Relative writes of unsigned LEB128 varints: 7 bits per byte, so values under 128 take 1 byte.
+	// Signed values are zigzag encoded first so small negative values are short too.
+	void putVarUInt32(uint32_t value);
+	void putVarUInt64(uint64_t value);
+	void putVarInt32(int32_t value);
+	void putVarInt64(int64_t value);
+
+	// Varint Encoding
+
+	static constexpr const uint32_t MAX_VARINT32_SIZE = 5;
+	static constexpr const uint32_t MAX_VARINT64_SIZE = 10;
+
+	enum class VarintResult {
+		COMPLETE,
+		INCOMPLETE, // ran out of data before the last byte of the varint
+		MALFORMED // too many bytes, or too large for the requested type
+	};
+
+	// Writes value to out, which needs room for MAX_VARINT64_SIZE bytes (MAX_VARINT32_SIZE if value fits in 32 bits).
+	// Returns the number of bytes written.
+	static uint32_t encodeVarint(uint64_t value, uint8_t* out);
+
+	static VarintResult decodeVarint32(const uint8_t* data, uint32_t available, uint32_t &value, uint32_t &bytesRead);
+	static VarintResult decodeVarint64(const uint8_t* data, uint32_t available, uint64_t &value, uint32_t &bytesRead);
+
 	// Buffer Position Accessors & Mutators
 
 	void setReadPos(uint32_t r) {
@@ -191,14 +368,36 @@ public:
 #endif
 
 protected:
-	const std::vector<uint8_t> &getBuffer() const {
+	// Growing storage_vector with resize() leaves the new bytes uninitialised, so everything except prepareWrite
+	// grows it with an explicit fill value or by inserting the bytes being written
+#ifndef APG_NO_BUFFER_POOL
+	using storage_vector = std::vector<uint8_t, DefaultInitAllocator<uint8_t, PoolAllocator<uint8_t>>>;
+#else
+	using storage_vector = std::vector<uint8_t, DefaultInitAllocator<uint8_t>>;
+#endif
+
+	const storage_vector &getBuffer() const {
 		return buf;
 	}
 
+	/**
+	 * Grows the buffer by length uninitialised bytes so they can be written to directly (e.g. by ::recv); the
+	 * only way of growing the buffer without initialising the new bytes. Must be followed by commitWrite before
+	 * anything else reads or modifies the buffer, so bytes which weren't written are never exposed.
+	 * @return a pointer to the first new byte.
+	 */
+	uint8_t *prepareWrite(uint32_t length);
+
+	/**
+	 * Keeps the first used bytes of the previous prepareWrite call, discarding the rest, and moves the write
+	 * position to the end of the buffer.
+	 */
+	void commitWrite(uint32_t used, uint32_t prepared);
+
 private:
 	uint32_t wpos;
 	mutable uint32_t rpos;
-	std::vector<uint8_t> buf;
+	storage_vector buf;
 
 #ifdef BB_UTILITY
 	std::string name;
@@ -211,20 +410,48 @@ private:
 	}
 
 	template<typename T> T read(uint32_t index) const {
+		T data = 0;
 		if (index + sizeof(T) <= buf.size())
-			return *((T*) &buf[index]);
-		return 0;
+			memcpy(&data, &buf[index], sizeof(T));
+		return data;
 	}
 
-	template<typename T> void append(T data) {
-		uint32_t s = sizeof(data);
+	template<typename T> T readLE() const {
+		uint8_t bytes[sizeof(T)];
+		getBytes(bytes, sizeof(T));
 
-		if (size() < (wpos + s))
-			buf.resize(wpos + s);
-		memcpy(&buf[wpos], (uint8_t*) &data, s);
-		//printf("writing %c to %i\n", (uint8_t)data, wpos);
+		T value = 0;
+		for (uint32_t i = 0; i < sizeof(T); i++)
+			value |= static_cast<T>(bytes[i]) << (8 * i);
+		return value;
+	}
 
-		wpos += s;
+	template<typename T> T readBE() const {
+		uint8_t bytes[sizeof(T)];
+		getBytes(bytes, sizeof(T));
+
+		T value = 0;
+		for (uint32_t i = 0; i < sizeof(T); i++)
+			value = static_cast<T>(value << 8) | bytes[i];
+		return value;
+	}
+
+	template<typename T> void appendLE(T data) {
+		uint8_t bytes[sizeof(T)];
+		for (uint32_t i = 0; i < sizeof(T); i++)
+			bytes[i] = static_cast<uint8_t>(data >> (8 * i));
+		putBytes(bytes, sizeof(T));
+	}
+
+	template<typename T> void appendBE(T data) {
+		uint8_t bytes[sizeof(T)];
+		for (uint32_t i = 0; i < sizeof(T); i++)
+			bytes[sizeof(T) - 1 - i] = static_cast<uint8_t>(data >> (8 * i));
+		putBytes(bytes, sizeof(T));
+	}
+
+	template<typename T> void append(T data) {
+		putBytes(reinterpret_cast<const uint8_t*>(&data), sizeof(data));
 	}
 
 	template<typename T> void insert(T data, uint32_t index) {
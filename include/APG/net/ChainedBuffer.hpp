@@ -0,0 +1,191 @@
+#ifndef INCLUDE_APG_NET_CHAINEDBUFFER_HPP_
+#define INCLUDE_APG_NET_CHAINEDBUFFER_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "BufferView.hpp"
+#include "ByteBuffer.hpp"
+#include "StringView.hpp"
+
+namespace APG {
+
+class Socket;
+
+/**
+ * A buffer for large payloads (map transfers, replays) made of a chain of fixed-size blocks from BufferPool.
+ * Appending fills the last block and then adds new ones, so existing data is never moved or copied however large
+ * the buffer grows, and blocks are recycled when the buffer is cleared or destroyed.
+ *
+ * Provides the same relative put and get methods as ByteBuffer. Writes always append; there's no write position.
+ * Values may straddle blocks, which is handled transparently.
+ *
+ * The whole chain can be sent with a single vectored send using send(), without flattening it.
+ */
+class ChainedBuffer {
+public:
+	static constexpr const uint32_t DEFAULT_BLOCK_SIZE = 64u * 1024u;
+
+	explicit ChainedBuffer(uint32_t blockSize = DEFAULT_BLOCK_SIZE);
+	~ChainedBuffer();
+
+	ChainedBuffer(const ChainedBuffer &other) = delete;
+	ChainedBuffer &operator=(const ChainedBuffer &other) = delete;
+
+	ChainedBuffer(ChainedBuffer &&other) noexcept;
+	ChainedBuffer &operator=(ChainedBuffer &&other) noexcept;
+
+	/**
+	 * Empties the buffer and resets the read position. The first block is kept for reuse and the rest are
+	 * returned to the pool.
+	 */
+	void clear();
+
+	size_t size() const {
+		return totalSize;
+	}
+
+	size_t bytesRemaining() const {
+		return totalSize - readPos;
+	}
+
+	uint32_t getBlockSize() const {
+		return blockSize;
+	}
+
+	uint32_t getBlockCount() const {
+		return static_cast<uint32_t>(blocks.size());
+	}
+
+	size_t getReadPos() const {
+		return readPos;
+	}
+
+	void setReadPos(size_t pos);
+
+	// Write
+
+	void put(uint8_t b);
+	void put(const ByteBuffer &src); // The entire contents of src
+	void putBytes(const uint8_t *b, size_t len);
+	void putBytes(const BufferView &view);
+	void putChar(char value);
+	void putDouble(double value);
+	void putFloat(float value);
+	void putUInt16(uint16_t value);
+	void putUInt32(uint32_t value);
+	void putUInt64(uint64_t value);
+	void putString(const std::string &str);
+	void putVarUInt32(uint32_t value);
+	void putVarUInt64(uint64_t value);
+	void putLengthPrefixedString(const std::string &str);
+
+	template<typename T> void putArray(const T *values, uint32_t count) {
+		static_assert(std::is_trivially_copyable<T>::value, "ChainedBuffer::putArray needs a trivially copyable type");
+
+		putBytes(reinterpret_cast<const uint8_t *>(values), sizeof(T) * count);
+	}
+
+	// Read; as with ByteBuffer, reading past the end yields zeros
+
+	uint8_t get() const;
+	void getBytes(uint8_t *buf, size_t len) const;
+	char getChar() const;
+	double getDouble() const;
+	float getFloat() const;
+	uint16_t getUInt16() const;
+	uint32_t getUInt32() const;
+	uint64_t getUInt64() const;
+	std::string getStringByLength(size_t length) const;
+
+	// Return false without moving the read position on incomplete or malformed input
+	bool getVarUInt32(uint32_t &value) const;
+	bool getVarUInt64(uint64_t &value) const;
+	bool getLengthPrefixedString(std::string &str) const;
+
+	template<typename T> bool getArray(T *values, uint32_t count) const {
+		static_assert(std::is_trivially_copyable<T>::value, "ChainedBuffer::getArray needs a trivially copyable type");
+
+		if (bytesRemaining() < sizeof(T) * count) {
+			return false;
+		}
+
+		getBytes(reinterpret_cast<uint8_t *>(values), sizeof(T) * count);
+		return true;
+	}
+
+	// Output
+
+	/**
+	 * Appends a view of every block's data, in order, to views. The views are invalidated by clear(), destruction
+	 * or moving the buffer, but not by further appends.
+	 */
+	void getViews(std::vector<BufferView> &views) const;
+
+	/**
+	 * Sends the whole buffer with one vectored send, without copying it.
+	 * @return the result of Socket::sendv.
+	 */
+	int send(Socket &socket) const;
+
+	/**
+	 * Replaces the contents of target with a flat copy of this buffer.
+	 */
+	void copyTo(ByteBuffer &target) const;
+
+private:
+	struct Block {
+		uint8_t *data;
+		uint32_t used;
+	};
+
+	uint32_t blockSize;
+
+	std::vector<Block> blocks;
+	size_t totalSize = 0u;
+
+	// the block and offset within it of readPos, kept so sequential reads don't have to search
+	mutable size_t readPos = 0u;
+	mutable uint32_t readBlock = 0u;
+	mutable uint32_t readOffset = 0u;
+
+	// reused by send() so sending doesn't allocate
+	mutable std::vector<BufferView> sendViews;
+
+	void addBlock();
+	void releaseBlocks(size_t keep);
+
+	/**
+	 * Copies up to len bytes from readPos to buf without moving the read position.
+	 * @return the number of bytes copied.
+	 */
+	size_t peekBytes(uint8_t *buf, size_t len) const;
+
+	template<typename T> void append(T data) {
+		putBytes(reinterpret_cast<const uint8_t *>(&data), sizeof(T));
+	}
+
+	template<typename T> T read() const {
+		T data = 0;
+
+		// fast path for values which don't straddle blocks
+		if (readBlock < blocks.size() && blocks[readBlock].used - readOffset >= sizeof(T)) {
+			std::memcpy(&data, blocks[readBlock].data + readOffset, sizeof(T));
+			readOffset += sizeof(T);
+			readPos += sizeof(T);
+			return data;
+		}
+
+		getBytes(reinterpret_cast<uint8_t *>(&data), sizeof(T));
+		return data;
+	}
+};
+
+}
+
+#endif
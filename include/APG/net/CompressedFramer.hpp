@@ -0,0 +1,171 @@
+#ifndef INCLUDE_APG_NET_COMPRESSEDFRAMER_HPP_
+#define INCLUDE_APG_NET_COMPRESSEDFRAMER_HPP_
+
+#include <cstdint>
+
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include <zlib.h>
+
+#include "spdlog/spdlog.h"
+
+#include "BufferView.hpp"
+#include "ByteBuffer.hpp"
+#include "MessageFramer.hpp"
+
+namespace APG {
+
+struct CompressionOptions {
+	/**
+	 * If false, this side never compresses and tells the remote side not to either.
+	 */
+	bool enabled = true;
+
+	/**
+	 * Messages shorter than this are sent uncompressed, since deflate can't shrink them enough to be worth the
+	 * CPU time.
+	 */
+	uint32_t threshold = 128u;
+
+	/**
+	 * zlib compression level, from 1 (fastest) to 9 (smallest).
+	 */
+	int level = Z_DEFAULT_COMPRESSION;
+
+	/**
+	 * Preset dictionary of byte strings expected to be common in messages (field names, common values). Both
+	 * sides must use the same dictionary for compression to be negotiated.
+	 */
+	std::vector<uint8_t> dictionary;
+
+	/**
+	 * Compressed messages which would decompress to more than this put the socket into an error state, so a
+	 * small message can't be used to exhaust memory.
+	 */
+	uint32_t maxMessageSize = MessageFramer::DEFAULT_MAX_MESSAGE_SIZE;
+};
+
+struct CompressionStats {
+	uint64_t messagesCompressed = 0u;
+	uint64_t messagesUncompressed = 0u;
+
+	// compressed messages only, before and after deflating
+	uint64_t bytesBeforeCompression = 0u;
+	uint64_t bytesAfterCompression = 0u;
+
+	uint64_t messagesDecompressed = 0u;
+	uint64_t bytesBeforeDecompression = 0u;
+	uint64_t bytesAfterDecompression = 0u;
+
+	std::chrono::nanoseconds compressTime { 0 };
+	std::chrono::nanoseconds decompressTime { 0 };
+
+	/**
+	 * @return compressed size as a fraction of the original size for compressed messages, or 1 if nothing has
+	 *         been compressed.
+	 */
+	double getCompressionRatio() const {
+		return bytesBeforeCompression == 0u ?
+		        1.0 : static_cast<double>(bytesAfterCompression) / static_cast<double>(bytesBeforeCompression);
+	}
+};
+
+/**
+ * An optional compression stage on top of a MessageFramer, which deflates each message in a single zlib stream per
+ * connection direction. Since the stream's history carries over between messages, repetitive traffic such as map
+ * and snapshot transfers compresses far better than compressing each message on its own.
+ *
+ * Both sides must call sendHandshake() once after connecting or accepting. The handshake tells the remote side
+ * whether compression is enabled and which dictionary is in use; compression is only used once both handshakes
+ * have been exchanged, both sides have it enabled and their dictionaries match. Messages sent before that, or
+ * shorter than the threshold, are sent uncompressed, so the handshake never delays sending.
+ *
+ * Each message costs one extra byte to say whether it's compressed. Messages returned by next() are only valid
+ * until the next call to next() or receive().
+ */
+class CompressedFramer {
+public:
+	explicit CompressedFramer(MessageFramer &framer, const CompressionOptions &options = CompressionOptions());
+	~CompressedFramer();
+
+	CompressedFramer(const CompressedFramer &other) = delete;
+	CompressedFramer &operator=(const CompressedFramer &other) = delete;
+
+	/**
+	 * Queues and flushes this side's handshake.
+	 */
+	int sendHandshake();
+
+	void queue(const BufferView &message);
+
+	void queue(const ByteBuffer &message) {
+		queue(message.view());
+	}
+
+	int flush() {
+		return framer.flush();
+	}
+
+	int receive(uint32_t length = 64u * 1024u) {
+		return framer.receive(length);
+	}
+
+	/**
+	 * Reads the next message, decompressing it if needed. The remote side's handshake is consumed here and never
+	 * returned. A corrupt compressed message puts the socket into an error state.
+	 * @return true if a message was read into message.
+	 */
+	bool next(BufferView &message);
+
+	/**
+	 * @return true once the remote side's handshake has been received.
+	 */
+	bool isNegotiated() const {
+		return negotiated;
+	}
+
+	/**
+	 * @return true if messages over the threshold are being compressed.
+	 */
+	bool isCompressing() const {
+		return compressing;
+	}
+
+	const CompressionStats &getStats() const {
+		return stats;
+	}
+
+	MessageFramer &getFramer() {
+		return framer;
+	}
+
+private:
+	MessageFramer &framer;
+	CompressionOptions options;
+
+	uint32_t dictionaryChecksum;
+
+	bool negotiated = false;
+	bool compressing = false;
+
+	z_stream deflater;
+	z_stream inflater;
+	bool deflaterReady = false;
+	bool inflaterReady = false;
+
+	byte_vector compressed;
+	byte_vector decompressed;
+
+	CompressionStats stats;
+
+	std::shared_ptr<spdlog::logger> logger;
+
+	void processHandshake(const BufferView &message);
+	bool inflateMessage(const BufferView &payload, BufferView &message);
+};
+
+}
+
+#endif
@@ -0,0 +1,195 @@
+#ifndef INCLUDE_APG_NET_IOURING_HPP_
+#define INCLUDE_APG_NET_IOURING_HPP_
+
+#ifndef APG_NO_NATIVE
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+
+#include <linux/io_uring.h>
+
+// multishot receive is the newest feature used, so its presence means the headers are new enough for everything
+#ifdef IORING_RECV_MULTISHOT
+#define APG_HAS_IO_URING
+#endif
+
+#endif
+#endif
+#endif
+
+#ifdef APG_HAS_IO_URING
+
+#include <cstddef>
+#include <cstdint>
+
+#include <memory>
+#include <vector>
+
+#include "spdlog/spdlog.h"
+
+namespace APG {
+
+/**
+ * A thin wrapper around an io_uring instance, using the system calls directly so that liburing isn't needed.
+ *
+ * SQEs are filled in with getSqe() and only passed to the kernel by submit(), so any number of operations can be
+ * submitted together, along with waiting for completions, in one system call. Completions are read straight from
+ * the shared completion ring with reapCompletions().
+ *
+ * Not thread safe.
+ */
+class IOUring {
+public:
+	/**
+	 * Checks that io_uring can be used and that the kernel supports the features NativeEventLoop needs (multishot
+	 * accept and receive, and provided buffer rings, which need Linux 6.0). The result is cached.
+	 */
+	static bool isSupported();
+
+	/**
+	 * @param entries the size of the submission queue; the completion queue is four times larger.
+	 */
+	explicit IOUring(uint32_t entries);
+	~IOUring();
+
+	IOUring(const IOUring &other) = delete;
+	IOUring &operator=(const IOUring &other) = delete;
+
+	bool isValid() const {
+		return ringFD != -1;
+	}
+
+	int getFileDescriptor() const {
+		return ringFD;
+	}
+
+	/**
+	 * Gets the next free SQE, cleared to zero, to be filled in and later submitted. If the submission queue is
+	 * full everything in it is submitted first.
+	 * @return the SQE, or nullptr if the queue was full and couldn't be submitted.
+	 */
+	io_uring_sqe *getSqe();
+
+	/**
+	 * Submits every SQE filled in since the last submit and runs any pending completion work. If waitCount is
+	 * above zero, waits for that many completions or until timeoutMilliseconds passes (forever if negative).
+	 * @return the number of SQEs submitted, or -1 on error.
+	 */
+	int submit(uint32_t waitCount = 0u, int timeoutMilliseconds = -1);
+
+	uint32_t getUnsubmittedCount() const {
+		return sqeTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+	}
+
+	/**
+	 * Calls handler with a copy of every completion available, oldest first. Each completion is removed from the
+	 * ring before handler is called, so handler may submit more work.
+	 * @return the number of completions handled.
+	 */
+	template<typename Handler> uint32_t reapCompletions(Handler &&handler) {
+		uint32_t count = 0u;
+		auto head = *cqHead;
+
+		while (head != __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+			const io_uring_cqe cqe = cqes[head & cqMask];
+
+			++head;
+			__atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+
+			handler(cqe);
+			++count;
+		}
+
+		return count;
+	}
+
+	/**
+	 * Registers a ring of provided buffers, which the kernel picks from for operations with IOSQE_BUFFER_SELECT
+	 * set and a matching buf_group.
+	 * @return true if the ring was registered.
+	 */
+	bool registerBufferRing(io_uring_buf_ring *bufferRing, uint32_t entries, uint16_t group);
+	void unregisterBufferRing(uint16_t group);
+
+private:
+	int ringFD = -1;
+
+	void *sqRing = nullptr;
+	size_t sqRingSize = 0u;
+	void *cqRing = nullptr;
+	size_t cqRingSize = 0u;
+
+	io_uring_sqe *sqes = nullptr;
+	size_t sqesSize = 0u;
+
+	uint32_t *sqHead = nullptr;
+	uint32_t *sqTail = nullptr;
+	uint32_t sqMask = 0u;
+	uint32_t sqEntries = 0u;
+
+	// SQEs up to here have been filled in; they're made visible to the kernel in submit()
+	uint32_t sqeTail = 0u;
+
+	uint32_t *cqHead = nullptr;
+	uint32_t *cqTail = nullptr;
+	uint32_t cqMask = 0u;
+	io_uring_cqe *cqes = nullptr;
+
+	std::shared_ptr<spdlog::logger> logger;
+
+	void unmapRings();
+};
+
+/**
+ * A ring of fixed-size receive buffers from BufferPool, registered with an IOUring as a provided buffer group.
+ * The kernel picks a buffer from the ring whenever a receive completes, so sockets with nothing to read don't tie
+ * up any memory. Buffers must be recycled once their data has been used.
+ */
+class IOUringBufferRing {
+public:
+	/**
+	 * @param bufferCount the number of buffers, which must be a power of two no larger than 32768.
+	 */
+	explicit IOUringBufferRing(IOUring &ring, uint16_t group, uint32_t bufferCount, uint32_t bufferSize);
+	~IOUringBufferRing();
+
+	IOUringBufferRing(const IOUringBufferRing &other) = delete;
+	IOUringBufferRing &operator=(const IOUringBufferRing &other) = delete;
+
+	bool isValid() const {
+		return registered;
+	}
+
+	uint16_t getGroup() const {
+		return group;
+	}
+
+	const uint8_t *getBuffer(uint16_t id) const {
+		return buffers[id];
+	}
+
+	/**
+	 * Gives a buffer back to the kernel to be used for future receives.
+	 */
+	void recycle(uint16_t id);
+
+private:
+	IOUring &ring;
+
+	const uint16_t group;
+	const uint32_t bufferSize;
+	const uint32_t mask;
+
+	io_uring_buf_ring *bufferRing = nullptr;
+	size_t bufferRingSize = 0u;
+
+	std::vector<uint8_t *> buffers;
+
+	uint16_t tail = 0u;
+	bool registered = false;
+};
+
+}
+
+#endif
+
+#endif
@@ -0,0 +1,105 @@
+#ifndef INCLUDE_APG_NET_MESSAGEFRAMER_HPP_
+#define INCLUDE_APG_NET_MESSAGEFRAMER_HPP_
+
+#include <cstdint>
+
+#include <memory>
+#include <vector>
+
+#include "spdlog/spdlog.h"
+
+#include "BufferView.hpp"
+#include "ByteBuffer.hpp"
+#include "Socket.hpp"
+
+namespace APG {
+
+/**
+ * Splits the byte stream of a Socket into discrete messages, each prefixed with its length as an unsigned LEB128
+ * varint (1 byte for messages under 128 bytes, 2 bytes under 16KiB).
+ *
+ * Outgoing messages are queued into a single batch which is sent with one call when flush() is called, so many
+ * small messages per tick cost one syscall. Large messages can be sent with sendNow() which doesn't copy them.
+ *
+ * Incoming messages are parsed incrementally from the socket's own buffer; next() yields a view of each complete
+ * message in place, without copying. Views are only valid until the next call to receive() or recv() on the socket.
+ * Incomplete messages are left in the socket's buffer until the rest arrives.
+ *
+ * A message with a malformed or oversized prefix puts the socket into an error state.
+ */
+class MessageFramer {
+public:
+	static constexpr const uint32_t DEFAULT_MAX_MESSAGE_SIZE = 16u * 1024u * 1024u;
+
+	explicit MessageFramer(Socket &socket, uint32_t maxMessageSize = DEFAULT_MAX_MESSAGE_SIZE);
+	~MessageFramer() = default;
+
+	MessageFramer(const MessageFramer &other) = delete;
+	MessageFramer &operator=(const MessageFramer &other) = delete;
+
+	/**
+	 * Copies a message into the outgoing batch, to be sent on the next flush().
+	 */
+	void queue(const uint8_t *data, uint32_t length);
+
+	void queue(const BufferView &message) {
+		queue(message.data, message.length);
+	}
+
+	void queue(const ByteBuffer &message) {
+		queue(message.view());
+	}
+
+	/**
+	 * Sends everything in the outgoing batch followed by the given message in one vectored send, without
+	 * copying the message. The batch is emptied either way, so on error the queued messages are discarded.
+	 * @return the number of bytes sent or queued by the socket; less on error.
+	 */
+	int sendNow(const BufferView &message);
+
+	/**
+	 * Sends every queued message with a single send. The batch is emptied either way, so on error the queued
+	 * messages are discarded.
+	 * @return the number of bytes sent or queued by the socket; less on error.
+	 */
+	int flush();
+
+	uint32_t getQueuedBytes() const {
+		return static_cast<uint32_t>(outgoing.size());
+	}
+
+	uint32_t getQueuedMessageCount() const {
+		return queuedMessages;
+	}
+
+	/**
+	 * Receives up to length bytes from the socket into its buffer, after which complete messages can be read
+	 * with next(). Invalidates any views returned by next().
+	 */
+	int receive(uint32_t length = 64u * 1024u);
+
+	/**
+	 * Reads the next complete message from the socket's buffer, if there is one.
+	 * @return true if a message was read into message; false if no complete message is available yet.
+	 */
+	bool next(BufferView &message);
+
+	Socket &getSocket() {
+		return socket;
+	}
+
+private:
+	static constexpr const uint32_t MAX_PREFIX_SIZE = ByteBuffer::MAX_VARINT32_SIZE;
+
+	Socket &socket;
+	const uint32_t maxMessageSize;
+
+	byte_vector outgoing;
+	uint32_t queuedMessages = 0u;
+
+	std::shared_ptr<spdlog::logger> logger;
+};
+
+}
+
+#endif
@@ -0,0 +1,179 @@
+#ifndef INCLUDE_APG_NET_NATIVECONNECTOR_HPP_
+#define INCLUDE_APG_NET_NATIVECONNECTOR_HPP_
+
+#include "NativeEventLoop.hpp"
+
+#ifdef APG_HAS_EPOLL
+
+#include <cstddef>
+#include <cstdint>
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "spdlog/spdlog.h"
+
+#include "NativeSocket.hpp"
+#include "NativeResolver.hpp"
+
+namespace APG {
+
+/**
+ * Opens outgoing connections without blocking the thread running a NativeEventLoop, as an alternative to
+ * NativeSocket::connect().
+ *
+ * Host names are resolved on a NativeResolver's thread (or straight from its cache), and connections are made with
+ * non-blocking connect() calls which complete through the loop. Where a host has several addresses they're tried
+ * in the order of RFC 8305 ("happy eyeballs"): address families are interleaved, and if an attempt hasn't succeeded
+ * after the attempt delay the next one is started alongside it, with the first to connect being used. An attempt
+ * which fails starts the next one straight away.
+ *
+ * Callbacks are called from inside the loop's poll(), never from connect(), and only once the connector has
+ * finished with its own state, so a callback can destroy the connector. Like the loop, not thread safe. Only
+ * available where NativeEventLoop is (APG_HAS_EPOLL).
+ */
+class NativeConnector {
+public:
+	static constexpr const uint32_t DEFAULT_ATTEMPT_DELAY_MILLISECONDS = 250u;
+	static constexpr const uint32_t DEFAULT_TIMEOUT_MILLISECONDS = 10u * 1000u;
+
+	/**
+	 * Called with the connected, non-blocking socket, or nullptr if the connection failed or timed out.
+	 */
+	using connect_callback = std::function<void(std::unique_ptr<Socket> socket)>;
+
+	/**
+	 * @param resolver the resolver to use, which can be shared between connectors; if nullptr, the connector
+	 *                 creates its own.
+	 */
+	explicit NativeConnector(NativeEventLoop &loop, std::shared_ptr<NativeResolver> resolver = nullptr);
+
+	/**
+	 * Cancels every pending connection without calling its callback.
+	 */
+	~NativeConnector();
+
+	NativeConnector(const NativeConnector &other) = delete;
+	NativeConnector &operator=(const NativeConnector &other) = delete;
+
+	/**
+	 * Starts connecting to host and port.
+	 * @param timeoutMilliseconds how long resolving and connecting can take altogether before giving up.
+	 * @return an ID which can be passed to cancel(), or 0 if the connection couldn't be started.
+	 */
+	uint64_t connect(const std::string &host, uint16_t port, connect_callback callback,
+	        uint32_t timeoutMilliseconds = DEFAULT_TIMEOUT_MILLISECONDS);
+
+	/**
+	 * Stops a pending connection without calling its callback.
+	 */
+	void cancel(uint64_t id);
+
+	size_t getPendingCount() const {
+		return pending.size();
+	}
+
+	void setAttemptDelay(uint32_t milliseconds) {
+		attemptDelay = std::chrono::milliseconds(milliseconds);
+	}
+
+	NativeResolver &getResolver() {
+		return *resolver;
+	}
+
+private:
+	using clock = std::chrono::steady_clock;
+
+	struct PendingConnect {
+		uint64_t id = 0u;
+
+		std::string host;
+		uint16_t port = 0u;
+
+		connect_callback callback;
+
+		// nullptr until the host has been resolved
+		NativeResolver::result_ptr resolved;
+
+		// addresses from resolved in the order they're to be tried
+		std::vector<const NativeResolver::Address *> order;
+		size_t nextAddress = 0u;
+
+		// descriptors of connect attempts in progress
+		std::vector<int> attempts;
+
+		clock::time_point nextAttemptTime;
+		clock::time_point deadline;
+
+		int lastError = 0;
+	};
+
+	// shared with resolver callbacks, which can outlive the connector
+	struct Inbox {
+		std::mutex mutex;
+		std::vector<std::pair<uint64_t, NativeResolver::result_ptr>> results;
+
+		// eventfd written to when results are added; -1 once the connector is destroyed
+		int wakeFD = -1;
+	};
+
+	NativeEventLoop &loop;
+	std::shared_ptr<NativeResolver> resolver;
+
+	std::shared_ptr<Inbox> inbox;
+
+	// a timerfd armed for the earliest attempt delay or deadline of any pending connection
+	int timerFD = -1;
+
+	std::unordered_map<uint64_t, std::unique_ptr<PendingConnect>> pending;
+	uint64_t nextID = 1u;
+
+	std::chrono::milliseconds attemptDelay { DEFAULT_ATTEMPT_DELAY_MILLISECONDS };
+
+	// callbacks of connections which finished during the current event, with their results
+	std::vector<std::pair<connect_callback, std::unique_ptr<Socket>>> finished;
+
+	std::shared_ptr<spdlog::logger> logger;
+
+	void handleResolved();
+	void handleTimer();
+	void handleAttempt(uint64_t id, int fd, uint32_t events);
+
+	/**
+	 * Starts, fails or times out the connection as needed, calling its callback if it finished.
+	 */
+	void advance(uint64_t id);
+
+	/**
+	 * @return true if an attempt was started, false if every remaining address failed immediately.
+	 */
+	bool startAttempt(PendingConnect &connect);
+
+	void closeAttempt(int fd);
+
+	/**
+	 * Queues the connection's callback in finished; it's called by callFinished().
+	 */
+	void succeed(uint64_t id, int fd);
+	void fail(uint64_t id, const std::string &reason);
+
+	/**
+	 * Calls and clears every queued callback. Must be the last thing an event handler does, as it doesn't touch
+	 * the connector after the first callback is called.
+	 */
+	void callFinished();
+
+	void rearmTimer();
+};
+
+}
+
+#endif
+
+#endif
@@ -0,0 +1,275 @@
+#ifndef INCLUDE_APG_NET_NATIVEEVENTLOOP_HPP_
+#define INCLUDE_APG_NET_NATIVEEVENTLOOP_HPP_
+
+#ifndef APG_NO_NATIVE
+#ifdef __linux__
+
+#define APG_HAS_EPOLL
+
+#include <cstddef>
+#include <cstdint>
+
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include <sys/epoll.h>
+
+#include "spdlog/spdlog.h"
+
+#include "NativeSocket.hpp"
+#include "ByteBuffer.hpp"
+#include "IOUring.hpp"
+#include "TimingWheel.hpp"
+
+namespace APG {
+
+/**
+ * A reactor which waits on many NativeSockets and NativeDualAcceptorSockets at once using epoll, and dispatches
+ * events for every ready socket from a single wait.
+ *
+ * Sockets are registered edge-triggered, so a readable callback is only called again once new data arrives after
+ * it was called; callbacks should recv() until no more data is returned. Likewise, a writable callback is called
+ * when a socket's send buffer goes from full to having space; any data in the socket's send queue is flushed before
+ * the callback is called. Acceptor callbacks are called once for every pending connection.
+ *
+ * Registered sockets are unregistered automatically when they're disconnected or destroyed. Sockets can be added
+ * and removed from inside callbacks.
+ *
+ * Not thread safe; each loop should be used by a single thread. Only available on Linux (APG_HAS_EPOLL is defined
+ * when it is available).
+ *
+ * With the IO_URING backend the loop drives sockets with completions rather than readiness: every socket has a
+ * multishot receive armed into a ring of pooled buffers, listeners have a multishot accept armed, and sends are
+ * handed to the kernel asynchronously. Operations queued between calls to poll() are submitted together with the
+ * wait in a single system call, so a busy server makes one system call per poll rather than one per recv, send and
+ * accept. Callbacks work the same way; recv() on a registered socket returns data which has already been received
+ * without a system call, and send() queues data which is sent at the start of the next poll() (or immediately, by
+ * calling flushSendQueue()). Sockets shouldn't be removed while a send is in flight unless they're disconnecting.
+ *
+ * The loop also owns a TimingWheel, so per-connection timeouts and heartbeats don't need a descriptor each; poll()
+ * never waits past the next timer and fires every timer which is due after dispatching events.
+ */
+class NativeEventLoop {
+public:
+	static constexpr const uint32_t EVENT_READABLE = 1u << 0u;
+	static constexpr const uint32_t EVENT_WRITABLE = 1u << 1u;
+	static constexpr const uint32_t EVENT_HANGUP = 1u << 2u;
+	static constexpr const uint32_t EVENT_ERROR = 1u << 3u;
+
+	enum class Backend {
+		EPOLL,
+
+		/**
+		 * Uses io_uring where the kernel supports it (Linux 6.0 and later), and falls back to EPOLL otherwise.
+		 */
+		IO_URING
+	};
+
+	static constexpr const uint32_t URING_RECEIVE_BUFFER_COUNT = 256u;
+	static constexpr const uint32_t URING_RECEIVE_BUFFER_SIZE = 16u * 1024u;
+
+	/**
+	 * With io_uring, receiving into a socket stops once this much received data is waiting for recv(), so a peer
+	 * which sends faster than the application reads is held back by TCP flow control as it would be with epoll.
+	 */
+	static constexpr const uint32_t URING_RECEIVE_QUEUE_LIMIT = 4u * URING_RECEIVE_BUFFER_SIZE;
+
+	/**
+	 * Called with the socket which had activity and a combination of EVENT_* flags describing what happened.
+	 */
+	using socket_callback = std::function<void(NativeSocket &socket, uint32_t events)>;
+
+	/**
+	 * Called with the acceptor which had a pending connection, and the newly accepted socket.
+	 */
+	using accept_callback = std::function<void(NativeDualAcceptorSocket &acceptor, std::unique_ptr<Socket> socket)>;
+
+	/**
+	 * Called with a combination of EVENT_* flags for a descriptor registered with addDescriptor.
+	 */
+	using descriptor_callback = std::function<void(uint32_t events)>;
+
+	/**
+	 * @param maxEventsPerWait the maximum number of events handled in one call to poll; any more are handled
+	 *                         in the next call. For IO_URING, this is the size of the submission queue instead.
+	 */
+	explicit NativeEventLoop(uint32_t maxEventsPerWait = 1024u, Backend backend = Backend::EPOLL);
+	~NativeEventLoop();
+
+	NativeEventLoop(const NativeEventLoop &other) = delete;
+	NativeEventLoop &operator=(const NativeEventLoop &other) = delete;
+
+	/**
+	 * Registers a connected socket with this loop. The socket must stay alive until it's removed, disconnected
+	 * or destroyed. A socket can only be registered with one loop at a time.
+	 * @return true if the socket was registered.
+	 */
+	bool add(NativeSocket *socket, socket_callback callback);
+
+	/**
+	 * Registers both listeners of a listening acceptor with this loop. Every connection accepted is set to
+	 * non-blocking mode before being passed to the callback.
+	 * @return true if the acceptor was registered.
+	 */
+	bool addAcceptor(NativeDualAcceptorSocket *acceptor, accept_callback callback);
+
+	/**
+	 * Registers any other non-blocking descriptor (e.g. a UDP socket) with this loop, edge-triggered for both
+	 * reading and writing. The descriptor must be removed before it's closed.
+	 * @return true if the descriptor was registered.
+	 */
+	bool addDescriptor(int fd, descriptor_callback callback);
+
+	void remove(NativeSocket *socket);
+	void removeAcceptor(NativeDualAcceptorSocket *acceptor);
+	void removeDescriptor(int fd);
+
+	/**
+	 * Schedules callback to be called from poll() once, after at least delayMilliseconds.
+	 * @return an ID which can be passed to cancelTimer.
+	 */
+	TimingWheel::timer_id addTimer(uint32_t delayMilliseconds, TimingWheel::timer_callback callback);
+
+	/**
+	 * @return true if the timer was scheduled and has now been cancelled.
+	 */
+	bool cancelTimer(TimingWheel::timer_id id);
+
+	TimingWheel &getTimers() {
+		return timers;
+	}
+
+	/**
+	 * Waits for up to timeoutMilliseconds for events (forever if negative, not at all if 0), or until the next
+	 * timer is due if that's sooner, then dispatches every event received and fires every timer which is due.
+	 * @return the number of events dispatched plus the number of timers fired, or -1 on error.
+	 */
+	int poll(int timeoutMilliseconds = 0);
+
+	size_t size() const {
+		return entries.size();
+	}
+
+	/**
+	 * @return the backend in use, which is EPOLL if IO_URING was asked for but isn't supported.
+	 */
+	Backend getBackend() const {
+		return backend;
+	}
+
+private:
+	friend class NativeSocket;
+
+	struct Entry {
+		int fd = -1;
+		bool active = true;
+
+		NativeSocket *socket = nullptr;
+		NativeDualAcceptorSocket *acceptor = nullptr;
+
+		socket_callback socketCallback;
+		accept_callback acceptCallback;
+		descriptor_callback descriptorCallback;
+
+		// io_uring state; operations in flight keep the entry alive after it's removed
+		uint32_t pendingOperations = 0u;
+		bool receiveArmed = false;
+		bool notifyArmed = false;
+		bool sendInFlight = false;
+		bool sendRequested = false;
+
+		// events collected while reaping completions, dispatched once afterwards
+		uint32_t readyEvents = 0u;
+
+		// data owned by an in-flight send, which the kernel reads from until the send completes
+		byte_vector sendBuffer;
+		uint32_t sendOffset = 0u;
+	};
+
+	Backend backend;
+
+	int epollFD = -1;
+
+	std::vector<epoll_event> events;
+
+	std::unordered_map<int, std::unique_ptr<Entry>> entries;
+
+	// entries removed during dispatch, kept alive until the dispatch finishes since later events may point at them
+	std::vector<std::unique_ptr<Entry>> removedEntries;
+
+	TimingWheel timers;
+
+	std::shared_ptr<spdlog::logger> logger;
+
+	int pollEpoll(int timeoutMilliseconds);
+
+	bool addEntry(std::unique_ptr<Entry> &&entry, uint32_t epollEvents);
+	void removeEntry(int fd);
+
+	void dispatchAccept(Entry &entry);
+
+#ifdef APG_HAS_IO_URING
+	enum class Operation : uint64_t {
+		RECEIVE = 1u,
+		SEND = 2u,
+		// multishot accept for acceptors, multishot poll for other descriptors
+		NOTIFY = 3u
+	};
+
+	static constexpr const uint64_t OPERATION_MASK = 3u;
+
+	std::unique_ptr<IOUring> ring;
+	std::unique_ptr<IOUringBufferRing> receiveBuffers;
+
+	// removed entries with operations still in flight
+	std::unordered_map<Entry *, std::unique_ptr<Entry>> drainingEntries;
+
+	// entries with events collected while reaping
+	std::vector<Entry *> readyEntries;
+
+	// descriptors of sockets with data queued to send
+	std::vector<int> pendingSends;
+
+	uint64_t operationsInFlight = 0u;
+
+	bool initIOUring(uint32_t entries);
+	void shutdownIOUring();
+
+	bool armReceive(Entry &entry);
+	bool armNotify(Entry &entry);
+	bool submitSend(Entry &entry);
+	void cancelOperations(Entry &entry);
+
+	/**
+	 * Cancels the socket's multishot receive once its receive queue passes URING_RECEIVE_QUEUE_LIMIT.
+	 */
+	void pauseReceive(Entry &entry);
+
+	/**
+	 * Called by a socket whose receive was paused once recv() has drained its queue below the limit.
+	 */
+	void resumeReceive(NativeSocket &socket);
+
+	/**
+	 * Called by a socket with data in its send queue, so it's sent at the start of the next poll.
+	 */
+	void requestSend(NativeSocket &socket, bool submitNow);
+	void submitPendingSends();
+
+	int pollIOUring(int timeoutMilliseconds);
+	void handleCompletion(const io_uring_cqe &cqe);
+	void completeReceive(Entry &entry, const io_uring_cqe &cqe);
+	void completeSend(Entry &entry, const io_uring_cqe &cqe);
+	void completeNotify(Entry &entry, const io_uring_cqe &cqe);
+	void markReady(Entry &entry, uint32_t events);
+#endif
+};
+
+}
+
+#endif
+#endif
+
+#endif
@@ -0,0 +1,132 @@
+#ifndef INCLUDE_APG_NET_NATIVERESOLVER_HPP_
+#define INCLUDE_APG_NET_NATIVERESOLVER_HPP_
+
+#ifndef APG_NO_NATIVE
+
+#include <cstddef>
+#include <cstdint>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "spdlog/spdlog.h"
+
+#include "NativeSocket.hpp"
+
+namespace APG {
+
+/**
+ * Resolves host names with getaddrinfo on a background thread, so that a slow DNS server can't stall the thread
+ * which asked. Results, including failures, are cached; lookups of the same host and port which arrive while one is
+ * already running share its result rather than queueing another.
+ *
+ * getaddrinfo doesn't report the TTLs of the records it found, so cached results expire after a fixed time instead,
+ * which is shorter for failures so that a host coming back is noticed quickly.
+ *
+ * Thread safe. Lookups run one at a time, in the order they were asked for.
+ */
+class NativeResolver {
+public:
+	static constexpr const uint32_t DEFAULT_CACHE_TTL_MILLISECONDS = 60u * 1000u;
+	static constexpr const uint32_t DEFAULT_NEGATIVE_CACHE_TTL_MILLISECONDS = 5u * 1000u;
+
+	// expired results are only cleared out once the cache is at least this big
+	static constexpr const size_t CACHE_PRUNE_SIZE = 1024u;
+
+	struct Address {
+		sockaddr_storage address;
+		socklen_t length;
+		int family;
+	};
+
+	struct Result {
+		std::vector<Address> addresses;
+
+		// 0 on success, or the error returned by getaddrinfo
+		int error = 0;
+
+		std::string getErrorMessage() const;
+	};
+
+	using result_ptr = std::shared_ptr<const Result>;
+
+	/**
+	 * Called on the resolver's thread when a lookup finishes; should return quickly.
+	 */
+	using resolve_callback = std::function<void(result_ptr result)>;
+
+	explicit NativeResolver(uint32_t cacheTTLMilliseconds = DEFAULT_CACHE_TTL_MILLISECONDS,
+	        uint32_t negativeCacheTTLMilliseconds = DEFAULT_NEGATIVE_CACHE_TTL_MILLISECONDS);
+
+	/**
+	 * Waits for any lookup which is running to finish; callbacks for lookups which hadn't finished aren't called.
+	 */
+	~NativeResolver();
+
+	NativeResolver(const NativeResolver &other) = delete;
+	NativeResolver &operator=(const NativeResolver &other) = delete;
+
+	/**
+	 * Looks up the addresses for host and port on the resolver's thread, then calls callback on that thread. A
+	 * cached result is used if there is one.
+	 */
+	void resolve(const std::string &host, uint16_t port, resolve_callback callback);
+
+	/**
+	 * @return the cached result for host and port if there is one which hasn't expired, or nullptr otherwise.
+	 */
+	result_ptr lookupCached(const std::string &host, uint16_t port);
+
+	void clearCache();
+
+	size_t getCacheSize() const;
+
+private:
+	using clock = std::chrono::steady_clock;
+
+	struct CacheEntry {
+		result_ptr result;
+		clock::time_point expiry;
+	};
+
+	const std::chrono::milliseconds cacheTTL;
+	const std::chrono::milliseconds negativeCacheTTL;
+
+	mutable std::mutex mutex;
+	std::condition_variable condition;
+
+	std::unordered_map<std::string, CacheEntry> cache;
+
+	// keys waiting to be looked up, and the callbacks waiting on each
+	std::deque<std::string> queue;
+	std::unordered_map<std::string, std::vector<resolve_callback>> waiting;
+
+	bool stopping = false;
+
+	std::thread thread;
+
+	std::shared_ptr<spdlog::logger> logger;
+
+	void run();
+
+	result_ptr lookup(const std::string &key) const;
+
+	// must be called with mutex held
+	result_ptr findCached(const std::string &key, clock::time_point now);
+
+	static std::string makeKey(const std::string &host, uint16_t port);
+};
+
+}
+
+#endif
+
+#endif
@@ -0,0 +1,157 @@
+#ifndef INCLUDE_APG_NET_NATIVESHARDEDACCEPTOR_HPP_
+#define INCLUDE_APG_NET_NATIVESHARDEDACCEPTOR_HPP_
+
+#include "NativeEventLoop.hpp"
+
+#ifdef APG_HAS_EPOLL
+
+#include <cstdint>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "spdlog/spdlog.h"
+
+#include "NativeSocket.hpp"
+#include "SocketStats.hpp"
+
+namespace APG {
+
+/**
+ * Accepts connections on one port from several threads at once. Each shard has its own SO_REUSEPORT listener
+ * (IPv4 and IPv6), its own NativeEventLoop and its own thread, and the kernel spreads incoming connections between
+ * the listeners, so a flood of connections is handled by every core rather than queueing behind one thread.
+ *
+ * The accept callback runs on the accepting shard's thread, and is expected to register the new socket with that
+ * shard's loop. Everything registered with a shard's loop is then only touched from that thread, so no locking is
+ * needed for per-connection state.
+ *
+ * Only available where NativeEventLoop is (APG_HAS_EPOLL).
+ */
+class NativeShardedAcceptor {
+public:
+	class Shard {
+	public:
+		uint32_t getIndex() const {
+			return index;
+		}
+
+		/**
+		 * Only safe to use from this shard's thread (e.g. in callbacks) while the acceptor is running.
+		 */
+		NativeEventLoop &getLoop() {
+			return loop;
+		}
+
+		NativeDualAcceptorSocket &getAcceptor() {
+			return *acceptor;
+		}
+
+		uint64_t getAcceptedCount() const {
+			return acceptedCount.load(std::memory_order_relaxed);
+		}
+
+	private:
+		friend class NativeShardedAcceptor;
+
+		explicit Shard(uint32_t index, uint16_t port, NativeEventLoop::Backend backend);
+
+		const uint32_t index;
+
+		std::unique_ptr<NativeDualAcceptorSocket> acceptor;
+		NativeEventLoop loop;
+
+		std::thread thread;
+
+		// an eventfd written to by stop() to wake the shard's loop
+		int wakeFD = -1;
+
+		std::atomic<uint64_t> acceptedCount { 0u };
+	};
+
+	/**
+	 * Called on the accepting shard's thread with the newly accepted, non-blocking socket.
+	 */
+	using accept_callback = std::function<void(Shard &shard, std::unique_ptr<Socket> socket)>;
+
+	/**
+	 * Opens shardCount listeners on port straight away, so failures can be checked with isListening() before
+	 * starting.
+	 * @param shardCount the number of listeners and threads, or 0 to use one per hardware thread.
+	 * @param backend the backend for every shard's event loop.
+	 */
+	explicit NativeShardedAcceptor(uint16_t port, uint32_t shardCount = 0u,
+	        NativeEventLoop::Backend backend = NativeEventLoop::Backend::EPOLL);
+	~NativeShardedAcceptor();
+
+	NativeShardedAcceptor(const NativeShardedAcceptor &other) = delete;
+	NativeShardedAcceptor &operator=(const NativeShardedAcceptor &other) = delete;
+
+	/**
+	 * Starts one thread per shard, each accepting connections and dispatching events for its loop until stop()
+	 * is called.
+	 * @return true if every shard was started.
+	 */
+	bool start(accept_callback callback);
+
+	/**
+	 * Wakes and joins every shard's thread. Sockets registered with a shard's loop stay registered, and can be
+	 * safely used or destroyed from any thread once this returns.
+	 */
+	void stop();
+
+	/**
+	 * @return true if every shard's listener was opened successfully.
+	 */
+	bool isListening() const;
+
+	bool isRunning() const {
+		return running.load(std::memory_order_acquire);
+	}
+
+	uint16_t getPort() const {
+		return port;
+	}
+
+	uint32_t getShardCount() const {
+		return static_cast<uint32_t>(shards.size());
+	}
+
+	Shard &getShard(uint32_t index) {
+		return *shards[index];
+	}
+
+	/**
+	 * @return the total number of connections accepted by every shard.
+	 */
+	uint64_t getAcceptedCount() const;
+
+	/**
+	 * @return the stats of every socket accepted by any shard; safe to use from any thread.
+	 */
+	const std::shared_ptr<SocketStatsGroup> &getStatsGroup() const {
+		return statsGroup;
+	}
+
+private:
+	const uint16_t port;
+
+	std::shared_ptr<SocketStatsGroup> statsGroup;
+
+	std::vector<std::unique_ptr<Shard>> shards;
+
+	std::atomic<bool> running { false };
+
+	std::shared_ptr<spdlog::logger> logger;
+
+	void runShard(Shard &shard);
+};
+
+}
+
+#endif
+
+#endif
@@ -3,8 +3,11 @@
 
 #ifndef APG_NO_NATIVE
 
+#include <cstdint>
+
 #include <string>
 #include <memory>
+#include <vector>
 
 #ifdef _WIN32
 // WIN32_LEAN_AND_MEAN should be defined at build time
@@ -28,6 +31,7 @@
 #include <netdb.h>
 #include <unistd.h>
 #include <netinet/tcp.h>
+#include <sys/uio.h>
 #endif
 
 #include "spdlog/spdlog.h"
@@ -37,6 +41,8 @@
 
 namespace APG {
 
+class NativeEventLoop;
+
 class NativeSocketUtil {
 public:
 	using addrinfo_ptr = std::unique_ptr<addrinfo, void(*)(addrinfo*)>;
@@ -69,10 +75,13 @@ public:
 	 * If ip4 or ip6 fails, the corresponding ip4Socket or ip6Socket will be set to mimic the other socket that succeeded,
 	 * although there will only be one real socket and it will obviously only support one protocol.
 	 *
+	 * If reusePort is true, SO_REUSEPORT is set on both sockets before binding so that several sockets can listen on
+	 * the same port, with the kernel spreading incoming connections between them.
+	 *
 	 * @return a DualSocketReturn describing what the outcome of the function was.
 	 */
 	static DualSocketReturn findValidDualSockets(int &ip4Socket, int &ip6Socket, const addrinfo_ptr &ptr,
-	        addrinfo **targetStruct4 = nullptr, addrinfo **targetStruct6 = nullptr);
+	        addrinfo **targetStruct4 = nullptr, addrinfo **targetStruct6 = nullptr, bool reusePort = false);
 
 	/**
 	 * Close the given socket FD; implemented here to handle differences between Windows and other
@@ -92,6 +101,12 @@ public:
 
 	static std::string getErrorMessage(int errorCode);
 
+	/**
+	 * @return true if errorCode from accept() only means the connection being accepted failed (e.g. the peer
+	 *         reset it first), so the listener is fine and other connections may still be waiting.
+	 */
+	static bool isConnectionAcceptError(int errorCode);
+
 #ifdef _WIN32
 	static constexpr const int APGWOULDBLOCK = WSAEWOULDBLOCK;
 #else
@@ -129,18 +144,60 @@ public:
 	explicit NativeSocket(int fd, const std::string &str, uint16_t port, uint32_t bufferSize = BB_DEFAULT_SIZE);
 	virtual ~NativeSocket();
 
+	static constexpr const uint32_t DEFAULT_SEND_QUEUE_LOW_WATERMARK = 64u * 1024u;
+	static constexpr const uint32_t DEFAULT_SEND_QUEUE_HIGH_WATERMARK = 256u * 1024u;
+
+	/**
+	 * Sends as much of the buffer as the kernel will accept without blocking, and queues the rest.
+	 */
 	virtual int send() override final;
 
+	using Socket::sendv;
+
+	/**
+	 * Sends every view with as few sendmsg calls as possible (usually one); anything which can't be sent
+	 * immediately is copied into the send queue.
+	 *
+	 * On Windows, each view is deliberately sent with its own call to ::send instead, which still avoids copying
+	 * but makes one system call per view.
+	 */
+	virtual int sendv(const BufferView *views, uint32_t viewCount) override final;
+
+	virtual int flushSendQueue() override final;
+
+	virtual uint32_t getSendQueueSize() const override final {
+		return static_cast<uint32_t>(sendQueue.size()) - sendQueueHead + sendInFlight;
+	}
+
+	virtual bool isSendBackpressured() const override final {
+		return backpressured;
+	}
+
+	/**
+	 * Sets the queue sizes, in bytes, at which the socket starts and stops reporting backpressure.
+	 */
+	void setSendWatermarks(uint32_t lowWatermark, uint32_t highWatermark);
+
 	virtual int recv(uint32_t length = 1024u) override final;
 
 	virtual bool hasActivity() override final;
 
 	virtual bool waitForActivity(uint32_t millisecondsToWait = 0u) override final;
 
+	/**
+	 * Resolves the host and connects, blocking until both are done; use a NativeConnector to connect without
+	 * blocking.
+	 */
 	virtual void connect() override final;
 	virtual void disconnect() override final;
 
+	int getFileDescriptor() const {
+		return internalSocket;
+	}
+
 private:
+	friend class NativeEventLoop;
+
 	void addToSet();
 	const std::string portString;
 
@@ -148,6 +205,55 @@ private:
 
 	fd_set socketSet;
 
+	// the loop this socket is registered with, if any
+	NativeEventLoop *eventLoop = nullptr;
+
+	// data accepted by send() but not yet accepted by the kernel; bytes before sendQueueHead have been sent
+	byte_vector sendQueue;
+	uint32_t sendQueueHead = 0u;
+
+	uint32_t lowWatermark = DEFAULT_SEND_QUEUE_LOW_WATERMARK;
+	uint32_t highWatermark = DEFAULT_SEND_QUEUE_HIGH_WATERMARK;
+	bool backpressured = false;
+
+	// with an io_uring event loop, the number of bytes taken from the send queue by a send which hasn't completed
+	uint32_t sendInFlight = 0u;
+
+	// with an io_uring event loop, data received by the loop which recv() hasn't returned yet
+	byte_vector receiveQueue;
+	uint32_t receiveQueueHead = 0u;
+	int receiveError = 0;
+
+	// set by the loop when the receive queue passed its limit and receiving was stopped until recv() drains it
+	bool receivePaused = false;
+
+#ifndef _WIN32
+	// reused between calls to sendv to avoid allocating
+	std::vector<iovec> iovecs;
+#endif
+
+	/**
+	 * Calls ::send until everything is sent or the call would block.
+	 * @return the number of bytes sent, or -1 on error.
+	 */
+	int sendSome(const uint8_t *data, uint32_t length);
+
+	/**
+	 * Sends from the views until everything is sent or the call would block. On return, firstView and offset
+	 * give the first byte which wasn't sent.
+	 * @return the number of bytes sent, or -1 on error.
+	 */
+	int sendSomeVectored(const BufferView *views, uint32_t viewCount, uint32_t &firstView, uint32_t &offset);
+
+	void queueSend(const uint8_t *data, uint32_t length);
+
+	bool isUsingIOUring() const;
+
+	/**
+	 * Moves up to length bytes from the receive queue into the buffer.
+	 */
+	int recvQueued(uint32_t length);
+
 	std::shared_ptr<spdlog::logger> logger;
 };
 
@@ -156,12 +262,20 @@ private:
  *
  * Will attempt to create 2 sockets listening on the same port; one for IPv4, one for IPv6.
  * If one of those is not available, it can be queried using hasIPXSupport for X = {4, 6}.
+ *
+ * If reusePort is true, the listeners are opened with SO_REUSEPORT so that several acceptors can listen on the same
+ * port at once; see NativeShardedAcceptor. This isn't supported on Windows.
  */
 class NativeDualAcceptorSocket : public AcceptorSocket {
 public:
-	explicit NativeDualAcceptorSocket(uint16_t port_, bool autoListen = false, uint32_t bufferSize = BB_DEFAULT_SIZE);
+	explicit NativeDualAcceptorSocket(uint16_t port_, bool autoListen = false, uint32_t bufferSize = BB_DEFAULT_SIZE,
+	        bool reusePort = false);
 	virtual ~NativeDualAcceptorSocket();
 
+	/**
+	 * Waits for a connection on either listener using select(), without spinning. Accepted sockets are
+	 * non-blocking.
+	 */
 	virtual std::unique_ptr<Socket> acceptSocket(float maxWaitInSeconds = -1.0f) override final;
 	virtual std::unique_ptr<Socket> acceptSocketOnce() override final;
 
@@ -175,13 +289,43 @@ public:
 		return supportsIP6;
 	}
 
+	bool isReusingPort() const {
+		return reusePort;
+	}
+
+	int getIP4FileDescriptor() const {
+		return internalListener4;
+	}
+
+	int getIP6FileDescriptor() const {
+		return internalListener6;
+	}
+
 protected:
 	virtual void listen() override final;
 
 private:
-	static constexpr const int CONNECTION_BACKLOG_SIZE = 10;
+	friend class NativeEventLoop;
+
+	// large enough that a burst of logins isn't refused while the accepting thread catches up
+	static constexpr const int CONNECTION_BACKLOG_SIZE = SOMAXCONN;
+
+	NativeEventLoop *eventLoop = nullptr;
+
+	enum class AcceptResult {
+		ACCEPTED,
+		SKIPPED, // a connection was waiting but failed before it could be set up; others may still be waiting
+		WOULD_BLOCK, // no connections are waiting
+		FAILED // the listener has an error, which is also set on the acceptor
+	};
+
+	/**
+	 * Tries once to accept a connection on the given listener, storing it in accepted if successful.
+	 */
+	AcceptResult acceptFrom(int listenerFD, std::unique_ptr<Socket> &accepted);
 
 	const std::string portString;
+	const bool reusePort;
 
 	int internalListener4 = -1;
 	int internalListener6 = -1;
@@ -189,6 +333,9 @@ private:
 	bool supportsIP4 = false;
 	bool supportsIP6 = false;
 
+	// alternates which listener acceptSocketOnce tries
+	bool acceptIP4Next = false;
+
 	std::shared_ptr<spdlog::logger> logger;
 };
 
@@ -31,6 +31,14 @@ public:
 	virtual ~SDLSocket();
 
 	virtual int send() override final;
+
+	using Socket::sendv;
+
+	/**
+	 * Sends each view with its own call, since SDL_net has no vectored send.
+	 */
+	virtual int sendv(const BufferView *views, uint32_t viewCount) override final;
+
 	virtual int recv(uint32_t length = 1024u) override final;
 
 	virtual bool hasActivity() override final;
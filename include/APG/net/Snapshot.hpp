@@ -0,0 +1,136 @@
+#ifndef INCLUDE_APG_NET_SNAPSHOT_HPP_
+#define INCLUDE_APG_NET_SNAPSHOT_HPP_
+
+#include <cstdint>
+
+#include <string>
+#include <vector>
+
+namespace APG {
+
+/**
+ * Describes the fields every entity in a Snapshot has, and how many bits each takes on the wire.
+ *
+ * Integers are stored in a fixed number of bits; signed values should be zigzag encoded first. Floats are
+ * quantised to an integer within [minimum, maximum] at a given precision, so e.g. a position in [-512, 512] to
+ * the nearest 1/64 only takes 16 bits.
+ *
+ * The schema must be identical on the sender and the receiver.
+ */
+class SnapshotSchema {
+public:
+	struct Field {
+		std::string name;
+		uint32_t bits;
+
+		bool quantisedFloat;
+		float minimum;
+		float maximum;
+		float precision;
+	};
+
+	/**
+	 * @return the index of the new field, used to access it in a Snapshot.
+	 */
+	uint32_t addInteger(const std::string &name, uint32_t bits);
+	uint32_t addBool(const std::string &name);
+	uint32_t addFloat(const std::string &name, float minimum, float maximum, float precision);
+
+	uint32_t quantise(uint32_t field, float value) const;
+	float dequantise(uint32_t field, uint32_t value) const;
+
+	uint32_t getFieldCount() const {
+		return static_cast<uint32_t>(fields.size());
+	}
+
+	const Field &getField(uint32_t field) const {
+		return fields[field];
+	}
+
+private:
+	std::vector<Field> fields;
+};
+
+/**
+ * The state of every replicated entity at one tick. Entities are identified by an ID and have a value for every
+ * field in the schema, stored quantised; a new entity starts with every field 0.
+ *
+ * Entities are kept sorted by ID so snapshots can be compared cheaply; adding them in ascending ID order is
+ * fastest. Clearing and refilling a snapshot reuses its storage.
+ *
+ * The schema must outlive the snapshot.
+ */
+class Snapshot {
+public:
+	explicit Snapshot(const SnapshotSchema &schema);
+
+	void clear();
+
+	uint32_t getTick() const {
+		return tick;
+	}
+
+	void setTick(uint32_t tick_) {
+		tick = tick_;
+	}
+
+	void addEntity(uint32_t id);
+	void removeEntity(uint32_t id);
+	bool hasEntity(uint32_t id) const;
+
+	uint32_t getEntityCount() const {
+		return static_cast<uint32_t>(entityIDs.size());
+	}
+
+	/**
+	 * @return the ID of the index-th entity, in ascending order.
+	 */
+	uint32_t getEntityID(uint32_t index) const {
+		return entityIDs[index];
+	}
+
+	/**
+	 * Setters add the entity if it doesn't already exist.
+	 */
+	void setInteger(uint32_t id, uint32_t field, uint32_t value);
+	void setBool(uint32_t id, uint32_t field, bool value);
+	void setFloat(uint32_t id, uint32_t field, float value);
+
+	/**
+	 * Getters return 0 for entities which don't exist.
+	 */
+	uint32_t getInteger(uint32_t id, uint32_t field) const;
+	bool getBool(uint32_t id, uint32_t field) const;
+	float getFloat(uint32_t id, uint32_t field) const;
+
+	const SnapshotSchema &getSchema() const {
+		return *schema;
+	}
+
+private:
+	friend class SnapshotEncoder;
+	friend class SnapshotDecoder;
+
+	const SnapshotSchema *schema;
+	uint32_t tick = 0u;
+
+	std::vector<uint32_t> entityIDs;
+
+	// getFieldCount() values for each entity, in the same order as entityIDs
+	std::vector<uint32_t> values;
+
+	int32_t findEntity(uint32_t id) const;
+	uint32_t addEntityIndex(uint32_t id);
+
+	const uint32_t *entityValues(uint32_t index) const {
+		return values.data() + static_cast<size_t>(index) * schema->getFieldCount();
+	}
+
+	uint32_t *entityValues(uint32_t index) {
+		return values.data() + static_cast<size_t>(index) * schema->getFieldCount();
+	}
+};
+
+}
+
+#endif
@@ -0,0 +1,149 @@
+#ifndef INCLUDE_APG_NET_SNAPSHOTREPLICATION_HPP_
+#define INCLUDE_APG_NET_SNAPSHOTREPLICATION_HPP_
+
+#include <cstdint>
+
+#include <unordered_map>
+#include <vector>
+
+#include "spdlog/spdlog.h"
+
+#include "BufferView.hpp"
+#include "ByteBuffer.hpp"
+#include "Snapshot.hpp"
+
+namespace APG {
+
+/**
+ * Encodes the world state for each client as a delta against the last snapshot that client acknowledged,
+ * containing only entities which were added, removed or changed, and only the fields which changed. Fields are
+ * bit-packed at their schema width, and small changes to wide fields are sent as a few bits of difference.
+ *
+ * Each tick, commit() the world's snapshot then encode() it for each client and send it, typically on an unreliable
+ * channel. Clients acknowledge the ticks they decode (see SnapshotDecoder::getLatestTick()) and those acks are
+ * passed to acknowledge(). If a client's acks stop arriving its deltas grow relative to its old baseline, and once
+ * that baseline falls out of the history a full snapshot is sent instead, so a client always catches up.
+ */
+class SnapshotEncoder {
+public:
+	static constexpr const uint32_t DEFAULT_HISTORY_SIZE = 32u;
+
+	explicit SnapshotEncoder(const SnapshotSchema &schema, uint32_t historySize = DEFAULT_HISTORY_SIZE);
+	~SnapshotEncoder() = default;
+
+	SnapshotEncoder(const SnapshotEncoder &other) = delete;
+	SnapshotEncoder &operator=(const SnapshotEncoder &other) = delete;
+
+	/**
+	 * Copies a snapshot into the history; it becomes the snapshot sent by encode(). Ticks must increase with
+	 * each commit.
+	 */
+	void commit(const Snapshot &snapshot);
+
+	/**
+	 * Records that a client has received the snapshot for a tick, making it that client's baseline. Stale or
+	 * unknown ticks are ignored.
+	 */
+	void acknowledge(uint32_t clientID, uint32_t tick);
+
+	/**
+	 * Forgets a client's baseline, so the next encode() for it sends a full snapshot.
+	 */
+	void removeClient(uint32_t clientID);
+
+	/**
+	 * Appends the latest committed snapshot, delta encoded for the given client, to out.
+	 * @return the number of bytes written.
+	 */
+	uint32_t encode(uint32_t clientID, ByteBuffer &out);
+
+	uint64_t getFullSnapshotCount() const {
+		return fullSnapshots;
+	}
+
+	uint64_t getDeltaSnapshotCount() const {
+		return deltaSnapshots;
+	}
+
+	uint64_t getBytesEncoded() const {
+		return bytesEncoded;
+	}
+
+private:
+	struct ClientState {
+		bool hasBaseline = false;
+		uint32_t baselineTick = 0u;
+	};
+
+	const SnapshotSchema &schema;
+
+	std::vector<Snapshot> history;
+	std::vector<uint8_t> historyValid;
+
+	bool hasLatest = false;
+	uint32_t latestTick = 0u;
+
+	std::unordered_map<uint32_t, ClientState> clients;
+
+	uint64_t fullSnapshots = 0u;
+	uint64_t deltaSnapshots = 0u;
+	uint64_t bytesEncoded = 0u;
+
+	const Snapshot *findSnapshot(uint32_t tick) const;
+};
+
+/**
+ * Decodes snapshots written by a SnapshotEncoder, keeping a history of decoded snapshots to use as baselines for
+ * later deltas. After each successful decode the application should acknowledge getLatestTick() to the sender.
+ */
+class SnapshotDecoder {
+public:
+	explicit SnapshotDecoder(const SnapshotSchema &schema, uint32_t historySize =
+	        SnapshotEncoder::DEFAULT_HISTORY_SIZE);
+	~SnapshotDecoder() = default;
+
+	SnapshotDecoder(const SnapshotDecoder &other) = delete;
+	SnapshotDecoder &operator=(const SnapshotDecoder &other) = delete;
+
+	/**
+	 * @return true if a newer snapshot was decoded; false if the data was malformed, older than the latest
+	 *         snapshot, or a delta against a baseline which is no longer held.
+	 */
+	bool decode(const BufferView &data);
+
+	bool decode(const ByteBuffer &data) {
+		return decode(data.view());
+	}
+
+	bool hasSnapshot() const {
+		return hasLatest;
+	}
+
+	uint32_t getLatestTick() const {
+		return latestTick;
+	}
+
+	/**
+	 * @return the most recently decoded snapshot; only valid if hasSnapshot() is true.
+	 */
+	const Snapshot &getLatest() const;
+
+private:
+	const SnapshotSchema &schema;
+
+	std::vector<Snapshot> history;
+	std::vector<uint8_t> historyValid;
+
+	bool hasLatest = false;
+	uint32_t latestTick = 0u;
+
+	Snapshot scratch;
+
+	std::shared_ptr<spdlog::logger> logger;
+
+	const Snapshot *findSnapshot(uint32_t tick) const;
+};
+
+}
+
+#endif
@@ -32,23 +32,19 @@
 
 #include <memory>
 #include <array>
+#include <initializer_list>
 #include <string>
+#include <vector>
 
+#include "BufferView.hpp"
 #include "ByteBuffer.hpp"
+#include "SocketStats.hpp"
 
 // if APG_SOCKET_NO_AUTO_CLEAR is defined, sockets will not empty their buffers
-// after send()ing data or before recv()ing data, which puts the burden on the
-// programmer
+// after send()ing data or discard already-read data before recv()ing data,
+// which puts the burden on the programmer
 // #define APG_SOCKET_NO_AUTO_CLEAR
 
-#ifndef APG_RECV_BUFFER_SIZE
-
-// the size of the buffer used to recv() on this socket, to prevent having to
-// create a new buffer every recv()
-#define APG_RECV_BUFFER_SIZE 2048
-
-#endif
-
 namespace APG {
 /**
  * This is a class for implementing shared functionality between Socket and AcceptorSocket;
@@ -92,21 +88,70 @@ private:
 class Socket : public SocketCommon {
 public:
 	explicit Socket(const std::string &remoteHost, uint16_t port, uint32_t bufferSize = BB_DEFAULT_SIZE);
-	virtual ~Socket() = default;
+	virtual ~Socket();
 
 	const uint16_t port;
 	const std::string remoteHost;
 
 	/**
 	 * Send all data currently in the buffer.
-	 * @return the number of bytes sent which should match the size() of the buffer; less on error.
+	 *
+	 * Sockets which support non-blocking sends may not be able to send everything immediately; in that case the
+	 * rest is added to an outbound queue which is sent by later calls to flushSendQueue() (or send()), in order.
+	 *
+	 * @return the number of bytes sent or queued which should match the size() of the buffer; less on error.
 	 */
 	virtual int send() = 0;
 
-	// TODO: sendOnce() ?
+	/**
+	 * Sends the contents of several buffers, in order, as if they'd been put into this socket's buffer and sent,
+	 * without copying them where possible. The socket's own buffer is left untouched.
+	 *
+	 * This allows e.g. one snapshot to be broadcast to many sockets with a per-socket header without copying
+	 * the snapshot for each socket.
+	 *
+	 * @return the total number of bytes sent or queued; less on error.
+	 */
+	virtual int sendv(const BufferView *views, uint32_t viewCount) = 0;
+
+	int sendv(std::initializer_list<BufferView> views) {
+		return sendv(views.begin(), static_cast<uint32_t>(views.size()));
+	}
+
+	int sendv(const std::vector<BufferView> &views) {
+		return sendv(views.data(), static_cast<uint32_t>(views.size()));
+	}
+
+	/**
+	 * Tries to send data queued by earlier calls to send() without blocking.
+	 * @return the number of bytes sent.
+	 */
+	virtual int flushSendQueue() {
+		return 0;
+	}
+
+	/**
+	 * @return the number of bytes queued by send() which haven't yet been sent.
+	 */
+	virtual uint32_t getSendQueueSize() const {
+		return 0u;
+	}
 
 	/**
-	 * Read up to length bytes of data into the buffer.
+	 * True once the send queue grows past its high watermark, until it has drained below its low watermark.
+	 * Callers should stop sending to a socket while this is true, so slow consumers can't grow the queue forever.
+	 */
+	virtual bool isSendBackpressured() const {
+		return false;
+	}
+
+	/**
+	 * Read up to length bytes of data, appending it to the buffer. Data is received directly into the buffer
+	 * without any intermediate copy, and there's no limit on length.
+	 *
+	 * Bytes before the read position are discarded first, but bytes which haven't been read yet are kept, so
+	 * a message split across several recv() calls can be read once all of it has arrived.
+	 *
 	 * @return the number of bytes actually read; 0 if an error occurred.
 	 */
 	virtual int recv(uint32_t length = 1024u) = 0;
@@ -125,8 +170,36 @@ public:
 	virtual void connect() = 0;
 	virtual void disconnect() = 0;
 
+	/**
+	 * Traffic counters for this socket, updated as it sends and receives.
+	 */
+	SocketStats &getStats() {
+		return stats;
+	}
+
+	const SocketStats &getStats() const {
+		return stats;
+	}
+
+	/**
+	 * Adds this socket's stats to a group, removing them from any previous group; acceptors do this for every
+	 * socket they accept. Pass nullptr to just remove them.
+	 */
+	void setStatsGroup(std::shared_ptr<SocketStatsGroup> group);
+
 protected:
-	std::unique_ptr<uint8_t[]> recvBuffer;
+	SocketStats stats;
+
+	/**
+	 * Discards data which has already been read, keeping unread data. Called at the start of recv().
+	 *
+	 * Unread data is only moved to the start of the buffer once more than half of the buffer has been read,
+	 * so each byte is moved at most once on average.
+	 */
+	void discardReadData();
+
+private:
+	std::shared_ptr<SocketStatsGroup> statsGroup;
 };
 
 /**
@@ -161,9 +234,31 @@ public:
 	 * Just calls listen.
 	 */
 	virtual void connect() override final;
+
+	/**
+	 * @return the group every socket accepted by this acceptor is added to.
+	 */
+	const std::shared_ptr<SocketStatsGroup> &getStatsGroup() const {
+		return statsGroup;
+	}
+
+	/**
+	 * Replaces the group accepted sockets are added to, e.g. so several acceptors can share one.
+	 */
+	void setStatsGroup(std::shared_ptr<SocketStatsGroup> group);
+
 protected:
 
 	virtual void listen() = 0;
+
+	/**
+	 * Adds a newly accepted socket to this acceptor's stats group.
+	 * @return socket, which may be nullptr.
+	 */
+	std::unique_ptr<Socket> trackAccepted(std::unique_ptr<Socket> socket);
+
+private:
+	std::shared_ptr<SocketStatsGroup> statsGroup;
 };
 
 }
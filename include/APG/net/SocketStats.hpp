@@ -0,0 +1,242 @@
+#ifndef INCLUDE_APG_NET_SOCKETSTATS_HPP_
+#define INCLUDE_APG_NET_SOCKETSTATS_HPP_
+
+#include <cstdint>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <utility>
+
+#include "spdlog/spdlog.h"
+
+namespace APG {
+
+/**
+ * Traffic counters and a send latency histogram for one socket, kept up to date by the socket as it sends and
+ * receives. Every counter has a single writer (the thread using the socket) so updates are plain loads and stores
+ * rather than locked instructions, which makes them cheap enough to always leave on; snapshot() can be called
+ * from any thread.
+ *
+ * Send latency is measured from a call to send() or sendv() until the kernel has accepted the last byte of it, so
+ * it includes time spent in the socket's send queue. Latencies are bucketed by powers of two of microseconds.
+ * At most MAX_QUEUED_SENDS queued sends are tracked at once, so recording never allocates; sends queued while
+ * that many are already waiting aren't sampled.
+ */
+class SocketStats {
+public:
+	using clock = std::chrono::steady_clock;
+
+	// bucket 0 holds latencies under 1us, bucket i latencies under 2^i us; the last holds everything longer
+	static constexpr const uint32_t LATENCY_BUCKET_COUNT = 32u;
+
+	static constexpr const uint32_t MAX_QUEUED_SENDS = 64u;
+
+	struct Snapshot {
+		// the number of sockets counted; more than 1 for a SocketStatsGroup
+		uint64_t connections = 0u;
+
+		uint64_t bytesSent = 0u;
+		uint64_t bytesReceived = 0u;
+
+		// messages are only counted by a MessageFramer using the socket
+		uint64_t messagesSent = 0u;
+		uint64_t messagesReceived = 0u;
+
+		// system calls (or io_uring operations) made to send or receive
+		uint64_t sendCalls = 0u;
+		uint64_t receiveCalls = 0u;
+
+		// sends which the kernel only accepted some of, leaving the rest queued
+		uint64_t partialSends = 0u;
+
+		// calls which failed with EAGAIN / EWOULDBLOCK
+		uint64_t wouldBlocks = 0u;
+
+		// bytes in the send queue when the snapshot was taken, and the most there has ever been
+		uint64_t sendQueueDepth = 0u;
+		uint64_t maxSendQueueDepth = 0u;
+
+		std::array<uint64_t, LATENCY_BUCKET_COUNT> sendLatency;
+
+		Snapshot() {
+			sendLatency.fill(0u);
+		}
+
+		/**
+		 * Adds other's counts to these; queue depths are summed, except the maximum which is the larger of the two.
+		 */
+		void merge(const Snapshot &other);
+
+		uint64_t getSendLatencyCount() const;
+
+		/**
+		 * @return an upper bound on the given percentile (0 to 100) of send latencies in microseconds, or 0 if
+		 *         nothing has been sent.
+		 */
+		uint64_t getSendLatencyPercentile(double percentile) const;
+
+		/**
+		 * @return every counter and the 50th, 99th and 99.9th percentile send latencies on one line, as
+		 *         space-separated name=value pairs.
+		 */
+		std::string toString() const;
+
+		void log(spdlog::logger &logger, const std::string &label) const;
+
+		/**
+		 * Appends a line with the time, the label and toString() to the file at path.
+		 * @return true if the line was written.
+		 */
+		bool appendToFile(const std::string &path, const std::string &label) const;
+	};
+
+	SocketStats();
+
+	SocketStats(const SocketStats &other) = delete;
+	SocketStats &operator=(const SocketStats &other) = delete;
+
+	Snapshot snapshot() const;
+
+	/**
+	 * Zeroes every counter; only safe to call from the thread using the socket.
+	 */
+	void reset();
+
+	void addBytesSent(uint64_t count) {
+		add(bytesSent, count);
+	}
+
+	void addBytesReceived(uint64_t count) {
+		add(bytesReceived, count);
+	}
+
+	void addMessagesSent(uint64_t count) {
+		add(messagesSent, count);
+	}
+
+	void addMessagesReceived(uint64_t count) {
+		add(messagesReceived, count);
+	}
+
+	void addSendCall() {
+		add(sendCalls, 1u);
+	}
+
+	void addReceiveCall() {
+		add(receiveCalls, 1u);
+	}
+
+	void addPartialSend() {
+		add(partialSends, 1u);
+	}
+
+	void addWouldBlock() {
+		add(wouldBlocks, 1u);
+	}
+
+	void setSendQueueDepth(uint64_t depth);
+
+	/**
+	 * Records a send which was completely accepted by the kernel before returning.
+	 */
+	void recordSendLatency(clock::time_point started, clock::time_point finished = clock::now());
+
+	/**
+	 * Records that length bytes from a send started at the given time were left in the send queue; their latency
+	 * is recorded once markDequeued has been called for every byte queued before and including them. Not recorded
+	 * if MAX_QUEUED_SENDS sends are already waiting.
+	 */
+	void markQueued(uint32_t length, clock::time_point started);
+
+	/**
+	 * Records that length bytes at the front of the send queue have been accepted by the kernel.
+	 */
+	void markDequeued(uint32_t length);
+
+	/**
+	 * Forgets everything in the send queue, e.g. when it's discarded after an error.
+	 */
+	void discardQueued();
+
+private:
+	std::atomic<uint64_t> bytesSent { 0u };
+	std::atomic<uint64_t> bytesReceived { 0u };
+	std::atomic<uint64_t> messagesSent { 0u };
+	std::atomic<uint64_t> messagesReceived { 0u };
+	std::atomic<uint64_t> sendCalls { 0u };
+	std::atomic<uint64_t> receiveCalls { 0u };
+	std::atomic<uint64_t> partialSends { 0u };
+	std::atomic<uint64_t> wouldBlocks { 0u };
+	std::atomic<uint64_t> sendQueueDepth { 0u };
+	std::atomic<uint64_t> maxSendQueueDepth { 0u };
+
+	std::array<std::atomic<uint64_t>, LATENCY_BUCKET_COUNT> sendLatency;
+
+	// the total bytes ever queued and dequeued, and a ring of the queued total and start time at the end of each
+	// queued send
+	uint64_t queuedTotal = 0u;
+	uint64_t dequeuedTotal = 0u;
+
+	std::array<std::pair<uint64_t, clock::time_point>, MAX_QUEUED_SENDS> queuedSends;
+	uint32_t queuedSendsStart = 0u;
+	uint32_t queuedSendsCount = 0u;
+
+	static void add(std::atomic<uint64_t> &counter, uint64_t count) {
+		// only ever written by one thread, so this needn't be an atomic read-modify-write
+		counter.store(counter.load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+	}
+};
+
+/**
+ * Aggregates the stats of many sockets, such as every socket accepted by an acceptor. Sockets add themselves with
+ * Socket::setStatsGroup and remove themselves when they're destroyed, at which point their final counts are kept
+ * so that totals never go backwards. Thread safe.
+ */
+class SocketStatsGroup {
+public:
+	SocketStatsGroup() = default;
+
+	SocketStatsGroup(const SocketStatsGroup &other) = delete;
+	SocketStatsGroup &operator=(const SocketStatsGroup &other) = delete;
+
+	void attach(const SocketStats *stats);
+	void detach(const SocketStats *stats);
+
+	/**
+	 * @return the combined counts of every socket ever attached; connections counts the sockets currently
+	 *         attached.
+	 */
+	SocketStats::Snapshot snapshot() const;
+
+	/**
+	 * @return the number of sockets ever attached.
+	 */
+	uint64_t getTotalConnections() const;
+
+	void log(spdlog::logger &logger, const std::string &label) const {
+		snapshot().log(logger, label);
+	}
+
+	bool appendToFile(const std::string &path, const std::string &label) const {
+		return snapshot().appendToFile(path, label);
+	}
+
+private:
+	mutable std::mutex mutex;
+
+	std::unordered_set<const SocketStats *> attached;
+
+	// counts from sockets which have been detached
+	SocketStats::Snapshot detached;
+
+	uint64_t totalConnections = 0u;
+};
+
+}
+
+#endif
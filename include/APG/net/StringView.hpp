@@ -0,0 +1,81 @@
+#ifndef INCLUDE_APG_NET_STRINGVIEW_HPP_
+#define INCLUDE_APG_NET_STRINGVIEW_HPP_
+
+#include <cstdint>
+#include <cstring>
+
+#include <string>
+
+namespace APG {
+
+/**
+ * A non-owning view of a run of characters which isn't null terminated, such as a string read from a ByteBuffer
+ * without copying it.
+ *
+ * The same lifetime rules as BufferView apply: a view into a ByteBuffer is invalidated by anything which might move
+ * the buffer's contents, such as writing past its capacity, resize(), clear(), compact() or a socket receiving.
+ * Reading from the buffer never invalidates views. Call toString() to keep the contents for longer.
+ */
+struct StringView {
+	const char *data = nullptr;
+	uint32_t length = 0u;
+
+	StringView() = default;
+
+	StringView(const char *data, uint32_t length) :
+			data{data},
+			length{length} {
+	}
+
+	bool empty() const {
+		return length == 0u;
+	}
+
+	uint32_t size() const {
+		return length;
+	}
+
+	const char *begin() const {
+		return data;
+	}
+
+	const char *end() const {
+		return data + length;
+	}
+
+	char operator[](uint32_t index) const {
+		return data[index];
+	}
+
+	std::string toString() const {
+		return std::string(data, length);
+	}
+
+	bool operator==(const StringView &other) const {
+		return length == other.length && (length == 0u || std::memcmp(data, other.data, length) == 0);
+	}
+
+	bool operator!=(const StringView &other) const {
+		return !(*this == other);
+	}
+
+	bool operator==(const std::string &other) const {
+		return *this == StringView(other.data(), static_cast<uint32_t>(other.size()));
+	}
+
+	bool operator!=(const std::string &other) const {
+		return !(*this == other);
+	}
+
+	bool operator==(const char *other) const {
+		return *this == StringView(other, static_cast<uint32_t>(std::strlen(other)));
+	}
+
+	bool operator!=(const char *other) const {
+		return !(*this == other);
+	}
+};
+
+}
+
+#endif
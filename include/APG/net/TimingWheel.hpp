@@ -0,0 +1,176 @@
+#ifndef INCLUDE_APG_NET_TIMINGWHEEL_HPP_
+#define INCLUDE_APG_NET_TIMINGWHEEL_HPP_
+
+#include <cstddef>
+#include <cstdint>
+
+#include <array>
+#include <chrono>
+#include <functional>
+#include <vector>
+
+namespace APG {
+
+/**
+ * A hierarchical timing wheel for large numbers of timers which are mostly cancelled or rescheduled before they
+ * fire, such as idle timeouts, heartbeats and resend timers for every connection on a server.
+ *
+ * Time is divided into ticks. Timers due within the next 256 ticks are kept in one slot per tick; later timers are
+ * kept in three coarser levels of 64 slots each, and are moved down a level each time the level below wraps around.
+ * Scheduling and cancelling are O(1) and don't allocate once the wheel has grown to its working size, and advancing
+ * only touches the slots for ticks which have passed, skipping ahead when the levels below a cascade are empty, and
+ * fires every timer due in a tick together. With the default 1ms tick, timers up to about 18 hours away are placed
+ * directly; later ones are cascaded until they're due.
+ *
+ * Timers never fire early, but can fire up to a tick late. Callbacks are called from advance() and may schedule
+ * and cancel timers, including themselves; calls to advance() from inside a callback do nothing. Not thread safe.
+ */
+class TimingWheel {
+public:
+	using clock = std::chrono::steady_clock;
+
+	/**
+	 * Identifies a scheduled timer. IDs aren't reused, so cancelling a timer which has already fired is harmless.
+	 */
+	using timer_id = uint64_t;
+	using timer_callback = std::function<void()>;
+
+	static constexpr const timer_id INVALID_TIMER = 0u;
+
+	explicit TimingWheel(std::chrono::milliseconds tickLength = std::chrono::milliseconds(1), clock::time_point start =
+	        clock::now());
+
+	TimingWheel(const TimingWheel &other) = delete;
+	TimingWheel &operator=(const TimingWheel &other) = delete;
+
+	/**
+	 * Schedules callback to be called once, delay after now.
+	 */
+	timer_id schedule(std::chrono::milliseconds delay, timer_callback callback);
+
+	/**
+	 * Schedules callback to be called once, at or just after deadline.
+	 */
+	timer_id scheduleAt(clock::time_point deadline, timer_callback callback);
+
+	/**
+	 * @return true if the timer was scheduled and has now been cancelled.
+	 */
+	bool cancel(timer_id id);
+
+	bool isScheduled(timer_id id) const;
+
+	/**
+	 * Fires every timer which is due by now, in order of their deadlines (timers in the same tick fire in the order
+	 * they were scheduled).
+	 * @return the number of timers fired.
+	 */
+	uint32_t advance(clock::time_point now = clock::now());
+
+	/**
+	 * @return the time until the earliest timer is due, rounded up to a whole millisecond, or -1 if no timers are
+	 *         scheduled; suitable for use as a poll timeout. Timers far in the future are only found once they're
+	 *         cascaded, so this can be earlier than the earliest timer (by at most the time until the cascade).
+	 */
+	int getMillisecondsUntilNextTimer(clock::time_point now = clock::now());
+
+	size_t size() const {
+		return timerCount;
+	}
+
+	bool empty() const {
+		return timerCount == 0u;
+	}
+
+	std::chrono::milliseconds getTickLength() const {
+		return tickLength;
+	}
+
+private:
+	static constexpr const uint32_t NONE = 0xFFFFFFFFu;
+
+	static constexpr const uint32_t NEAR_BITS = 8u;
+	static constexpr const uint32_t NEAR_SLOTS = 1u << NEAR_BITS;
+	static constexpr const uint32_t FAR_BITS = 6u;
+	static constexpr const uint32_t FAR_SLOTS = 1u << FAR_BITS;
+	static constexpr const uint32_t FAR_LEVELS = 3u;
+
+	static constexpr const uint32_t SLOT_COUNT = NEAR_SLOTS + FAR_SLOTS * FAR_LEVELS;
+
+	// the list timers being fired are moved to, so that callbacks can still cancel them
+	static constexpr const uint32_t FIRING_SLOT = SLOT_COUNT;
+
+	struct Node {
+		uint64_t expiry = 0u;
+		timer_callback callback;
+
+		uint32_t prev = NONE;
+		uint32_t next = NONE;
+
+		// the slot this node is listed in, or NONE if it's free
+		uint32_t slot = NONE;
+
+		// bumped every time the node is freed, so old IDs stop matching
+		uint32_t generation = 1u;
+	};
+
+	const std::chrono::milliseconds tickLength;
+	const clock::time_point start;
+
+	// every tick up to and including this one has been processed
+	uint64_t currentTick = 0u;
+
+	std::vector<Node> nodes;
+	uint32_t freeList = NONE;
+
+	std::array<uint32_t, SLOT_COUNT + 1u> slotHeads;
+	std::array<uint32_t, SLOT_COUNT + 1u> slotTails;
+
+	size_t timerCount = 0u;
+
+	// timers in the near level and each far level, so runs of ticks with nothing to do can be skipped
+	std::array<uint32_t, FAR_LEVELS + 1u> levelCounts;
+
+	bool advancing = false;
+
+	// the tick of the next timer to fire or far slot to cascade, whichever is first, cached while nextEventValid
+	uint64_t nextEvent = 0u;
+	bool nextEventValid = false;
+
+	uint64_t toTickRoundingUp(clock::time_point time) const;
+	uint64_t toTickRoundingDown(clock::time_point time) const;
+
+	uint32_t allocateNode();
+	void freeNode(uint32_t index);
+
+	void link(uint32_t index, uint32_t slot);
+	void unlink(uint32_t index);
+
+	/**
+	 * Lists a node in the slot for its expiry relative to the current tick.
+	 */
+	void place(uint32_t index);
+
+	/**
+	 * Moves every timer in a far slot down to the level (or levels) below.
+	 */
+	void cascade(uint32_t level, uint32_t slotInLevel);
+
+	uint32_t fireSlot(uint32_t slot);
+
+	uint64_t findNextEvent() const;
+
+	static uint32_t getLevel(uint32_t slot) {
+		return slot < NEAR_SLOTS ? 0u : 1u + (slot - NEAR_SLOTS) / FAR_SLOTS;
+	}
+
+	timer_id makeID(uint32_t index) const {
+		return (static_cast<uint64_t>(nodes[index].generation) << 32u) | index;
+	}
+
+	uint32_t findNode(timer_id id) const;
+};
+
+}
+
+#endif
@@ -0,0 +1,401 @@
+#ifndef INCLUDE_APG_NET_UDPENDPOINT_HPP_
+#define INCLUDE_APG_NET_UDPENDPOINT_HPP_
+
+#ifndef APG_NO_NATIVE
+
+#include <cstdint>
+
+#include <array>
+#include <chrono>
+#include <functional>
+#include <list>
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "spdlog/spdlog.h"
+
+#include "BufferView.hpp"
+#include "ByteBuffer.hpp"
+#include "NativeSocket.hpp"
+#include "NativeEventLoop.hpp"
+
+namespace APG {
+
+enum class UDPChannel : uint8_t {
+	/**
+	 * Sent once; may be lost, duplicated messages are dropped and messages may arrive out of order.
+	 */
+	UNRELIABLE = 0,
+
+	/**
+	 * Resent until acknowledged and delivered exactly once, in whatever order they arrive.
+	 */
+	RELIABLE_UNORDERED = 1,
+
+	/**
+	 * Resent until acknowledged and delivered exactly once, in the order they were sent.
+	 */
+	RELIABLE_ORDERED = 2
+};
+
+class UDPEndpoint;
+
+/**
+ * A virtual connection to a remote UDPEndpoint. Created and owned by a UDPEndpoint.
+ */
+class UDPConnection {
+public:
+	enum class State {
+		CONNECTING,
+		CONNECTED,
+		DISCONNECTED
+	};
+
+	using clock = std::chrono::steady_clock;
+
+	explicit UDPConnection(UDPEndpoint *endpoint, const sockaddr_storage &address, socklen_t addressLength);
+	~UDPConnection() = default;
+
+	UDPConnection(const UDPConnection &other) = delete;
+	UDPConnection &operator=(const UDPConnection &other) = delete;
+
+	/**
+	 * Copies a message to be sent on the given channel on the next UDPEndpoint::update(). Messages larger than
+	 * UDPEndpoint::FRAGMENT_SIZE are split into fragments and reassembled by the receiver.
+	 *
+	 * Messages sent while connecting are sent once the connection is established.
+	 *
+	 * @return false if the message is too large or the connection is closed.
+	 */
+	bool send(UDPChannel channel, const BufferView &message);
+
+	bool send(UDPChannel channel, const ByteBuffer &message) {
+		return send(channel, message.view());
+	}
+
+	/**
+	 * Tells the remote endpoint we're leaving and closes the connection. The disconnect callback is called and the
+	 * connection destroyed on the next UDPEndpoint::update().
+	 */
+	void disconnect();
+
+	State getState() const {
+		return state;
+	}
+
+	bool isConnected() const {
+		return state == State::CONNECTED;
+	}
+
+	const std::string &getRemoteHost() const {
+		return remoteHost;
+	}
+
+	uint16_t getRemotePort() const {
+		return remotePort;
+	}
+
+	/**
+	 * @return the smoothed round trip time in seconds.
+	 */
+	float getRoundTripTime() const {
+		return roundTripTime;
+	}
+
+	/**
+	 * @return the number of reliable messages which haven't yet been acknowledged.
+	 */
+	uint32_t getReliableBacklog() const {
+		return static_cast<uint32_t>(reliableOutgoing.size());
+	}
+
+private:
+	friend class UDPEndpoint;
+
+	static constexpr const uint32_t CHANNEL_COUNT = 3u;
+	static constexpr const uint32_t SEQUENCE_BUFFER_SIZE = 1024u;
+
+	struct OutgoingMessage {
+		UDPChannel channel = UDPChannel::UNRELIABLE;
+		uint16_t id = 0u;
+
+		byte_vector data;
+
+		uint16_t fragmentCount = 1u;
+		uint16_t fragmentsAcked = 0u;
+
+		byte_vector fragmentAcked;
+		std::vector<clock::time_point> fragmentSentAt;
+	};
+
+	struct FragmentRef {
+		uint32_t messageKey;
+		uint16_t fragment;
+	};
+
+	struct SentPacket {
+		uint16_t sequence = 0u;
+		bool valid = false;
+		bool acked = false;
+
+		clock::time_point sentAt;
+		std::vector<FragmentRef> fragments;
+	};
+
+	struct Reassembly {
+		uint16_t fragmentCount = 0u;
+		uint16_t fragmentsReceived = 0u;
+		uint32_t length = 0u;
+
+		byte_vector data;
+		byte_vector received;
+
+		clock::time_point startedAt;
+	};
+
+	UDPEndpoint *endpoint;
+
+	sockaddr_storage address;
+	socklen_t addressLength;
+
+	std::string remoteHost;
+	uint16_t remotePort = 0u;
+
+	State state = State::CONNECTING;
+
+	// true if we connected to the remote endpoint, false if it connected to us
+	bool initiator = false;
+
+	uint32_t clientSalt = 0u;
+	uint32_t serverSalt = 0u;
+	uint32_t connectionID = 0u;
+
+	clock::time_point createdAt;
+	clock::time_point lastReceivedAt;
+	clock::time_point lastSentAt;
+
+	bool ackPending = false;
+
+	float roundTripTime = 0.1f;
+
+	// outgoing
+	uint16_t localSequence = 0u;
+	std::array<uint16_t, CHANNEL_COUNT> nextMessageIDs;
+
+	std::vector<OutgoingMessage> unreliableOutgoing;
+	std::list<OutgoingMessage> reliableOutgoing;
+	std::unordered_map<uint32_t, std::list<OutgoingMessage>::iterator> reliableIndex;
+
+	std::vector<SentPacket> sentPackets;
+
+	// incoming
+	uint16_t remoteSequence = 0u;
+	bool receivedAnyPacket = false;
+	std::vector<int32_t> receivedPackets;
+
+	std::vector<int32_t> receivedUnorderedIDs;
+
+	uint16_t nextOrderedID = 0u;
+	std::unordered_map<uint16_t, byte_vector> orderedStash;
+
+	std::unordered_map<uint32_t, Reassembly> reassemblies;
+
+	// bytes held by reassemblies and orderedStash, which are limited so a peer can't make us buffer without bound
+	uint32_t bufferedBytes = 0u;
+
+	void processAcks(uint16_t ack, uint32_t ackBits, clock::time_point now);
+	void acknowledgeFragment(const FragmentRef &fragment);
+
+	bool recordReceivedPacket(uint16_t sequence);
+	uint32_t buildAckBits() const;
+
+	void receiveFragment(UDPChannel channel, uint16_t messageID, uint16_t fragment, uint16_t fragmentCount,
+	        const uint8_t *data, uint16_t length, clock::time_point now);
+	void receiveMessage(UDPChannel channel, uint16_t messageID, const uint8_t *data, uint32_t length);
+
+	bool alreadyReceived(UDPChannel channel, uint16_t messageID) const;
+
+	/**
+	 * Drops an unreliable message, or disconnects if the message was reliable.
+	 */
+	void bufferLimitReached(UDPChannel channel);
+
+	static uint32_t makeMessageKey(UDPChannel channel, uint16_t messageID) {
+		return (static_cast<uint32_t>(channel) << 16u) | messageID;
+	}
+};
+
+/**
+ * A UDP socket which multiplexes virtual connections to other UDPEndpoints, providing a connection handshake,
+ * packet acknowledgement with sequence numbers and ack bitfields, unreliable, reliable-unordered and
+ * reliable-ordered channels, and fragmentation and reassembly of large messages. Unlike TCP, a lost packet only
+ * delays messages on reliable-ordered channels.
+ *
+ * Received datagrams are processed by receive(), which can be called automatically by attaching the endpoint to
+ * a NativeEventLoop. update() must be called regularly (e.g. every tick) to send queued messages, resend lost
+ * reliable messages, acknowledge received packets and time out dead connections.
+ *
+ * Packets are built using ByteBuffer and so use native byte order; both ends must have the same endianness.
+ *
+ * The data each connection can make us hold for partly reassembled or out of order messages is limited. Past the
+ * limit, unreliable messages are dropped and a connection sending reliable messages is disconnected.
+ *
+ * Not thread safe.
+ */
+class UDPEndpoint {
+public:
+	using connection_callback = std::function<void(UDPConnection &connection)>;
+
+	/**
+	 * Called for each message received. The message view is only valid until the callback returns.
+	 */
+	using message_callback = std::function<void(UDPConnection &connection, UDPChannel channel,
+	        const BufferView &message)>;
+
+	static constexpr const uint32_t MAX_PACKET_SIZE = 1200u;
+	static constexpr const uint32_t FRAGMENT_SIZE = 1024u;
+	static constexpr const uint32_t MAX_FRAGMENTS = 256u;
+	static constexpr const uint32_t MAX_MESSAGE_SIZE = FRAGMENT_SIZE * MAX_FRAGMENTS;
+
+	/**
+	 * @param port the port to bind to; 0 binds an ephemeral port, which is what clients usually want.
+	 * @param acceptConnections if true, connection requests from other endpoints are accepted.
+	 */
+	explicit UDPEndpoint(uint16_t port = 0u, bool acceptConnections = false);
+	~UDPEndpoint();
+
+	UDPEndpoint(const UDPEndpoint &other) = delete;
+	UDPEndpoint &operator=(const UDPEndpoint &other) = delete;
+
+	/**
+	 * Starts connecting to a remote endpoint which accepts connections. The connection callback is called once
+	 * the handshake completes, or the disconnect callback if it times out. If two endpoints which both accept
+	 * connections connect to each other at the same time, one of them accepts the other's request instead.
+	 * @return the new connection, which is owned by this endpoint; nullptr on failure.
+	 */
+	UDPConnection *connect(const std::string &host, uint16_t port);
+
+	/**
+	 * Reads and processes every datagram waiting on the socket.
+	 */
+	void receive();
+
+	/**
+	 * Sends queued and unacknowledged messages, acks and keepalives, and times out connections.
+	 * Connections which were disconnected are destroyed here, after their disconnect callback.
+	 *
+	 * Disconnect callbacks are called at the end of update() and receive(), once the endpoint has finished with
+	 * its connections, so a callback can safely call connect() to reconnect.
+	 */
+	void update();
+
+#ifdef APG_HAS_EPOLL
+	/**
+	 * Registers this endpoint's socket with an event loop, so receive() is called whenever datagrams arrive.
+	 */
+	bool attach(NativeEventLoop &loop);
+	void detach();
+#endif
+
+	void setConnectCallback(connection_callback callback) {
+		connectCallback = std::move(callback);
+	}
+
+	void setDisconnectCallback(connection_callback callback) {
+		disconnectCallback = std::move(callback);
+	}
+
+	void setMessageCallback(message_callback callback) {
+		messageCallback = std::move(callback);
+	}
+
+	size_t getConnectionCount() const {
+		return connections.size();
+	}
+
+	bool hasError() const {
+		return error;
+	}
+
+	int getFileDescriptor() const {
+		return internalSocket;
+	}
+
+private:
+	friend class UDPConnection;
+
+	using clock = UDPConnection::clock;
+
+	int internalSocket = -1;
+	int socketFamily = AF_UNSPEC;
+
+	bool acceptConnections;
+	bool error = false;
+
+	std::unordered_map<std::string, std::unique_ptr<UDPConnection>> connections;
+
+	// connections closed since their disconnect callbacks were last called
+	std::vector<UDPConnection *> closedConnections;
+
+	// connections removed from connections which are kept alive until the end of the current update() or receive()
+	std::vector<std::unique_ptr<UDPConnection>> retiredConnections;
+
+	connection_callback connectCallback;
+	connection_callback disconnectCallback;
+	message_callback messageCallback;
+
+	ByteBuffer packet;
+	byte_vector receiveBuffer;
+
+	std::mt19937 random;
+
+#ifdef APG_HAS_EPOLL
+	NativeEventLoop *eventLoop = nullptr;
+#endif
+
+	std::shared_ptr<spdlog::logger> logger;
+
+	void processPacket(const sockaddr_storage &address, socklen_t addressLength, const uint8_t *data,
+	        uint32_t length, clock::time_point now);
+	void processConnectRequest(const sockaddr_storage &address, socklen_t addressLength, uint32_t clientSalt,
+	        clock::time_point now);
+	void processData(UDPConnection &connection, const uint8_t *data, uint32_t length, clock::time_point now);
+
+	void updateConnection(UDPConnection &connection, clock::time_point now);
+	void sendDataPackets(UDPConnection &connection, clock::time_point now);
+
+	void beginDataPacket(UDPConnection &connection, clock::time_point now);
+	void finishDataPacket(UDPConnection &connection, clock::time_point now);
+
+	void sendConnectRequest(UDPConnection &connection);
+	void sendConnectAccept(UDPConnection &connection);
+	void sendDisconnect(UDPConnection &connection);
+
+	void sendPacket(const UDPConnection &connection);
+
+	/**
+	 * Marks the connection as disconnected; its disconnect callback is called by finishCallbacks().
+	 */
+	void closeConnection(UDPConnection &connection);
+
+	/**
+	 * Replaces or removes the connection stored under key, keeping the old one alive until finishCallbacks().
+	 */
+	void retireConnection(const std::string &key);
+
+	/**
+	 * Calls the disconnect callback for each closed connection, then destroys retired connections.
+	 */
+	void finishCallbacks();
+
+	static std::string addressKey(const sockaddr_storage &address);
+};
+
+}
+
+#endif
+
+#endif
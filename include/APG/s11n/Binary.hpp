@@ -0,0 +1,657 @@
+#ifndef INCLUDE_APG_S11N_BINARY_HPP_
+#define INCLUDE_APG_S11N_BINARY_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <memory>
+#include <string>
+#include <typeindex>
+#include <typeinfo>
+#include <type_traits>
+#include <vector>
+
+#include "spdlog/spdlog.h"
+
+#include "APG/net/ByteBuffer.hpp"
+
+namespace APG {
+
+/**
+ * Describes the fields of a type for BinaryWriter and BinaryReader. Specialise it for each type to be serialised,
+ * giving a schema VERSION (starting at 1, incremented whenever fields are added) and a visit function which passes
+ * every field to the archive in order:
+ *
+ *     template<> struct BinaryFields<PlayerState> {
+ *         static constexpr const uint32_t VERSION = 2u;
+ *
+ *         template<typename Archive, typename Value> static void visit(Archive &archive, Value &value) {
+ *             archive(value.id, value.name, asFixed(value.x), asFixed(value.y));
+ *             archive.since(2u, value.inventory);
+ *         }
+ *     };
+ *
+ * Value is const when writing. New fields must be added at the end with since(), so that data written with an
+ * older version leaves them as they were, and readers built with an older version skip them. Types whose fields
+ * were all there from the first version can use APG_BINARY_FIELDS instead.
+ */
+template<typename T> struct BinaryFields {
+};
+
+enum class BinaryEncoding {
+	// LEB128, zigzag encoded for signed types; small values take fewer bytes
+	VARINT,
+
+	// little endian, always sizeof(T) bytes
+	FIXED
+};
+
+template<typename T, BinaryEncoding Encoding> struct BinaryEncoded {
+	T &value;
+};
+
+/**
+ * Writes an integer (or a vector or array of them) with a fixed size rather than as a varint, e.g. for values which
+ * are usually large, such as hashes. Arrays of fixed size values are copied in bulk.
+ */
+template<typename T> BinaryEncoded<T, BinaryEncoding::FIXED> asFixed(T &value) {
+	return BinaryEncoded<T, BinaryEncoding::FIXED> { value };
+}
+
+/**
+ * Writes a vector or array of integers as varints rather than in bulk, for lists of mostly small values.
+ */
+template<typename T> BinaryEncoded<T, BinaryEncoding::VARINT> asVarint(T &value) {
+	return BinaryEncoded<T, BinaryEncoding::VARINT> { value };
+}
+
+namespace detail {
+
+#if defined(__BYTE_ORDER__) && defined(__ORDER_BIG_ENDIAN__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+constexpr const bool BINARY_HOST_LITTLE_ENDIAN = false;
+#else
+constexpr const bool BINARY_HOST_LITTLE_ENDIAN = true;
+#endif
+
+template<typename T, typename = void> struct HasBinaryFields : std::false_type {
+};
+
+template<typename T> struct HasBinaryFields<T, decltype(static_cast<void>(BinaryFields<T>::VERSION))> : std::true_type {
+};
+
+/**
+ * Arrays of these types are written with a single copy: arithmetic types in little endian order (so only on
+ * little endian hosts), and other trivially copyable types without BinaryFields in host layout, which must then
+ * be the same for the writer and the reader.
+ */
+template<typename T> struct IsBinaryBulk : std::integral_constant<bool,
+        (std::is_arithmetic<T>::value && !std::is_same<T, bool>::value && BINARY_HOST_LITTLE_ENDIAN)
+                || (std::is_trivially_copyable<T>::value && std::is_class<T>::value && !HasBinaryFields<T>::value)> {
+};
+
+template<typename T> struct IsBinaryFixedBulk : std::integral_constant<bool,
+        std::is_arithmetic<T>::value && !std::is_same<T, bool>::value && BINARY_HOST_LITTLE_ENDIAN> {
+};
+
+}
+
+/**
+ * Writes values to the end of a ByteBuffer in a compact binary format:
+ *
+ * - bool and 8 bit integers are single bytes
+ * - other integers are varints by default (see asFixed); floating point values are fixed size
+ * - enums are written as their underlying type
+ * - strings are written as by ByteBuffer::putLengthPrefixedString
+ * - vectors are a varint count followed by their elements; std::arrays are just their elements. Arrays of
+ *   arithmetic and other trivially copyable types are copied in bulk.
+ * - types with BinaryFields are their varint schema version, a varint length, and their fields
+ *
+ * Everything is written in the same format on every platform, except bulk copies of trivially copyable class types.
+ */
+class BinaryWriter {
+public:
+	explicit BinaryWriter(ByteBuffer &buffer) :
+			buffer(buffer) {
+	}
+
+	template<typename ... Fields> void operator()(Fields &&... fields) {
+		using expand = int[];
+		static_cast<void>(expand { 0, (write(fields), 0)... });
+	}
+
+	/**
+	 * Writes a field added in the given schema version; every field is always written.
+	 */
+	template<typename T> void since(uint32_t, T &&field) {
+		write(field);
+	}
+
+	void write(bool value) {
+		buffer.put(static_cast<uint8_t>(value ? 1u : 0u));
+	}
+
+	template<typename T> typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value>::type write(
+	        const T &value) {
+		writeVarint(value);
+	}
+
+	template<typename T> typename std::enable_if<std::is_floating_point<T>::value>::type write(const T &value) {
+		writeFixed(value);
+	}
+
+	template<typename T> typename std::enable_if<std::is_enum<T>::value>::type write(const T &value) {
+		write(static_cast<typename std::underlying_type<T>::type>(value));
+	}
+
+	void write(const std::string &value) {
+		buffer.putLengthPrefixedString(value);
+	}
+
+	template<typename T, typename Alloc> void write(const std::vector<T, Alloc> &values) {
+		buffer.putVarUInt32(static_cast<uint32_t>(values.size()));
+		writeElements(values.data(), static_cast<uint32_t>(values.size()), detail::IsBinaryBulk<T>());
+	}
+
+	template<typename Alloc> void write(const std::vector<bool, Alloc> &values) {
+		buffer.putVarUInt32(static_cast<uint32_t>(values.size()));
+
+		for (const bool value : values) {
+			write(value);
+		}
+	}
+
+	template<typename T, size_t N> void write(const std::array<T, N> &values) {
+		writeElements(values.data(), static_cast<uint32_t>(N), detail::IsBinaryBulk<T>());
+	}
+
+	template<typename T> void write(const BinaryEncoded<T, BinaryEncoding::FIXED> &encoded) {
+		writeFixed(encoded.value);
+	}
+
+	template<typename T> void write(const BinaryEncoded<T, BinaryEncoding::VARINT> &encoded) {
+		writeVarint(encoded.value);
+	}
+
+	template<typename T> typename std::enable_if<detail::HasBinaryFields<T>::value>::type write(const T &value) {
+		const uint32_t version = BinaryFields<T>::VERSION;
+		buffer.putVarUInt32(version);
+
+		const auto lengthPos = beginStruct();
+		BinaryFields<T>::visit(*this, value);
+		endStruct(lengthPos);
+	}
+
+	ByteBuffer &getBuffer() {
+		return buffer;
+	}
+
+private:
+	ByteBuffer &buffer;
+
+	/**
+	 * Reserves a byte for the length of a struct's fields.
+	 * @return the position of the length.
+	 */
+	uint32_t beginStruct();
+
+	/**
+	 * Fills in the length of a struct's fields, moving them along if it doesn't fit in the reserved byte.
+	 */
+	void endStruct(uint32_t lengthPos);
+
+	template<typename T> typename std::enable_if<std::is_integral<T>::value && sizeof(T) == 1u>::type writeVarint(
+	        const T &value) {
+		buffer.put(static_cast<uint8_t>(value));
+	}
+
+	template<typename T> typename std::enable_if<std::is_unsigned<T>::value && sizeof(T) != 1u>::type writeVarint(
+	        const T &value) {
+		buffer.putVarUInt64(value);
+	}
+
+	template<typename T> typename std::enable_if<std::is_signed<T>::value && std::is_integral<T>::value
+	        && sizeof(T) != 1u>::type writeVarint(const T &value) {
+		buffer.putVarInt64(value);
+	}
+
+	template<typename T, typename Alloc> void writeVarint(const std::vector<T, Alloc> &values) {
+		buffer.putVarUInt32(static_cast<uint32_t>(values.size()));
+
+		for (const auto &value : values) {
+			writeVarint(value);
+		}
+	}
+
+	template<typename T, size_t N> void writeVarint(const std::array<T, N> &values) {
+		for (const auto &value : values) {
+			writeVarint(value);
+		}
+	}
+
+	template<typename T> typename std::enable_if<std::is_arithmetic<T>::value>::type writeFixed(const T &value) {
+		uint8_t bytes[sizeof(T)];
+		std::memcpy(bytes, &value, sizeof(T));
+
+		if (!detail::BINARY_HOST_LITTLE_ENDIAN) {
+			std::reverse(bytes, bytes + sizeof(T));
+		}
+
+		buffer.putBytes(bytes, sizeof(T));
+	}
+
+	template<typename T, typename Alloc> void writeFixed(const std::vector<T, Alloc> &values) {
+		buffer.putVarUInt32(static_cast<uint32_t>(values.size()));
+		writeFixedElements(values.data(), static_cast<uint32_t>(values.size()), detail::IsBinaryFixedBulk<T>());
+	}
+
+	template<typename T, size_t N> void writeFixed(const std::array<T, N> &values) {
+		writeFixedElements(values.data(), static_cast<uint32_t>(N), detail::IsBinaryFixedBulk<T>());
+	}
+
+	template<typename T> void writeElements(const T *values, uint32_t count, std::true_type) {
+		buffer.putArray(values, count);
+	}
+
+	template<typename T> void writeElements(const T *values, uint32_t count, std::false_type) {
+		for (uint32_t i = 0u; i < count; ++i) {
+			write(values[i]);
+		}
+	}
+
+	template<typename T> void writeFixedElements(const T *values, uint32_t count, std::true_type) {
+		buffer.putArray(values, count);
+	}
+
+	template<typename T> void writeFixedElements(const T *values, uint32_t count, std::false_type) {
+		for (uint32_t i = 0u; i < count; ++i) {
+			writeFixed(values[i]);
+		}
+	}
+};
+
+/**
+ * Reads values written by BinaryWriter from a ByteBuffer's read position. Fields of a struct written with an older
+ * schema version than the reader's are left untouched, and fields written with a newer version are skipped.
+ *
+ * Reading stops at the first error (e.g. truncated data or a value out of range for its type), after which isOK()
+ * is false and the read position is unspecified.
+ */
+class BinaryReader {
+public:
+	explicit BinaryReader(ByteBuffer &buffer) :
+			buffer(buffer) {
+	}
+
+	template<typename ... Fields> void operator()(Fields &&... fields) {
+		using expand = int[];
+		static_cast<void>(expand { 0, (read(fields), 0)... });
+	}
+
+	/**
+	 * Reads a field added in the given schema version, if the data being read has it.
+	 */
+	template<typename T> void since(uint32_t fieldVersion, T &&field) {
+		if (version >= fieldVersion) {
+			read(field);
+		}
+	}
+
+	void read(bool &value) {
+		uint8_t byte = 0u;
+
+		if (readBytes(&byte, 1u)) {
+			value = (byte != 0u);
+		}
+	}
+
+	template<typename T> typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value>::type read(
+	        T &value) {
+		readVarint(value);
+	}
+
+	template<typename T> typename std::enable_if<std::is_floating_point<T>::value>::type read(T &value) {
+		readFixed(value);
+	}
+
+	template<typename T> typename std::enable_if<std::is_enum<T>::value>::type read(T &value) {
+		typename std::underlying_type<T>::type underlying { };
+		read(underlying);
+
+		if (ok) {
+			value = static_cast<T>(underlying);
+		}
+	}
+
+	void read(std::string &value) {
+		if (ok && !buffer.getLengthPrefixedString(value)) {
+			fail("truncated string");
+		}
+	}
+
+	template<typename T, typename Alloc> void read(std::vector<T, Alloc> &values) {
+		uint32_t count = 0u;
+
+		if (!readCount(count, detail::IsBinaryBulk<T>::value ? sizeof(T) : 1u)) {
+			return;
+		}
+
+		values.resize(count);
+		readElements(values.data(), count, detail::IsBinaryBulk<T>());
+	}
+
+	template<typename Alloc> void read(std::vector<bool, Alloc> &values) {
+		uint32_t count = 0u;
+
+		if (!readCount(count, 1u)) {
+			return;
+		}
+
+		values.resize(count);
+
+		for (uint32_t i = 0u; i < count && ok; ++i) {
+			bool value = false;
+			read(value);
+			values[i] = value;
+		}
+	}
+
+	template<typename T, size_t N> void read(std::array<T, N> &values) {
+		readElements(values.data(), static_cast<uint32_t>(N), detail::IsBinaryBulk<T>());
+	}
+
+	template<typename T> void read(const BinaryEncoded<T, BinaryEncoding::FIXED> &encoded) {
+		readFixed(encoded.value);
+	}
+
+	template<typename T> void read(const BinaryEncoded<T, BinaryEncoding::VARINT> &encoded) {
+		readVarint(encoded.value);
+	}
+
+	template<typename T> typename std::enable_if<detail::HasBinaryFields<T>::value>::type read(T &value) {
+		uint32_t structVersion = 0u;
+		uint32_t end = 0u;
+
+		if (!beginStruct(structVersion, end)) {
+			return;
+		}
+
+		const auto outerVersion = version;
+		version = structVersion;
+
+		BinaryFields<T>::visit(*this, value);
+
+		version = outerVersion;
+		endStruct(end);
+	}
+
+	bool isOK() const {
+		return ok;
+	}
+
+	/**
+	 * @return a description of the first error, or an empty string if there wasn't one.
+	 */
+	const char *getError() const {
+		return error;
+	}
+
+	/**
+	 * @return the schema version of the struct currently being read.
+	 */
+	uint32_t getVersion() const {
+		return version;
+	}
+
+private:
+	ByteBuffer &buffer;
+
+	uint32_t version = 0u;
+
+	bool ok = true;
+	const char *error = "";
+
+	void fail(const char *reason) {
+		if (ok) {
+			ok = false;
+			error = reason;
+		}
+	}
+
+	uint32_t getRemaining() const {
+		return buffer.getReadPos() < buffer.size() ? buffer.size() - buffer.getReadPos() : 0u;
+	}
+
+	/**
+	 * Reads a struct's version and length.
+	 * @return true if the struct's fields should be read, with end set to the position just past them.
+	 */
+	bool beginStruct(uint32_t &structVersion, uint32_t &end);
+
+	/**
+	 * Skips to end, past any fields added in a later version than the reader's.
+	 */
+	void endStruct(uint32_t end);
+
+	/**
+	 * Reads a vector's length, checking that there's room for count elements of at least minimumSize bytes each.
+	 */
+	bool readCount(uint32_t &count, size_t minimumSize);
+
+	bool readBytes(uint8_t *bytes, uint32_t length) {
+		if (!ok) {
+			return false;
+		}
+
+		if (!buffer.getArray(bytes, length)) {
+			fail("truncated data");
+			return false;
+		}
+
+		return true;
+	}
+
+	template<typename T> typename std::enable_if<std::is_integral<T>::value && sizeof(T) == 1u>::type readVarint(
+	        T &value) {
+		uint8_t byte = 0u;
+
+		if (readBytes(&byte, 1u)) {
+			value = static_cast<T>(byte);
+		}
+	}
+
+	template<typename T> typename std::enable_if<std::is_unsigned<T>::value && sizeof(T) != 1u>::type readVarint(
+	        T &value) {
+		uint64_t raw = 0u;
+
+		if (!ok) {
+			return;
+		}
+
+		if (!buffer.getVarUInt64(raw)) {
+			fail("malformed varint");
+		} else if (raw > std::numeric_limits<T>::max()) {
+			fail("varint out of range");
+		} else {
+			value = static_cast<T>(raw);
+		}
+	}
+
+	template<typename T> typename std::enable_if<std::is_signed<T>::value && std::is_integral<T>::value
+	        && sizeof(T) != 1u>::type readVarint(T &value) {
+		int64_t raw = 0;
+
+		if (!ok) {
+			return;
+		}
+
+		if (!buffer.getVarInt64(raw)) {
+			fail("malformed varint");
+		} else if (raw < std::numeric_limits<T>::min() || raw > std::numeric_limits<T>::max()) {
+			fail("varint out of range");
+		} else {
+			value = static_cast<T>(raw);
+		}
+	}
+
+	template<typename T, typename Alloc> void readVarint(std::vector<T, Alloc> &values) {
+		uint32_t count = 0u;
+
+		if (!readCount(count, 1u)) {
+			return;
+		}
+
+		values.resize(count);
+
+		for (uint32_t i = 0u; i < count && ok; ++i) {
+			readVarint(values[i]);
+		}
+	}
+
+	template<typename T, size_t N> void readVarint(std::array<T, N> &values) {
+		for (size_t i = 0u; i < N && ok; ++i) {
+			readVarint(values[i]);
+		}
+	}
+
+	template<typename T> typename std::enable_if<std::is_arithmetic<T>::value>::type readFixed(T &value) {
+		uint8_t bytes[sizeof(T)];
+
+		if (!readBytes(bytes, sizeof(T))) {
+			return;
+		}
+
+		if (!detail::BINARY_HOST_LITTLE_ENDIAN) {
+			std::reverse(bytes, bytes + sizeof(T));
+		}
+
+		std::memcpy(&value, bytes, sizeof(T));
+	}
+
+	template<typename T, typename Alloc> void readFixed(std::vector<T, Alloc> &values) {
+		uint32_t count = 0u;
+
+		if (!readCount(count, sizeof(T))) {
+			return;
+		}
+
+		values.resize(count);
+		readFixedElements(values.data(), count, detail::IsBinaryFixedBulk<T>());
+	}
+
+	template<typename T, size_t N> void readFixed(std::array<T, N> &values) {
+		readFixedElements(values.data(), static_cast<uint32_t>(N), detail::IsBinaryFixedBulk<T>());
+	}
+
+	template<typename T> void readElements(T *values, uint32_t count, std::true_type) {
+		if (ok && !buffer.getArray(values, count)) {
+			fail("truncated array");
+		}
+	}
+
+	template<typename T> void readElements(T *values, uint32_t count, std::false_type) {
+		for (uint32_t i = 0u; i < count && ok; ++i) {
+			read(values[i]);
+		}
+	}
+
+	template<typename T> void readFixedElements(T *values, uint32_t count, std::true_type) {
+		readElements(values, count, std::true_type());
+	}
+
+	template<typename T> void readFixedElements(T *values, uint32_t count, std::false_type) {
+		for (uint32_t i = 0u; i < count && ok; ++i) {
+			readFixed(values[i]);
+		}
+	}
+};
+
+/**
+ * Converts values of type T to and from the format written by BinaryWriter; T can be anything BinaryWriter
+ * supports, usually a type with BinaryFields.
+ */
+template<typename T> class BinarySerializer {
+public:
+	explicit BinarySerializer() :
+			logger { spdlog::get("APG") } {
+	}
+
+	~BinarySerializer() = default;
+
+	/**
+	 * Appends value to buffer at its write position.
+	 */
+	void toBinary(const T &value, ByteBuffer &buffer) {
+		BinaryWriter(buffer).write(value);
+	}
+
+	/**
+	 * Reads value from buffer's read position, leaving the read position after it.
+	 * @return true if a whole value was read.
+	 */
+	bool fromBinary(ByteBuffer &buffer, T &value) {
+		BinaryReader reader(buffer);
+		reader.read(value);
+
+		if (!reader.isOK()) {
+			logger->warn("Couldn't read binary value of type \"{}\": {}", std::type_index(typeid(T)).name(),
+			        reader.getError());
+		}
+
+		return reader.isOK();
+	}
+
+private:
+	std::shared_ptr<spdlog::logger> logger;
+};
+
+}
+
+#define APG_BINARY_EXPAND(x) x
+
+#define APG_BINARY_FIELD(field) value.field
+
+#define APG_BINARY_FE_1(M, a) M(a)
+#define APG_BINARY_FE_2(M, a, ...) M(a), APG_BINARY_EXPAND(APG_BINARY_FE_1(M, __VA_ARGS__))
+#define APG_BINARY_FE_3(M, a, ...) M(a), APG_BINARY_EXPAND(APG_BINARY_FE_2(M, __VA_ARGS__))
+#define APG_BINARY_FE_4(M, a, ...) M(a), APG_BINARY_EXPAND(APG_BINARY_FE_3(M, __VA_ARGS__))
+#define APG_BINARY_FE_5(M, a, ...) M(a), APG_BINARY_EXPAND(APG_BINARY_FE_4(M, __VA_ARGS__))
+#define APG_BINARY_FE_6(M, a, ...) M(a), APG_BINARY_EXPAND(APG_BINARY_FE_5(M, __VA_ARGS__))
+#define APG_BINARY_FE_7(M, a, ...) M(a), APG_BINARY_EXPAND(APG_BINARY_FE_6(M, __VA_ARGS__))
+#define APG_BINARY_FE_8(M, a, ...) M(a), APG_BINARY_EXPAND(APG_BINARY_FE_7(M, __VA_ARGS__))
+#define APG_BINARY_FE_9(M, a, ...) M(a), APG_BINARY_EXPAND(APG_BINARY_FE_8(M, __VA_ARGS__))
+#define APG_BINARY_FE_10(M, a, ...) M(a), APG_BINARY_EXPAND(APG_BINARY_FE_9(M, __VA_ARGS__))
+#define APG_BINARY_FE_11(M, a, ...) M(a), APG_BINARY_EXPAND(APG_BINARY_FE_10(M, __VA_ARGS__))
+#define APG_BINARY_FE_12(M, a, ...) M(a), APG_BINARY_EXPAND(APG_BINARY_FE_11(M, __VA_ARGS__))
+#define APG_BINARY_FE_13(M, a, ...) M(a), APG_BINARY_EXPAND(APG_BINARY_FE_12(M, __VA_ARGS__))
+#define APG_BINARY_FE_14(M, a, ...) M(a), APG_BINARY_EXPAND(APG_BINARY_FE_13(M, __VA_ARGS__))
+#define APG_BINARY_FE_15(M, a, ...) M(a), APG_BINARY_EXPAND(APG_BINARY_FE_14(M, __VA_ARGS__))
+#define APG_BINARY_FE_16(M, a, ...) M(a), APG_BINARY_EXPAND(APG_BINARY_FE_15(M, __VA_ARGS__))
+
+#define APG_BINARY_FE_PICK(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, NAME, ...) NAME
+
+#define APG_BINARY_FOR_EACH(M, ...) APG_BINARY_EXPAND(APG_BINARY_FE_PICK(__VA_ARGS__, APG_BINARY_FE_16, \
+	APG_BINARY_FE_15, APG_BINARY_FE_14, APG_BINARY_FE_13, APG_BINARY_FE_12, APG_BINARY_FE_11, APG_BINARY_FE_10, \
+	APG_BINARY_FE_9, APG_BINARY_FE_8, APG_BINARY_FE_7, APG_BINARY_FE_6, APG_BINARY_FE_5, APG_BINARY_FE_4, \
+	APG_BINARY_FE_3, APG_BINARY_FE_2, APG_BINARY_FE_1)(M, __VA_ARGS__))
+
+/**
+ * Specialises APG::BinaryFields for Type with the given schema version and up to 16 member fields, all written
+ * with their default encodings. Must be used outside of any namespace, e.g.
+ *
+ *     APG_BINARY_FIELDS(PlayerState, 1u, id, name, x, y)
+ */
+#define APG_BINARY_FIELDS(Type, Version, ...) \
+	namespace APG { \
+	template<> struct BinaryFields<Type> { \
+		static constexpr const uint32_t VERSION = Version; \
+		template<typename Archive, typename Value> static void visit(Archive &archive, Value &value) { \
+			archive(APG_BINARY_FOR_EACH(APG_BINARY_FIELD, __VA_ARGS__)); \
+		} \
+	}; \
+	}
+
+#endif /* INCLUDE_APG_S11N_BINARY_HPP_ */
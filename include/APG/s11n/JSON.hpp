@@ -1,109 +1,477 @@
 #ifndef INCLUDE_APG_S11N_JSON_HPP_
 #define INCLUDE_APG_S11N_JSON_HPP_
 
-#define APG_JSON_PRETTY
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
 
-#include <string>
-#include <sstream>
+#include <limits>
 #include <memory>
+#include <sstream>
+#include <string>
 #include <typeindex>
 #include <typeinfo>
 #include <type_traits>
+#include <utility>
+#include <vector>
 
 #include <rapidjson/document.h>
-#ifdef APG_JSON_PRETTY
 #include <rapidjson/prettywriter.h>
-#else
+#include <rapidjson/reader.h>
+#include <rapidjson/stringbuffer.h>
 #include <rapidjson/writer.h>
-#endif
+
+#include "APG/net/StringView.hpp"
 
 #include "spdlog/spdlog.h"
 
 namespace APG {
+
+enum class JSONFormat {
+	COMPACT,
+	PRETTY
+};
+
+/**
+ * State shared by every JSONSerializer: an output buffer with a compact and a pretty writer, a SAX reader and a
+ * document whose values are allocated from a memory pool. All of them are kept between calls and reset rather
+ * than recreated, so once they've grown to fit the largest document seen, serializing doesn't allocate.
+ */
 class JSONCommon {
 public:
-	explicit JSONCommon() : logger{spdlog::get("APG")} {
-		writer = std::make_unique<writerType>(buffer);
-	}
+	// the first arena chunk is owned by the serializer and kept when the arena is cleared
+	static constexpr const size_t ARENA_CHUNK_SIZE = 16u * 1024u;
 
+	explicit JSONCommon(JSONFormat format = JSONFormat::COMPACT);
 	~JSONCommon() = default;
 
-protected:
-#ifdef APG_JSON_PRETTY
-	using writerType = rapidjson::PrettyWriter<rapidjson::StringBuffer>;
-#else
-	using writerType = rapidjson::Writer<rapidjson::StringBuffer>;
-#endif
+	JSONCommon(const JSONCommon &other) = delete;
+	JSONCommon &operator=(const JSONCommon &other) = delete;
+
+	void setFormat(JSONFormat format) {
+		this->format = format;
+	}
+
+	JSONFormat getFormat() const {
+		return format;
+	}
 
+protected:
 	rapidjson::StringBuffer buffer;
 
-	std::unique_ptr<rapidjson::Writer<rapidjson::StringBuffer>> writer;
+	rapidjson::Writer<rapidjson::StringBuffer> compactWriter;
+	rapidjson::PrettyWriter<rapidjson::StringBuffer> prettyWriter;
+
+	rapidjson::Reader reader;
+
+	std::unique_ptr<char[]> arenaChunk;
+	rapidjson::MemoryPoolAllocator<> arena;
+	rapidjson::Document document;
+
+	JSONFormat format;
 
 	std::shared_ptr<spdlog::logger> logger;
+
+	/**
+	 * Clears the output buffer and calls function with the writer for the current format, which is passed as
+	 * either a rapidjson::Writer or a rapidjson::PrettyWriter so it should be a generic lambda or functor.
+	 * @return the JSON written, valid until the next write.
+	 */
+	template<typename Function> StringView write(Function &&function) {
+		buffer.Clear();
+
+		if (format == JSONFormat::PRETTY) {
+			prettyWriter.Reset(buffer);
+			function(prettyWriter);
+		} else {
+			compactWriter.Reset(buffer);
+			function(compactWriter);
+		}
+
+		return getOutput();
+	}
+
+	StringView getOutput() const {
+		return StringView(buffer.GetString(), static_cast<uint32_t>(buffer.GetSize()));
+	}
+
+	/**
+	 * For specializations which need a DOM; the document and all its values are recycled by the next call, so
+	 * nothing from it should be kept.
+	 * @return the parsed document, which has a parse error if json was invalid.
+	 */
+	rapidjson::Document &parseDocument(const char *json);
+
+	/**
+	 * Runs the SAX reader over json, logging any error; a handler returning false also counts as an error.
+	 * @return true if the whole of json was parsed and handler accepted it.
+	 */
+	template<typename Handler> bool parse(const char *json, Handler &handler) {
+		rapidjson::StringStream stream(json);
+		const auto result = reader.Parse(stream, handler);
+
+		if (result.IsError()) {
+			logParseError(result.Code(), result.Offset());
+			return false;
+		}
+
+		return true;
+	}
+
+	void logParseError(rapidjson::ParseErrorCode code, size_t offset);
 };
 
+namespace detail {
+
+enum class JSONKind {
+	BOOLEAN,
+	INTEGER,
+	FLOATING_POINT,
+	STRING,
+	OTHER
+};
+
+template<JSONKind kind> using JSONKindTag = std::integral_constant<JSONKind, kind>;
+
+template<typename T> using JSONKindOf = JSONKindTag<
+        std::is_same<T, bool>::value ? JSONKind::BOOLEAN :
+        std::is_integral<T>::value ? JSONKind::INTEGER :
+        std::is_floating_point<T>::value ? JSONKind::FLOATING_POINT :
+        std::is_same<T, std::string>::value ? JSONKind::STRING : JSONKind::OTHER>;
+
+template<typename T> bool fitsIn(int64_t value) {
+	if (value < 0) {
+		return std::is_signed<T>::value && value >= static_cast<int64_t>(std::numeric_limits<T>::min());
+	}
+
+	return static_cast<uint64_t>(value) <= static_cast<uint64_t>(std::numeric_limits<T>::max());
+}
+
+template<typename T> bool fitsIn(uint64_t value) {
+	return value <= static_cast<uint64_t>(std::numeric_limits<T>::max());
+}
+
+}
+
 /**
- * Should be specialised for each seraializable type T to override the
- * fromJSON and toJSON methods.
+ * By default, values are written as { "value": <value> }, with booleans, integers, floating point numbers and
+ * std::strings written as the matching JSON type and anything else formatted with operator<< as a string. Only
+ * those four kinds can be read back.
+ *
+ * Should be specialised for each other serializable type T to override the fromJSON and toJSON methods.
+ * Specializations can derive from JSONCommon to reuse its writers, reader and pooled document.
  *
  * APG provides a python auto-generation framework for doing exactly this for each type you want.
  */
 template<typename T> class JSONSerializer : public JSONCommon {
 public:
-	explicit JSONSerializer() :
-			        JSONCommon() {
-
+	explicit JSONSerializer(JSONFormat format = JSONFormat::COMPACT) :
+			        JSONCommon(format) {
 	}
 
 	~JSONSerializer() = default;
 
 	T fromJSON(const char *json) {
-		if (!std::is_default_constructible<T>::value) {
-			logger->critical(
-			        "Default fromJSON requires types to be default constructible. You probably need to specialize the JSONSerializer<T> class. Type: {}",
-			        std::type_index(typeid(T)).name());
+		T value { };
+		fromJSON(json, value);
+		return value;
+	}
+
+	/**
+	 * Reads a single { "value": <value> } object without building a DOM.
+	 * @return true if json held a value of the right type, which was stored in value.
+	 */
+	bool fromJSON(const char *json, T &value) {
+		if (!canRead()) {
+			return false;
 		}
 
-		rapidjson::Document d;
-		d.Parse(json);
+		ValueHandler handler(&value, nullptr);
 
-		if (is_integral) {
-			if (d.HasMember("value") && d["value"].IsInt()) {
-				return d["value"].GetInt();
-			}
-		} else if (is_floating_point) {
-			if (d.HasMember("value") && d["value"].IsDouble()) {
-				return d["value"].GetDouble();
-			}
+		if (!parse(json, handler) || handler.getValuesRead() == 0u) {
+			logger->warn("Couldn't read a value of type \"{}\" from JSON input, which was ignored.",
+			        std::type_index(typeid(T)).name());
+			return false;
 		}
 
-		logger->warn(
-		        "No sensible implementation available for JSONSerializer::fromJSON for type \"{}\", JSON input was ignored.",
-		        std::type_index(typeid(T)).name());
+		return true;
+	}
 
-		return T();
+	/**
+	 * Reads an array of objects as written by writeJSONArray, appending each to values. Objects without a value
+	 * are appended as a default constructed T.
+	 * @return true if the whole array was read.
+	 */
+	bool fromJSONArray(const char *json, std::vector<T> &values) {
+		if (!canRead()) {
+			return false;
+		}
+
+		ValueHandler handler(nullptr, &values);
+		return parse(json, handler);
 	}
 
 	std::string toJSON(const T &t) {
-		buffer.Clear();
-
-		writer->StartObject();
+		return writeJSON(t).toString();
+	}
 
-		writer->String("value");
-		std::stringstream ss;
-		ss << t;
-		writer->String(ss.str().c_str());
+	/**
+	 * @return the JSON for t, valid until the next call on this serializer.
+	 */
+	StringView writeJSON(const T &t) {
+		return write([this, &t](auto &writer) {
+			this->writeObject(writer, t);
+		});
+	}
 
-		writer->EndObject();
+	/**
+	 * Writes count values as a single JSON array of objects, without copying anything between them.
+	 * @return the JSON array, valid until the next call on this serializer.
+	 */
+	StringView writeJSONArray(const T *values, size_t count) {
+		return writeArray(values, values + count);
+	}
 
-		return std::string(buffer.GetString());
+	StringView writeJSONArray(const std::vector<T> &values) {
+		return writeArray(values.begin(), values.end());
 	}
 
 protected:
-	constexpr static const bool is_integral = std::is_scalar<T>::value;
-	constexpr static const bool is_floating_point = std::is_floating_point<T>::value;
+	using Kind = detail::JSONKindOf<T>;
+
+	constexpr static const char *VALUE_KEY = "value";
+	constexpr static const rapidjson::SizeType VALUE_KEY_LENGTH = 5u;
+
+	// only used to format types which have no JSON equivalent
+	std::ostringstream formatStream;
+
+	bool canRead() {
+		if (Kind::value == detail::JSONKind::OTHER) {
+			logger->warn(
+			        "No sensible implementation available for JSONSerializer::fromJSON for type \"{}\", JSON input was ignored.",
+			        std::type_index(typeid(T)).name());
+			return false;
+		}
+
+		return true;
+	}
+
+	template<typename Iterator> StringView writeArray(Iterator begin, Iterator end) {
+		return write([this, begin, end](auto &writer) {
+			writer.StartArray();
+
+			for (auto it = begin; it != end; ++it) {
+				this->writeObject(writer, *it);
+			}
+
+			writer.EndArray();
+		});
+	}
+
+	template<typename Writer> void writeObject(Writer &writer, const T &t) {
+		writer.StartObject();
+		writer.Key(VALUE_KEY, VALUE_KEY_LENGTH);
+		writeValue(writer, t, Kind());
+		writer.EndObject();
+	}
+
+	template<typename Writer> void writeValue(Writer &writer, const T &t, detail::JSONKindTag<detail::JSONKind::BOOLEAN>) {
+		writer.Bool(t);
+	}
+
+	template<typename Writer> void writeValue(Writer &writer, const T &t, detail::JSONKindTag<detail::JSONKind::INTEGER>) {
+		if (std::is_signed<T>::value) {
+			writer.Int64(static_cast<int64_t>(t));
+		} else {
+			writer.Uint64(static_cast<uint64_t>(t));
+		}
+	}
+
+	template<typename Writer> void writeValue(Writer &writer, const T &t,
+	        detail::JSONKindTag<detail::JSONKind::FLOATING_POINT>) {
+		writer.Double(static_cast<double>(t));
+	}
+
+	template<typename Writer> void writeValue(Writer &writer, const T &t, detail::JSONKindTag<detail::JSONKind::STRING>) {
+		writer.String(t.data(), static_cast<rapidjson::SizeType>(t.size()));
+	}
+
+	template<typename Writer> void writeValue(Writer &writer, const T &t, detail::JSONKindTag<detail::JSONKind::OTHER>) {
+		formatStream.str(std::string());
+		formatStream.clear();
+		formatStream << t;
+
+		const auto formatted = formatStream.str();
+		writer.String(formatted.data(), static_cast<rapidjson::SizeType>(formatted.size()));
+	}
+
+	/**
+	 * Accepts either one { "value": <value> } object, storing the value in single, or an array of them, appending
+	 * each to many. Other keys are skipped; a value of the wrong type or out of range for T stops the parse.
+	 */
+	class ValueHandler : public rapidjson::BaseReaderHandler<rapidjson::UTF8<>, ValueHandler> {
+	public:
+		explicit ValueHandler(T *single, std::vector<T> *many) :
+				        target { single },
+				        many { many },
+				        objectDepth { many == nullptr ? 1u : 2u } {
+		}
+
+		uint32_t getValuesRead() const {
+			return valuesRead;
+		}
+
+		bool StartObject() {
+			expectingValue = false;
+
+			if (depth == 0u && many != nullptr) {
+				return false;
+			}
+
+			if (depth == 1u && many != nullptr) {
+				element = T();
+				target = &element;
+			}
+
+			++depth;
+			return true;
+		}
+
+		bool EndObject(rapidjson::SizeType) {
+			--depth;
+
+			if (depth == 1u && many != nullptr) {
+				many->push_back(std::move(element));
+				target = nullptr;
+			}
+
+			return true;
+		}
+
+		bool StartArray() {
+			expectingValue = false;
+
+			if (depth == 0u && many == nullptr) {
+				return false;
+			}
+
+			++depth;
+			return true;
+		}
+
+		bool EndArray(rapidjson::SizeType) {
+			--depth;
+			return true;
+		}
+
+		bool Key(const char *str, rapidjson::SizeType length, bool) {
+			expectingValue = depth == objectDepth && length == VALUE_KEY_LENGTH
+			        && std::memcmp(str, VALUE_KEY, VALUE_KEY_LENGTH) == 0;
+			return true;
+		}
+
+		bool Null() {
+			return skip();
+		}
+
+		bool Bool(bool b) {
+			return expected() ? setBool(b, Kind()) : true;
+		}
+
+		bool Int(int i) {
+			return Int64(i);
+		}
+
+		bool Uint(unsigned u) {
+			return Uint64(u);
+		}
+
+		bool Int64(int64_t i) {
+			return expected() ? setNumber(i, Kind()) : true;
+		}
+
+		bool Uint64(uint64_t u) {
+			return expected() ? setNumber(u, Kind()) : true;
+		}
+
+		bool Double(double d) {
+			return expected() ? setNumber(d, Kind()) : true;
+		}
+
+		bool String(const char *str, rapidjson::SizeType length, bool) {
+			return expected() ? setString(str, length, Kind()) : true;
+		}
+
+	private:
+		T *target;
+		std::vector<T> *many;
+
+		// each object in an array is read into this and then appended to many
+		T element { };
+
+		const uint32_t objectDepth;
+		uint32_t depth = 0u;
+
+		bool expectingValue = false;
+		uint32_t valuesRead = 0u;
+
+		bool expected() {
+			const auto wasExpecting = expectingValue;
+			expectingValue = false;
+			return wasExpecting && target != nullptr;
+		}
+
+		bool skip() {
+			// a null value is accepted and leaves the default
+			expectingValue = false;
+			return true;
+		}
+
+		bool set(T value) {
+			*target = std::move(value);
+			++valuesRead;
+			return true;
+		}
+
+		bool setBool(bool b, detail::JSONKindTag<detail::JSONKind::BOOLEAN>) {
+			return set(b);
+		}
+
+		template<typename Tag> bool setBool(bool, Tag) {
+			return false;
+		}
+
+		template<typename Number> bool setNumber(Number n, detail::JSONKindTag<detail::JSONKind::INTEGER>) {
+			return detail::fitsIn<T>(n) && set(static_cast<T>(n));
+		}
+
+		bool setNumber(double, detail::JSONKindTag<detail::JSONKind::INTEGER>) {
+			return false;
+		}
+
+		template<typename Number> bool setNumber(Number n, detail::JSONKindTag<detail::JSONKind::FLOATING_POINT>) {
+			return set(static_cast<T>(n));
+		}
+
+		template<typename Number, typename Tag> bool setNumber(Number, Tag) {
+			return false;
+		}
+
+		bool setString(const char *str, rapidjson::SizeType length, detail::JSONKindTag<detail::JSONKind::STRING>) {
+			target->assign(str, length);
+			++valuesRead;
+			return true;
+		}
+
+		template<typename Tag> bool setString(const char *, rapidjson::SizeType, Tag) {
+			return false;
+		}
+	};
 };
 
+template<typename T> constexpr const char *JSONSerializer<T>::VALUE_KEY;
+template<typename T> constexpr const rapidjson::SizeType JSONSerializer<T>::VALUE_KEY_LENGTH;
+
 }
 
 #endif /* INCLUDE_APG_S11N_JSON_HPP_ */
@@ -29,15 +29,9 @@ public:
 protected:
 	friend class TmxRenderer<GLTmxRenderer>;
 
-	static std::unordered_map<std::string, std::shared_ptr<Tileset>> tmxTilesets;
-
 	void renderLayerImpl(const Tmx::TileLayer *layer);
 
-	void renderObjectGroupImpl(const std::vector<TiledObject> &objects);
-
-	std::unordered_map<std::string, std::shared_ptr<Tileset>> &getTmxTilesets() {
-		return tmxTilesets;
-	}
+	void renderObjectGroupImpl(const TiledObjectGroup &objects);
 
 private:
 	SpriteBatch *batch;
@@ -12,9 +12,11 @@
 #include "APG/graphics/Sprite.hpp"
 #include "APG/graphics/SpriteBatch.hpp"
 #include "APG/graphics/AnimatedSprite.hpp"
+#include "APG/graphics/AnimationSystem.hpp"
 #include "APG/graphics/PackedTexture.hpp"
 
 #include "APG/tiled/TiledObject.hpp"
+#include "APG/tiled/TiledObjectGroup.hpp"
 
 namespace Tmx {
 class Tile;
@@ -40,19 +42,28 @@ public:
 
 	void renderLayer(Tmx::TileLayer *layer);
 
-	void renderObjectGroup(const std::vector<TiledObject> &objects);
+	void renderObjectGroup(const TiledObjectGroup &objects);
 
 	const glm::vec2 &getPosition() const;
 
 	void setPosition(glm::vec2 position);
 
+	/**
+	 * Sets the area of the screen which is visible, used to cull objects when rendering.
+	 * A viewport with a zero size (the default) disables culling.
+	 */
+	void setViewport(glm::vec2 topLeft, glm::vec2 size);
+
 	PackedTexture *getPackedTexture();
 
 	int getPixelWidth() const;
 
 	int getPixelHeight() const;
 
-	std::vector<TiledObject> getObjectGroup(const std::string &groupName) const;
+	/**
+	 * @return the object group with the given name, or nullptr if no such group exists.
+	 */
+	const TiledObjectGroup *getObjectGroup(const std::string &groupName) const;
 
 	const Tmx::Map *getMap() const;
 
@@ -69,12 +80,17 @@ private:
 	std::unordered_map<int, SpriteBase *> sprites;
 
 	std::forward_list<Sprite> loadedSprites;
-	std::forward_list<AnimatedSprite> loadedAnimatedSprites;
 
-	std::unordered_map<std::string, std::vector<TiledObject>> objectGroups;
+	AnimationSystem animations;
+	std::forward_list<AnimationSystemSprite> loadedAnimatedSprites;
+
+	std::unordered_map<std::string, TiledObjectGroup> objectGroups;
 
 	glm::vec2 position{0, 0};
 
+	glm::vec2 viewportPosition{0, 0};
+	glm::vec2 viewportSize{0, 0};
+
 	std::shared_ptr<spdlog::logger> logger;
 };
 
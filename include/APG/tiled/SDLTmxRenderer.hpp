@@ -3,9 +3,13 @@
 
 #ifndef APG_NO_SDL
 
+#include <cstdint>
+
+#include <unordered_map>
 #include <vector>
 
 #include "APG/SXXDL.hpp"
+#include "APG/graphics/SDLQuadBatch.hpp"
 #include "APG/core/APGCommon.hpp"
 #include "APG/tiled/TmxRenderer.hpp"
 #include "APG/graphics/Tileset.hpp"
@@ -24,6 +28,16 @@ namespace APG {
  * Contains methods for rendering a loaded TMX file using SDL2.
  *
  * Requires that SDL2 + SDL2_image have already been initialised. Doesn't yet support animated tiles.
+ *
+ * Tile layers are split into chunks of CHUNK_SIZE_TILES x CHUNK_SIZE_TILES tiles, each of which is pre-rendered into
+ * a cached render target texture and only redrawn when invalidated. Only chunks which intersect the renderer's
+ * viewport are drawn. If the renderer doesn't support render targets, visible tiles are drawn individually.
+ *
+ * Tiles are submitted through an SDLQuadBatch, so each tileset is drawn with a single geometry call where SDL
+ * supports it.
+ *
+ * The cached chunks must be invalidated using invalidateTile, invalidateLayer or invalidateAll after changing tiles
+ * in a layer, and invalidateAll must be called when SDL reports SDL_RENDER_TARGETS_RESET.
  */
 class SDLTmxRenderer final : public TmxRenderer<SDLTmxRenderer> {
 public:
@@ -40,25 +54,71 @@ public:
 
 	SDLTmxRenderer(const SDLTmxRenderer &other) = delete;
 
-protected:
-	friend class TmxRenderer<SDLTmxRenderer>;
+	static constexpr const int32_t CHUNK_SIZE_TILES = 16;
 
-	static std::unordered_map<std::string, std::shared_ptr<Tileset>> tmxTilesets;
+	/**
+	 * Marks the chunk containing the given tile as needing to be redrawn.
+	 */
+	void invalidateTile(const Tmx::TileLayer *layer, int32_t x, int32_t y);
 
-	void renderLayerImpl(const Tmx::TileLayer *layer);
+	/**
+	 * Marks every chunk of the given layer as needing to be redrawn.
+	 */
+	void invalidateLayer(const Tmx::TileLayer *layer);
+
+	/**
+	 * Marks every cached chunk as needing to be redrawn.
+	 */
+	void invalidateAll();
 
-	void renderObjectGroupImpl(const std::vector<TiledObject> &objects);
+	/**
+	 * Enables or disables caching of chunks in render targets; when disabled, visible tiles are drawn every frame.
+	 * Caching is enabled by default if the renderer supports render targets.
+	 */
+	void setChunkCaching(bool enabled);
 
-	std::unordered_map<std::string, std::shared_ptr<Tileset>> &getTmxTilesets() {
-		return tmxTilesets;
+	bool isChunkCaching() const {
+		return chunkCaching;
 	}
 
+protected:
+	friend class TmxRenderer<SDLTmxRenderer>;
+
+	void renderLayerImpl(const Tmx::TileLayer *layer);
+
+	void renderObjectGroupImpl(const TiledObjectGroup &objects);
+
 private:
+	struct LayerCache {
+		int32_t chunksX = 0;
+		int32_t chunksY = 0;
+
+		std::vector<SXXDL::sdl_texture_ptr> chunks;
+		std::vector<bool> dirty;
+	};
+
 	const SXXDL::renderer_ptr &renderer;
 
 	std::vector<SXXDL::sdl_texture_ptr> sdlTextures;
 
+	SDLQuadBatch tileBatch;
+
+	std::unordered_map<const Tmx::TileLayer *, LayerCache> layerCaches;
+
+	bool chunkCaching = true;
+
 	void setupTilesets();
+
+	LayerCache &getLayerCache(const Tmx::TileLayer *layer);
+
+	bool redrawChunk(const Tmx::TileLayer *layer, LayerCache &cache, int32_t chunkX, int32_t chunkY);
+
+	/**
+	 * Draws the tiles in the inclusive range [firstX, lastX] x [firstY, lastY], with tile (0, 0) at (offsetX, offsetY).
+	 * @return false if an SDL error occurred.
+	 */
+	bool drawTiles(const Tmx::TileLayer *layer, int32_t firstX, int32_t firstY, int32_t lastX, int32_t lastY,
+				   int32_t offsetX, int32_t offsetY);
 };
 
 }
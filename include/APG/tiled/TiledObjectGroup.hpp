@@ -0,0 +1,223 @@
+#ifndef APG_TILED_TILEDOBJECTGROUP_HPP
+#define APG_TILED_TILEDOBJECTGROUP_HPP
+
+#include <cstdint>
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <glm/vec2.hpp>
+
+#include "APG/tiled/TiledObject.hpp"
+
+namespace APG {
+
+/**
+ * Holds all the objects in a Tiled object group, spatially indexed in a uniform grid.
+ *
+ * Objects are bucketed by the grid cell which contains their top-left corner, and an index of them is stored
+ * contiguously by cell; the objects themselves stay in the order they appeared in the map file. Queries expand
+ * their search area by the size of the largest object in the group so that objects overlapping a cell boundary
+ * are still found, meaning each object is indexed exactly once.
+ *
+ * Query results are pointers into the group; they're valid for as long as the group itself is alive and are
+ * never invalidated by further queries. Queries which take an output vector append to it without clearing it,
+ * so a single vector can be reused across frames to avoid allocating.
+ */
+class TiledObjectGroup {
+public:
+	static constexpr const float DEFAULT_CELL_SIZE = 256.0f;
+
+	explicit TiledObjectGroup(std::vector<TiledObject> objects = std::vector<TiledObject>(),
+							  float cellSize = DEFAULT_CELL_SIZE);
+
+	~TiledObjectGroup() = default;
+
+	/**
+	 * Calls f(const TiledObject &) for each object whose bounds intersect the given rectangle, in grid order.
+	 * Doesn't allocate.
+	 */
+	template<typename F>
+	void forEachInRect(const glm::vec2 &topLeft, const glm::vec2 &size, F &&f) const {
+		forEachIndexInRect(topLeft, size, [this, &f](uint32_t index) {
+			f(objects[index]);
+		});
+	}
+
+	/**
+	 * Calls f(const TiledObject &) for each object whose bounds intersect the given rectangle, in map file order
+	 * so that overlapping objects stack the same whether or not they're culled. Used by the renderers.
+	 *
+	 * Reuses a scratch buffer held by the group, so it only allocates while that buffer grows, and mustn't be
+	 * called concurrently on the same group.
+	 */
+	template<typename F>
+	void forEachInRectInOrder(const glm::vec2 &topLeft, const glm::vec2 &size, F &&f) const {
+		visibleIndices.clear();
+
+		forEachIndexInRect(topLeft, size, [this](uint32_t index) {
+			visibleIndices.emplace_back(index);
+		});
+
+		std::sort(visibleIndices.begin(), visibleIndices.end());
+
+		for (const auto index : visibleIndices) {
+			f(objects[index]);
+		}
+	}
+
+	/**
+	 * Appends every object intersecting the given rectangle to out.
+	 * @return the number of objects found.
+	 */
+	size_t queryRect(const glm::vec2 &topLeft, const glm::vec2 &size, std::vector<const TiledObject *> &out) const;
+
+	/**
+	 * Appends every object whose bounds are at least partially within radius of centre to out.
+	 * @return the number of objects found.
+	 */
+	size_t queryRadius(const glm::vec2 &centre, float radius, std::vector<const TiledObject *> &out) const;
+
+	/**
+	 * Appends every object with the given name to out.
+	 * @return the number of objects found.
+	 */
+	size_t queryName(const std::string &name, std::vector<const TiledObject *> &out) const;
+
+	/**
+	 * @return the first object found with the given name, or nullptr if there is no such object.
+	 */
+	const TiledObject *findByName(const std::string &name) const;
+
+	/**
+	 * @return all objects in the group, in the order they appeared in the map file.
+	 */
+	const std::vector<TiledObject> &getObjects() const {
+		return objects;
+	}
+
+	size_t size() const {
+		return objects.size();
+	}
+
+	bool empty() const {
+		return objects.empty();
+	}
+
+private:
+	static constexpr const int32_t MAX_CELLS_PER_AXIS = 1024;
+
+	std::vector<TiledObject> objects;
+
+	// cached sprite dimensions for each object in objects, to avoid virtual calls when querying
+	std::vector<glm::vec2> objectSizes;
+
+	// indices into objects, sorted by cell and then by map file order
+	std::vector<uint32_t> cellObjects;
+
+	// indices of objects in cell i are cellObjects[cellStarts[i]] up to cellObjects[cellStarts[i + 1]]
+	std::vector<uint32_t> cellStarts;
+
+	// scratch space for forEachInRectInOrder
+	mutable std::vector<uint32_t> visibleIndices;
+
+	// indices into objects, sorted by object name
+	std::vector<uint32_t> nameIndex;
+
+	glm::vec2 origin{0.0f, 0.0f};
+	glm::vec2 maxObjectSize{0.0f, 0.0f};
+
+	float cellSize;
+	float invCellSize;
+
+	int32_t cellsX = 0;
+	int32_t cellsY = 0;
+
+	int32_t clampCell(float offset, int32_t cellCount) const {
+		const float cell = offset * invCellSize;
+
+		if (cell <= 0.0f) {
+			return 0;
+		}
+
+		return std::min(static_cast<int32_t>(std::min(cell, static_cast<float>(cellCount))), cellCount - 1);
+	}
+
+	/**
+	 * Calls f(uint32_t) with the index of each object whose bounds intersect the given rectangle, in grid order.
+	 */
+	template<typename F>
+	void forEachIndexInRect(const glm::vec2 &topLeft, const glm::vec2 &size, F &&f) const {
+		if (objects.empty()) {
+			return;
+		}
+
+		const float minX = topLeft.x, minY = topLeft.y;
+		const float maxX = topLeft.x + size.x, maxY = topLeft.y + size.y;
+
+		const int32_t firstCellX = clampCell(minX - maxObjectSize.x - origin.x, cellsX);
+		const int32_t firstCellY = clampCell(minY - maxObjectSize.y - origin.y, cellsY);
+		const int32_t lastCellX = clampCell(maxX - origin.x, cellsX);
+		const int32_t lastCellY = clampCell(maxY - origin.y, cellsY);
+
+		for (int32_t cellY = firstCellY; cellY <= lastCellY; ++cellY) {
+			// cells in a row are contiguous, so a whole row span can be walked in one go
+			const auto rowStart = cellStarts[cellY * cellsX + firstCellX];
+			const auto rowEnd = cellStarts[cellY * cellsX + lastCellX + 1];
+
+			for (auto i = rowStart; i < rowEnd; ++i) {
+				const auto index = cellObjects[i];
+				const auto &object = objects[index];
+				const auto &objectSize = objectSizes[index];
+
+				if (object.position.x <= maxX && object.position.x + objectSize.x >= minX &&
+					object.position.y <= maxY && object.position.y + objectSize.y >= minY) {
+					f(index);
+				}
+			}
+		}
+	}
+
+	struct NameComparator {
+		const std::vector<TiledObject> &objects;
+
+		bool operator()(uint32_t a, uint32_t b) const {
+			return objects[a].name < objects[b].name;
+		}
+
+		bool operator()(uint32_t index, const std::string &name) const {
+			return objects[index].name < name;
+		}
+
+		bool operator()(const std::string &name, uint32_t index) const {
+			return name < objects[index].name;
+		}
+	};
+
+	void buildGrid();
+
+	void buildNameIndex();
+};
+
+/**
+ * Calls f(const TiledObject &) in map file order for each object in a group drawn at groupPosition which is visible
+ * in the given viewport, or for every object if the viewport has a zero size (i.e. culling is disabled). Shared by
+ * the renderers.
+ */
+template<typename F>
+void forEachObjectInViewport(const TiledObjectGroup &objects, const glm::vec2 &groupPosition,
+							 const glm::vec2 &viewportPosition, const glm::vec2 &viewportSize, F &&f) {
+	if (viewportSize.x <= 0.0f || viewportSize.y <= 0.0f) {
+		for (const auto &obj : objects.getObjects()) {
+			f(obj);
+		}
+	} else {
+		objects.forEachInRectInOrder(viewportPosition - groupPosition, viewportSize, std::forward<F>(f));
+	}
+}
+
+}
+
+#endif
@@ -4,8 +4,10 @@
 // TODO: Remove dependence on SDL
 #ifndef APG_NO_SDL
 
+#include <string>
 #include <vector>
 #include <unordered_map>
+#include <utility>
 
 #include <glm/vec2.hpp>
 
@@ -14,10 +16,13 @@
 #include "APG/SXXDL.hpp"
 #include "APG/core/APGCommon.hpp"
 #include "APG/graphics/Tileset.hpp"
+#include "APG/graphics/AssetCache.hpp"
 #include "APG/graphics/AnimatedSprite.hpp"
+#include "APG/graphics/AnimationSystem.hpp"
 #include "APG/internal/Assert.hpp"
 
 #include "APG/tiled/TiledObject.hpp"
+#include "APG/tiled/TiledObjectGroup.hpp"
 
 namespace Tmx {
 class Map;
@@ -62,7 +67,7 @@ public:
 		static_cast<T *>(this)->renderLayerImpl(layer);
 	}
 
-	void renderObjectGroup(const std::vector<TiledObject> &objects) {
+	void renderObjectGroup(const TiledObjectGroup &objects) {
 		static_cast<T *>(this)->renderObjectGroupImpl(objects);
 	}
 
@@ -83,7 +88,10 @@ public:
 					}
 
 					case Tmx::LayerType::TMX_LAYERTYPE_OBJECTGROUP: {
-						renderObjectGroup(objectGroups[layer->GetName()]);
+						const auto found = objectGroups.find(layer->GetName());
+						if (found != objectGroups.end()) {
+							renderObjectGroup(found->second);
+						}
 						break;
 					}
 
@@ -97,9 +105,7 @@ public:
 	}
 
 	void update(float deltaTime) {
-		for (auto &animation : loadedAnimatedSprites) {
-			animation.update(deltaTime);
-		}
+		animations.updateAll(deltaTime);
 	}
 
 	const Tmx::Map *getMap() {
@@ -114,6 +120,24 @@ public:
 		this->position = position;
 	}
 
+	/**
+	 * Sets the area of the screen which is visible, used to cull objects when rendering.
+	 * A viewport with a zero size (the default) disables culling.
+	 */
+	void setViewport(const glm::vec2 &topLeft, const glm::vec2 &size) {
+		viewportPosition = topLeft;
+		viewportSize = size;
+	}
+
+	/**
+	 * @return the object group with the given name, or nullptr if no such group exists.
+	 */
+	const TiledObjectGroup *getObjectGroup(const std::string &groupName) const {
+		const auto found = objectGroups.find(groupName);
+
+		return found == objectGroups.end() ? nullptr : &(found->second);
+	}
+
 	Tileset *getTilesetByID(int32_t id) const {
 		if (tilesets[id] == nullptr) {
 			return nullptr;
@@ -134,28 +158,34 @@ protected:
 	static const uint64_t MAX_SPRITES_PER_UNIT = 1000000;
 
 
-	void initialiseTilesets(std::unordered_map<std::string, std::shared_ptr<Tileset>> &tmxTilesets) {
-		if (tmxTilesets.empty()) {
-			tmxTilesets.reserve(internal::MAX_SUPPORTED_TEXTURES);
-		}
-	}
-
 	Tmx::Map *map = nullptr;
 	std::vector<std::shared_ptr<Tileset>> tilesets;
 	std::unordered_map<uint64_t, SpriteBase *> sprites;
 
 	std::vector<Sprite> loadedSprites;
-	std::vector<AnimatedSprite> loadedAnimatedSprites;
 
-	std::unordered_map<std::string, std::vector<TiledObject>> objectGroups;
+	AnimationSystem animations;
+	std::vector<AnimationSystemSprite> loadedAnimatedSprites;
+
+	std::unordered_map<std::string, TiledObjectGroup> objectGroups;
 
 	glm::vec2 position{0.0f, 0.0f};
 
+	glm::vec2 viewportPosition{0.0f, 0.0f};
+	glm::vec2 viewportSize{0.0f, 0.0f};
+
+	/**
+	 * Calls f for each object in the group which is visible in the viewport, or every object if culling is disabled.
+	 */
+	template<typename F>
+	void forEachVisibleObject(const TiledObjectGroup &objects, F &&f) const {
+		forEachObjectInViewport(objects, position, viewportPosition, viewportSize, std::forward<F>(f));
+	}
+
 	std::shared_ptr<spdlog::logger> logger;
 
 	void loadTilesets() {
-		auto &tmxTilesets = getDerivedTmxTilesets();
-		initialiseTilesets(tmxTilesets);
+		auto &assetCache = AssetCache::getDefault();
 
 		const auto tileWidth = map->GetTileWidth();
 		const auto tileHeight = map->GetTileHeight();
@@ -175,23 +205,13 @@ protected:
 
 			const auto tilesetName = map->GetFilepath() + tileset->GetImage()->GetSource();
 
-			const auto tilesetExists = tmxTilesets.find(tilesetName);
-			Tileset *loadedTileset = nullptr;
+			logger->info("Loading tileset \"{}\" (first GID = {}, has {} special tiles, spacing = {}px)",
+						 tilesetName,
+						 tileset->GetFirstGid(), tileset->GetTiles().size(), tileset->GetSpacing());
 
-			if (tilesetExists != tmxTilesets.end()) {
-				logger->info("Using previously loaded tileset for \"{}\"", tilesetName);
-
-				loadedTileset = tilesetExists->second.get();
-			} else {
-				logger->info("Loading tileset \"{}\" (first GID = {}, has {} special tiles, spacing = {}px)",
-							 tilesetName,
-							 tileset->GetFirstGid(), tileset->GetTiles().size(), tileset->GetSpacing());
-
-				tmxTilesets.emplace(tilesetName, std::make_shared<Tileset>(tilesetName, tileset));
-
-				tilesets.emplace_back(std::shared_ptr<Tileset>(tmxTilesets.at(tilesetName)));
-				loadedTileset = tilesets.back().get();
-			}
+			// the cache handles sharing tilesets between maps; we keep a reference for as long as the map is loaded
+			tilesets.emplace_back(assetCache.loadTileset(tilesetName, tileset));
+			Tileset *loadedTileset = tilesets.back().get();
 
 			REQUIRE(loadedTileset != nullptr, "Couldn't load/find tileset when loading map");
 
@@ -239,11 +259,10 @@ protected:
 
 					const auto &frames = tile->GetFrames();
 					std::vector<SpriteBase *> framePointers;
+					std::vector<float> frameDurations;
 					framePointers.reserve(frames.size());
+					frameDurations.reserve(frames.size());
 
-					// TODO: This ignores per-frame durations in the file, should be improved.
-					// Length is stored in ms, convert to seconds
-					float length = (float) tile->GetTotalDuration() / 1000.0f;
 					unsigned int framesLoaded = 0;
 
 					for (const auto &frame : frames) {
@@ -255,10 +274,13 @@ protected:
 						REQUIRE(sprites.find(gid) != sprites.end(), "Animation frame not loaded into sprites array.");
 
 						framePointers.emplace_back(sprites[gid]);
+						// durations are stored in ms, convert to seconds
+						frameDurations.emplace_back(frame.GetDuration() / 1000.0f);
 						++framesLoaded;
 					}
 
-					loadedAnimatedSprites.emplace_back(length, framePointers, AnimationMode::LOOP);
+					const auto handle = animations.add(framePointers, frameDurations, AnimationMode::LOOP);
+					loadedAnimatedSprites.emplace_back(&animations, handle);
 					sprites[tileGID] = &(loadedAnimatedSprites.back());
 				}
 			}
@@ -281,7 +303,7 @@ protected:
 				objects.emplace_back(obj->GetName(), obj->GetX(), obj->GetY() - map->GetTileHeight(), sprites[gid]);
 			}
 
-			objectGroups.emplace(group->GetName(), objects);
+			objectGroups.emplace(group->GetName(), TiledObjectGroup(std::move(objects)));
 		}
 	}
 
@@ -327,10 +349,6 @@ private:
 		loadedSprites.reserve(tileCount);
 		loadedAnimatedSprites.reserve(animTileCount);
 	}
-
-	std::unordered_map<std::string, std::shared_ptr<Tileset>> &getDerivedTmxTilesets() {
-		return static_cast<T *>(this)->getTmxTilesets();
-	}
 };
 
 }
@@ -0,0 +1,187 @@
+#ifndef APG_NO_SDL
+#ifndef APG_NO_GL
+
+#include <cstdint>
+#include <cmath>
+
+#include <algorithm>
+#include <vector>
+
+#include "APG/graphics/AnimationSystem.hpp"
+#include "APG/internal/Assert.hpp"
+
+namespace APG {
+
+AnimationSystem::AnimationSystem(uint32_t expectedAnimations) {
+	times.reserve(expectedAnimations);
+	periods.reserve(expectedAnimations);
+	inversePeriods.reserve(expectedAnimations);
+	durations.reserve(expectedAnimations);
+	mirrors.reserve(expectedAnimations);
+	firstFrames.reserve(expectedAnimations);
+	frameCounts.reserve(expectedAnimations);
+	currentFrames.reserve(expectedAnimations);
+	reversed.reserve(expectedAnimations);
+	modes.reserve(expectedAnimations);
+	textures.reserve(expectedAnimations);
+	widths.reserve(expectedAnimations);
+	heights.reserve(expectedAnimations);
+	uvs.reserve(expectedAnimations);
+}
+
+AnimationSystem::handle_type AnimationSystem::add(const std::vector<SpriteBase *> &frames,
+        const std::vector<float> &frameDurations, AnimationMode mode) {
+	REQUIRE(!frames.empty(), "Can't add an animation with no frames to an animation system.");
+	REQUIRE(frames.size() == frameDurations.size(), "Need exactly one duration per frame in an animation system.");
+
+	const auto handle = static_cast<handle_type>(times.size());
+	const auto first = frames.front();
+
+	firstFrames.emplace_back(static_cast<uint32_t>(frameEndTimes.size()));
+	frameCounts.emplace_back(static_cast<uint32_t>(frames.size()));
+
+	float endTime = 0.0f;
+	for (size_t i = 0; i < frames.size(); ++i) {
+		const auto frame = frames[i];
+
+		REQUIRE(frame->getWidth() == first->getWidth() && frame->getHeight() == first->getHeight(),
+		        "Frame dimensions must match existing frames for animations.");
+		REQUIRE(frame->getTexture() == first->getTexture(), "Cannot have an animation spanning two different textures.");
+
+		endTime += std::max(frameDurations[i], 0.0f);
+
+		frameEndTimes.emplace_back(endTime);
+		frameUVs.push_back(UVRect{frame->getU1(), frame->getV1(), frame->getU2(), frame->getV2()});
+	}
+
+	times.emplace_back(0.0f);
+	durations.emplace_back(endTime);
+	periods.emplace_back(0.0f);
+	inversePeriods.emplace_back(0.0f);
+	mirrors.emplace_back(0.0f);
+	currentFrames.emplace_back(0u);
+	reversed.emplace_back(0u);
+	modes.emplace_back(mode);
+
+	textures.emplace_back(first->getTexture());
+	widths.emplace_back(first->getWidth());
+	heights.emplace_back(first->getHeight());
+
+	uvs.emplace_back(frameUVs[firstFrames.back()]);
+
+	applyMode(handle);
+
+	return handle;
+}
+
+AnimationSystem::handle_type AnimationSystem::add(const std::vector<SpriteBase *> &frames, float frameDuration,
+        AnimationMode mode) {
+	return add(frames, std::vector<float>(frames.size(), frameDuration), mode);
+}
+
+void AnimationSystem::updateAll(float deltaTime) {
+	const auto count = times.size();
+
+	float * const timeData = times.data();
+	const float * const periodData = periods.data();
+	const float * const inversePeriodData = inversePeriods.data();
+
+	// Pass 1: advance and wrap every animation's clock. There are no branches here so this loop vectorises.
+	// Looping animations wrap around their period; one-shot animations have an inverse period of 0 and
+	// are clamped to their end instead.
+	for (size_t i = 0; i < count; ++i) {
+		const float t = timeData[i] + deltaTime;
+		const float wrapped = t - std::floor(t * inversePeriodData[i]) * periodData[i];
+		timeData[i] = std::min(wrapped, periodData[i]);
+	}
+
+	// Pass 2: find the current frame of each animation in its frame time table and copy out its UVs.
+	for (size_t i = 0; i < count; ++i) {
+		const float t = timeData[i];
+
+		// ping-pong animations play backwards in the second half of their period
+		float localTime = t - mirrors[i] * 2.0f * std::max(0.0f, t - durations[i]);
+
+		// reversed animations mirror the time rather than the frame, so each frame keeps its own duration
+		if (reversed[i]) {
+			localTime = durations[i] - localTime;
+		}
+
+		const auto tableStart = frameEndTimes.begin() + firstFrames[i];
+		const auto tableEnd = tableStart + frameCounts[i];
+
+		auto frame = static_cast<uint32_t>(std::upper_bound(tableStart, tableEnd, localTime) - tableStart);
+		frame = std::min(frame, frameCounts[i] - 1u);
+
+		currentFrames[i] = frame;
+		uvs[i] = frameUVs[firstFrames[i] + frame];
+	}
+}
+
+void AnimationSystem::reset(handle_type handle) {
+	REQUIRE(handle < times.size(), "Invalid animation handle passed to reset.");
+
+	times[handle] = 0.0f;
+	currentFrames[handle] = reversed[handle] ? frameCounts[handle] - 1u : 0u;
+	uvs[handle] = frameUVs[firstFrames[handle] + currentFrames[handle]];
+}
+
+void AnimationSystem::setAnimationMode(handle_type handle, AnimationMode mode) {
+	REQUIRE(handle < times.size(), "Invalid animation handle passed to setAnimationMode.");
+
+	modes[handle] = mode;
+	applyMode(handle);
+}
+
+void AnimationSystem::clear() {
+	times.clear();
+	periods.clear();
+	inversePeriods.clear();
+	durations.clear();
+	mirrors.clear();
+	firstFrames.clear();
+	frameCounts.clear();
+	currentFrames.clear();
+	reversed.clear();
+	modes.clear();
+	textures.clear();
+	widths.clear();
+	heights.clear();
+	uvs.clear();
+	frameEndTimes.clear();
+	frameUVs.clear();
+}
+
+void AnimationSystem::applyMode(handle_type handle) {
+	const auto duration = durations[handle];
+
+	switch (modes[handle]) {
+	case AnimationMode::NORMAL:
+	case AnimationMode::REVERSED:
+		periods[handle] = duration;
+		inversePeriods[handle] = 0.0f;
+		mirrors[handle] = 0.0f;
+		break;
+
+	case AnimationMode::LOOP:
+		periods[handle] = duration;
+		inversePeriods[handle] = duration > 0.0f ? 1.0f / duration : 0.0f;
+		mirrors[handle] = 0.0f;
+		break;
+
+	case AnimationMode::LOOP_PINGPONG:
+		periods[handle] = duration * 2.0f;
+		inversePeriods[handle] = duration > 0.0f ? 1.0f / (duration * 2.0f) : 0.0f;
+		mirrors[handle] = 1.0f;
+		break;
+	}
+
+	reversed[handle] = (modes[handle] == AnimationMode::REVERSED) ? 1u : 0u;
+
+	reset(handle);
+}
+
+}
+
+#endif
+#endif
@@ -0,0 +1,254 @@
+#ifndef APG_NO_SDL
+#ifndef APG_NO_GL
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Tmx.h"
+
+#include "APG/graphics/AssetCache.hpp"
+
+namespace APG {
+
+AssetCache &AssetCache::getDefault() {
+	static AssetCache defaultCache;
+	return defaultCache;
+}
+
+AssetCache::AssetCache(size_t gpuBudgetBytes, size_t cpuBudgetBytes) :
+		gpuBudget{gpuBudgetBytes},
+		cpuBudget{cpuBudgetBytes},
+		logger{spdlog::get("APG")} {
+}
+
+std::shared_ptr<Texture> AssetCache::loadTexture(const std::string &fileName) {
+	return load<Texture>("texture:", fileName, [&fileName]() {
+		return std::make_shared<Texture>(fileName);
+	});
+}
+
+std::shared_ptr<Tileset> AssetCache::loadTileset(const std::string &fileName, Tmx::Tileset *tileset) {
+	return loadTileset(fileName, tileset->GetTileWidth(), tileset->GetTileHeight(), tileset->GetSpacing());
+}
+
+std::shared_ptr<Tileset> AssetCache::loadTileset(const std::string &fileName, int32_t tileWidth, int32_t tileHeight,
+        int32_t spacing) {
+	std::stringstream kind;
+	kind << "tileset:" << tileWidth << "x" << tileHeight << "+" << spacing << ":";
+
+	return load<Tileset>(kind.str(), fileName, [&]() {
+		return std::make_shared<Tileset>(fileName, tileWidth, tileHeight, spacing);
+	});
+}
+
+template<typename T, typename Loader>
+std::shared_ptr<T> AssetCache::load(const std::string &kindKey, const std::string &fileName, Loader &&loader) {
+	const auto pathKey = kindKey + fileName;
+
+	const auto byPath = pathIndex.find(pathKey);
+	if (byPath != pathIndex.end()) {
+		++stats.hits;
+		touch(byPath->second);
+		return std::static_pointer_cast<T>(byPath->second->asset);
+	}
+
+	uint64_t fileSize = 0u;
+	const auto contentKey = getFileSize(fileName, fileSize) ? kindKey + std::to_string(fileSize) : std::string();
+
+	if (!contentKey.empty()) {
+		const auto candidates = contentIndex.equal_range(contentKey);
+
+		for (auto candidate = candidates.first; candidate != candidates.second; ++candidate) {
+			const auto existing = candidate->second;
+
+			if (!fileContentsEqual(fileName, existing->sourceFile)) {
+				continue;
+			}
+
+			logger->trace("Asset \"{}\" has the same contents as an existing asset; reusing it.", fileName);
+
+			++stats.hits;
+			existing->pathKeys.emplace_back(pathKey);
+			pathIndex.emplace(pathKey, existing);
+			touch(existing);
+			return std::static_pointer_cast<T>(existing->asset);
+		}
+	}
+
+	++stats.misses;
+
+	std::shared_ptr<T> asset = loader();
+
+	if (asset->getWidth() == 0 || asset->getHeight() == 0) {
+		// failed to load; the texture will have already logged why. Don't cache failures.
+		return asset;
+	}
+
+	Entry entry;
+	entry.asset = asset;
+	entry.pathKeys.emplace_back(pathKey);
+	entry.contentKey = contentKey;
+	entry.sourceFile = fileName;
+
+	// textures are always uploaded as GL_RGBA8
+	entry.gpuBytes = static_cast<size_t>(asset->getWidth()) * static_cast<size_t>(asset->getHeight()) * 4u;
+
+	const auto surface = asset->getPreservedSurface();
+	if (surface != nullptr) {
+		entry.cpuBytes = static_cast<size_t>(surface->pitch) * static_cast<size_t>(surface->h);
+	}
+
+	stats.residentGPUBytes += entry.gpuBytes;
+	stats.residentCPUBytes += entry.cpuBytes;
+	++stats.assetCount;
+
+	entries.emplace_front(std::move(entry));
+
+	pathIndex.emplace(pathKey, entries.begin());
+	if (!contentKey.empty()) {
+		contentIndex.emplace(contentKey, entries.begin());
+	}
+
+	trim();
+
+	return asset;
+}
+
+void AssetCache::setBudget(size_t gpuBudgetBytes, size_t cpuBudgetBytes) {
+	gpuBudget = gpuBudgetBytes;
+	cpuBudget = cpuBudgetBytes;
+
+	trim();
+}
+
+size_t AssetCache::trim() {
+	size_t evicted = 0u;
+
+	auto it = entries.end();
+	while (overBudget() && it != entries.begin()) {
+		--it;
+
+		// only the cache holds a reference, so nobody is using this asset
+		if (it->asset.use_count() == 1) {
+			const auto toEvict = it;
+			++it;
+			evict(toEvict);
+			++evicted;
+		}
+	}
+
+	if (overBudget()) {
+		logger->trace("Asset cache is over budget but all resident assets are in use.");
+	}
+
+	return evicted;
+}
+
+size_t AssetCache::purgeUnused() {
+	size_t evicted = 0u;
+
+	for (auto it = entries.begin(); it != entries.end();) {
+		const auto current = it++;
+
+		if (current->asset.use_count() == 1) {
+			evict(current);
+			++evicted;
+		}
+	}
+
+	return evicted;
+}
+
+bool AssetCache::overBudget() const {
+	return (gpuBudget != 0u && stats.residentGPUBytes > gpuBudget)
+	       || (cpuBudget != 0u && stats.residentCPUBytes > cpuBudget);
+}
+
+void AssetCache::touch(entry_list::iterator it) {
+	entries.splice(entries.begin(), entries, it);
+}
+
+void AssetCache::evict(entry_list::iterator it) {
+	logger->trace("Evicting asset \"{}\" from cache ({} GPU bytes, {} CPU bytes).", it->asset->getFileName(),
+	        it->gpuBytes, it->cpuBytes);
+
+	for (const auto &pathKey : it->pathKeys) {
+		pathIndex.erase(pathKey);
+	}
+
+	const auto candidates = contentIndex.equal_range(it->contentKey);
+	for (auto candidate = candidates.first; candidate != candidates.second; ++candidate) {
+		if (candidate->second == it) {
+			contentIndex.erase(candidate);
+			break;
+		}
+	}
+
+	stats.residentGPUBytes -= it->gpuBytes;
+	stats.residentCPUBytes -= it->cpuBytes;
+	--stats.assetCount;
+	++stats.evictions;
+
+	entries.erase(it);
+}
+
+bool AssetCache::getFileSize(const std::string &fileName, uint64_t &size) {
+	std::ifstream file(fileName, std::ios::in | std::ios::binary | std::ios::ate);
+
+	if (!file) {
+		return false;
+	}
+
+	const auto end = file.tellg();
+	if (end < 0) {
+		return false;
+	}
+
+	size = static_cast<uint64_t>(end);
+	return true;
+}
+
+bool AssetCache::fileContentsEqual(const std::string &first, const std::string &second) {
+	std::ifstream firstFile(first, std::ios::in | std::ios::binary);
+	std::ifstream secondFile(second, std::ios::in | std::ios::binary);
+
+	if (!firstFile || !secondFile) {
+		return false;
+	}
+
+	std::vector<char> firstChunk(64u * 1024u);
+	std::vector<char> secondChunk(firstChunk.size());
+
+	while (true) {
+		firstFile.read(firstChunk.data(), firstChunk.size());
+		secondFile.read(secondChunk.data(), secondChunk.size());
+
+		const auto readCount = firstFile.gcount();
+
+		if (readCount != secondFile.gcount()) {
+			return false;
+		}
+
+		if (readCount <= 0) {
+			// both files ended at the same point; anything else means one of the reads failed
+			return firstFile.eof() && secondFile.eof();
+		}
+
+		if (std::memcmp(firstChunk.data(), secondChunk.data(), static_cast<size_t>(readCount)) != 0) {
+			return false;
+		}
+	}
+}
+
+}
+
+#endif
+#endif
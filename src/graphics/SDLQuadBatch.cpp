@@ -0,0 +1,126 @@
+#ifndef APG_NO_SDL
+
+#include <cstddef>
+
+#include <utility>
+#include <vector>
+
+#include "APG/SDL.hpp"
+#include "APG/SXXDL.hpp"
+#include "APG/graphics/SDLQuadBatch.hpp"
+
+namespace APG {
+
+SDLQuadBatch::SDLQuadBatch(const SXXDL::renderer_ptr &renderer) :
+		renderer{renderer} {
+}
+
+void SDLQuadBatch::add(SDL_Texture *texture, const SDL_Rect &srcRect, const SDL_Rect &dstRect) {
+	auto &bucket = getBucket(texture);
+
+#ifdef APG_SDL_HAS_RENDER_GEOMETRY
+	const auto u1 = srcRect.x * bucket.inverseWidth;
+	const auto v1 = srcRect.y * bucket.inverseHeight;
+	const auto u2 = (srcRect.x + srcRect.w) * bucket.inverseWidth;
+	const auto v2 = (srcRect.y + srcRect.h) * bucket.inverseHeight;
+
+	const auto x1 = static_cast<float>(dstRect.x);
+	const auto y1 = static_cast<float>(dstRect.y);
+	const auto x2 = static_cast<float>(dstRect.x + dstRect.w);
+	const auto y2 = static_cast<float>(dstRect.y + dstRect.h);
+
+	const SDL_Color white{255, 255, 255, 255};
+	const auto firstIndex = static_cast<int>(bucket.vertices.size());
+
+	bucket.vertices.push_back(SDL_Vertex{SDL_FPoint{x1, y1}, white, SDL_FPoint{u1, v1}});
+	bucket.vertices.push_back(SDL_Vertex{SDL_FPoint{x2, y1}, white, SDL_FPoint{u2, v1}});
+	bucket.vertices.push_back(SDL_Vertex{SDL_FPoint{x2, y2}, white, SDL_FPoint{u2, v2}});
+	bucket.vertices.push_back(SDL_Vertex{SDL_FPoint{x1, y2}, white, SDL_FPoint{u1, v2}});
+
+	bucket.indices.push_back(firstIndex);
+	bucket.indices.push_back(firstIndex + 1);
+	bucket.indices.push_back(firstIndex + 2);
+	bucket.indices.push_back(firstIndex + 2);
+	bucket.indices.push_back(firstIndex + 3);
+	bucket.indices.push_back(firstIndex);
+#else
+	bucket.srcRects.push_back(srcRect);
+	bucket.dstRects.push_back(dstRect);
+#endif
+
+	++quadCount;
+}
+
+bool SDLQuadBatch::flush() {
+	bool success = true;
+
+	for (const auto &bucket : buckets) {
+#ifdef APG_SDL_HAS_RENDER_GEOMETRY
+		if (bucket.vertices.empty()) {
+			continue;
+		}
+
+		if (SDL_RenderGeometry(renderer.get(), bucket.texture, bucket.vertices.data(),
+							   static_cast<int>(bucket.vertices.size()), bucket.indices.data(),
+							   static_cast<int>(bucket.indices.size())) < 0) {
+			success = false;
+		}
+#else
+		for (size_t i = 0; i < bucket.srcRects.size(); ++i) {
+			if (SDL_RenderCopy(renderer.get(), bucket.texture, &bucket.srcRects[i], &bucket.dstRects[i]) < 0) {
+				success = false;
+				break;
+			}
+		}
+#endif
+	}
+
+	clear();
+
+	return success;
+}
+
+void SDLQuadBatch::clear() {
+	for (auto &bucket : buckets) {
+#ifdef APG_SDL_HAS_RENDER_GEOMETRY
+		bucket.vertices.clear();
+		bucket.indices.clear();
+#else
+		bucket.srcRects.clear();
+		bucket.dstRects.clear();
+#endif
+	}
+
+	quadCount = 0u;
+}
+
+SDLQuadBatch::Bucket &SDLQuadBatch::getBucket(SDL_Texture *texture) {
+	if (lastBucket < buckets.size() && buckets[lastBucket].texture == texture) {
+		return buckets[lastBucket];
+	}
+
+	for (size_t i = 0; i < buckets.size(); ++i) {
+		if (buckets[i].texture == texture) {
+			lastBucket = i;
+			return buckets[i];
+		}
+	}
+
+	Bucket bucket;
+	bucket.texture = texture;
+
+	int width = 0, height = 0;
+	SDL_QueryTexture(texture, nullptr, nullptr, &width, &height);
+
+	bucket.inverseWidth = width > 0 ? 1.0f / static_cast<float>(width) : 0.0f;
+	bucket.inverseHeight = height > 0 ? 1.0f / static_cast<float>(height) : 0.0f;
+
+	lastBucket = buckets.size();
+	buckets.emplace_back(std::move(bucket));
+
+	return buckets.back();
+}
+
+}
+
+#endif
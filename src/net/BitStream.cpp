@@ -0,0 +1,111 @@
+#include <cstdint>
+
+#include "APG/net/BitStream.hpp"
+#include "APG/internal/Assert.hpp"
+
+namespace APG {
+
+namespace {
+
+// writeVarUInt's size classes, selected by a 2 bit prefix
+constexpr const uint32_t VAR_UINT_BITS[] = {4u, 8u, 16u, 32u};
+
+}
+
+BitWriter::BitWriter(ByteBuffer &buffer) :
+		buffer(buffer) {
+}
+
+BitWriter::~BitWriter() {
+	flush();
+}
+
+void BitWriter::writeBits(uint32_t value, uint32_t bits) {
+	REQUIRE(bits > 0u && bits <= 32u, "BitWriter can only write between 1 and 32 bits at once.");
+
+	const uint64_t mask = (static_cast<uint64_t>(1u) << bits) - 1u;
+
+	scratch |= (static_cast<uint64_t>(value) & mask) << scratchBits;
+	scratchBits += bits;
+	bitsWritten += bits;
+
+	while (scratchBits >= 8u) {
+		buffer.put(static_cast<uint8_t>(scratch & 0xFFu));
+		scratch >>= 8u;
+		scratchBits -= 8u;
+	}
+}
+
+void BitWriter::writeVarUInt(uint32_t value) {
+	uint32_t sizeClass = 0u;
+
+	while (sizeClass < 3u && (value >> VAR_UINT_BITS[sizeClass]) != 0u) {
+		++sizeClass;
+	}
+
+	writeBits(sizeClass, 2u);
+	writeBits(value, VAR_UINT_BITS[sizeClass]);
+}
+
+void BitWriter::flush() {
+	if (scratchBits > 0u) {
+		buffer.put(static_cast<uint8_t>(scratch & 0xFFu));
+		bitsWritten += 8u - scratchBits;
+	}
+
+	scratch = 0u;
+	scratchBits = 0u;
+}
+
+BitReader::BitReader(const BufferView &view) :
+		data{view.data},
+		totalBits{view.length * 8u} {
+}
+
+bool BitReader::readBits(uint32_t &value, uint32_t bits) {
+	REQUIRE(bits > 0u && bits <= 32u, "BitReader can only read between 1 and 32 bits at once.");
+
+	if (getBitsRemaining() < bits) {
+		bitPosition = totalBits;
+		return false;
+	}
+
+	uint64_t result = 0u;
+	uint32_t resultBits = 0u;
+
+	while (resultBits < bits) {
+		const auto byteOffset = bitPosition / 8u;
+		const auto bitOffset = bitPosition % 8u;
+		const auto available = 8u - bitOffset;
+
+		result |= static_cast<uint64_t>(data[byteOffset] >> bitOffset) << resultBits;
+
+		resultBits += available;
+		bitPosition += available;
+	}
+
+	// the last byte read may have contained bits beyond the ones asked for
+	bitPosition -= resultBits - bits;
+
+	value = static_cast<uint32_t>(result & ((static_cast<uint64_t>(1u) << bits) - 1u));
+	return true;
+}
+
+bool BitReader::readBool(bool &value) {
+	uint32_t bit = 0u;
+
+	if (!readBits(bit, 1u)) {
+		return false;
+	}
+
+	value = (bit != 0u);
+	return true;
+}
+
+bool BitReader::readVarUInt(uint32_t &value) {
+	uint32_t sizeClass = 0u;
+
+	return readBits(sizeClass, 2u) && readBits(value, VAR_UINT_BITS[sizeClass]);
+}
+
+}
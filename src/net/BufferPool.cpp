@@ -0,0 +1,266 @@
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <new>
+
+#include "APG/net/BufferPool.hpp"
+
+namespace APG {
+
+namespace {
+
+static_assert((BufferPool::MIN_CLASS_SIZE << (BufferPool::CLASS_COUNT - 1u)) == BufferPool::MAX_CLASS_SIZE,
+        "CLASS_COUNT must cover MIN_CLASS_SIZE to MAX_CLASS_SIZE");
+
+// how many bytes of free blocks each thread caches per class, and the shared pool holds per class
+constexpr const size_t THREAD_CACHE_BYTES = 256u * 1024u;
+constexpr const size_t SHARED_POOL_BYTES = 4u * 1024u * 1024u;
+
+constexpr const uint32_t MIN_CACHED_BLOCKS = 2u;
+constexpr const uint32_t MAX_CACHED_BLOCKS = 256u;
+
+// free blocks are kept in intrusive lists, so caching them never allocates
+struct FreeBlock {
+	FreeBlock *next;
+};
+
+struct FreeList {
+	FreeBlock *head = nullptr;
+	uint32_t count = 0u;
+
+	void push(void *block) {
+		auto freeBlock = static_cast<FreeBlock *>(block);
+		freeBlock->next = head;
+		head = freeBlock;
+		++count;
+	}
+
+	void *pop() {
+		auto block = head;
+		head = head->next;
+		--count;
+		return block;
+	}
+};
+
+std::atomic<uint64_t> heapAllocations { 0u };
+std::atomic<uint64_t> reuses { 0u };
+std::atomic<uint64_t> releases { 0u };
+std::atomic<uint64_t> unpooledAllocations { 0u };
+std::atomic<uint64_t> blocksOwned { 0u };
+std::atomic<uint64_t> bytesOwned { 0u };
+
+uint32_t classIndex(size_t size) {
+	uint32_t index = 0u;
+
+	while ((BufferPool::MIN_CLASS_SIZE << index) < size) {
+		++index;
+	}
+
+	return index;
+}
+
+size_t classSize(uint32_t index) {
+	return BufferPool::MIN_CLASS_SIZE << index;
+}
+
+uint32_t cacheLimit(uint32_t index, size_t bytes) {
+	return static_cast<uint32_t>(std::min<size_t>(MAX_CACHED_BLOCKS,
+	        std::max<size_t>(MIN_CACHED_BLOCKS, bytes / classSize(index))));
+}
+
+void freeBlock(void *block, uint32_t index) {
+	::operator delete(block);
+
+	--blocksOwned;
+	bytesOwned -= classSize(index);
+}
+
+struct SharedPool {
+	std::mutex mutex;
+	FreeList lists[BufferPool::CLASS_COUNT];
+
+	~SharedPool() {
+		for (uint32_t i = 0u; i < BufferPool::CLASS_COUNT; ++i) {
+			while (lists[i].count > 0u) {
+				freeBlock(lists[i].pop(), i);
+			}
+		}
+	}
+};
+
+SharedPool &sharedPool() {
+	static SharedPool pool;
+	return pool;
+}
+
+// set once this thread's cache is destroyed, for buffers freed by later thread_local or static destructors
+thread_local bool threadCacheDestroyed = false;
+
+struct ThreadCache {
+	FreeList lists[BufferPool::CLASS_COUNT];
+
+	~ThreadCache() {
+		threadCacheDestroyed = true;
+
+		// hand everything to the shared pool so other threads can use it
+		auto &shared = sharedPool();
+		std::lock_guard<std::mutex> lock(shared.mutex);
+
+		for (uint32_t i = 0u; i < BufferPool::CLASS_COUNT; ++i) {
+			const auto limit = cacheLimit(i, SHARED_POOL_BYTES);
+
+			while (lists[i].count > 0u) {
+				auto block = lists[i].pop();
+
+				if (shared.lists[i].count < limit) {
+					shared.lists[i].push(block);
+				} else {
+					freeBlock(block, i);
+				}
+			}
+		}
+	}
+};
+
+/**
+ * @return the calling thread's cache, or nullptr if it's already been destroyed during thread or process exit.
+ */
+ThreadCache *threadCache() {
+	if (threadCacheDestroyed) {
+		return nullptr;
+	}
+
+	// thread_local objects are destroyed before function-local statics on the main thread, so the shared pool
+	// outlives every thread cache
+	sharedPool();
+
+	thread_local ThreadCache cache;
+	return &cache;
+}
+
+}
+
+constexpr const size_t BufferPool::MIN_CLASS_SIZE;
+constexpr const size_t BufferPool::MAX_CLASS_SIZE;
+constexpr const uint32_t BufferPool::CLASS_COUNT;
+
+void *BufferPool::acquire(size_t size) {
+	if (size > MAX_CLASS_SIZE) {
+		++unpooledAllocations;
+		return ::operator new(size);
+	}
+
+	const auto index = classIndex(size);
+	const auto cache = threadCache();
+
+	if (cache == nullptr) {
+		++heapAllocations;
+		++blocksOwned;
+		bytesOwned += classSize(index);
+
+		return ::operator new(classSize(index));
+	}
+
+	auto &local = cache->lists[index];
+
+	if (local.count == 0u) {
+		// refill half of the thread cache at once so the lock is taken rarely
+		auto &shared = sharedPool();
+		std::lock_guard<std::mutex> lock(shared.mutex);
+
+		const auto wanted = std::max(1u, cacheLimit(index, THREAD_CACHE_BYTES) / 2u);
+
+		while (local.count < wanted && shared.lists[index].count > 0u) {
+			local.push(shared.lists[index].pop());
+		}
+	}
+
+	if (local.count > 0u) {
+		++reuses;
+		return local.pop();
+	}
+
+	++heapAllocations;
+	++blocksOwned;
+	bytesOwned += classSize(index);
+
+	return ::operator new(classSize(index));
+}
+
+void BufferPool::release(void *block, size_t size) {
+	if (block == nullptr) {
+		return;
+	}
+
+	if (size > MAX_CLASS_SIZE) {
+		::operator delete(block);
+		return;
+	}
+
+	++releases;
+
+	const auto index = classIndex(size);
+	const auto cache = threadCache();
+
+	if (cache == nullptr) {
+		freeBlock(block, index);
+		return;
+	}
+
+	auto &local = cache->lists[index];
+
+	local.push(block);
+
+	const auto limit = cacheLimit(index, THREAD_CACHE_BYTES);
+
+	if (local.count <= limit) {
+		return;
+	}
+
+	auto &shared = sharedPool();
+	std::lock_guard<std::mutex> lock(shared.mutex);
+
+	const auto sharedLimit = cacheLimit(index, SHARED_POOL_BYTES);
+
+	while (local.count > limit / 2u) {
+		auto spare = local.pop();
+
+		if (shared.lists[index].count < sharedLimit) {
+			shared.lists[index].push(spare);
+		} else {
+			freeBlock(spare, index);
+		}
+	}
+}
+
+size_t BufferPool::getClassSize(size_t size) {
+	return size > MAX_CLASS_SIZE ? size : classSize(classIndex(size));
+}
+
+BufferPool::Stats BufferPool::getStats() {
+	return Stats { heapAllocations.load(), reuses.load(), releases.load(), unpooledAllocations.load(),
+	        blocksOwned.load(), bytesOwned.load() };
+}
+
+void BufferPool::trim() {
+	const auto local = threadCache();
+	auto &shared = sharedPool();
+
+	std::lock_guard<std::mutex> lock(shared.mutex);
+
+	for (uint32_t i = 0u; i < CLASS_COUNT; ++i) {
+		while (local != nullptr && local->lists[i].count > 0u) {
+			freeBlock(local->lists[i].pop(), i);
+		}
+
+		while (shared.lists[i].count > 0u) {
+			freeBlock(shared.lists[i].pop(), i);
+		}
+	}
+}
+
+}
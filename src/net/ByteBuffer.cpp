@@ -20,6 +20,8 @@
  Adapted from https://github.com/RamseyK/ByteBufferCpp
  */
 
+#include <cstring>
+
 #include <vector>
 #include <utility>
 #include <algorithm>
@@ -98,16 +100,58 @@ void ByteBuffer::clear() {
 std::unique_ptr<ByteBuffer> ByteBuffer::clone() {
 	std::unique_ptr<ByteBuffer> ret = std::make_unique<ByteBuffer>(buf.size());
 
-	// Copy data
-	for (uint32_t i = 0; i < buf.size(); i++) {
-		ret->put((uint8_t) get(i));
+	cloneInto(*ret);
+
+	return ret;
+}
+
+/**
+ * Clone Into
+ * Replace the contents of target with a copy of this buffer's contents. target keeps its storage if it's large
+ * enough, so a buffer which is cloned into repeatedly stops allocating.
+ *
+ * @param target The buffer to copy into; its positions are reset to 0
+ */
+void ByteBuffer::cloneInto(ByteBuffer &target) const {
+	if (&target == this) {
+		return;
 	}
 
+	target.buf.assign(buf.begin(), buf.end());
+
 	// Reset positions
-	ret->setReadPos(0);
-	ret->setWritePos(0);
+	target.setReadPos(0);
+	target.setWritePos(0);
+}
 
-	return ret;
+/**
+ * Compact
+ * Discards all bytes before the read position, moving unread bytes to the start of the buffer. The write position
+ * moves back by the same amount, or to 0 if it was before the read position.
+ */
+void ByteBuffer::compact() {
+	if (rpos == 0) {
+		return;
+	}
+
+	const uint32_t consumed = std::min<uint32_t>(rpos, buf.size());
+
+	buf.erase(buf.begin(), buf.begin() + consumed);
+
+	wpos = (wpos > consumed) ? wpos - consumed : 0;
+	rpos = 0;
+}
+
+uint8_t *ByteBuffer::prepareWrite(uint32_t length) {
+	const auto oldSize = buf.size();
+	buf.resize(oldSize + length);
+
+	return buf.data() + oldSize;
+}
+
+void ByteBuffer::commitWrite(uint32_t used, uint32_t prepared) {
+	buf.resize(buf.size() - (prepared - used));
+	wpos = buf.size();
 }
 
 /**
@@ -122,24 +166,18 @@ bool ByteBuffer::equals(ByteBuffer* other) {
 	if (size() != other->size())
 		return false;
 
-	// Compare byte by byte
-	uint32_t len = size();
-	for (uint32_t i = 0; i < len; i++) {
-		if ((uint8_t) get(i) != (uint8_t) other->get(i))
-			return false;
-	}
-
-	return true;
+	return size() == 0 || memcmp(buf.data(), other->buf.data(), size()) == 0;
 }
 
 /**
  * Resize
- * Reallocates memory for the internal buffer of size newSize. Read and write positions will also be reset
+ * Reallocates memory for the internal buffer of size newSize. Read and write positions will also be reset.
+ * New bytes are zeroed, since pooled storage may hold another buffer's old contents
  *
  * @param newSize The amount of memory to allocate
  */
 void ByteBuffer::resize(uint32_t newSize) {
-	buf.resize(newSize);
+	buf.resize(newSize, 0);
 	rpos = 0;
 	wpos = 0;
 }
@@ -150,10 +188,44 @@ void ByteBuffer::resize(uint32_t newSize) {
  *
  * @return size of the internal buffer
  */
-uint32_t ByteBuffer::size() {
+uint32_t ByteBuffer::size() const {
 	return buf.size();
 }
 
+// Searching
+
+/**
+ * Find Bytes
+ * Find the first occurance of a sequence of bytes, starting from index start. memchr is used to jump between
+ * occurances of the first byte of the pattern, so long runs without it are skipped quickly.
+ *
+ * @param pattern Bytes to search for
+ * @param len Length of pattern
+ * @param start Index to start from. By default, start is 0
+ * @return Index of the start of the first match, or -1 if there is none
+ */
+int32_t ByteBuffer::findBytes(const uint8_t* pattern, uint32_t len, uint32_t start) const {
+	const uint32_t size = buf.size();
+
+	if (len == 0 || start >= size || size - start < len)
+		return -1;
+
+	const uint8_t* data = buf.data();
+	const uint8_t* end = data + size - len + 1; // one past the last position a match can start
+
+	for (const uint8_t* p = data + start; p < end; p++) {
+		p = static_cast<const uint8_t*>(memchr(p, pattern[0], end - p));
+
+		if (p == nullptr)
+			return -1;
+
+		if (memcmp(p + 1, pattern + 1, len - 1) == 0)
+			return static_cast<int32_t>(p - data);
+	}
+
+	return -1;
+}
+
 // Replacement
 
 /**
@@ -166,23 +238,24 @@ uint32_t ByteBuffer::size() {
  * @param firstOccuranceOnly If true, only replace the first occurance of the key. If false, replace all occurances. False by default
  */
 void ByteBuffer::replace(uint8_t key, uint8_t rep, uint32_t start, bool firstOccuranceOnly) {
-	uint32_t len = buf.size();
-	for (uint32_t i = start; i < len; i++) {
-		uint8_t data = read<uint8_t>(i);
+	const uint32_t len = buf.size();
 
-		// Wasn't actually found, bounds of buffer were exceeded
-		if ((key != 0) && (data == 0)) {
-			break;
-		}
+	if (start >= len)
+		return;
 
-		// Key was found in array, perform replacement
-		if (data == key) {
-			buf[i] = rep;
+	uint8_t* data = buf.data();
+	uint8_t* end = data + len;
 
-			if (firstOccuranceOnly) {
-				return;
-			}
-		}
+	for (uint8_t* p = data + start; p < end; p++) {
+		p = static_cast<uint8_t*>(memchr(p, key, end - p));
+
+		if (p == nullptr)
+			return;
+
+		*p = rep;
+
+		if (firstOccuranceOnly)
+			return;
 	}
 }
 
@@ -201,9 +274,107 @@ uint8_t ByteBuffer::get(uint32_t index) const {
 }
 
 void ByteBuffer::getBytes(uint8_t* buf, uint32_t len) const {
-	for (uint32_t i = 0; i < len; i++) {
-		buf[i] = read<uint8_t>();
-	}
+	// Bytes past the end of the buffer read as 0, as with the other getters
+	const uint32_t available = (rpos < size()) ? std::min(len, size() - rpos) : 0;
+
+	memcpy(buf, this->buf.data() + rpos, available);
+	memset(buf + available, 0, len - available);
+
+	rpos += len;
+}
+
+uint16_t ByteBuffer::getUInt16LE() const {
+	return readLE<uint16_t>();
+}
+
+uint16_t ByteBuffer::getUInt16BE() const {
+	return readBE<uint16_t>();
+}
+
+uint32_t ByteBuffer::getUInt32LE() const {
+	return readLE<uint32_t>();
+}
+
+uint32_t ByteBuffer::getUInt32BE() const {
+	return readBE<uint32_t>();
+}
+
+uint64_t ByteBuffer::getUInt64LE() const {
+	return readLE<uint64_t>();
+}
+
+uint64_t ByteBuffer::getUInt64BE() const {
+	return readBE<uint64_t>();
+}
+
+float ByteBuffer::getFloatLE() const {
+	const uint32_t bits = readLE<uint32_t>();
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+float ByteBuffer::getFloatBE() const {
+	const uint32_t bits = readBE<uint32_t>();
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+double ByteBuffer::getDoubleLE() const {
+	const uint64_t bits = readLE<uint64_t>();
+	double value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+double ByteBuffer::getDoubleBE() const {
+	const uint64_t bits = readBE<uint64_t>();
+	double value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+bool ByteBuffer::getVarUInt32(uint32_t &value) const {
+	const uint32_t available = (rpos < size()) ? size() - rpos : 0;
+	uint32_t bytesRead = 0;
+
+	if (decodeVarint32(buf.data() + rpos, available, value, bytesRead) != VarintResult::COMPLETE)
+		return false;
+
+	rpos += bytesRead;
+	return true;
+}
+
+bool ByteBuffer::getVarUInt64(uint64_t &value) const {
+	const uint32_t available = (rpos < size()) ? size() - rpos : 0;
+	uint32_t bytesRead = 0;
+
+	if (decodeVarint64(buf.data() + rpos, available, value, bytesRead) != VarintResult::COMPLETE)
+		return false;
+
+	rpos += bytesRead;
+	return true;
+}
+
+bool ByteBuffer::getVarInt32(int32_t &value) const {
+	uint32_t encoded = 0;
+
+	if (!getVarUInt32(encoded))
+		return false;
+
+	value = zigzagDecode(encoded);
+	return true;
+}
+
+bool ByteBuffer::getVarInt64(int64_t &value) const {
+	uint64_t encoded = 0;
+
+	if (!getVarUInt64(encoded))
+		return false;
+
+	value = zigzagDecode(encoded);
+	return true;
 }
 
 char ByteBuffer::getChar() const {
@@ -279,66 +450,148 @@ uint16_t ByteBuffer::getShort(uint32_t index) const {
 }
 
 std::string ByteBuffer::getStringByNullCharacter() const {
-	std::vector<char> strBuf;
-	strBuf.reserve(std::min<size_t>(64u, buf.size() - rpos));
+	return getStringViewByNullCharacter().toString();
+}
 
-	bool done = false;
-	while (!done) {
-		char charRead = read<char>();
+std::string ByteBuffer::getStringByNullCharacter(uint32_t index) const {
+	const uint32_t oldPos = rpos;
 
-		done = (charRead == '\0');
+	rpos = index;
+	const StringView str = getStringViewByNullCharacter();
+	rpos = oldPos;
 
-		strBuf.emplace_back(std::move(charRead));
-	}
+	return str.toString();
+}
+
+std::string ByteBuffer::getStringByLength(size_t length) const {
+	std::string str(length, '\0');
+	getBytes(reinterpret_cast<uint8_t*>(&str[0]), length);
 
-	return std::string(strBuf.data());
+	return str;
 }
 
-std::string ByteBuffer::getStringByNullCharacter(uint32_t index) const {
-	std::vector<char> strBuf;
-	strBuf.reserve(std::min<size_t>(64u, buf.size() - rpos));
+std::string ByteBuffer::getStringByLength(size_t length, uint32_t index) const {
+	const uint32_t oldPos = rpos;
 
-	bool done = false;
-	while (!done) {
-		char charRead = read<char>(index);
-		index++;
+	rpos = index;
+	std::string str = getStringByLength(length);
+	rpos = oldPos;
 
-		done = (charRead == '\0');
+	return str;
+}
 
-		strBuf.emplace_back(std::move(charRead));
+BufferView ByteBuffer::getView(uint32_t length) const {
+	const BufferView view = getView(length, rpos);
+
+	if (view.length == length)
+		rpos += length;
+
+	return view;
+}
+
+BufferView ByteBuffer::getView(uint32_t length, uint32_t index) const {
+	if (index > size() || size() - index < length)
+		return BufferView();
+
+	return BufferView(buf.data() + index, length);
+}
+
+StringView ByteBuffer::getStringViewByNullCharacter() const {
+	if (rpos >= size()) {
+		rpos += 1;
+		return StringView();
 	}
 
-	return std::string(strBuf.data());
+	const char* start = reinterpret_cast<const char*>(buf.data() + rpos);
+	const uint32_t available = size() - rpos;
+
+	const char* terminator = static_cast<const char*>(memchr(start, '\0', available));
+	const uint32_t length = (terminator == nullptr) ? available : static_cast<uint32_t>(terminator - start);
+
+	// Skip the terminator too, even if it was missing, as the byte-by-byte version did
+	rpos += length + 1;
+
+	return StringView(start, length);
 }
 
-std::string ByteBuffer::getStringByLength(size_t length) const {
-	std::vector<char> strBuf;
-	strBuf.reserve(length);
+StringView ByteBuffer::getStringViewByLength(uint32_t length) const {
+	const BufferView view = getView(length);
+
+	if (view.length != length)
+		return StringView();
+
+	return StringView(reinterpret_cast<const char*>(view.data), view.length);
+}
+
+bool ByteBuffer::getLengthPrefixedString(StringView &str) const {
+	const uint32_t oldPos = rpos;
+	uint32_t length = 0;
+
+	if (!getVarUInt32(length))
+		return false;
 
-	for (size_t i = 0u; i < length; i++) {
-		strBuf.emplace_back(read<char>());
+	if (size() - rpos < length) {
+		rpos = oldPos;
+		return false;
 	}
 
-	return std::string(strBuf.data(), length);
+	str = StringView(reinterpret_cast<const char*>(buf.data() + rpos), length);
+	rpos += length;
+
+	return true;
 }
 
-std::string ByteBuffer::getStringByLength(size_t length, uint32_t index) const {
-	std::vector<char> strBuf;
-	strBuf.reserve(length);
+bool ByteBuffer::getLengthPrefixedString(std::string &str) const {
+	StringView view;
+
+	if (!getLengthPrefixedString(view))
+		return false;
+
+	str.assign(view.data, view.length);
+	return true;
+}
+
+bool ByteBuffer::getLengthPrefixedStrings(std::vector<StringView> &strs) const {
+	const uint32_t oldPos = rpos;
+	uint32_t count = 0;
+
+	if (!getVarUInt32(count))
+		return false;
+
+	// Each string takes at least one byte, which bounds a malicious count before anything is reserved
+	if (count > size() - rpos) {
+		rpos = oldPos;
+		return false;
+	}
+
+	strs.clear();
+	strs.reserve(count);
 
-	for (size_t i = index; i < length; i++) {
-		strBuf.emplace_back(read<char>(i));
+	for (uint32_t i = 0; i < count; i++) {
+		StringView str;
+
+		if (!getLengthPrefixedString(str)) {
+			rpos = oldPos;
+			strs.clear();
+			return false;
+		}
+
+		strs.push_back(str);
 	}
 
-	return std::string(strBuf.data(), length);
+	return true;
 }
 
 // Write Functions
 
 void ByteBuffer::put(ByteBuffer* src) {
-	uint32_t len = src->size();
-	for (uint32_t i = 0; i < len; i++)
-		append<uint8_t>(src->get(i));
+	if (src == this) {
+		const byte_vector copy(buf.begin(), buf.end());
+		putBytes(copy.data(), copy.size());
+		return;
+	}
+
+	putBytes(src->buf.data(), src->size());
 }
 
 void ByteBuffer::put(uint8_t b) {
@@ -349,18 +602,39 @@ void ByteBuffer::put(uint8_t b, uint32_t index) {
 	insert<uint8_t>(b, index);
 }
 
-void ByteBuffer::putBytes(uint8_t* b, uint32_t len) {
-	// Insert the data one byte at a time into the internal buffer at position i+starting index
-	for (uint32_t i = 0; i < len; i++)
-		append<uint8_t>(b[i]);
+void ByteBuffer::putBytes(const uint8_t* b, uint32_t len) {
+	if (len == 0)
+		return;
+
+	// A write position past the end leaves a gap, which is zeroed rather than exposing old pooled memory
+	if (size() < wpos)
+		buf.resize(wpos, 0);
+
+	// Overwrite what's already there and insert the rest, so no new byte is left uninitialised
+	const uint32_t overlap = std::min(len, size() - wpos);
+
+	memcpy(buf.data() + wpos, b, overlap);
+	buf.insert(buf.end(), b + overlap, b + len);
+
+	wpos += len;
 }
 
-void ByteBuffer::putBytes(uint8_t* b, uint32_t len, uint32_t index) {
+void ByteBuffer::putBytes(const uint8_t* b, uint32_t len, uint32_t index) {
 	wpos = index;
+	putBytes(b, len);
+}
+
+void ByteBuffer::insertBytes(const uint8_t* b, uint32_t len, uint32_t index) {
+	if (len == 0 || index > size())
+		return;
+
+	buf.insert(buf.begin() + index, b, b + len);
 
-	// Insert the data one byte at a time into the internal buffer at position i+starting index
-	for (uint32_t i = 0; i < len; i++)
-		append<uint8_t>(b[i]);
+	if (wpos > index)
+		wpos += len;
+
+	if (rpos > index)
+		rpos += len;
 }
 
 void ByteBuffer::putChar(char value) {
@@ -435,9 +709,7 @@ void ByteBuffer::putShort(uint16_t value, uint32_t index) {
 }
 
 void ByteBuffer::putString(const std::string &str) {
-	for (const char &c : str) {
-		append<char>(c);
-	}
+	putBytes(reinterpret_cast<const uint8_t*>(str.data()), str.size());
 }
 
 void ByteBuffer::putString(const std::string &str, uint32_t index) {
@@ -447,6 +719,166 @@ void ByteBuffer::putString(const std::string &str, uint32_t index) {
 	}
 }
 
+void ByteBuffer::putLengthPrefixedString(const char* str, uint32_t len) {
+	uint8_t prefix[MAX_VARINT32_SIZE];
+	const uint32_t prefixLength = encodeVarint(len, prefix);
+
+	// One allocation for both, rather than growing twice
+	buf.reserve(wpos + prefixLength + len);
+
+	putBytes(prefix, prefixLength);
+	putBytes(reinterpret_cast<const uint8_t*>(str), len);
+}
+
+void ByteBuffer::putLengthPrefixedString(const std::string &str) {
+	putLengthPrefixedString(str.data(), str.size());
+}
+
+void ByteBuffer::putLengthPrefixedString(const StringView &str) {
+	putLengthPrefixedString(str.data, str.length);
+}
+
+void ByteBuffer::putLengthPrefixedStrings(const std::vector<std::string> &strs) {
+	size_t total = MAX_VARINT32_SIZE;
+	for (const auto &str : strs)
+		total += MAX_VARINT32_SIZE + str.size();
+
+	buf.reserve(wpos + total);
+
+	putVarUInt32(strs.size());
+
+	for (const auto &str : strs)
+		putLengthPrefixedString(str);
+}
+
+void ByteBuffer::putUInt16LE(uint16_t value) {
+	appendLE<uint16_t>(value);
+}
+
+void ByteBuffer::putUInt16BE(uint16_t value) {
+	appendBE<uint16_t>(value);
+}
+
+void ByteBuffer::putUInt32LE(uint32_t value) {
+	appendLE<uint32_t>(value);
+}
+
+void ByteBuffer::putUInt32BE(uint32_t value) {
+	appendBE<uint32_t>(value);
+}
+
+void ByteBuffer::putUInt64LE(uint64_t value) {
+	appendLE<uint64_t>(value);
+}
+
+void ByteBuffer::putUInt64BE(uint64_t value) {
+	appendBE<uint64_t>(value);
+}
+
+void ByteBuffer::putFloatLE(float value) {
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	appendLE<uint32_t>(bits);
+}
+
+void ByteBuffer::putFloatBE(float value) {
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	appendBE<uint32_t>(bits);
+}
+
+void ByteBuffer::putDoubleLE(double value) {
+	uint64_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	appendLE<uint64_t>(bits);
+}
+
+void ByteBuffer::putDoubleBE(double value) {
+	uint64_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	appendBE<uint64_t>(bits);
+}
+
+void ByteBuffer::putVarUInt32(uint32_t value) {
+	putVarUInt64(value);
+}
+
+void ByteBuffer::putVarUInt64(uint64_t value) {
+	uint8_t bytes[MAX_VARINT64_SIZE];
+	putBytes(bytes, encodeVarint(value, bytes));
+}
+
+void ByteBuffer::putVarInt32(int32_t value) {
+	putVarUInt64(zigzagEncode(value));
+}
+
+void ByteBuffer::putVarInt64(int64_t value) {
+	putVarUInt64(zigzagEncode(value));
+}
+
+// Varint Encoding
+
+constexpr const uint32_t ByteBuffer::MAX_VARINT32_SIZE;
+constexpr const uint32_t ByteBuffer::MAX_VARINT64_SIZE;
+
+uint32_t ByteBuffer::encodeVarint(uint64_t value, uint8_t* out) {
+	uint32_t count = 0;
+
+	while (value >= 0x80) {
+		out[count++] = static_cast<uint8_t>(value | 0x80);
+		value >>= 7;
+	}
+
+	out[count++] = static_cast<uint8_t>(value);
+
+	return count;
+}
+
+ByteBuffer::VarintResult ByteBuffer::decodeVarint32(const uint8_t* data, uint32_t available, uint32_t &value,
+        uint32_t &bytesRead) {
+	uint64_t result = 0;
+	uint32_t count = 0;
+
+	const VarintResult ret = decodeVarint64(data, std::min(available, MAX_VARINT32_SIZE), result, count);
+
+	if (ret == VarintResult::INCOMPLETE && available >= MAX_VARINT32_SIZE)
+		return VarintResult::MALFORMED;
+
+	if (ret != VarintResult::COMPLETE)
+		return ret;
+
+	if (result > UINT32_MAX)
+		return VarintResult::MALFORMED;
+
+	value = static_cast<uint32_t>(result);
+	bytesRead = count;
+	return VarintResult::COMPLETE;
+}
+
+ByteBuffer::VarintResult ByteBuffer::decodeVarint64(const uint8_t* data, uint32_t available, uint64_t &value,
+        uint32_t &bytesRead) {
+	uint64_t result = 0;
+
+	for (uint32_t i = 0; i < MAX_VARINT64_SIZE; i++) {
+		if (i == available)
+			return VarintResult::INCOMPLETE;
+
+		result |= static_cast<uint64_t>(data[i] & 0x7f) << (7 * i);
+
+		if ((data[i] & 0x80) == 0) {
+			// the 10th byte can only hold the top bit of a 64 bit value
+			if (i == MAX_VARINT64_SIZE - 1 && data[i] > 1)
+				return VarintResult::MALFORMED;
+
+			value = result;
+			bytesRead = i + 1;
+			return VarintResult::COMPLETE;
+		}
+	}
+
+	return VarintResult::MALFORMED;
+}
+
 // Utility Functions
 #ifdef BB_UTILITY
 void ByteBuffer::setName(std::string n) {
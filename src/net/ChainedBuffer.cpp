@@ -0,0 +1,327 @@
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "APG/net/ChainedBuffer.hpp"
+#include "APG/net/BufferPool.hpp"
+#include "APG/net/Socket.hpp"
+#include "APG/internal/Assert.hpp"
+
+namespace APG {
+
+constexpr const uint32_t ChainedBuffer::DEFAULT_BLOCK_SIZE;
+
+ChainedBuffer::ChainedBuffer(uint32_t blockSize) :
+		blockSize{blockSize} {
+	REQUIRE(blockSize > 0u, "ChainedBuffer blocks must have a size.");
+}
+
+ChainedBuffer::~ChainedBuffer() {
+	releaseBlocks(0u);
+}
+
+ChainedBuffer::ChainedBuffer(ChainedBuffer &&other) noexcept :
+		blockSize{other.blockSize},
+		blocks(std::move(other.blocks)),
+		totalSize{other.totalSize},
+		readPos{other.readPos},
+		readBlock{other.readBlock},
+		readOffset{other.readOffset} {
+	other.blocks.clear();
+	other.totalSize = 0u;
+	other.readPos = 0u;
+	other.readBlock = 0u;
+	other.readOffset = 0u;
+}
+
+ChainedBuffer &ChainedBuffer::operator=(ChainedBuffer &&other) noexcept {
+	if (&other != this) {
+		releaseBlocks(0u);
+
+		blockSize = other.blockSize;
+		blocks = std::move(other.blocks);
+		totalSize = other.totalSize;
+		readPos = other.readPos;
+		readBlock = other.readBlock;
+		readOffset = other.readOffset;
+
+		other.blocks.clear();
+		other.totalSize = 0u;
+		other.readPos = 0u;
+		other.readBlock = 0u;
+		other.readOffset = 0u;
+	}
+
+	return *this;
+}
+
+void ChainedBuffer::clear() {
+	releaseBlocks(1u);
+
+	if (!blocks.empty()) {
+		blocks.front().used = 0u;
+	}
+
+	totalSize = 0u;
+	readPos = 0u;
+	readBlock = 0u;
+	readOffset = 0u;
+}
+
+void ChainedBuffer::setReadPos(size_t pos) {
+	readPos = std::min(pos, totalSize);
+
+	if (blocks.empty()) {
+		readBlock = 0u;
+		readOffset = 0u;
+		return;
+	}
+
+	// every block but the last is full, so the block can be found by division
+	readBlock = static_cast<uint32_t>(readPos / blockSize);
+	readOffset = static_cast<uint32_t>(readPos % blockSize);
+
+	if (readBlock == blocks.size()) {
+		--readBlock;
+		readOffset = blockSize;
+	}
+}
+
+void ChainedBuffer::put(uint8_t b) {
+	append<uint8_t>(b);
+}
+
+void ChainedBuffer::put(const ByteBuffer &src) {
+	putBytes(src.view());
+}
+
+void ChainedBuffer::putBytes(const uint8_t *b, size_t len) {
+	while (len > 0u) {
+		if (blocks.empty() || blocks.back().used == blockSize) {
+			addBlock();
+		}
+
+		auto &block = blocks.back();
+		const auto count = std::min<size_t>(len, blockSize - block.used);
+
+		std::memcpy(block.data + block.used, b, count);
+
+		block.used += static_cast<uint32_t>(count);
+		totalSize += count;
+		b += count;
+		len -= count;
+	}
+}
+
+void ChainedBuffer::putBytes(const BufferView &view) {
+	putBytes(view.data, view.length);
+}
+
+void ChainedBuffer::putChar(char value) {
+	append<char>(value);
+}
+
+void ChainedBuffer::putDouble(double value) {
+	append<double>(value);
+}
+
+void ChainedBuffer::putFloat(float value) {
+	append<float>(value);
+}
+
+void ChainedBuffer::putUInt16(uint16_t value) {
+	append<uint16_t>(value);
+}
+
+void ChainedBuffer::putUInt32(uint32_t value) {
+	append<uint32_t>(value);
+}
+
+void ChainedBuffer::putUInt64(uint64_t value) {
+	append<uint64_t>(value);
+}
+
+void ChainedBuffer::putString(const std::string &str) {
+	putBytes(reinterpret_cast<const uint8_t *>(str.data()), str.size());
+}
+
+void ChainedBuffer::putVarUInt32(uint32_t value) {
+	putVarUInt64(value);
+}
+
+void ChainedBuffer::putVarUInt64(uint64_t value) {
+	uint8_t bytes[ByteBuffer::MAX_VARINT64_SIZE];
+	putBytes(bytes, ByteBuffer::encodeVarint(value, bytes));
+}
+
+void ChainedBuffer::putLengthPrefixedString(const std::string &str) {
+	putVarUInt32(static_cast<uint32_t>(str.size()));
+	putString(str);
+}
+
+uint8_t ChainedBuffer::get() const {
+	return read<uint8_t>();
+}
+
+void ChainedBuffer::getBytes(uint8_t *buf, size_t len) const {
+	size_t copied = 0u;
+
+	while (copied < len && readBlock < blocks.size()) {
+		const auto &block = blocks[readBlock];
+
+		if (readOffset == block.used) {
+			if (readBlock + 1u == blocks.size()) {
+				break;
+			}
+
+			++readBlock;
+			readOffset = 0u;
+			continue;
+		}
+
+		const auto count = std::min<size_t>(len - copied, block.used - readOffset);
+		std::memcpy(buf + copied, block.data + readOffset, count);
+
+		copied += count;
+		readOffset += static_cast<uint32_t>(count);
+	}
+
+	readPos += copied;
+
+	std::memset(buf + copied, 0, len - copied);
+}
+
+char ChainedBuffer::getChar() const {
+	return read<char>();
+}
+
+double ChainedBuffer::getDouble() const {
+	return read<double>();
+}
+
+float ChainedBuffer::getFloat() const {
+	return read<float>();
+}
+
+uint16_t ChainedBuffer::getUInt16() const {
+	return read<uint16_t>();
+}
+
+uint32_t ChainedBuffer::getUInt32() const {
+	return read<uint32_t>();
+}
+
+uint64_t ChainedBuffer::getUInt64() const {
+	return read<uint64_t>();
+}
+
+std::string ChainedBuffer::getStringByLength(size_t length) const {
+	std::string str(length, '\0');
+	getBytes(reinterpret_cast<uint8_t *>(&str[0]), length);
+
+	return str;
+}
+
+bool ChainedBuffer::getVarUInt32(uint32_t &value) const {
+	uint64_t result = 0u;
+
+	if (!getVarUInt64(result) || result > UINT32_MAX) {
+		return false;
+	}
+
+	value = static_cast<uint32_t>(result);
+	return true;
+}
+
+bool ChainedBuffer::getVarUInt64(uint64_t &value) const {
+	uint8_t bytes[ByteBuffer::MAX_VARINT64_SIZE];
+	const auto available = peekBytes(bytes, ByteBuffer::MAX_VARINT64_SIZE);
+
+	uint32_t bytesRead = 0u;
+
+	if (ByteBuffer::decodeVarint64(bytes, static_cast<uint32_t>(available), value, bytesRead)
+	        != ByteBuffer::VarintResult::COMPLETE) {
+		return false;
+	}
+
+	getBytes(bytes, bytesRead);
+	return true;
+}
+
+bool ChainedBuffer::getLengthPrefixedString(std::string &str) const {
+	const auto oldPos = readPos;
+	const auto oldBlock = readBlock;
+	const auto oldOffset = readOffset;
+
+	uint32_t length = 0u;
+
+	if (!getVarUInt32(length) || bytesRemaining() < length) {
+		readPos = oldPos;
+		readBlock = oldBlock;
+		readOffset = oldOffset;
+		return false;
+	}
+
+	str.resize(length);
+	getBytes(reinterpret_cast<uint8_t *>(&str[0]), length);
+
+	return true;
+}
+
+void ChainedBuffer::getViews(std::vector<BufferView> &views) const {
+	for (const auto &block : blocks) {
+		if (block.used > 0u) {
+			views.emplace_back(block.data, block.used);
+		}
+	}
+}
+
+int ChainedBuffer::send(Socket &socket) const {
+	sendViews.clear();
+	getViews(sendViews);
+
+	return socket.sendv(sendViews);
+}
+
+void ChainedBuffer::copyTo(ByteBuffer &target) const {
+	target.clear();
+
+	for (const auto &block : blocks) {
+		target.putBytes(block.data, block.used);
+	}
+}
+
+void ChainedBuffer::addBlock() {
+	blocks.push_back(Block { static_cast<uint8_t *>(BufferPool::acquire(blockSize)), 0u });
+}
+
+void ChainedBuffer::releaseBlocks(size_t keep) {
+	while (blocks.size() > keep) {
+		BufferPool::release(blocks.back().data, blockSize);
+		blocks.pop_back();
+	}
+}
+
+size_t ChainedBuffer::peekBytes(uint8_t *buf, size_t len) const {
+	size_t copied = 0u;
+	auto block = readBlock;
+	auto offset = readOffset;
+
+	while (copied < len && block < blocks.size()) {
+		const auto count = std::min<size_t>(len - copied, blocks[block].used - offset);
+		std::memcpy(buf + copied, blocks[block].data + offset, count);
+
+		copied += count;
+		++block;
+		offset = 0u;
+	}
+
+	return copied;
+}
+
+}
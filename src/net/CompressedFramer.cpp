@@ -0,0 +1,270 @@
+#include <cstdint>
+#include <cstring>
+
+#include <chrono>
+
+#include <zlib.h>
+
+#include "APG/net/CompressedFramer.hpp"
+
+namespace APG {
+
+namespace {
+
+enum class MessageType : uint8_t {
+	UNCOMPRESSED = 0u,
+	COMPRESSED = 1u,
+	HANDSHAKE = 2u
+};
+
+constexpr const uint8_t HANDSHAKE_VERSION = 1u;
+constexpr const uint8_t HANDSHAKE_FLAG_COMPRESSION = 1u << 0u;
+constexpr const uint32_t HANDSHAKE_SIZE = 7u;
+
+// negative window bits select raw deflate, without zlib headers or checksums on every message
+constexpr const int WINDOW_BITS = -15;
+constexpr const int MEMORY_LEVEL = 8;
+
+// a sync flush always ends with an empty stored block; it's stripped before sending and restored before inflating
+constexpr const uint8_t SYNC_FLUSH_TAIL[] = {0x00u, 0x00u, 0xFFu, 0xFFu};
+
+constexpr const uint32_t OUTPUT_CHUNK_SIZE = 16u * 1024u;
+
+using clock = std::chrono::steady_clock;
+
+}
+
+CompressedFramer::CompressedFramer(MessageFramer &framer, const CompressionOptions &options) :
+		framer(framer),
+		options(options),
+		logger{spdlog::get("APG")} {
+	dictionaryChecksum = static_cast<uint32_t>(::adler32(0L, Z_NULL, 0));
+
+	if (!options.dictionary.empty()) {
+		dictionaryChecksum = static_cast<uint32_t>(::adler32(dictionaryChecksum, options.dictionary.data(),
+		        static_cast<uInt>(options.dictionary.size())));
+	}
+
+	if (!options.enabled) {
+		return;
+	}
+
+	std::memset(&deflater, 0, sizeof(deflater));
+	std::memset(&inflater, 0, sizeof(inflater));
+
+	deflaterReady = (::deflateInit2(&deflater, options.level, Z_DEFLATED, WINDOW_BITS, MEMORY_LEVEL,
+	        Z_DEFAULT_STRATEGY) == Z_OK);
+	inflaterReady = (::inflateInit2(&inflater, WINDOW_BITS) == Z_OK);
+
+	bool dictionarySet = true;
+
+	if (deflaterReady && inflaterReady && !options.dictionary.empty()) {
+		const auto dictionary = options.dictionary.data();
+		const auto dictionaryLength = static_cast<uInt>(options.dictionary.size());
+
+		dictionarySet = (::deflateSetDictionary(&deflater, dictionary, dictionaryLength) == Z_OK)
+		        && (::inflateSetDictionary(&inflater, dictionary, dictionaryLength) == Z_OK);
+	}
+
+	if (!deflaterReady || !inflaterReady || !dictionarySet) {
+		logger->error("Couldn't initialise zlib for message compression; compression will be disabled.");
+		this->options.enabled = false;
+	}
+}
+
+CompressedFramer::~CompressedFramer() {
+	if (deflaterReady) {
+		::deflateEnd(&deflater);
+	}
+
+	if (inflaterReady) {
+		::inflateEnd(&inflater);
+	}
+}
+
+int CompressedFramer::sendHandshake() {
+	uint8_t handshake[HANDSHAKE_SIZE];
+
+	handshake[0] = static_cast<uint8_t>(MessageType::HANDSHAKE);
+	handshake[1] = HANDSHAKE_VERSION;
+	handshake[2] = options.enabled ? HANDSHAKE_FLAG_COMPRESSION : 0u;
+
+	for (uint32_t i = 0u; i < 4u; ++i) {
+		handshake[3u + i] = static_cast<uint8_t>(dictionaryChecksum >> (8u * i));
+	}
+
+	framer.queue(handshake, HANDSHAKE_SIZE);
+	return framer.flush();
+}
+
+void CompressedFramer::queue(const BufferView &message) {
+	if (!compressing || message.length < options.threshold) {
+		compressed.clear();
+		compressed.push_back(static_cast<uint8_t>(MessageType::UNCOMPRESSED));
+		compressed.insert(compressed.end(), message.begin(), message.end());
+
+		framer.queue(compressed.data(), static_cast<uint32_t>(compressed.size()));
+
+		++stats.messagesUncompressed;
+		return;
+	}
+
+	const auto start = clock::now();
+
+	compressed.resize(1u + OUTPUT_CHUNK_SIZE);
+	compressed[0] = static_cast<uint8_t>(MessageType::COMPRESSED);
+
+	deflater.next_in = const_cast<Bytef *>(message.data);
+	deflater.avail_in = message.length;
+
+	size_t produced = 1u;
+
+	while (true) {
+		deflater.next_out = compressed.data() + produced;
+		deflater.avail_out = static_cast<uInt>(compressed.size() - produced);
+
+		::deflate(&deflater, Z_SYNC_FLUSH);
+
+		produced = compressed.size() - deflater.avail_out;
+
+		// deflate is done once it had output space left over after consuming everything
+		if (deflater.avail_out != 0u && deflater.avail_in == 0u) {
+			break;
+		}
+
+		compressed.resize(compressed.size() + OUTPUT_CHUNK_SIZE);
+	}
+
+	compressed.resize(produced - sizeof(SYNC_FLUSH_TAIL));
+
+	stats.compressTime += clock::now() - start;
+
+	framer.queue(compressed.data(), static_cast<uint32_t>(compressed.size()));
+
+	++stats.messagesCompressed;
+	stats.bytesBeforeCompression += message.length;
+	stats.bytesAfterCompression += compressed.size() - 1u;
+}
+
+bool CompressedFramer::next(BufferView &message) {
+	BufferView frame;
+
+	while (framer.next(frame)) {
+		if (frame.empty()) {
+			logger->error("Received an empty frame from {} without a compression header.",
+			        framer.getSocket().remoteHost);
+			framer.getSocket().setError();
+			return false;
+		}
+
+		const BufferView payload(frame.data + 1u, frame.length - 1u);
+
+		switch (static_cast<MessageType>(frame.data[0])) {
+		case MessageType::HANDSHAKE:
+			processHandshake(payload);
+			continue;
+
+		case MessageType::UNCOMPRESSED:
+			message = payload;
+			return true;
+
+		case MessageType::COMPRESSED:
+			return inflateMessage(payload, message);
+
+		default:
+			logger->error("Received a frame with unknown compression type {} from {}.", frame.data[0],
+			        framer.getSocket().remoteHost);
+			framer.getSocket().setError();
+			return false;
+		}
+	}
+
+	return false;
+}
+
+void CompressedFramer::processHandshake(const BufferView &message) {
+	if (message.length < HANDSHAKE_SIZE - 1u || message.data[0] != HANDSHAKE_VERSION) {
+		logger->warn("Received an unknown compression handshake from {}; compression is disabled.",
+		        framer.getSocket().remoteHost);
+		negotiated = true;
+		return;
+	}
+
+	uint32_t remoteChecksum = 0u;
+
+	for (uint32_t i = 0u; i < 4u; ++i) {
+		remoteChecksum |= static_cast<uint32_t>(message.data[2u + i]) << (8u * i);
+	}
+
+	const bool remoteEnabled = (message.data[1] & HANDSHAKE_FLAG_COMPRESSION) != 0u;
+
+	negotiated = true;
+	compressing = options.enabled && remoteEnabled && remoteChecksum == dictionaryChecksum;
+
+	if (options.enabled && remoteEnabled && !compressing) {
+		logger->warn("Compression dictionary mismatch with {}; compression is disabled.",
+		        framer.getSocket().remoteHost);
+	}
+}
+
+bool CompressedFramer::inflateMessage(const BufferView &payload, BufferView &message) {
+	if (!options.enabled) {
+		logger->error("Received a compressed message from {} after disabling compression.",
+		        framer.getSocket().remoteHost);
+		framer.getSocket().setError();
+		return false;
+	}
+
+	const auto start = clock::now();
+
+	decompressed.resize(OUTPUT_CHUNK_SIZE);
+
+	size_t produced = 0u;
+
+	// the payload, then the sync flush tail which was stripped by the sender
+	const BufferView inputs[] = {payload, BufferView(SYNC_FLUSH_TAIL, sizeof(SYNC_FLUSH_TAIL))};
+
+	for (const auto &input : inputs) {
+		inflater.next_in = const_cast<Bytef *>(input.data);
+		inflater.avail_in = input.length;
+
+		// keep going while there's input left, or output which didn't fit last time
+		do {
+			if (produced == decompressed.size()) {
+				if (decompressed.size() >= options.maxMessageSize) {
+					logger->error("Compressed message from {} decompresses to more than {} bytes.",
+					        framer.getSocket().remoteHost, options.maxMessageSize);
+					framer.getSocket().setError();
+					return false;
+				}
+
+				decompressed.resize(decompressed.size() + OUTPUT_CHUNK_SIZE);
+			}
+
+			inflater.next_out = decompressed.data() + produced;
+			inflater.avail_out = static_cast<uInt>(decompressed.size() - produced);
+
+			const auto ret = ::inflate(&inflater, Z_SYNC_FLUSH);
+
+			produced = decompressed.size() - inflater.avail_out;
+
+			if (ret != Z_OK && ret != Z_BUF_ERROR) {
+				logger->error("Corrupt compressed message from {}: {}", framer.getSocket().remoteHost,
+				        inflater.msg == nullptr ? "unknown error" : inflater.msg);
+				framer.getSocket().setError();
+				return false;
+			}
+		} while (inflater.avail_in > 0u || inflater.avail_out == 0u);
+	}
+
+	stats.decompressTime += clock::now() - start;
+
+	++stats.messagesDecompressed;
+	stats.bytesBeforeDecompression += payload.length;
+	stats.bytesAfterDecompression += produced;
+
+	message = BufferView(decompressed.data(), static_cast<uint32_t>(produced));
+	return true;
+}
+
+}
@@ -0,0 +1,324 @@
+#include "APG/net/IOUring.hpp"
+
+#ifdef APG_HAS_IO_URING
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include <algorithm>
+
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/utsname.h>
+#include <unistd.h>
+
+#include "APG/net/BufferPool.hpp"
+#include "APG/internal/Assert.hpp"
+
+namespace APG {
+
+namespace {
+
+int ioUringSetup(uint32_t entries, io_uring_params *params) {
+	return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+}
+
+int ioUringEnter(int fd, uint32_t toSubmit, uint32_t minComplete, uint32_t flags, const void *arg, size_t argSize) {
+	return static_cast<int>(::syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, arg, argSize));
+}
+
+int ioUringRegister(int fd, uint32_t opcode, const void *arg, uint32_t argCount) {
+	return static_cast<int>(::syscall(__NR_io_uring_register, fd, opcode, arg, argCount));
+}
+
+// multishot receive arrived in 6.0; the kernel rejects it as an invalid argument before that, and there's no way to
+// probe for it other than trying it
+bool isKernelNewEnough() {
+	utsname name;
+
+	if (::uname(&name) != 0) {
+		return false;
+	}
+
+	int major = 0;
+
+	if (std::sscanf(name.release, "%d", &major) != 1) {
+		return false;
+	}
+
+	return major >= 6;
+}
+
+}
+
+bool IOUring::isSupported() {
+	static const bool supported = []() {
+		if (!isKernelNewEnough()) {
+			return false;
+		}
+
+		// io_uring can still be disabled with a sysctl or seccomp, so try to make one
+		io_uring_params params;
+		std::memset(&params, 0, sizeof(params));
+
+		const int fd = ioUringSetup(4u, &params);
+
+		if (fd < 0) {
+			return false;
+		}
+
+		::close(fd);
+
+		return (params.features & IORING_FEAT_EXT_ARG) != 0u && (params.features & IORING_FEAT_NODROP) != 0u;
+	}();
+
+	return supported;
+}
+
+IOUring::IOUring(uint32_t entries) :
+		logger{spdlog::get("APG")} {
+	io_uring_params params;
+	std::memset(&params, 0, sizeof(params));
+
+	// completions can outnumber submissions a lot with multishot operations
+	params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SUBMIT_ALL | IORING_SETUP_COOP_TASKRUN;
+	params.cq_entries = entries * 4u;
+
+	ringFD = ioUringSetup(entries, &params);
+
+	if (ringFD < 0) {
+		logger->error("Couldn't create io_uring instance: {}", std::strerror(errno));
+		ringFD = -1;
+		return;
+	}
+
+	sqRingSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+	cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+	const bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0u;
+
+	if (singleMap) {
+		sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+	}
+
+	sqRing = ::mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFD,
+	        IORING_OFF_SQ_RING);
+
+	if (sqRing == MAP_FAILED) {
+		sqRing = nullptr;
+	} else if (singleMap) {
+		cqRing = sqRing;
+	} else {
+		cqRing = ::mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFD,
+		        IORING_OFF_CQ_RING);
+
+		if (cqRing == MAP_FAILED) {
+			cqRing = nullptr;
+		}
+	}
+
+	sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+
+	void *sqesMap = ::mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFD,
+	        IORING_OFF_SQES);
+
+	if (sqesMap != MAP_FAILED) {
+		sqes = static_cast<io_uring_sqe *>(sqesMap);
+	}
+
+	if (sqRing == nullptr || cqRing == nullptr || sqes == nullptr) {
+		logger->error("Couldn't map io_uring queues: {}", std::strerror(errno));
+		unmapRings();
+		::close(ringFD);
+		ringFD = -1;
+		return;
+	}
+
+	const auto sqBase = static_cast<uint8_t *>(sqRing);
+	const auto cqBase = static_cast<uint8_t *>(cqRing);
+
+	sqHead = reinterpret_cast<uint32_t *>(sqBase + params.sq_off.head);
+	sqTail = reinterpret_cast<uint32_t *>(sqBase + params.sq_off.tail);
+	sqMask = *reinterpret_cast<uint32_t *>(sqBase + params.sq_off.ring_mask);
+	sqEntries = *reinterpret_cast<uint32_t *>(sqBase + params.sq_off.ring_entries);
+
+	// SQEs are always used in order, so the indirection array never changes after this
+	const auto sqArray = reinterpret_cast<uint32_t *>(sqBase + params.sq_off.array);
+
+	for (uint32_t i = 0u; i < sqEntries; ++i) {
+		sqArray[i] = i;
+	}
+
+	sqeTail = *sqTail;
+
+	cqHead = reinterpret_cast<uint32_t *>(cqBase + params.cq_off.head);
+	cqTail = reinterpret_cast<uint32_t *>(cqBase + params.cq_off.tail);
+	cqMask = *reinterpret_cast<uint32_t *>(cqBase + params.cq_off.ring_mask);
+	cqes = reinterpret_cast<io_uring_cqe *>(cqBase + params.cq_off.cqes);
+}
+
+IOUring::~IOUring() {
+	if (ringFD != -1) {
+		unmapRings();
+		::close(ringFD);
+	}
+}
+
+io_uring_sqe *IOUring::getSqe() {
+	if (sqeTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= sqEntries) {
+		if (submit() < 0 || sqeTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= sqEntries) {
+			logger->error("io_uring submission queue is full.");
+			return nullptr;
+		}
+	}
+
+	auto sqe = &sqes[sqeTail & sqMask];
+	std::memset(sqe, 0, sizeof(*sqe));
+
+	++sqeTail;
+
+	return sqe;
+}
+
+int IOUring::submit(uint32_t waitCount, int timeoutMilliseconds) {
+	__atomic_store_n(sqTail, sqeTail, __ATOMIC_RELEASE);
+
+	const auto toSubmit = getUnsubmittedCount();
+
+	// with cooperative task running, some completions are only posted when entering the kernel, so always enter
+	uint32_t flags = IORING_ENTER_GETEVENTS;
+
+	__kernel_timespec timeout;
+	io_uring_getevents_arg arg;
+	std::memset(&arg, 0, sizeof(arg));
+
+	if (waitCount > 0u && timeoutMilliseconds >= 0) {
+		timeout.tv_sec = timeoutMilliseconds / 1000;
+		timeout.tv_nsec = static_cast<long long>(timeoutMilliseconds % 1000) * 1000000;
+
+		arg.ts = reinterpret_cast<uint64_t>(&timeout);
+		flags |= IORING_ENTER_EXT_ARG;
+	}
+
+	const int result = ioUringEnter(ringFD, toSubmit, waitCount, flags,
+	        (flags & IORING_ENTER_EXT_ARG) ? static_cast<const void *>(&arg) : nullptr,
+	        (flags & IORING_ENTER_EXT_ARG) ? sizeof(arg) : _NSIG / 8);
+
+	if (result < 0) {
+		// timing out, being interrupted or having to reap completions before submitting more aren't errors
+		if (errno == ETIME || errno == EINTR || errno == EAGAIN || errno == EBUSY) {
+			return 0;
+		}
+
+		logger->error("io_uring_enter failed: {}", std::strerror(errno));
+		return -1;
+	}
+
+	return result;
+}
+
+bool IOUring::registerBufferRing(io_uring_buf_ring *bufferRing, uint32_t entries, uint16_t group) {
+	io_uring_buf_reg reg;
+	std::memset(&reg, 0, sizeof(reg));
+
+	reg.ring_addr = reinterpret_cast<uint64_t>(bufferRing);
+	reg.ring_entries = entries;
+	reg.bgid = group;
+
+	if (ioUringRegister(ringFD, IORING_REGISTER_PBUF_RING, &reg, 1u) < 0) {
+		logger->error("Couldn't register io_uring buffer ring: {}", std::strerror(errno));
+		return false;
+	}
+
+	return true;
+}
+
+void IOUring::unregisterBufferRing(uint16_t group) {
+	io_uring_buf_reg reg;
+	std::memset(&reg, 0, sizeof(reg));
+
+	reg.bgid = group;
+
+	ioUringRegister(ringFD, IORING_UNREGISTER_PBUF_RING, &reg, 1u);
+}
+
+void IOUring::unmapRings() {
+	if (sqes != nullptr) {
+		::munmap(sqes, sqesSize);
+		sqes = nullptr;
+	}
+
+	if (cqRing != nullptr && cqRing != sqRing) {
+		::munmap(cqRing, cqRingSize);
+	}
+
+	if (sqRing != nullptr) {
+		::munmap(sqRing, sqRingSize);
+	}
+
+	sqRing = cqRing = nullptr;
+}
+
+IOUringBufferRing::IOUringBufferRing(IOUring &ring, uint16_t group, uint32_t bufferCount, uint32_t bufferSize) :
+		ring(ring),
+		group{group},
+		bufferSize{bufferSize},
+		mask{bufferCount - 1u} {
+	REQUIRE(bufferCount > 0u && bufferCount <= 32768u && (bufferCount & (bufferCount - 1u)) == 0u,
+	        "io_uring buffer rings need a power of two number of buffers, up to 32768.");
+
+	// the ring must be page aligned, which mmap guarantees
+	bufferRingSize = bufferCount * sizeof(io_uring_buf);
+	void *mapped = ::mmap(nullptr, bufferRingSize, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+
+	if (mapped == MAP_FAILED) {
+		spdlog::get("APG")->error("Couldn't allocate io_uring buffer ring: {}", std::strerror(errno));
+		return;
+	}
+
+	bufferRing = static_cast<io_uring_buf_ring *>(mapped);
+
+	buffers.reserve(bufferCount);
+
+	for (uint32_t i = 0u; i < bufferCount; ++i) {
+		buffers.emplace_back(static_cast<uint8_t *>(BufferPool::acquire(bufferSize)));
+		recycle(static_cast<uint16_t>(i));
+	}
+
+	registered = ring.registerBufferRing(bufferRing, bufferCount, group);
+}
+
+IOUringBufferRing::~IOUringBufferRing() {
+	if (registered) {
+		ring.unregisterBufferRing(group);
+	}
+
+	for (auto buffer : buffers) {
+		BufferPool::release(buffer, bufferSize);
+	}
+
+	if (bufferRing != nullptr) {
+		::munmap(bufferRing, bufferRingSize);
+	}
+}
+
+void IOUringBufferRing::recycle(uint16_t id) {
+	// the bufs member can't be used from C++, since the kernel header's flexible array adds padding in front of it
+	auto &entry = reinterpret_cast<io_uring_buf *>(bufferRing)[tail & mask];
+
+	entry.addr = reinterpret_cast<uint64_t>(buffers[id]);
+	entry.len = bufferSize;
+	entry.bid = id;
+
+	++tail;
+
+	// the tail overlays the first entry's reserved field, so it's published after the entry it covers is written
+	__atomic_store_n(&bufferRing->tail, tail, __ATOMIC_RELEASE);
+}
+
+}
+
+#endif
@@ -0,0 +1,120 @@
+#include <cstddef>
+#include <cstdint>
+
+#include <vector>
+
+#include "APG/net/MessageFramer.hpp"
+
+namespace APG {
+
+constexpr const uint32_t MessageFramer::DEFAULT_MAX_MESSAGE_SIZE;
+constexpr const uint32_t MessageFramer::MAX_PREFIX_SIZE;
+
+MessageFramer::MessageFramer(Socket &socket, uint32_t maxMessageSize) :
+		socket{socket},
+		maxMessageSize{maxMessageSize},
+		logger{spdlog::get("APG")} {
+}
+
+void MessageFramer::queue(const uint8_t *data, uint32_t length) {
+	uint8_t prefix[MAX_PREFIX_SIZE];
+	const auto prefixLength = ByteBuffer::encodeVarint(length, prefix);
+
+	outgoing.insert(outgoing.end(), prefix, prefix + prefixLength);
+	outgoing.insert(outgoing.end(), data, data + length);
+
+	++queuedMessages;
+}
+
+int MessageFramer::sendNow(const BufferView &message) {
+	uint8_t prefix[MAX_PREFIX_SIZE];
+	const auto prefixLength = ByteBuffer::encodeVarint(message.length, prefix);
+
+	const auto total = outgoing.size() + prefixLength + message.length;
+
+	const auto sent = socket.sendv({BufferView(outgoing.data(), static_cast<uint32_t>(outgoing.size())),
+	        BufferView(prefix, prefixLength), message});
+
+	if (sent >= 0 && static_cast<size_t>(sent) >= total) {
+		socket.getStats().addMessagesSent(queuedMessages + 1u);
+	}
+
+	outgoing.clear();
+	queuedMessages = 0u;
+
+	return sent;
+}
+
+int MessageFramer::flush() {
+	if (outgoing.empty()) {
+		return 0;
+	}
+
+	const auto sent = socket.sendv({BufferView(outgoing.data(), static_cast<uint32_t>(outgoing.size()))});
+
+	if (sent >= 0 && static_cast<size_t>(sent) >= outgoing.size()) {
+		socket.getStats().addMessagesSent(queuedMessages);
+	}
+
+	// keeps its capacity, so a steady stream of messages doesn't allocate
+	outgoing.clear();
+	queuedMessages = 0u;
+
+	return sent;
+}
+
+int MessageFramer::receive(uint32_t length) {
+	return socket.recv(length);
+}
+
+bool MessageFramer::next(BufferView &message) {
+	if (socket.hasError()) {
+		return false;
+	}
+
+	const auto buffer = socket.view();
+	const auto readPos = socket.getReadPos();
+
+	if (readPos >= buffer.length) {
+		return false;
+	}
+
+	const auto available = buffer.length - readPos;
+	const auto start = buffer.data + readPos;
+
+	uint32_t length = 0u;
+	uint32_t prefixLength = 0u;
+
+	switch (ByteBuffer::decodeVarint32(start, available, length, prefixLength)) {
+	case ByteBuffer::VarintResult::INCOMPLETE:
+		return false;
+
+	case ByteBuffer::VarintResult::MALFORMED:
+		logger->error("Malformed message length prefix received from {}.", socket.remoteHost);
+		socket.setError();
+		return false;
+
+	case ByteBuffer::VarintResult::COMPLETE:
+		break;
+	}
+
+	if (length > maxMessageSize) {
+		logger->error("Message of {} bytes from {} is larger than the maximum of {} bytes.", length,
+		        socket.remoteHost, maxMessageSize);
+		socket.setError();
+		return false;
+	}
+
+	if (available - prefixLength < length) {
+		return false;
+	}
+
+	message = BufferView(start + prefixLength, length);
+	socket.setReadPos(readPos + prefixLength + length);
+
+	socket.getStats().addMessagesReceived(1u);
+
+	return true;
+}
+
+}
@@ -0,0 +1,419 @@
+#include "APG/net/NativeConnector.hpp"
+
+#ifdef APG_HAS_EPOLL
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+namespace APG {
+
+constexpr const uint32_t NativeConnector::DEFAULT_ATTEMPT_DELAY_MILLISECONDS;
+constexpr const uint32_t NativeConnector::DEFAULT_TIMEOUT_MILLISECONDS;
+
+NativeConnector::NativeConnector(NativeEventLoop &loop, std::shared_ptr<NativeResolver> resolver) :
+		loop(loop),
+		resolver{resolver != nullptr ? std::move(resolver) : std::make_shared<NativeResolver>()},
+		inbox{std::make_shared<Inbox>()},
+		logger{spdlog::get("APG")} {
+	inbox->wakeFD = ::eventfd(0u, EFD_NONBLOCK | EFD_CLOEXEC);
+	timerFD = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+
+	if (inbox->wakeFD == -1 || timerFD == -1) {
+		logger->error("Couldn't create descriptors for native connector: {}", NativeSocketUtil::getErrorMessage(errno));
+		return;
+	}
+
+	loop.addDescriptor(inbox->wakeFD, [this](uint32_t) {
+		handleResolved();
+	});
+
+	loop.addDescriptor(timerFD, [this](uint32_t) {
+		handleTimer();
+	});
+}
+
+NativeConnector::~NativeConnector() {
+	for (auto &entry : pending) {
+		for (auto fd : entry.second->attempts) {
+			closeAttempt(fd);
+		}
+	}
+
+	pending.clear();
+
+	if (timerFD != -1) {
+		loop.removeDescriptor(timerFD);
+		::close(timerFD);
+	}
+
+	// resolver callbacks check the descriptor under the lock, so none can write to it once it's closed
+	std::lock_guard<std::mutex> lock(inbox->mutex);
+
+	if (inbox->wakeFD != -1) {
+		loop.removeDescriptor(inbox->wakeFD);
+		::close(inbox->wakeFD);
+		inbox->wakeFD = -1;
+	}
+}
+
+uint64_t NativeConnector::connect(const std::string &host, uint16_t port, connect_callback callback,
+        uint32_t timeoutMilliseconds) {
+	if (inbox->wakeFD == -1 || timerFD == -1) {
+		logger->error("Can't connect to {}:{} with a native connector which failed to initialise.", host, port);
+		return 0u;
+	}
+
+	auto connect = std::make_unique<PendingConnect>();
+	const auto id = nextID++;
+
+	connect->id = id;
+	connect->host = host;
+	connect->port = port;
+	connect->callback = std::move(callback);
+	connect->deadline = clock::now() + std::chrono::milliseconds(timeoutMilliseconds);
+
+	pending.emplace(id, std::move(connect));
+
+	const auto addResult = [id](const std::shared_ptr<Inbox> &inbox, NativeResolver::result_ptr result) {
+		std::lock_guard<std::mutex> lock(inbox->mutex);
+
+		if (inbox->wakeFD == -1) {
+			return;
+		}
+
+		inbox->results.emplace_back(id, std::move(result));
+		::eventfd_write(inbox->wakeFD, 1u);
+	};
+
+	// cached results still go through the inbox, so the callback is never called from in here
+	auto cached = resolver->lookupCached(host, port);
+
+	if (cached != nullptr) {
+		addResult(inbox, std::move(cached));
+	} else {
+		std::weak_ptr<Inbox> weakInbox = inbox;
+
+		resolver->resolve(host, port, [weakInbox, addResult](NativeResolver::result_ptr result) {
+			if (auto inbox = weakInbox.lock()) {
+				addResult(inbox, std::move(result));
+			}
+		});
+	}
+
+	rearmTimer();
+
+	return id;
+}
+
+void NativeConnector::cancel(uint64_t id) {
+	const auto it = pending.find(id);
+
+	if (it == pending.end()) {
+		return;
+	}
+
+	for (auto fd : it->second->attempts) {
+		closeAttempt(fd);
+	}
+
+	pending.erase(it);
+	rearmTimer();
+}
+
+void NativeConnector::handleResolved() {
+	std::vector<std::pair<uint64_t, NativeResolver::result_ptr>> results;
+
+	{
+		std::lock_guard<std::mutex> lock(inbox->mutex);
+
+		eventfd_t value;
+		::eventfd_read(inbox->wakeFD, &value);
+
+		results.swap(inbox->results);
+	}
+
+	for (auto &result : results) {
+		const auto it = pending.find(result.first);
+
+		// cancelled while resolving
+		if (it == pending.end()) {
+			continue;
+		}
+
+		auto &connect = *it->second;
+		connect.resolved = std::move(result.second);
+
+		// RFC 8305 section 4: alternate between families, starting with whichever getaddrinfo preferred
+		std::vector<const NativeResolver::Address *> first, second;
+
+		for (const auto &address : connect.resolved->addresses) {
+			(address.family == connect.resolved->addresses.front().family ? first : second).emplace_back(&address);
+		}
+
+		for (size_t i = 0u; i < std::max(first.size(), second.size()); ++i) {
+			if (i < first.size()) {
+				connect.order.emplace_back(first[i]);
+			}
+
+			if (i < second.size()) {
+				connect.order.emplace_back(second[i]);
+			}
+		}
+
+		connect.nextAttemptTime = clock::now();
+
+		advance(result.first);
+	}
+
+	rearmTimer();
+	callFinished();
+}
+
+void NativeConnector::handleTimer() {
+	uint64_t expirations;
+
+	if (::read(timerFD, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN) {
+		logger->error("Couldn't read native connector timer: {}", NativeSocketUtil::getErrorMessage(errno));
+	}
+
+	std::vector<uint64_t> ids;
+	ids.reserve(pending.size());
+
+	for (const auto &entry : pending) {
+		ids.emplace_back(entry.first);
+	}
+
+	for (auto id : ids) {
+		advance(id);
+	}
+
+	rearmTimer();
+	callFinished();
+}
+
+void NativeConnector::handleAttempt(uint64_t id, int fd, uint32_t events) {
+	const auto it = pending.find(id);
+
+	if (it == pending.end()) {
+		return;
+	}
+
+	auto &connect = *it->second;
+
+	if (std::find(connect.attempts.begin(), connect.attempts.end(), fd) == connect.attempts.end()) {
+		return;
+	}
+
+	if ((events & (NativeEventLoop::EVENT_WRITABLE | NativeEventLoop::EVENT_ERROR | NativeEventLoop::EVENT_HANGUP))
+	        == 0u) {
+		return;
+	}
+
+	int error = 0;
+	socklen_t errorLength = sizeof(error);
+
+	if (::getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &errorLength) != 0) {
+		error = errno;
+	}
+
+	if (error == 0 && (events & NativeEventLoop::EVENT_WRITABLE) != 0u) {
+		succeed(id, fd);
+		rearmTimer();
+		callFinished();
+		return;
+	}
+
+	if (error == EINPROGRESS) {
+		return;
+	}
+
+	connect.attempts.erase(std::find(connect.attempts.begin(), connect.attempts.end(), fd));
+	closeAttempt(fd);
+
+	connect.lastError = (error != 0 ? error : ECONNREFUSED);
+
+	// no point waiting out the attempt delay once an attempt has failed
+	connect.nextAttemptTime = clock::now();
+
+	advance(id);
+	rearmTimer();
+	callFinished();
+}
+
+void NativeConnector::advance(uint64_t id) {
+	const auto it = pending.find(id);
+
+	if (it == pending.end()) {
+		return;
+	}
+
+	auto &connect = *it->second;
+	const auto now = clock::now();
+
+	if (now >= connect.deadline) {
+		fail(id, "timed out");
+		return;
+	}
+
+	if (connect.resolved == nullptr) {
+		return;
+	}
+
+	if (connect.resolved->error != 0) {
+		fail(id, connect.resolved->getErrorMessage());
+		return;
+	}
+
+	if (connect.nextAddress < connect.order.size() && (connect.attempts.empty() || now >= connect.nextAttemptTime)) {
+		if (startAttempt(connect)) {
+			connect.nextAttemptTime = now + attemptDelay;
+		}
+	}
+
+	if (connect.attempts.empty()) {
+		fail(id, connect.lastError != 0 ? NativeSocketUtil::getErrorMessage(connect.lastError) : "no addresses");
+	}
+}
+
+bool NativeConnector::startAttempt(PendingConnect &connect) {
+	while (connect.nextAddress < connect.order.size()) {
+		const auto &address = *connect.order[connect.nextAddress++];
+
+		const int fd = ::socket(address.family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_TCP);
+
+		if (fd == -1) {
+			connect.lastError = errno;
+			continue;
+		}
+
+		if (::connect(fd, reinterpret_cast<const sockaddr *>(&address.address), address.length) != 0
+		        && errno != EINPROGRESS) {
+			connect.lastError = errno;
+			::close(fd);
+			continue;
+		}
+
+		// a connect which finished immediately is reported as writable as soon as it's registered
+		const auto id = connect.id;
+
+		if (!loop.addDescriptor(fd, [this, id, fd](uint32_t events) {
+			handleAttempt(id, fd, events);
+		})) {
+			connect.lastError = EBADF;
+			::close(fd);
+			continue;
+		}
+
+		connect.attempts.emplace_back(fd);
+		return true;
+	}
+
+	return false;
+}
+
+void NativeConnector::closeAttempt(int fd) {
+	loop.removeDescriptor(fd);
+	::close(fd);
+}
+
+void NativeConnector::succeed(uint64_t id, int fd) {
+	const auto it = pending.find(id);
+	auto connect = std::move(it->second);
+	pending.erase(it);
+
+	for (auto attempt : connect->attempts) {
+		if (attempt != fd) {
+			closeAttempt(attempt);
+		}
+	}
+
+	loop.removeDescriptor(fd);
+
+	if (NativeSocketUtil::setTCPNodelay(fd) != 0) {
+		logger->warn("Couldn't set nodelay on connection to {}:{}: {}", connect->host, connect->port,
+		        NativeSocketUtil::getErrorMessage(errno));
+	}
+
+	finished.emplace_back(std::move(connect->callback),
+	        std::make_unique<NativeSocket>(fd, connect->host, connect->port));
+}
+
+void NativeConnector::fail(uint64_t id, const std::string &reason) {
+	const auto it = pending.find(id);
+	auto connect = std::move(it->second);
+	pending.erase(it);
+
+	for (auto attempt : connect->attempts) {
+		closeAttempt(attempt);
+	}
+
+	logger->error("Couldn't connect to remote host ({}:{}): {}", connect->host, connect->port, reason);
+
+	finished.emplace_back(std::move(connect->callback), nullptr);
+}
+
+void NativeConnector::callFinished() {
+	// taken out of the connector first, since a callback is allowed to destroy it
+	auto callbacks = std::move(finished);
+	finished.clear();
+
+	for (auto &callback : callbacks) {
+		callback.first(std::move(callback.second));
+	}
+}
+
+void NativeConnector::rearmTimer() {
+	if (timerFD == -1) {
+		return;
+	}
+
+	bool armed = false;
+	clock::time_point earliest;
+
+	for (const auto &entry : pending) {
+		const auto &connect = *entry.second;
+
+		auto wakeTime = connect.deadline;
+
+		if (!connect.attempts.empty() && connect.nextAddress < connect.order.size()) {
+			wakeTime = std::min(wakeTime, connect.nextAttemptTime);
+		}
+
+		if (!armed || wakeTime < earliest) {
+			earliest = wakeTime;
+			armed = true;
+		}
+	}
+
+	itimerspec spec;
+	std::memset(&spec, 0, sizeof(spec));
+
+	if (armed) {
+		const auto delay = std::chrono::duration_cast<std::chrono::nanoseconds>(earliest - clock::now()).count();
+
+		// an all-zero value would disarm the timer instead
+		const auto clamped = std::max<int64_t>(delay, 1);
+
+		spec.it_value.tv_sec = static_cast<time_t>(clamped / 1000000000);
+		spec.it_value.tv_nsec = static_cast<long>(clamped % 1000000000);
+	}
+
+	::timerfd_settime(timerFD, 0, &spec, nullptr);
+}
+
+}
+
+#endif
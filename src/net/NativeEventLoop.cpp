@@ -0,0 +1,964 @@
+#ifndef APG_NO_NATIVE
+#ifdef __linux__
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+
+#include <chrono>
+#include <memory>
+#include <utility>
+
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "APG/net/NativeEventLoop.hpp"
+#include "APG/net/NativeSocket.hpp"
+
+namespace APG {
+
+constexpr const uint32_t NativeEventLoop::EVENT_READABLE;
+constexpr const uint32_t NativeEventLoop::EVENT_WRITABLE;
+constexpr const uint32_t NativeEventLoop::EVENT_HANGUP;
+constexpr const uint32_t NativeEventLoop::EVENT_ERROR;
+constexpr const uint32_t NativeEventLoop::URING_RECEIVE_BUFFER_COUNT;
+constexpr const uint32_t NativeEventLoop::URING_RECEIVE_BUFFER_SIZE;
+constexpr const uint32_t NativeEventLoop::URING_RECEIVE_QUEUE_LIMIT;
+
+NativeEventLoop::NativeEventLoop(uint32_t maxEventsPerWait, Backend requestedBackend) :
+		backend{Backend::EPOLL},
+		logger{spdlog::get("APG")} {
+	if (maxEventsPerWait == 0u) {
+		maxEventsPerWait = 1u;
+	}
+
+	if (requestedBackend == Backend::IO_URING) {
+#ifdef APG_HAS_IO_URING
+		if (IOUring::isSupported() && initIOUring(maxEventsPerWait)) {
+			backend = Backend::IO_URING;
+			return;
+		}
+
+		logger->info("io_uring isn't supported here; falling back to epoll.");
+#else
+		logger->info("Built without io_uring support; falling back to epoll.");
+#endif
+	}
+
+	epollFD = ::epoll_create1(EPOLL_CLOEXEC);
+	events.resize(maxEventsPerWait);
+
+	if (epollFD == -1) {
+		logger->error("Couldn't create epoll instance: {}", NativeSocketUtil::getErrorMessage(errno));
+	}
+}
+
+NativeEventLoop::~NativeEventLoop() {
+	for (auto &entry : entries) {
+		if (entry.second->socket != nullptr) {
+			entry.second->socket->eventLoop = nullptr;
+			entry.second->socket->sendInFlight = 0u;
+		} else if (entry.second->acceptor != nullptr) {
+			entry.second->acceptor->eventLoop = nullptr;
+		}
+	}
+
+#ifdef APG_HAS_IO_URING
+	if (ring != nullptr) {
+		shutdownIOUring();
+	}
+#endif
+
+	if (epollFD != -1) {
+		::close(epollFD);
+	}
+}
+
+bool NativeEventLoop::add(NativeSocket *socket, socket_callback callback) {
+	if (!socket->isConnected()) {
+		logger->error("Can't add a disconnected socket to an event loop.");
+		return false;
+	}
+
+	if (socket->eventLoop != nullptr && socket->eventLoop != this) {
+		logger->error("Socket {} is already registered with another event loop.", socket->getFileDescriptor());
+		return false;
+	}
+
+	// edge triggered events only make sense for non-blocking sockets; accepted sockets start out blocking
+	if (NativeSocketUtil::setNonBlocking(socket->getFileDescriptor()) != 0) {
+		logger->error("Couldn't set non-blocking state for socket in event loop: {}",
+		        NativeSocketUtil::getErrorMessage(errno));
+		return false;
+	}
+
+	auto entry = std::make_unique<Entry>();
+	entry->fd = socket->getFileDescriptor();
+	entry->socket = socket;
+	entry->socketCallback = std::move(callback);
+
+	if (!addEntry(std::move(entry), EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET)) {
+		return false;
+	}
+
+	socket->eventLoop = this;
+
+#ifdef APG_HAS_IO_URING
+	// anything queued before the socket was added is sent with the next poll
+	if (backend == Backend::IO_URING && socket->getSendQueueSize() > 0u) {
+		requestSend(*socket, false);
+	}
+#endif
+
+	return true;
+}
+
+bool NativeEventLoop::addAcceptor(NativeDualAcceptorSocket *acceptor, accept_callback callback) {
+	if (!acceptor->isConnected()) {
+		logger->error("Can't add an acceptor which isn't listening to an event loop.");
+		return false;
+	}
+
+	if (acceptor->eventLoop != nullptr && acceptor->eventLoop != this) {
+		logger->error("Acceptor on port {} is already registered with another event loop.", acceptor->port);
+		return false;
+	}
+
+	const int listeners[] = {acceptor->getIP4FileDescriptor(), acceptor->getIP6FileDescriptor()};
+
+	for (const auto fd : listeners) {
+		// if only one protocol is supported both descriptors are the same
+		if (fd == -1 || entries.find(fd) != entries.end()) {
+			continue;
+		}
+
+		auto entry = std::make_unique<Entry>();
+		entry->fd = fd;
+		entry->acceptor = acceptor;
+		entry->acceptCallback = callback;
+
+		if (!addEntry(std::move(entry), EPOLLIN | EPOLLET)) {
+			removeAcceptor(acceptor);
+			return false;
+		}
+	}
+
+	acceptor->eventLoop = this;
+	return true;
+}
+
+bool NativeEventLoop::addDescriptor(int fd, descriptor_callback callback) {
+	auto entry = std::make_unique<Entry>();
+	entry->fd = fd;
+	entry->descriptorCallback = std::move(callback);
+
+	return addEntry(std::move(entry), EPOLLIN | EPOLLOUT | EPOLLET);
+}
+
+void NativeEventLoop::removeDescriptor(int fd) {
+	const auto found = entries.find(fd);
+
+	if (found != entries.end() && found->second->socket == nullptr && found->second->acceptor == nullptr) {
+		removeEntry(fd);
+	}
+}
+
+void NativeEventLoop::remove(NativeSocket *socket) {
+	if (socket->eventLoop != this) {
+		return;
+	}
+
+	removeEntry(socket->getFileDescriptor());
+	socket->eventLoop = nullptr;
+}
+
+void NativeEventLoop::removeAcceptor(NativeDualAcceptorSocket *acceptor) {
+	const int listeners[] = {acceptor->getIP4FileDescriptor(), acceptor->getIP6FileDescriptor()};
+
+	for (const auto fd : listeners) {
+		const auto found = entries.find(fd);
+
+		if (found != entries.end() && found->second->acceptor == acceptor) {
+			removeEntry(fd);
+		}
+	}
+
+	if (acceptor->eventLoop == this) {
+		acceptor->eventLoop = nullptr;
+	}
+}
+
+TimingWheel::timer_id NativeEventLoop::addTimer(uint32_t delayMilliseconds, TimingWheel::timer_callback callback) {
+	return timers.schedule(std::chrono::milliseconds(delayMilliseconds), std::move(callback));
+}
+
+bool NativeEventLoop::cancelTimer(TimingWheel::timer_id id) {
+	return timers.cancel(id);
+}
+
+int NativeEventLoop::poll(int timeoutMilliseconds) {
+	// the wait ends in time for the next timer, however long the caller is prepared to wait
+	const int untilNextTimer = timers.getMillisecondsUntilNextTimer();
+
+	if (untilNextTimer >= 0 && (timeoutMilliseconds < 0 || untilNextTimer < timeoutMilliseconds)) {
+		timeoutMilliseconds = untilNextTimer;
+	}
+
+	int dispatched;
+
+#ifdef APG_HAS_IO_URING
+	if (backend == Backend::IO_URING) {
+		dispatched = pollIOUring(timeoutMilliseconds);
+	} else {
+		dispatched = pollEpoll(timeoutMilliseconds);
+	}
+#else
+	dispatched = pollEpoll(timeoutMilliseconds);
+#endif
+
+	if (dispatched < 0) {
+		return dispatched;
+	}
+
+	return dispatched + static_cast<int>(timers.advance());
+}
+
+int NativeEventLoop::pollEpoll(int timeoutMilliseconds) {
+	if (epollFD == -1) {
+		return -1;
+	}
+
+	const int eventCount = ::epoll_wait(epollFD, events.data(), static_cast<int>(events.size()),
+	        timeoutMilliseconds < 0 ? -1 : timeoutMilliseconds);
+
+	if (eventCount < 0) {
+		if (errno == EINTR) {
+			return 0;
+		}
+
+		logger->error("epoll_wait failed in event loop: {}", NativeSocketUtil::getErrorMessage(errno));
+		return -1;
+	}
+
+	for (int i = 0; i < eventCount; ++i) {
+		auto &entry = *static_cast<Entry *>(events[i].data.ptr);
+
+		// removed by a callback earlier in this dispatch
+		if (!entry.active) {
+			continue;
+		}
+
+		const auto epollEvents = events[i].events;
+
+		if (entry.acceptor != nullptr) {
+			dispatchAccept(entry);
+			continue;
+		}
+
+		uint32_t socketEvents = 0u;
+
+		if (epollEvents & (EPOLLIN | EPOLLPRI)) {
+			socketEvents |= EVENT_READABLE;
+		}
+
+		if (epollEvents & EPOLLOUT) {
+			socketEvents |= EVENT_WRITABLE;
+		}
+
+		if (epollEvents & (EPOLLHUP | EPOLLRDHUP)) {
+			socketEvents |= EVENT_HANGUP;
+		}
+
+		if (epollEvents & EPOLLERR) {
+			socketEvents |= EVENT_ERROR;
+		}
+
+		if (entry.socket == nullptr) {
+			entry.descriptorCallback(socketEvents);
+			continue;
+		}
+
+		// queued data is sent before the callback so the callback sees the real queue size
+		if ((socketEvents & EVENT_WRITABLE) && entry.socket->getSendQueueSize() > 0u) {
+			entry.socket->flushSendQueue();
+		}
+
+		entry.socketCallback(*entry.socket, socketEvents);
+	}
+
+	removedEntries.clear();
+
+	return eventCount;
+}
+
+bool NativeEventLoop::addEntry(std::unique_ptr<Entry> &&entry, uint32_t epollEvents) {
+#ifdef APG_HAS_IO_URING
+	if (backend == Backend::IO_URING) {
+		const auto fd = entry->fd;
+		auto &added = *entry;
+
+		removeEntry(fd);
+		entries.emplace(fd, std::move(entry));
+
+		const bool armed = (added.socket != nullptr) ? armReceive(added) : armNotify(added);
+
+		if (!armed) {
+			removeEntry(fd);
+			return false;
+		}
+
+		return true;
+	}
+#endif
+
+	if (epollFD == -1) {
+		logger->error("Can't register socket with an event loop which failed to initialise.");
+		return false;
+	}
+
+	epoll_event event;
+	std::memset(&event, 0, sizeof(event));
+	event.events = epollEvents;
+	event.data.ptr = entry.get();
+
+	const auto fd = entry->fd;
+	const auto existing = entries.find(fd);
+
+	const int op = (existing == entries.end()) ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+
+	if (::epoll_ctl(epollFD, op, fd, &event) == -1) {
+		logger->error("Couldn't register descriptor {} with epoll: {}", fd, NativeSocketUtil::getErrorMessage(errno));
+		return false;
+	}
+
+	if (existing != entries.end()) {
+		existing->second->active = false;
+		removedEntries.emplace_back(std::move(existing->second));
+		existing->second = std::move(entry);
+	} else {
+		entries.emplace(fd, std::move(entry));
+	}
+
+	return true;
+}
+
+void NativeEventLoop::removeEntry(int fd) {
+	const auto found = entries.find(fd);
+
+	if (found == entries.end()) {
+		return;
+	}
+
+	found->second->active = false;
+
+#ifdef APG_HAS_IO_URING
+	if (backend == Backend::IO_URING) {
+		auto &entry = *found->second;
+
+		if (entry.socket != nullptr) {
+			entry.socket->sendInFlight = 0u;
+		}
+
+		cancelOperations(entry);
+
+		if (entry.pendingOperations > 0u) {
+			drainingEntries.emplace(&entry, std::move(found->second));
+			entries.erase(found);
+			return;
+		}
+	}
+#endif
+
+	// this can fail harmlessly if the descriptor was already closed
+	if (epollFD != -1) {
+		::epoll_ctl(epollFD, EPOLL_CTL_DEL, fd, nullptr);
+	}
+
+	removedEntries.emplace_back(std::move(found->second));
+	entries.erase(found);
+}
+
+void NativeEventLoop::dispatchAccept(Entry &entry) {
+	auto acceptor = entry.acceptor;
+
+	// edge triggered, so every pending connection must be accepted now; only running out of connections or a
+	// listener error stops us, since a connection which failed doesn't mean the rest have
+	while (entry.active) {
+		std::unique_ptr<Socket> socket;
+		const auto result = acceptor->acceptFrom(entry.fd, socket);
+
+		if (result == NativeDualAcceptorSocket::AcceptResult::SKIPPED) {
+			continue;
+		} else if (result != NativeDualAcceptorSocket::AcceptResult::ACCEPTED) {
+			break;
+		}
+
+		entry.acceptCallback(*acceptor, std::move(socket));
+	}
+}
+
+#ifdef APG_HAS_IO_URING
+
+bool NativeEventLoop::initIOUring(uint32_t entryCount) {
+	uint32_t queueSize = 1u;
+
+	while (queueSize < entryCount && queueSize < 4096u) {
+		queueSize <<= 1u;
+	}
+
+	ring = std::make_unique<IOUring>(queueSize);
+
+	if (!ring->isValid()) {
+		ring.reset();
+		return false;
+	}
+
+	receiveBuffers = std::make_unique<IOUringBufferRing>(*ring, 0u, URING_RECEIVE_BUFFER_COUNT,
+	        URING_RECEIVE_BUFFER_SIZE);
+
+	if (!receiveBuffers->isValid()) {
+		receiveBuffers.reset();
+		ring.reset();
+		return false;
+	}
+
+	return true;
+}
+
+void NativeEventLoop::shutdownIOUring() {
+	// the kernel can write into the receive buffers until every operation has finished, so wait for them all
+	auto sqe = ring->getSqe();
+
+	if (sqe != nullptr) {
+		sqe->opcode = IORING_OP_ASYNC_CANCEL;
+		sqe->fd = -1;
+		sqe->cancel_flags = IORING_ASYNC_CANCEL_ANY;
+	}
+
+	for (uint32_t attempt = 0u; operationsInFlight > 0u && attempt < 100u; ++attempt) {
+		if (ring->submit(1u, 10) < 0) {
+			break;
+		}
+
+		ring->reapCompletions([this](const io_uring_cqe &cqe) {
+			if (cqe.user_data == 0u) {
+				return;
+			}
+
+			if ((cqe.flags & IORING_CQE_F_BUFFER) != 0u) {
+				receiveBuffers->recycle(static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT));
+			}
+
+			if ((cqe.flags & IORING_CQE_F_MORE) == 0u) {
+				--operationsInFlight;
+			}
+		});
+	}
+
+	if (operationsInFlight > 0u) {
+		// better to leak the buffers than to have the kernel write into memory which has been reused
+		logger->warn("{} io_uring operations didn't finish when closing an event loop.", operationsInFlight);
+		receiveBuffers.release();
+	}
+
+	receiveBuffers.reset();
+	ring.reset();
+}
+
+namespace {
+
+template<typename Entry, typename Operation> uint64_t makeUserData(Entry &entry, Operation operation) {
+	return reinterpret_cast<uint64_t>(&entry) | static_cast<uint64_t>(operation);
+}
+
+}
+
+bool NativeEventLoop::armReceive(Entry &entry) {
+	auto sqe = ring->getSqe();
+
+	if (sqe == nullptr) {
+		return false;
+	}
+
+	sqe->opcode = IORING_OP_RECV;
+	sqe->fd = entry.fd;
+	sqe->ioprio = IORING_RECV_MULTISHOT;
+	sqe->flags = IOSQE_BUFFER_SELECT;
+	sqe->buf_group = receiveBuffers->getGroup();
+	sqe->user_data = makeUserData(entry, Operation::RECEIVE);
+
+	entry.receiveArmed = true;
+	++entry.pendingOperations;
+	++operationsInFlight;
+
+	return true;
+}
+
+bool NativeEventLoop::armNotify(Entry &entry) {
+	auto sqe = ring->getSqe();
+
+	if (sqe == nullptr) {
+		return false;
+	}
+
+	sqe->fd = entry.fd;
+	sqe->user_data = makeUserData(entry, Operation::NOTIFY);
+
+	if (entry.acceptor != nullptr) {
+		sqe->opcode = IORING_OP_ACCEPT;
+		sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+		sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+	} else {
+		sqe->opcode = IORING_OP_POLL_ADD;
+		sqe->len = IORING_POLL_ADD_MULTI;
+		sqe->poll32_events = POLLIN | POLLOUT | POLLRDHUP | POLLERR | POLLHUP;
+	}
+
+	entry.notifyArmed = true;
+	++entry.pendingOperations;
+	++operationsInFlight;
+
+	return true;
+}
+
+bool NativeEventLoop::submitSend(Entry &entry) {
+	auto &socket = *entry.socket;
+
+	if (entry.sendBuffer.empty()) {
+		if (socket.sendQueue.size() == socket.sendQueueHead) {
+			return true;
+		}
+
+		if (socket.sendQueueHead > 0u) {
+			socket.sendQueue.erase(socket.sendQueue.begin(), socket.sendQueue.begin() + socket.sendQueueHead);
+			socket.sendQueueHead = 0u;
+		}
+
+		// the queue's data now belongs to the send, and the socket gets the old (empty) send buffer to fill
+		std::swap(entry.sendBuffer, socket.sendQueue);
+		entry.sendOffset = 0u;
+	}
+
+	auto sqe = ring->getSqe();
+
+	if (sqe == nullptr) {
+		return false;
+	}
+
+	const auto remaining = static_cast<uint32_t>(entry.sendBuffer.size()) - entry.sendOffset;
+
+	sqe->opcode = IORING_OP_SEND;
+	sqe->fd = entry.fd;
+	sqe->addr = reinterpret_cast<uint64_t>(entry.sendBuffer.data() + entry.sendOffset);
+	sqe->len = remaining;
+	sqe->msg_flags = MSG_NOSIGNAL;
+	sqe->user_data = makeUserData(entry, Operation::SEND);
+
+	socket.sendInFlight = remaining;
+	socket.stats.addSendCall();
+
+	entry.sendInFlight = true;
+	++entry.pendingOperations;
+	++operationsInFlight;
+
+	return true;
+}
+
+void NativeEventLoop::cancelOperations(Entry &entry) {
+	const std::pair<bool, Operation> operations[] = {
+	        {entry.receiveArmed, Operation::RECEIVE},
+	        {entry.notifyArmed, Operation::NOTIFY},
+	        {entry.sendInFlight, Operation::SEND}};
+
+	bool cancelled = false;
+
+	for (const auto &operation : operations) {
+		if (!operation.first) {
+			continue;
+		}
+
+		auto sqe = ring->getSqe();
+
+		if (sqe == nullptr) {
+			continue;
+		}
+
+		sqe->opcode = IORING_OP_ASYNC_CANCEL;
+		sqe->fd = -1;
+		sqe->addr = makeUserData(entry, operation.second);
+		sqe->cancel_flags = IORING_ASYNC_CANCEL_ALL;
+
+		cancelled = true;
+	}
+
+	// submitted straight away, since the socket is usually about to be closed and a pending receive would keep
+	// the connection open
+	if (cancelled) {
+		ring->submit();
+	}
+}
+
+void NativeEventLoop::pauseReceive(Entry &entry) {
+	if (entry.socket->receivePaused) {
+		return;
+	}
+
+	entry.socket->receivePaused = true;
+
+	// a multishot receive which already ended isn't re-armed until the socket resumes
+	if (!entry.receiveArmed) {
+		return;
+	}
+
+	auto sqe = ring->getSqe();
+
+	if (sqe == nullptr) {
+		// tried again on the next completion
+		entry.socket->receivePaused = false;
+		return;
+	}
+
+	// submitted with the next poll; completions reaped before then are still queued, but there are at most as
+	// many as there are receive buffers
+	sqe->opcode = IORING_OP_ASYNC_CANCEL;
+	sqe->fd = -1;
+	sqe->addr = makeUserData(entry, Operation::RECEIVE);
+	sqe->cancel_flags = IORING_ASYNC_CANCEL_ALL;
+}
+
+void NativeEventLoop::resumeReceive(NativeSocket &socket) {
+	socket.receivePaused = false;
+
+	const auto found = entries.find(socket.getFileDescriptor());
+
+	if (found == entries.end() || found->second->socket != &socket) {
+		return;
+	}
+
+	auto &entry = *found->second;
+
+	// if the cancelled receive hasn't finished yet, it's re-armed when it does
+	if (entry.active && !entry.receiveArmed) {
+		armReceive(entry);
+	}
+}
+
+void NativeEventLoop::requestSend(NativeSocket &socket, bool submitNow) {
+	const auto found = entries.find(socket.getFileDescriptor());
+
+	if (found == entries.end() || found->second->socket != &socket) {
+		return;
+	}
+
+	auto &entry = *found->second;
+
+	if (!entry.sendRequested) {
+		entry.sendRequested = true;
+		pendingSends.emplace_back(entry.fd);
+	}
+
+	if (submitNow) {
+		submitPendingSends();
+		ring->submit();
+	}
+}
+
+void NativeEventLoop::submitPendingSends() {
+	for (const auto fd : pendingSends) {
+		const auto found = entries.find(fd);
+
+		if (found == entries.end()) {
+			continue;
+		}
+
+		auto &entry = *found->second;
+		entry.sendRequested = false;
+
+		// a send in flight picks up anything queued meanwhile when it completes
+		if (!entry.sendInFlight && entry.socket != nullptr && !entry.socket->hasError()) {
+			submitSend(entry);
+		}
+	}
+
+	pendingSends.clear();
+}
+
+int NativeEventLoop::pollIOUring(int timeoutMilliseconds) {
+	submitPendingSends();
+
+	// submitting everything queued since the last poll and waiting for completions is one system call
+	if (ring->submit(timeoutMilliseconds == 0 ? 0u : 1u, timeoutMilliseconds) < 0) {
+		return -1;
+	}
+
+	int dispatched = static_cast<int>(ring->reapCompletions([this](const io_uring_cqe &cqe) {
+		handleCompletion(cqe);
+	}));
+
+	// readiness collected from every completion is dispatched once per entry, so a socket which received several
+	// buffers gets one callback
+	for (size_t i = 0u; i < readyEntries.size(); ++i) {
+		auto &entry = *readyEntries[i];
+		const auto readyEvents = entry.readyEvents;
+		entry.readyEvents = 0u;
+
+		if (!entry.active) {
+			continue;
+		}
+
+		if (entry.socket != nullptr) {
+			entry.socketCallback(*entry.socket, readyEvents);
+		} else {
+			entry.descriptorCallback(readyEvents);
+		}
+	}
+
+	readyEntries.clear();
+	removedEntries.clear();
+
+	return dispatched;
+}
+
+void NativeEventLoop::handleCompletion(const io_uring_cqe &cqe) {
+	// cancellation requests complete with no user data
+	if (cqe.user_data == 0u) {
+		return;
+	}
+
+	auto &entry = *reinterpret_cast<Entry *>(cqe.user_data & ~OPERATION_MASK);
+	const auto operation = static_cast<Operation>(cqe.user_data & OPERATION_MASK);
+
+	const bool finished = (cqe.flags & IORING_CQE_F_MORE) == 0u;
+
+	switch (operation) {
+	case Operation::RECEIVE:
+		completeReceive(entry, cqe);
+		break;
+
+	case Operation::SEND:
+		completeSend(entry, cqe);
+		break;
+
+	case Operation::NOTIFY:
+		completeNotify(entry, cqe);
+		break;
+	}
+
+	if (finished) {
+		--entry.pendingOperations;
+		--operationsInFlight;
+
+		// removed entries are kept until the end of the poll, since they might still be waiting for dispatch
+		if (!entry.active && entry.pendingOperations == 0u) {
+			const auto found = drainingEntries.find(&entry);
+
+			if (found != drainingEntries.end()) {
+				removedEntries.emplace_back(std::move(found->second));
+				drainingEntries.erase(found);
+			}
+		}
+	}
+}
+
+void NativeEventLoop::completeReceive(Entry &entry, const io_uring_cqe &cqe) {
+	const bool hasBuffer = (cqe.flags & IORING_CQE_F_BUFFER) != 0u;
+	const auto bufferID = static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+
+	if ((cqe.flags & IORING_CQE_F_MORE) == 0u) {
+		entry.receiveArmed = false;
+	}
+
+	if (entry.active && hasBuffer && cqe.res > 0) {
+		const auto data = receiveBuffers->getBuffer(bufferID);
+		auto &queue = entry.socket->receiveQueue;
+
+		queue.insert(queue.end(), data, data + cqe.res);
+		markReady(entry, EVENT_READABLE);
+
+		entry.socket->stats.addReceiveCall();
+		entry.socket->stats.addBytesReceived(static_cast<uint64_t>(cqe.res));
+
+		if (queue.size() - entry.socket->receiveQueueHead >= URING_RECEIVE_QUEUE_LIMIT) {
+			pauseReceive(entry);
+		}
+	}
+
+	if (hasBuffer) {
+		receiveBuffers->recycle(bufferID);
+	}
+
+	if (!entry.active) {
+		return;
+	}
+
+	if (cqe.res == -ECANCELED) {
+		// the queue might have been drained while the cancellation was in flight
+		if (!entry.receiveArmed && !entry.socket->receivePaused) {
+			armReceive(entry);
+		}
+
+		return;
+	}
+
+	if (cqe.res == 0) {
+		// end of stream; recv() returns 0 once the queued data is read, as it would without io_uring
+		markReady(entry, EVENT_READABLE | EVENT_HANGUP);
+		return;
+	}
+
+	// running out of receive buffers ends a multishot receive, but they've been recycled by now
+	if (cqe.res < 0 && cqe.res != -ENOBUFS) {
+		entry.socket->receiveError = -cqe.res;
+		markReady(entry, EVENT_READABLE | EVENT_ERROR);
+		return;
+	}
+
+	if (!entry.receiveArmed && !entry.socket->receivePaused) {
+		armReceive(entry);
+	}
+}
+
+void NativeEventLoop::completeSend(Entry &entry, const io_uring_cqe &cqe) {
+	entry.sendInFlight = false;
+
+	if (!entry.active) {
+		return;
+	}
+
+	auto &socket = *entry.socket;
+
+	if (cqe.res < 0) {
+		logger->error("Send error: {}", NativeSocketUtil::getErrorMessage(-cqe.res));
+
+		entry.sendBuffer.clear();
+		entry.sendOffset = 0u;
+		socket.sendInFlight = 0u;
+		socket.setError();
+
+		socket.stats.discardQueued();
+		socket.stats.setSendQueueDepth(socket.getSendQueueSize());
+
+		markReady(entry, EVENT_ERROR);
+		return;
+	}
+
+	entry.sendOffset += static_cast<uint32_t>(cqe.res);
+
+	socket.sendInFlight -= static_cast<uint32_t>(cqe.res);
+	socket.stats.addBytesSent(static_cast<uint64_t>(cqe.res));
+	socket.stats.markDequeued(static_cast<uint32_t>(cqe.res));
+	socket.stats.setSendQueueDepth(socket.getSendQueueSize());
+
+	if (entry.sendOffset < entry.sendBuffer.size()) {
+		socket.stats.addPartialSend();
+		submitSend(entry);
+		return;
+	}
+
+	entry.sendBuffer.clear();
+	entry.sendOffset = 0u;
+	socket.sendInFlight = 0u;
+
+	// anything queued while the send was in flight goes next
+	if (socket.getSendQueueSize() > 0u) {
+		submitSend(entry);
+	}
+
+	if (socket.backpressured && socket.getSendQueueSize() <= socket.lowWatermark) {
+		socket.backpressured = false;
+		markReady(entry, EVENT_WRITABLE);
+	}
+}
+
+void NativeEventLoop::completeNotify(Entry &entry, const io_uring_cqe &cqe) {
+	if ((cqe.flags & IORING_CQE_F_MORE) == 0u) {
+		entry.notifyArmed = false;
+	}
+
+	if (entry.acceptor != nullptr) {
+		if (cqe.res >= 0) {
+			const int fd = cqe.res;
+
+			if (!entry.active) {
+				NativeSocketUtil::closeSocket(fd);
+				return;
+			}
+
+			sockaddr_storage theirAddr;
+			socklen_t addrLen = sizeof(theirAddr);
+			std::memset(&theirAddr, 0, sizeof(theirAddr));
+
+			if (::getpeername(fd, reinterpret_cast<sockaddr *>(&theirAddr), &addrLen) != 0
+			        || NativeSocketUtil::setTCPNodelay(fd) != 0) {
+				// usually the peer reset the connection already; either way it's only this connection that's affected
+				logger->warn("Couldn't set up accepted socket: {}", NativeSocketUtil::getErrorMessage(errno));
+				NativeSocketUtil::closeSocket(fd);
+			} else {
+				entry.acceptCallback(*entry.acceptor,
+				        entry.acceptor->trackAccepted(NativeSocket::fromRawFileDescriptor(fd, theirAddr)));
+			}
+		} else if (NativeSocketUtil::isConnectionAcceptError(-cqe.res)) {
+			// only that connection failed, so keep accepting
+			logger->trace("Skipped a connection which failed before it was accepted: {}",
+			        NativeSocketUtil::getErrorMessage(-cqe.res));
+		} else if (cqe.res != -ECANCELED && entry.active) {
+			// as with acceptFrom, errors stop the acceptor rather than retrying in a tight loop
+			logger->error("Error in acceptSocket: {}", NativeSocketUtil::getErrorMessage(-cqe.res));
+			entry.acceptor->setError();
+			return;
+		}
+	} else if (entry.active) {
+		if (cqe.res < 0) {
+			if (cqe.res != -ECANCELED) {
+				logger->error("Couldn't poll descriptor {}: {}", entry.fd,
+				        NativeSocketUtil::getErrorMessage(-cqe.res));
+				markReady(entry, EVENT_ERROR);
+			}
+
+			return;
+		}
+
+		const auto pollEvents = static_cast<uint32_t>(cqe.res);
+		uint32_t descriptorEvents = 0u;
+
+		if (pollEvents & (POLLIN | POLLPRI)) {
+			descriptorEvents |= EVENT_READABLE;
+		}
+
+		if (pollEvents & POLLOUT) {
+			descriptorEvents |= EVENT_WRITABLE;
+		}
+
+		if (pollEvents & (POLLHUP | POLLRDHUP)) {
+			descriptorEvents |= EVENT_HANGUP;
+		}
+
+		if (pollEvents & POLLERR) {
+			descriptorEvents |= EVENT_ERROR;
+		}
+
+		markReady(entry, descriptorEvents);
+	}
+
+	// multishot operations can end early (e.g. if the completion queue overflows), so they're rearmed
+	if (entry.active && !entry.notifyArmed && (entry.acceptor == nullptr || entry.acceptor->isConnected())) {
+		armNotify(entry);
+	}
+}
+
+void NativeEventLoop::markReady(Entry &entry, uint32_t readyEvents) {
+	if (entry.readyEvents == 0u) {
+		readyEntries.emplace_back(&entry);
+	}
+
+	entry.readyEvents |= readyEvents;
+}
+
+#endif
+
+}
+
+#endif
+#endif
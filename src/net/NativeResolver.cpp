@@ -0,0 +1,197 @@
+#ifndef APG_NO_NATIVE
+
+#include <cstring>
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "APG/net/NativeResolver.hpp"
+
+namespace APG {
+
+constexpr const uint32_t NativeResolver::DEFAULT_CACHE_TTL_MILLISECONDS;
+constexpr const uint32_t NativeResolver::DEFAULT_NEGATIVE_CACHE_TTL_MILLISECONDS;
+constexpr const size_t NativeResolver::CACHE_PRUNE_SIZE;
+
+std::string NativeResolver::Result::getErrorMessage() const {
+	return error == 0 ? std::string("no error") : std::string(::gai_strerror(error));
+}
+
+NativeResolver::NativeResolver(uint32_t cacheTTLMilliseconds, uint32_t negativeCacheTTLMilliseconds) :
+		cacheTTL{cacheTTLMilliseconds},
+		negativeCacheTTL{negativeCacheTTLMilliseconds},
+		logger{spdlog::get("APG")} {
+	thread = std::thread(&NativeResolver::run, this);
+}
+
+NativeResolver::~NativeResolver() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+
+	condition.notify_all();
+
+	if (thread.joinable()) {
+		thread.join();
+	}
+}
+
+void NativeResolver::resolve(const std::string &host, uint16_t port, resolve_callback callback) {
+	auto key = makeKey(host, port);
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	auto &callbacks = waiting[key];
+	callbacks.emplace_back(std::move(callback));
+
+	// otherwise a lookup for this key is already queued or running, and will call every waiting callback. Cached
+	// results are still passed back from the resolver thread, so callbacks are always called from the same place.
+	if (callbacks.size() == 1u) {
+		queue.emplace_back(std::move(key));
+		condition.notify_one();
+	}
+}
+
+NativeResolver::result_ptr NativeResolver::lookupCached(const std::string &host, uint16_t port) {
+	std::lock_guard<std::mutex> lock(mutex);
+	return findCached(makeKey(host, port), clock::now());
+}
+
+void NativeResolver::clearCache() {
+	std::lock_guard<std::mutex> lock(mutex);
+	cache.clear();
+}
+
+size_t NativeResolver::getCacheSize() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return cache.size();
+}
+
+void NativeResolver::run() {
+	std::unique_lock<std::mutex> lock(mutex);
+
+	while (true) {
+		condition.wait(lock, [this]() {
+			return stopping || !queue.empty();
+		});
+
+		if (stopping) {
+			return;
+		}
+
+		const auto key = std::move(queue.front());
+		queue.pop_front();
+
+		auto result = findCached(key, clock::now());
+
+		if (result == nullptr) {
+			lock.unlock();
+			result = lookup(key);
+			lock.lock();
+
+			if (stopping) {
+				return;
+			}
+
+			const auto now = clock::now();
+
+			if (cache.size() >= CACHE_PRUNE_SIZE) {
+				for (auto it = cache.begin(); it != cache.end();) {
+					it = (it->second.expiry <= now ? cache.erase(it) : std::next(it));
+				}
+			}
+
+			cache[key] = CacheEntry { result, now + (result->error == 0 ? cacheTTL : negativeCacheTTL) };
+		}
+
+		auto callbacksIt = waiting.find(key);
+
+		if (callbacksIt == waiting.end()) {
+			continue;
+		}
+
+		auto callbacks = std::move(callbacksIt->second);
+		waiting.erase(callbacksIt);
+
+		lock.unlock();
+
+		for (auto &callback : callbacks) {
+			callback(result);
+		}
+
+		lock.lock();
+	}
+}
+
+NativeResolver::result_ptr NativeResolver::lookup(const std::string &key) const {
+	// keys are the host, then a NUL, then the port
+	const auto separator = key.find('\0');
+	const auto host = key.substr(0u, separator);
+	const auto port = key.substr(separator + 1u);
+
+	addrinfo hints;
+	std::memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_protocol = IPPROTO_TCP;
+	hints.ai_flags = AI_NUMERICSERV | AI_ADDRCONFIG;
+
+	addrinfo *tempAI = nullptr;
+
+	auto result = std::make_shared<Result>();
+	result->error = ::getaddrinfo(host.c_str(), port.c_str(), &hints, &tempAI);
+
+	if (result->error != 0) {
+		logger->warn("Couldn't resolve hosts for \"{}\": {}", host, result->getErrorMessage());
+		return result;
+	}
+
+	auto addrPtr = NativeSocketUtil::make_addrinfo_ptr(tempAI);
+
+	for (auto p = addrPtr.get(); p != nullptr; p = p->ai_next) {
+		if ((p->ai_family != AF_INET && p->ai_family != AF_INET6) || p->ai_addrlen > sizeof(sockaddr_storage)) {
+			continue;
+		}
+
+		Address address;
+		std::memset(&address.address, 0, sizeof(address.address));
+		std::memcpy(&address.address, p->ai_addr, p->ai_addrlen);
+		address.length = static_cast<socklen_t>(p->ai_addrlen);
+		address.family = p->ai_family;
+
+		result->addresses.emplace_back(address);
+	}
+
+	return result;
+}
+
+NativeResolver::result_ptr NativeResolver::findCached(const std::string &key, clock::time_point now) {
+	const auto it = cache.find(key);
+
+	if (it == cache.end()) {
+		return nullptr;
+	}
+
+	if (it->second.expiry <= now) {
+		cache.erase(it);
+		return nullptr;
+	}
+
+	return it->second.result;
+}
+
+std::string NativeResolver::makeKey(const std::string &host, uint16_t port) {
+	std::string key = host;
+	key.push_back('\0');
+	key += std::to_string(port);
+
+	return key;
+}
+
+}
+
+#endif
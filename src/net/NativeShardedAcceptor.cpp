@@ -0,0 +1,158 @@
+#include "APG/net/NativeShardedAcceptor.hpp"
+
+#ifdef APG_HAS_EPOLL
+
+#include <cerrno>
+#include <cstdint>
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <utility>
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace APG {
+
+NativeShardedAcceptor::Shard::Shard(uint32_t index, uint16_t port, NativeEventLoop::Backend backend) :
+		index{index},
+		acceptor{std::make_unique<NativeDualAcceptorSocket>(port, true, BB_DEFAULT_SIZE, true)},
+		loop{1024u, backend} {
+}
+
+NativeShardedAcceptor::NativeShardedAcceptor(uint16_t port, uint32_t shardCount, NativeEventLoop::Backend backend) :
+		port{port},
+		statsGroup{std::make_shared<SocketStatsGroup>()},
+		logger{spdlog::get("APG")} {
+	if (shardCount == 0u) {
+		shardCount = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	shards.reserve(shardCount);
+
+	for (uint32_t i = 0u; i < shardCount; ++i) {
+		shards.emplace_back(std::unique_ptr<Shard>(new Shard(i, port, backend)));
+		shards.back()->acceptor->setStatsGroup(statsGroup);
+	}
+
+	if (!isListening()) {
+		logger->error("Couldn't open all {} sharded listeners on port {}.", shardCount, port);
+	}
+}
+
+NativeShardedAcceptor::~NativeShardedAcceptor() {
+	stop();
+}
+
+bool NativeShardedAcceptor::start(accept_callback callback) {
+	if (isRunning()) {
+		logger->error("Sharded acceptor on port {} is already running.", port);
+		return false;
+	}
+
+	if (!isListening()) {
+		logger->error("Can't start sharded acceptor on port {} since not every listener is open.", port);
+		return false;
+	}
+
+	for (auto &shardPtr : shards) {
+		auto &shard = *shardPtr;
+
+		shard.wakeFD = ::eventfd(0u, EFD_NONBLOCK | EFD_CLOEXEC);
+
+		if (shard.wakeFD == -1) {
+			logger->error("Couldn't create wake descriptor for acceptor shard: {}",
+			        NativeSocketUtil::getErrorMessage(errno));
+			stop();
+			return false;
+		}
+
+		const auto wakeFD = shard.wakeFD;
+
+		// the counter only needs draining so the next wake-up is a new edge; running is checked by the thread
+		shard.loop.addDescriptor(wakeFD, [wakeFD](uint32_t) {
+			eventfd_t value;
+			::eventfd_read(wakeFD, &value);
+		});
+
+		const bool added = shard.loop.addAcceptor(shard.acceptor.get(),
+		        [&shard, callback](NativeDualAcceptorSocket &, std::unique_ptr<Socket> socket) {
+			        shard.acceptedCount.fetch_add(1u, std::memory_order_relaxed);
+			        callback(shard, std::move(socket));
+		        });
+
+		if (!added) {
+			stop();
+			return false;
+		}
+	}
+
+	running.store(true, std::memory_order_release);
+
+	for (auto &shard : shards) {
+		shard->thread = std::thread(&NativeShardedAcceptor::runShard, this, std::ref(*shard));
+	}
+
+	logger->info("Accepting on port {} with {} shards.", port, shards.size());
+
+	return true;
+}
+
+void NativeShardedAcceptor::stop() {
+	running.store(false, std::memory_order_release);
+
+	for (auto &shard : shards) {
+		if (shard->wakeFD != -1) {
+			::eventfd_write(shard->wakeFD, 1u);
+		}
+	}
+
+	for (auto &shard : shards) {
+		if (shard->thread.joinable()) {
+			shard->thread.join();
+		}
+
+		if (shard->wakeFD != -1) {
+			shard->loop.removeDescriptor(shard->wakeFD);
+			::close(shard->wakeFD);
+			shard->wakeFD = -1;
+		}
+
+		shard->loop.removeAcceptor(shard->acceptor.get());
+	}
+}
+
+bool NativeShardedAcceptor::isListening() const {
+	for (const auto &shard : shards) {
+		if (!shard->acceptor->isConnected() || shard->acceptor->hasError()) {
+			return false;
+		}
+	}
+
+	return !shards.empty();
+}
+
+uint64_t NativeShardedAcceptor::getAcceptedCount() const {
+	uint64_t total = 0u;
+
+	for (const auto &shard : shards) {
+		total += shard->getAcceptedCount();
+	}
+
+	return total;
+}
+
+void NativeShardedAcceptor::runShard(Shard &shard) {
+	while (running.load(std::memory_order_acquire)) {
+		if (shard.loop.poll(-1) < 0) {
+			logger->error("Event loop for acceptor shard {} failed; the shard has stopped.", shard.index);
+			break;
+		}
+	}
+}
+
+}
+
+#endif
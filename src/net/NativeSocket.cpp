@@ -13,13 +13,35 @@
 #include <cstring>
 #include <cerrno>
 
+#include <algorithm>
 #include <chrono>
 
 #include "APG/net/NativeSocket.hpp"
+#include "APG/net/NativeEventLoop.hpp"
 #include "APG/internal/Assert.hpp"
 
 namespace APG {
 
+namespace {
+
+#ifdef MSG_NOSIGNAL
+// a peer disconnecting should be reported as an error, not kill the process with SIGPIPE
+constexpr const int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+constexpr const int SEND_FLAGS = 0;
+#endif
+
+#ifdef IOV_MAX
+constexpr const uint32_t MAX_IOVECS = IOV_MAX;
+#else
+constexpr const uint32_t MAX_IOVECS = 1024u;
+#endif
+
+}
+
+constexpr const uint32_t NativeSocket::DEFAULT_SEND_QUEUE_LOW_WATERMARK;
+constexpr const uint32_t NativeSocket::DEFAULT_SEND_QUEUE_HIGH_WATERMARK;
+
 NativeSocket::NativeSocket(const std::string &remoteHost, uint16_t port, bool autoConnect, uint32_t bufferSize) :
 		        Socket(remoteHost, port, bufferSize),
 		        portString { std::to_string(port) },
@@ -34,12 +56,13 @@ NativeSocket::NativeSocket(int fd, const std::string &remoteHost, uint16_t port,
 		        portString { std::to_string(port) },
 		        internalSocket { fd },
 				logger {spdlog::get("APG")} {
+	setConnected();
 	addToSet();
 }
 
 std::unique_ptr<Socket> NativeSocket::fromRawFileDescriptor(int fd, sockaddr_storage addr) {
 	// TODO: Make this more thread-friendly
-	char ip[INET6_ADDRSTRLEN];
+	char ip[INET6_ADDRSTRLEN] = "UNKNOWN";
 	int port = -1;
 
 	if (addr.ss_family == AF_INET) {
@@ -60,7 +83,7 @@ std::unique_ptr<Socket> NativeSocket::fromRawFileDescriptor(int fd, sockaddr_sto
 		}
 	}
 
-	return std::make_unique<NativeSocket>(fd, std::string(ip, INET6_ADDRSTRLEN), port);
+	return std::make_unique<NativeSocket>(fd, std::string(ip), port);
 }
 
 NativeSocket::~NativeSocket() {
@@ -69,51 +92,348 @@ NativeSocket::~NativeSocket() {
 
 int NativeSocket::send() {
 	if (hasError()) {
-		logger->warn("send() called on SDL socket in error state.");
+		logger->warn("send() called on native socket in error state.");
 		return 0;
 	}
 
-	const int total = size();
-	int sent = 0;
+	const auto started = SocketStats::clock::now();
+	const auto total = size();
+	const auto data = getBuffer().data();
+
+#ifdef APG_HAS_IO_URING
+	// the loop sends everything queued together at the start of its next poll
+	if (isUsingIOUring()) {
+		queueSend(data, total);
+		stats.markQueued(total, started);
+		eventLoop->requestSend(*this, false);
+
+#ifndef APG_SOCKET_NO_AUTO_CLEAR
+		clear();
+#endif
 
-	while (sent < total) {
-		sent += ::send(internalSocket, reinterpret_cast<const char *>(getBuffer().data()) + sent * sizeof(uint8_t),
-		        size() - sent, 0);
+		return total;
 	}
+#endif
 
-	if (sent < (int32_t) size()) {
-		if (sent >= 0) {
-			logger->trace("Warning: {} bytes sent of {} bytes total.", sent, size());
-		} else {
-			logger->error("Send error: {}", NativeSocketUtil::getErrorMessage(errno));
+	// anything already queued has to go first to keep the stream in order
+	if (getSendQueueSize() > 0u) {
+		flushSendQueue();
+
+		if (hasError()) {
+			return 0;
+		}
+	}
+
+	uint32_t sent = 0u;
+
+	if (getSendQueueSize() == 0u) {
+		const auto result = sendSome(data, total);
+
+		if (result < 0) {
 			setError();
 			return 0;
 		}
+
+		sent = static_cast<uint32_t>(result);
+	}
+
+	if (sent < total) {
+		logger->trace("{} bytes sent of {} bytes total; queueing the rest.", sent, total);
+		queueSend(data + sent, total - sent);
+		stats.markQueued(total - sent, started);
+	} else if (total > 0u) {
+		stats.recordSendLatency(started);
 	}
 
 #ifndef APG_SOCKET_NO_AUTO_CLEAR
 	clear();
 #endif
 
-	return sent;
+	return total;
 }
 
-int NativeSocket::recv(uint32_t length) {
-	REQUIRE(length <= APG_RECV_BUFFER_SIZE, "Cannot recv() on a buffer size smaller than the max");
-
+int NativeSocket::sendv(const BufferView *views, uint32_t viewCount) {
 	if (hasError()) {
-		logger->warn("recv() called on SDL socket in error state.");
+		logger->warn("sendv() called on native socket in error state.");
 		return 0;
 	}
 
-#ifndef APG_SOCKET_NO_AUTO_CLEAR
-	clear();
+	const auto started = SocketStats::clock::now();
+
+	uint32_t total = 0u;
+	for (uint32_t i = 0; i < viewCount; ++i) {
+		total += views[i].length;
+	}
+
+#ifdef APG_HAS_IO_URING
+	if (isUsingIOUring()) {
+		for (uint32_t i = 0; i < viewCount; ++i) {
+			queueSend(views[i].data, views[i].length);
+		}
+
+		stats.markQueued(total, started);
+		eventLoop->requestSend(*this, false);
+		return static_cast<int>(total);
+	}
+#endif
+
+	if (getSendQueueSize() > 0u) {
+		flushSendQueue();
+
+		if (hasError()) {
+			return 0;
+		}
+	}
+
+	uint32_t firstView = 0u;
+	uint32_t offset = 0u;
+	uint32_t sent = 0u;
+
+	if (getSendQueueSize() == 0u) {
+		const auto result = sendSomeVectored(views, viewCount, firstView, offset);
+
+		if (result < 0) {
+			setError();
+			return 0;
+		}
+
+		sent = static_cast<uint32_t>(result);
+	}
+
+	for (uint32_t i = firstView; i < viewCount; ++i) {
+		const auto skip = (i == firstView) ? offset : 0u;
+		queueSend(views[i].data + skip, views[i].length - skip);
+	}
+
+	if (sent < total) {
+		stats.markQueued(total - sent, started);
+	} else if (total > 0u) {
+		stats.recordSendLatency(started);
+	}
+
+	return static_cast<int>(total);
+}
+
+int NativeSocket::flushSendQueue() {
+	const auto pending = getSendQueueSize();
+
+	if (pending == 0u || hasError()) {
+		return 0;
+	}
+
+#ifdef APG_HAS_IO_URING
+	// sends complete asynchronously, so nothing counts as sent yet
+	if (isUsingIOUring()) {
+		eventLoop->requestSend(*this, true);
+		return 0;
+	}
+#endif
+
+	const auto result = sendSome(sendQueue.data() + sendQueueHead, pending);
+
+	if (result < 0) {
+		setError();
+		return 0;
+	}
+
+	sendQueueHead += static_cast<uint32_t>(result);
+	stats.markDequeued(static_cast<uint32_t>(result));
+
+	if (sendQueueHead == sendQueue.size()) {
+		sendQueue.clear();
+		sendQueueHead = 0u;
+	} else if (sendQueueHead > sendQueue.size() / 2u) {
+		// only compact once most of the queue is sent, so each byte is moved at most once on average
+		sendQueue.erase(sendQueue.begin(), sendQueue.begin() + sendQueueHead);
+		sendQueueHead = 0u;
+	}
+
+	if (backpressured && getSendQueueSize() <= lowWatermark) {
+		backpressured = false;
+	}
+
+	stats.setSendQueueDepth(getSendQueueSize());
+
+	return result;
+}
+
+void NativeSocket::setSendWatermarks(uint32_t lowWatermark_, uint32_t highWatermark_) {
+	REQUIRE(lowWatermark_ <= highWatermark_, "Low send watermark must not be above the high send watermark.");
+
+	lowWatermark = lowWatermark_;
+	highWatermark = highWatermark_;
+
+	const auto pending = getSendQueueSize();
+
+	if (pending > highWatermark) {
+		backpressured = true;
+	} else if (pending <= lowWatermark) {
+		backpressured = false;
+	}
+}
+
+int NativeSocket::sendSome(const uint8_t *data, uint32_t length) {
+	uint32_t sent = 0u;
+
+	while (sent < length) {
+		const auto result = ::send(internalSocket, reinterpret_cast<const char *>(data + sent), length - sent,
+		        SEND_FLAGS);
+
+		stats.addSendCall();
+
+		if (result < 0) {
+			if (errno == EINTR) {
+				continue;
+			} else if (errno == EAGAIN || errno == NativeSocketUtil::APGWOULDBLOCK) {
+				stats.addWouldBlock();
+				break;
+			}
+
+			logger->error("Send error: {}", NativeSocketUtil::getErrorMessage(errno));
+			return -1;
+		}
+
+		sent += static_cast<uint32_t>(result);
+	}
+
+	stats.addBytesSent(sent);
+
+	if (sent < length) {
+		stats.addPartialSend();
+	}
+
+	return static_cast<int>(sent);
+}
+
+int NativeSocket::sendSomeVectored(const BufferView *views, uint32_t viewCount, uint32_t &firstView,
+        uint32_t &offset) {
+	uint32_t sent = 0u;
+
+	firstView = 0u;
+	offset = 0u;
+
+#ifdef _WIN32
+	// one send per view; see sendv
+	for (; firstView < viewCount; ++firstView) {
+		const auto result = sendSome(views[firstView].data, views[firstView].length);
+
+		if (result < 0) {
+			return -1;
+		}
+
+		sent += static_cast<uint32_t>(result);
+
+		if (static_cast<uint32_t>(result) < views[firstView].length) {
+			offset = static_cast<uint32_t>(result);
+			break;
+		}
+	}
+#else
+	while (firstView < viewCount) {
+		iovecs.clear();
+
+		for (uint32_t i = firstView; i < viewCount && iovecs.size() < MAX_IOVECS; ++i) {
+			const auto skip = (i == firstView) ? offset : 0u;
+
+			if (views[i].length > skip) {
+				iovec vec;
+				vec.iov_base = const_cast<uint8_t *>(views[i].data + skip);
+				vec.iov_len = views[i].length - skip;
+				iovecs.emplace_back(vec);
+			}
+		}
+
+		if (iovecs.empty()) {
+			firstView = viewCount;
+			break;
+		}
+
+		msghdr message;
+		std::memset(&message, 0, sizeof(message));
+		message.msg_iov = iovecs.data();
+		message.msg_iovlen = iovecs.size();
+
+		const auto result = ::sendmsg(internalSocket, &message, SEND_FLAGS);
+
+		stats.addSendCall();
+
+		if (result < 0) {
+			if (errno == EINTR) {
+				continue;
+			} else if (errno == EAGAIN || errno == NativeSocketUtil::APGWOULDBLOCK) {
+				stats.addWouldBlock();
+				break;
+			}
+
+			logger->error("Send error: {}", NativeSocketUtil::getErrorMessage(errno));
+			return -1;
+		}
+
+		sent += static_cast<uint32_t>(result);
+
+		// skip past every view which was completely sent
+		auto remaining = static_cast<uint32_t>(result);
+		while (firstView < viewCount && remaining >= views[firstView].length - offset) {
+			remaining -= views[firstView].length - offset;
+			++firstView;
+			offset = 0u;
+		}
+
+		if (firstView < viewCount) {
+			offset += remaining;
+		}
+	}
+
+	stats.addBytesSent(sent);
+
+	if (firstView < viewCount) {
+		stats.addPartialSend();
+	}
 #endif
 
-	auto bytesReceived = ::recv(internalSocket, reinterpret_cast<char *>(recvBuffer.get()), length, 0);
+	return static_cast<int>(sent);
+}
+
+void NativeSocket::queueSend(const uint8_t *data, uint32_t length) {
+	sendQueue.insert(sendQueue.end(), data, data + length);
+	stats.setSendQueueDepth(getSendQueueSize());
+
+	if (getSendQueueSize() > highWatermark) {
+		if (!backpressured) {
+			logger->trace("Send queue for {} passed its high watermark ({} bytes).", remoteHost,
+			        getSendQueueSize());
+		}
+
+		backpressured = true;
+	}
+}
+
+int NativeSocket::recv(uint32_t length) {
+	if (hasError()) {
+		logger->warn("recv() called on native socket in error state.");
+		return 0;
+	}
+
+	// data already received by an io_uring loop comes first, even if the socket has been removed from the loop since
+	if (receiveQueueHead < receiveQueue.size() || isUsingIOUring()) {
+		return recvQueued(length);
+	}
+
+	discardReadData();
+
+	auto target = prepareWrite(length);
+	auto bytesReceived = ::recv(internalSocket, reinterpret_cast<char *>(target), length, 0);
+
+	stats.addReceiveCall();
 
 	if (bytesReceived <= 0) {
+		commitWrite(0u, length);
+
 		if (bytesReceived == 0 || errno == EAGAIN || errno == NativeSocketUtil::APGWOULDBLOCK) {
+			if (bytesReceived < 0) {
+				stats.addWouldBlock();
+			}
+
 			// remote connection closed/nonblock takes effect
 			return 0;
 		} else {
@@ -123,13 +443,73 @@ int NativeSocket::recv(uint32_t length) {
 		}
 	}
 
-	putBytes(recvBuffer.get(), bytesReceived);
+	commitWrite(static_cast<uint32_t>(bytesReceived), length);
+	stats.addBytesReceived(static_cast<uint64_t>(bytesReceived));
 
 	return bytesReceived;
 }
 
+int NativeSocket::recvQueued(uint32_t length) {
+	discardReadData();
+
+	const auto available = static_cast<uint32_t>(receiveQueue.size()) - receiveQueueHead;
+
+	if (available == 0u) {
+		if (receiveError != 0) {
+			logger->error("Recv error: {}", NativeSocketUtil::getErrorMessage(receiveError));
+			receiveError = 0;
+			setError();
+			return -1;
+		}
+
+		return 0;
+	}
+
+	const auto count = std::min(length, available);
+
+	auto target = prepareWrite(count);
+	std::memcpy(target, receiveQueue.data() + receiveQueueHead, count);
+	commitWrite(count, count);
+
+	receiveQueueHead += count;
+
+	if (receiveQueueHead == receiveQueue.size()) {
+		receiveQueue.clear();
+		receiveQueueHead = 0u;
+	} else if (receiveQueueHead > receiveQueue.size() / 2u) {
+		receiveQueue.erase(receiveQueue.begin(), receiveQueue.begin() + receiveQueueHead);
+		receiveQueueHead = 0u;
+	}
+
+#ifdef APG_HAS_IO_URING
+	if (receivePaused && isUsingIOUring()
+	        && receiveQueue.size() - receiveQueueHead < NativeEventLoop::URING_RECEIVE_QUEUE_LIMIT) {
+		eventLoop->resumeReceive(*this);
+	}
+#endif
+
+	return static_cast<int>(count);
+}
+
+bool NativeSocket::isUsingIOUring() const {
+#ifdef APG_HAS_IO_URING
+	return eventLoop != nullptr && eventLoop->getBackend() == NativeEventLoop::Backend::IO_URING;
+#else
+	return false;
+#endif
+}
+
 bool NativeSocket::hasActivity() {
-	const auto selRet = ::select(internalSocket + 1, &socketSet, nullptr, nullptr, nullptr);
+#ifndef _WIN32
+	if (internalSocket >= FD_SETSIZE) {
+		logger->error("Socket descriptor {} is too large for select(); use a NativeEventLoop instead.", internalSocket);
+		return false;
+	}
+#endif
+
+	fd_set readSet = socketSet;
+
+	const auto selRet = ::select(internalSocket + 1, &readSet, nullptr, nullptr, nullptr);
 
 	if (selRet < 0) {
 		logger->error("::select entered an error state: {}",
@@ -143,11 +523,21 @@ bool NativeSocket::hasActivity() {
 
 bool NativeSocket::waitForActivity(uint32_t millisecondsToWait) {
 	timeval timeval;
-	timeval.tv_sec = 0;
-	timeval.tv_usec = millisecondsToWait * 1000;
+	timeval.tv_sec = millisecondsToWait / 1000u;
+	timeval.tv_usec = (millisecondsToWait % 1000u) * 1000u;
+
+#ifndef _WIN32
+	if (internalSocket >= FD_SETSIZE) {
+		logger->error("Socket descriptor {} is too large for select(); use a NativeEventLoop instead.", internalSocket);
+		return false;
+	}
+#endif
+
+	// select() overwrites the set, so the member is only ever used as a template
+	fd_set readSet = socketSet;
 
 // returns the number of FDs in set if successful (i.e. 1 here)
-	const auto selRet = ::select(internalSocket + 1, &socketSet, nullptr, nullptr,
+	const auto selRet = ::select(internalSocket + 1, &readSet, nullptr, nullptr,
 	        (millisecondsToWait > 0 ? &timeval : nullptr));
 
 	if (selRet <= 0) {
@@ -214,24 +604,52 @@ void NativeSocket::connect() {
 }
 
 void NativeSocket::disconnect() {
+#ifdef APG_HAS_EPOLL
+	if (eventLoop != nullptr) {
+		eventLoop->remove(this);
+	}
+#endif
+
 	if (isConnected()) {
-		FD_CLR(internalSocket, &socketSet);
+		FD_ZERO(&socketSet);
 
 		NativeSocketUtil::closeSocket(internalSocket);
 	}
 
+	sendQueue.clear();
+	sendQueueHead = 0u;
+	sendInFlight = 0u;
+	backpressured = false;
+
+	stats.discardQueued();
+	stats.setSendQueueDepth(0u);
+
+	receiveQueue.clear();
+	receiveQueueHead = 0u;
+	receiveError = 0;
+	receivePaused = false;
+
 	setNotConnected();
 }
 
 void NativeSocket::addToSet() {
 	FD_ZERO(&socketSet);
 
+#ifndef _WIN32
+	// descriptors past FD_SETSIZE can't be used with select; such sockets must be used through a NativeEventLoop
+	if (internalSocket >= FD_SETSIZE) {
+		return;
+	}
+#endif
+
 	FD_SET(internalSocket, &socketSet);
 }
 
-NativeDualAcceptorSocket::NativeDualAcceptorSocket(uint16_t port_, bool autoListen, uint32_t bufferSize_) :
+NativeDualAcceptorSocket::NativeDualAcceptorSocket(uint16_t port_, bool autoListen, uint32_t bufferSize_,
+        bool reusePort_) :
 		        AcceptorSocket(port_, bufferSize_),
 		        portString { std::to_string(port) },
+		        reusePort { reusePort_ },
 				logger {spdlog::get("APG")} {
 	if (autoListen) {
 		listen();
@@ -243,6 +661,12 @@ NativeDualAcceptorSocket::~NativeDualAcceptorSocket() {
 }
 
 void NativeDualAcceptorSocket::disconnect() {
+#ifdef APG_HAS_EPOLL
+	if (eventLoop != nullptr) {
+		eventLoop->removeAcceptor(this);
+	}
+#endif
+
 	if (isConnected()) {
 		NativeSocketUtil::closeSocket(internalListener4);
 		NativeSocketUtil::closeSocket(internalListener6);
@@ -252,115 +676,137 @@ void NativeDualAcceptorSocket::disconnect() {
 }
 
 std::unique_ptr<Socket> NativeDualAcceptorSocket::acceptSocket(float maxWaitInSeconds) {
-	static bool timeFor4 = false;
-	int newFD;
-	sockaddr_storage theirAddr;
-	socklen_t addrLen = sizeof(theirAddr);
+	using clock = std::chrono::steady_clock;
 
-	if (maxWaitInSeconds > 0.0f) {
-		float waitTime = 0.0f;
+	const bool waitForever = maxWaitInSeconds <= 0.0f;
+	const auto deadline = clock::now()
+	        + std::chrono::duration_cast<clock::duration>(std::chrono::duration<float>(maxWaitInSeconds));
 
-		auto startTime = std::chrono::high_resolution_clock::now();
+	// if only one protocol is supported both descriptors are the same
+	const int listeners[] = {internalListener4, internalListener6};
+	const int listenerCount = (internalListener4 == internalListener6) ? 1 : 2;
 
-		// socket is set to O_NONBLOCK in listen() so -1 can mean
-		// errno was set to EWOULDBLOCK and no actual error occurred.
-		while (true) {
-			if (timeFor4) {
-				newFD = ::accept(internalListener4, (sockaddr *) &theirAddr, &addrLen);
-			} else {
-				newFD = ::accept(internalListener6, (sockaddr *) &theirAddr, &addrLen);
-			}
+#ifndef _WIN32
+	if (std::max(internalListener4, internalListener6) >= FD_SETSIZE) {
+		logger->error("Listener descriptor is too large for select(); use a NativeEventLoop instead.");
+		return nullptr;
+	}
+#endif
 
-			timeFor4 = !timeFor4;
+	while (isConnected() && !hasError()) {
+		fd_set readSet;
+		FD_ZERO(&readSet);
 
-			if (newFD == -1) {
-				if (errno == NativeSocketUtil::APGWOULDBLOCK) {
-					auto timeNow = std::chrono::high_resolution_clock::now();
-					const float deltaTime =
-					        std::chrono::duration_cast<std::chrono::milliseconds>(timeNow - startTime).count()
-					                / 1000.0f;
+		for (int i = 0; i < listenerCount; ++i) {
+			FD_SET(listeners[i], &readSet);
+		}
 
-					startTime = timeNow;
+		timeval timeout;
+		timeval *timeoutPtr = nullptr;
 
-					waitTime += deltaTime;
+		if (!waitForever) {
+			const auto remaining = std::chrono::duration_cast<std::chrono::microseconds>(deadline - clock::now());
 
-					if (waitTime > maxWaitInSeconds) {
-						return nullptr;
-					}
-				} else {
-					logger->error("Error in acceptSocket: {}",
-					        NativeSocketUtil::getErrorMessage(errno));
-					setError();
-					return nullptr;
-				}
-			} else {
-				break;
+			if (remaining.count() <= 0) {
+				return nullptr;
 			}
+
+			timeout.tv_sec = static_cast<decltype(timeout.tv_sec)>(remaining.count() / 1000000);
+			timeout.tv_usec = static_cast<decltype(timeout.tv_usec)>(remaining.count() % 1000000);
+			timeoutPtr = &timeout;
 		}
-	} else {
-		while (true) {
-			if (timeFor4) {
-				newFD = ::accept(internalListener4, (sockaddr *) &theirAddr, &addrLen);
-			} else {
-				newFD = ::accept(internalListener6, (sockaddr *) &theirAddr, &addrLen);
+
+		const auto selRet = ::select(std::max(listeners[0], listeners[1]) + 1, &readSet, nullptr, nullptr,
+		        timeoutPtr);
+
+		if (selRet < 0) {
+			if (errno == EINTR) {
+				continue;
 			}
 
-			timeFor4 = !timeFor4;
+			logger->error("::select failed in acceptSocket: {}", NativeSocketUtil::getErrorMessage(errno));
+			setError();
+			return nullptr;
+		} else if (selRet == 0) {
+			return nullptr;
+		}
+
+		for (int i = 0; i < listenerCount; ++i) {
+			if (FD_ISSET(listeners[i], &readSet)) {
+				std::unique_ptr<Socket> socket;
+				const auto result = acceptFrom(listeners[i], socket);
 
-			if (newFD == -1) {
-				if (errno == NativeSocketUtil::APGWOULDBLOCK) {
-					continue;
-				} else {
-					logger->error("Error in acceptSocket: {}", NativeSocketUtil::getErrorMessage(errno));
-					setError();
+				if (result == AcceptResult::ACCEPTED) {
+					return socket;
+				} else if (result == AcceptResult::FAILED) {
 					return nullptr;
 				}
-			} else {
-				break;
 			}
 		}
-	}
-
-	if (NativeSocketUtil::setTCPNodelay(newFD) != 0) {
-		logger->error("Couldn't set nodelay on new socket: {}", NativeSocketUtil::getErrorMessage(errno));
-		NativeSocketUtil::closeSocket(newFD);
 
-		return nullptr;
+		// the connection went away (or was taken by someone else) between select and accept, so wait again
 	}
 
-	return NativeSocket::fromRawFileDescriptor(newFD, theirAddr);
+	return nullptr;
 }
 
 std::unique_ptr<Socket> NativeDualAcceptorSocket::acceptSocketOnce() {
-	static bool four = false;
+	const auto listener = acceptIP4Next ? internalListener4 : internalListener6;
+	acceptIP4Next = !acceptIP4Next;
 
-	int newFD;
-	sockaddr_storage theirAddr;
-	socklen_t addrLen;
+	std::unique_ptr<Socket> socket;
 
-	newFD = ::accept(four ? internalListener4 : internalListener6, (sockaddr *) &theirAddr, &addrLen);
+	// connections which went away before they could be accepted don't count as the one try
+	while (acceptFrom(listener, socket) == AcceptResult::SKIPPED) {
+	}
+
+	return socket;
+}
 
-	four = !four;
+NativeDualAcceptorSocket::AcceptResult NativeDualAcceptorSocket::acceptFrom(int listenerFD,
+        std::unique_ptr<Socket> &accepted) {
+	sockaddr_storage theirAddr;
+	socklen_t addrLen = sizeof(theirAddr);
+
+	const int newFD = ::accept(listenerFD, (sockaddr *) &theirAddr, &addrLen);
 
 	if (newFD == -1) {
+		const int error = errno;
+
 		// We almost expect that it would have blocked, but certainly it's not an error if it would've.
-		if (errno != NativeSocketUtil::APGWOULDBLOCK) {
-			logger->error("Error in acceptSocket: {}", NativeSocketUtil::getErrorMessage(errno));
-			setError();
+		if (error == EAGAIN || error == NativeSocketUtil::APGWOULDBLOCK) {
+			return AcceptResult::WOULD_BLOCK;
+		} else if (NativeSocketUtil::isConnectionAcceptError(error)) {
+			logger->trace("Skipped a connection which failed before it was accepted: {}",
+			        NativeSocketUtil::getErrorMessage(error));
+			return AcceptResult::SKIPPED;
 		}
 
-		return nullptr;
+		logger->error("Error in acceptSocket: {}", NativeSocketUtil::getErrorMessage(error));
+		setError();
+
+		return AcceptResult::FAILED;
 	}
 
 	if (NativeSocketUtil::setTCPNodelay(newFD) != 0) {
-		logger->error("Couldn't set nodelay on new socket: {}",
-		        NativeSocketUtil::getErrorMessage(errno));
+		// usually the peer reset the connection already; either way it's only this connection that's affected
+		logger->warn("Couldn't set nodelay on new socket: {}", NativeSocketUtil::getErrorMessage(errno));
 		NativeSocketUtil::closeSocket(newFD);
 
-		return nullptr;
+		return AcceptResult::SKIPPED;
+	}
+
+	// accepted sockets don't inherit non-blocking mode, and a blocking send would stall on a slow consumer rather
+	// than using the send queue
+	if (NativeSocketUtil::setNonBlocking(newFD) != 0) {
+		logger->warn("Couldn't set new socket to non-blocking: {}", NativeSocketUtil::getErrorMessage(errno));
+		NativeSocketUtil::closeSocket(newFD);
+
+		return AcceptResult::SKIPPED;
 	}
 
-	return NativeSocket::fromRawFileDescriptor(newFD, theirAddr);
+	accepted = trackAccepted(NativeSocket::fromRawFileDescriptor(newFD, theirAddr));
+	return AcceptResult::ACCEPTED;
 }
 
 void NativeDualAcceptorSocket::listen() {
@@ -385,7 +831,8 @@ void NativeDualAcceptorSocket::listen() {
 		return;
 	}
 
-	auto supportedProtocols = NativeSocketUtil::findValidDualSockets(internalListener4, internalListener6, retHolder);
+	auto supportedProtocols = NativeSocketUtil::findValidDualSockets(internalListener4, internalListener6, retHolder,
+	        nullptr, nullptr, reusePort);
 
 	switch (supportedProtocols) {
 	case NativeSocketUtil::DualSocketReturn::IPV4_ONLY: {
@@ -516,7 +963,7 @@ int NativeSocketUtil::findValidSocket(const addrinfo_ptr &ptr, bool shouldBind,
 }
 
 NativeSocketUtil::DualSocketReturn NativeSocketUtil::findValidDualSockets(int &ip4Socket, int &ip6Socket,
-        const addrinfo_ptr &ptr, addrinfo **targetStruct4, addrinfo **targetStruct6) {
+        const addrinfo_ptr &ptr, addrinfo **targetStruct4, addrinfo **targetStruct6, bool reusePort) {
 	auto logger = spdlog::get("APG");
 
 	int tempSocketFD = -1;
@@ -567,6 +1014,23 @@ NativeSocketUtil::DualSocketReturn NativeSocketUtil::findValidDualSockets(int &i
 			}
 		}
 
+		if (reusePort) {
+#ifdef SO_REUSEPORT
+			const int opt = 1;
+
+			if (::setsockopt(tempSocketFD, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0) {
+				logger->error("Couldn't set SO_REUSEPORT for {} socket: {}", inetString,
+				        NativeSocketUtil::getErrorMessage(errno));
+				NativeSocketUtil::closeSocket(tempSocketFD);
+				continue;
+			}
+#else
+			logger->error("SO_REUSEPORT isn't supported on this platform.");
+			NativeSocketUtil::closeSocket(tempSocketFD);
+			continue;
+#endif
+		}
+
 		if (::bind(tempSocketFD, p->ai_addr, p->ai_addrlen) == -1) {
 			NativeSocketUtil::closeSocket(tempSocketFD);
 			logger->warn("Couldn't bind socket for {}. This could indicate connectivity problems for this IP version.",
@@ -639,6 +1103,18 @@ int NativeSocketUtil::setTCPNodelay(int socketFD) {
 	return ::setsockopt(socketFD, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
 }
 
+bool NativeSocketUtil::isConnectionAcceptError(int errorCode) {
+#ifdef _WIN32
+	return errorCode == WSAECONNRESET || errorCode == WSAEINTR;
+#else
+	// Linux also reports network errors pending on the new connection from accept(), which should be treated
+	// like EAGAIN; see accept(2)
+	return errorCode == ECONNABORTED || errorCode == EINTR || errorCode == EPROTO || errorCode == ENETDOWN
+	        || errorCode == ENOPROTOOPT || errorCode == EHOSTDOWN || errorCode == EHOSTUNREACH
+	        || errorCode == EOPNOTSUPP || errorCode == ENETUNREACH;
+#endif
+}
+
 void NativeSocket::nativeSocketInit() {
 #ifdef _WIN32
 	auto logger = spdlog::get("APG");
@@ -58,14 +58,20 @@ int SDLSocket::send() {
 
 	auto &buf = getBuffer();
 
+	const auto started = SocketStats::clock::now();
 	const auto sent = SDLNet_TCP_Send(internalSocket, buf.data(), size());
 
+	stats.addSendCall();
+
 	if (sent < static_cast<int32_t>(size())) {
 		logger->error("Send error: {}", SDLNet_GetError());
 		setError();
 		return 0;
 	}
 
+	stats.addBytesSent(static_cast<uint64_t>(sent));
+	stats.recordSendLatency(started);
+
 #ifndef APG_SOCKET_NO_AUTO_CLEAR
 	clear();
 #endif
@@ -73,27 +79,62 @@ int SDLSocket::send() {
 	return sent;
 }
 
-int SDLSocket::recv(uint32_t length) {
-	REQUIRE(length <= APG_RECV_BUFFER_SIZE, "Cannot recv() on a buffer size smaller than the max");
+int SDLSocket::sendv(const BufferView *views, uint32_t viewCount) {
+	if (hasError()) {
+		logger->warn("sendv() called on SDL socket in error state.");
+		return 0;
+	}
+
+	const auto started = SocketStats::clock::now();
+	int total = 0;
+
+	for (uint32_t i = 0; i < viewCount; ++i) {
+		if (views[i].empty()) {
+			continue;
+		}
+
+		const auto sent = SDLNet_TCP_Send(internalSocket, views[i].data, views[i].length);
+
+		stats.addSendCall();
+
+		if (sent < static_cast<int32_t>(views[i].length)) {
+			logger->error("Send error: {}", SDLNet_GetError());
+			setError();
+			return 0;
+		}
+
+		total += sent;
+	}
+
+	stats.addBytesSent(static_cast<uint64_t>(total));
+	stats.recordSendLatency(started);
+
+	return total;
+}
 
+int SDLSocket::recv(uint32_t length) {
 	if (hasError()) {
 		logger->warn("recv() called on SDL socket in error state.");
 		return 0;
 	}
 
-#ifndef APG_SOCKET_NO_AUTO_CLEAR
-	clear();
-#endif
+	discardReadData();
+
+	auto target = prepareWrite(length);
+	auto received = SDLNet_TCP_Recv(internalSocket, target, length);
 
-	auto received = SDLNet_TCP_Recv(internalSocket, recvBuffer.get(), length);
+	stats.addReceiveCall();
 
 	if (received <= 0) {
+		commitWrite(0u, length);
+
 		logger->error("Couldn't read data: {}", SDLNet_GetError());
 		setError();
 		return 0;
 	}
 
-	putBytes(recvBuffer.get(), received);
+	commitWrite(static_cast<uint32_t>(received), length);
+	stats.addBytesReceived(static_cast<uint64_t>(received));
 
 	return received;
 }
@@ -223,7 +264,7 @@ std::unique_ptr<Socket> SDLAcceptorSocket::acceptSocket(float maxWaitInSeconds)
 		}
 	}
 
-	return SDLSocket::fromRawSDLSocket(socket);
+	return trackAccepted(SDLSocket::fromRawSDLSocket(socket));
 }
 
 std::unique_ptr<Socket> SDLAcceptorSocket::acceptSocketOnce() {
@@ -233,7 +274,7 @@ std::unique_ptr<Socket> SDLAcceptorSocket::acceptSocketOnce() {
 		return nullptr;
 	}
 
-	return SDLSocket::fromRawSDLSocket(readSocket);
+	return trackAccepted(SDLSocket::fromRawSDLSocket(readSocket));
 }
 
 }
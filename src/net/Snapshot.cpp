@@ -0,0 +1,146 @@
+#include <cstdint>
+#include <cmath>
+
+#include <algorithm>
+#include <string>
+
+#include "APG/net/Snapshot.hpp"
+#include "APG/internal/Assert.hpp"
+
+namespace APG {
+
+uint32_t SnapshotSchema::addInteger(const std::string &name, uint32_t bits) {
+	REQUIRE(bits > 0u && bits <= 32u, "Snapshot integer fields must have between 1 and 32 bits.");
+
+	fields.push_back(Field { name, bits, false, 0.0f, 0.0f, 0.0f });
+	return static_cast<uint32_t>(fields.size() - 1u);
+}
+
+uint32_t SnapshotSchema::addBool(const std::string &name) {
+	return addInteger(name, 1u);
+}
+
+uint32_t SnapshotSchema::addFloat(const std::string &name, float minimum, float maximum, float precision) {
+	REQUIRE(maximum > minimum && precision > 0.0f, "Invalid range or precision for snapshot float field.");
+
+	const auto steps = std::ceil((maximum - minimum) / precision);
+	const auto bits = static_cast<uint32_t>(std::max(1.0, std::ceil(std::log2(steps + 1.0))));
+
+	REQUIRE(bits <= 32u, "Snapshot float field's range is too large for its precision.");
+
+	fields.push_back(Field { name, bits, true, minimum, maximum, precision });
+	return static_cast<uint32_t>(fields.size() - 1u);
+}
+
+uint32_t SnapshotSchema::quantise(uint32_t field, float value) const {
+	const auto &f = fields[field];
+
+	if (!f.quantisedFloat) {
+		return static_cast<uint32_t>(value);
+	}
+
+	const auto clamped = std::min(f.maximum, std::max(f.minimum, value));
+	return static_cast<uint32_t>(std::lround((clamped - f.minimum) / f.precision));
+}
+
+float SnapshotSchema::dequantise(uint32_t field, uint32_t value) const {
+	const auto &f = fields[field];
+
+	if (!f.quantisedFloat) {
+		return static_cast<float>(value);
+	}
+
+	return std::min(f.maximum, f.minimum + static_cast<float>(value) * f.precision);
+}
+
+Snapshot::Snapshot(const SnapshotSchema &schema) :
+		schema{&schema} {
+}
+
+void Snapshot::clear() {
+	entityIDs.clear();
+	values.clear();
+}
+
+void Snapshot::addEntity(uint32_t id) {
+	addEntityIndex(id);
+}
+
+void Snapshot::removeEntity(uint32_t id) {
+	const auto index = findEntity(id);
+
+	if (index < 0) {
+		return;
+	}
+
+	const auto fieldCount = schema->getFieldCount();
+	const auto first = values.begin() + static_cast<ptrdiff_t>(index) * fieldCount;
+
+	values.erase(first, first + fieldCount);
+	entityIDs.erase(entityIDs.begin() + index);
+}
+
+bool Snapshot::hasEntity(uint32_t id) const {
+	return findEntity(id) >= 0;
+}
+
+void Snapshot::setInteger(uint32_t id, uint32_t field, uint32_t value) {
+	const auto bits = schema->getField(field).bits;
+	const auto mask = (bits == 32u) ? 0xFFFFFFFFu : ((1u << bits) - 1u);
+
+	entityValues(addEntityIndex(id))[field] = value & mask;
+}
+
+void Snapshot::setBool(uint32_t id, uint32_t field, bool value) {
+	setInteger(id, field, value ? 1u : 0u);
+}
+
+void Snapshot::setFloat(uint32_t id, uint32_t field, float value) {
+	entityValues(addEntityIndex(id))[field] = schema->quantise(field, value);
+}
+
+uint32_t Snapshot::getInteger(uint32_t id, uint32_t field) const {
+	const auto index = findEntity(id);
+	return index < 0 ? 0u : entityValues(static_cast<uint32_t>(index))[field];
+}
+
+bool Snapshot::getBool(uint32_t id, uint32_t field) const {
+	return getInteger(id, field) != 0u;
+}
+
+float Snapshot::getFloat(uint32_t id, uint32_t field) const {
+	return schema->dequantise(field, getInteger(id, field));
+}
+
+int32_t Snapshot::findEntity(uint32_t id) const {
+	const auto found = std::lower_bound(entityIDs.begin(), entityIDs.end(), id);
+
+	if (found == entityIDs.end() || *found != id) {
+		return -1;
+	}
+
+	return static_cast<int32_t>(found - entityIDs.begin());
+}
+
+uint32_t Snapshot::addEntityIndex(uint32_t id) {
+	const auto fieldCount = schema->getFieldCount();
+
+	// fast path for entities added in ascending order
+	if (entityIDs.empty() || entityIDs.back() < id) {
+		entityIDs.push_back(id);
+		values.resize(values.size() + fieldCount, 0u);
+		return static_cast<uint32_t>(entityIDs.size() - 1u);
+	}
+
+	const auto found = std::lower_bound(entityIDs.begin(), entityIDs.end(), id);
+	const auto index = static_cast<uint32_t>(found - entityIDs.begin());
+
+	if (*found != id) {
+		entityIDs.insert(found, id);
+		values.insert(values.begin() + static_cast<ptrdiff_t>(index) * fieldCount, fieldCount, 0u);
+	}
+
+	return index;
+}
+
+}
@@ -0,0 +1,396 @@
+#include <cstdint>
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "APG/net/SnapshotReplication.hpp"
+#include "APG/net/BitStream.hpp"
+#include "APG/internal/Assert.hpp"
+
+namespace APG {
+
+namespace {
+
+enum class RecordType : uint32_t {
+	CHANGED = 0u,
+	ADDED = 1u,
+	REMOVED = 2u
+};
+
+constexpr const uint32_t RECORD_TYPE_BITS = 2u;
+
+// changes to fields wider than this which fit in SMALL_DELTA_BITS are sent as a zigzagged difference
+constexpr const uint32_t SMALL_DELTA_BITS = 5u;
+constexpr const uint32_t SMALL_DELTA_MIN_FIELD_BITS = SMALL_DELTA_BITS + 2u;
+constexpr const int64_t SMALL_DELTA_MIN = -(1 << (SMALL_DELTA_BITS - 1u));
+constexpr const int64_t SMALL_DELTA_MAX = (1 << (SMALL_DELTA_BITS - 1u)) - 1;
+
+uint32_t fieldMask(uint32_t bits) {
+	return (bits == 32u) ? 0xFFFFFFFFu : ((1u << bits) - 1u);
+}
+
+/**
+ * Writes each field which differs from its reference value. New entities use a reference of all zeros.
+ */
+void writeFields(BitWriter &writer, const SnapshotSchema &schema, const uint32_t *values, const uint32_t *reference) {
+	for (uint32_t field = 0u; field < schema.getFieldCount(); ++field) {
+		const auto value = values[field];
+		const auto previous = (reference == nullptr) ? 0u : reference[field];
+
+		if (value == previous) {
+			writer.writeBool(false);
+			continue;
+		}
+
+		writer.writeBool(true);
+
+		const auto bits = schema.getField(field).bits;
+
+		if (bits >= SMALL_DELTA_MIN_FIELD_BITS) {
+			const auto difference = static_cast<int64_t>(value) - static_cast<int64_t>(previous);
+			const bool small = (difference >= SMALL_DELTA_MIN && difference <= SMALL_DELTA_MAX);
+
+			writer.writeBool(small);
+
+			if (small) {
+				writer.writeBits(zigzagEncode(static_cast<int32_t>(difference)), SMALL_DELTA_BITS);
+				continue;
+			}
+		}
+
+		writer.writeBits(value, bits);
+	}
+}
+
+bool readFields(BitReader &reader, const SnapshotSchema &schema, uint32_t *values, const uint32_t *reference) {
+	for (uint32_t field = 0u; field < schema.getFieldCount(); ++field) {
+		const auto previous = (reference == nullptr) ? 0u : reference[field];
+
+		bool changed = false;
+		if (!reader.readBool(changed)) {
+			return false;
+		}
+
+		if (!changed) {
+			values[field] = previous;
+			continue;
+		}
+
+		const auto bits = schema.getField(field).bits;
+
+		if (bits >= SMALL_DELTA_MIN_FIELD_BITS) {
+			bool small = false;
+			if (!reader.readBool(small)) {
+				return false;
+			}
+
+			if (small) {
+				uint32_t difference = 0u;
+				if (!reader.readBits(difference, SMALL_DELTA_BITS)) {
+					return false;
+				}
+
+				values[field] = static_cast<uint32_t>(previous + zigzagDecode(difference)) & fieldMask(bits);
+				continue;
+			}
+		}
+
+		if (!reader.readBits(values[field], bits)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void writeRecordHeader(BitWriter &writer, uint32_t id, uint32_t &nextID, RecordType type) {
+	writer.writeBool(true);
+	writer.writeVarUInt(id - nextID);
+	writer.writeBits(static_cast<uint32_t>(type), RECORD_TYPE_BITS);
+
+	nextID = id + 1u;
+}
+
+}
+
+constexpr const uint32_t SnapshotEncoder::DEFAULT_HISTORY_SIZE;
+
+SnapshotEncoder::SnapshotEncoder(const SnapshotSchema &schema, uint32_t historySize) :
+		schema(schema),
+		history(std::max(1u, historySize), Snapshot(schema)),
+		historyValid(std::max(1u, historySize), 0u) {
+}
+
+void SnapshotEncoder::commit(const Snapshot &snapshot) {
+	REQUIRE(!hasLatest || snapshot.getTick() > latestTick, "Snapshot ticks must increase with each commit.");
+
+	const auto slot = snapshot.getTick() % history.size();
+
+	// assignment reuses the slot's storage
+	history[slot] = snapshot;
+	historyValid[slot] = 1u;
+
+	hasLatest = true;
+	latestTick = snapshot.getTick();
+}
+
+void SnapshotEncoder::acknowledge(uint32_t clientID, uint32_t tick) {
+	if (findSnapshot(tick) == nullptr) {
+		return;
+	}
+
+	auto &client = clients[clientID];
+
+	if (!client.hasBaseline || tick > client.baselineTick) {
+		client.hasBaseline = true;
+		client.baselineTick = tick;
+	}
+}
+
+void SnapshotEncoder::removeClient(uint32_t clientID) {
+	clients.erase(clientID);
+}
+
+uint32_t SnapshotEncoder::encode(uint32_t clientID, ByteBuffer &out) {
+	REQUIRE(hasLatest, "A snapshot must be committed before encoding.");
+
+	const auto startSize = out.size();
+
+	const auto &current = *findSnapshot(latestTick);
+	const Snapshot *baseline = nullptr;
+
+	const auto client = clients.find(clientID);
+
+	if (client != clients.end() && client->second.hasBaseline) {
+		baseline = findSnapshot(client->second.baselineTick);
+	}
+
+	{
+		BitWriter writer(out);
+
+		writer.writeBits(latestTick, 32u);
+		writer.writeBool(baseline != nullptr);
+
+		if (baseline != nullptr) {
+			writer.writeVarUInt(latestTick - baseline->getTick());
+		}
+
+		uint32_t nextID = 0u;
+		uint32_t c = 0u;
+		uint32_t b = 0u;
+
+		const auto currentCount = current.getEntityCount();
+		const auto baselineCount = (baseline == nullptr) ? 0u : baseline->getEntityCount();
+
+		while (c < currentCount || b < baselineCount) {
+			const bool haveCurrent = c < currentCount;
+			const bool haveBaseline = b < baselineCount;
+
+			if (haveCurrent && (!haveBaseline || current.entityIDs[c] < baseline->entityIDs[b])) {
+				writeRecordHeader(writer, current.entityIDs[c], nextID, RecordType::ADDED);
+				writeFields(writer, schema, current.entityValues(c), nullptr);
+				++c;
+			} else if (!haveCurrent || baseline->entityIDs[b] < current.entityIDs[c]) {
+				writeRecordHeader(writer, baseline->entityIDs[b], nextID, RecordType::REMOVED);
+				++b;
+			} else {
+				const auto values = current.entityValues(c);
+				const auto reference = baseline->entityValues(b);
+
+				if (!std::equal(values, values + schema.getFieldCount(), reference)) {
+					writeRecordHeader(writer, current.entityIDs[c], nextID, RecordType::CHANGED);
+					writeFields(writer, schema, values, reference);
+				}
+
+				++c;
+				++b;
+			}
+		}
+
+		writer.writeBool(false);
+	}
+
+	if (baseline == nullptr) {
+		++fullSnapshots;
+	} else {
+		++deltaSnapshots;
+	}
+
+	const auto written = out.size() - startSize;
+	bytesEncoded += written;
+
+	return written;
+}
+
+const Snapshot *SnapshotEncoder::findSnapshot(uint32_t tick) const {
+	const auto slot = tick % history.size();
+
+	if (historyValid[slot] == 0u || history[slot].getTick() != tick) {
+		return nullptr;
+	}
+
+	return &history[slot];
+}
+
+SnapshotDecoder::SnapshotDecoder(const SnapshotSchema &schema, uint32_t historySize) :
+		schema(schema),
+		history(std::max(1u, historySize), Snapshot(schema)),
+		historyValid(std::max(1u, historySize), 0u),
+		scratch(schema),
+		logger{spdlog::get("APG")} {
+}
+
+bool SnapshotDecoder::decode(const BufferView &data) {
+	BitReader reader(data);
+
+	uint32_t tick = 0u;
+	bool hasBaseline = false;
+
+	if (!reader.readBits(tick, 32u) || !reader.readBool(hasBaseline)) {
+		logger->trace("Truncated snapshot header.");
+		return false;
+	}
+
+	if (hasLatest && tick <= latestTick) {
+		return false;
+	}
+
+	const Snapshot *baseline = nullptr;
+
+	if (hasBaseline) {
+		uint32_t distance = 0u;
+
+		if (!reader.readVarUInt(distance)) {
+			return false;
+		}
+
+		baseline = findSnapshot(tick - distance);
+
+		if (baseline == nullptr) {
+			logger->trace("Snapshot {} is a delta against {} which is no longer held.", tick, tick - distance);
+			return false;
+		}
+	}
+
+	scratch.clear();
+	scratch.setTick(tick);
+
+	const auto fieldCount = schema.getFieldCount();
+	const auto baselineCount = (baseline == nullptr) ? 0u : baseline->getEntityCount();
+
+	uint32_t b = 0u;
+	uint32_t nextID = 0u;
+
+	const auto copyBaselineUntil = [&](uint32_t id) {
+		while (b < baselineCount && baseline->entityIDs[b] < id) {
+			const auto values = baseline->entityValues(b);
+
+			scratch.entityIDs.push_back(baseline->entityIDs[b]);
+			scratch.values.insert(scratch.values.end(), values, values + fieldCount);
+			++b;
+		}
+	};
+
+	while (true) {
+		bool more = false;
+		if (!reader.readBool(more)) {
+			return false;
+		}
+
+		if (!more) {
+			break;
+		}
+
+		uint32_t gap = 0u;
+		uint32_t type = 0u;
+
+		if (!reader.readVarUInt(gap) || !reader.readBits(type, RECORD_TYPE_BITS)) {
+			return false;
+		}
+
+		const auto id = nextID + gap;
+		nextID = id + 1u;
+
+		copyBaselineUntil(id);
+
+		const bool inBaseline = (b < baselineCount && baseline->entityIDs[b] == id);
+
+		switch (static_cast<RecordType>(type)) {
+		case RecordType::REMOVED:
+		case RecordType::ADDED:
+			if (inBaseline) {
+				++b;
+			}
+
+			if (static_cast<RecordType>(type) == RecordType::REMOVED) {
+				break;
+			}
+
+			scratch.entityIDs.push_back(id);
+			scratch.values.resize(scratch.values.size() + fieldCount, 0u);
+
+			if (!readFields(reader, schema, scratch.entityValues(scratch.getEntityCount() - 1u), nullptr)) {
+				return false;
+			}
+
+			break;
+
+		case RecordType::CHANGED:
+			if (!inBaseline) {
+				logger->trace("Snapshot {} changes entity {} which isn't in its baseline.", tick, id);
+				return false;
+			}
+
+			scratch.entityIDs.push_back(id);
+			scratch.values.resize(scratch.values.size() + fieldCount, 0u);
+
+			if (!readFields(reader, schema, scratch.entityValues(scratch.getEntityCount() - 1u),
+			        baseline->entityValues(b))) {
+				return false;
+			}
+
+			++b;
+			break;
+
+		default:
+			return false;
+		}
+	}
+
+	copyBaselineUntil(0xFFFFFFFFu);
+
+	if (b < baselineCount) {
+		// an entity with the largest possible ID
+		scratch.entityIDs.push_back(baseline->entityIDs[b]);
+		scratch.values.insert(scratch.values.end(), baseline->entityValues(b), baseline->entityValues(b) + fieldCount);
+	}
+
+	// swapping keeps the displaced snapshot's storage for the next decode
+	const auto slot = tick % history.size();
+	std::swap(history[slot], scratch);
+	historyValid[slot] = 1u;
+
+	hasLatest = true;
+	latestTick = tick;
+
+	return true;
+}
+
+const Snapshot &SnapshotDecoder::getLatest() const {
+	REQUIRE(hasLatest, "No snapshot has been decoded yet.");
+
+	return *findSnapshot(latestTick);
+}
+
+const Snapshot *SnapshotDecoder::findSnapshot(uint32_t tick) const {
+	const auto slot = tick % history.size();
+
+	if (historyValid[slot] == 0u || history[slot].getTick() != tick) {
+		return nullptr;
+	}
+
+	return &history[slot];
+}
+
+}
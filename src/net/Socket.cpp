@@ -26,6 +26,9 @@
  */
 #include <cstdint>
 
+#include <memory>
+#include <utility>
+
 #include "APG/APGNet.hpp"
 
 namespace APG {
@@ -54,17 +57,55 @@ void SocketCommon::clearError() {
 Socket::Socket(const std::string &remoteHost_, uint16_t port_, uint32_t bufferSize_) :
 		        SocketCommon(bufferSize_),
 		        port { port_ },
-		        remoteHost { remoteHost_ },
-		        recvBuffer { std::make_unique<uint8_t[]>(APG_RECV_BUFFER_SIZE) } {
+		        remoteHost { remoteHost_ } {
+}
+
+Socket::~Socket() {
+	setStatsGroup(nullptr);
+}
+
+void Socket::setStatsGroup(std::shared_ptr<SocketStatsGroup> group) {
+	if (statsGroup != nullptr) {
+		statsGroup->detach(&stats);
+	}
+
+	statsGroup = std::move(group);
+
+	if (statsGroup != nullptr) {
+		statsGroup->attach(&stats);
+	}
+}
+
+void Socket::discardReadData() {
+#ifndef APG_SOCKET_NO_AUTO_CLEAR
+	if (getReadPos() >= size()) {
+		clear();
+	} else if (getReadPos() > size() / 2u) {
+		compact();
+	}
+#endif
 }
 
 AcceptorSocket::AcceptorSocket(uint16_t port_, uint32_t bufferSize_) :
 		        SocketCommon(bufferSize_),
-		        port { port_ } {
+		        port { port_ },
+		        statsGroup { std::make_shared<SocketStatsGroup>() } {
 }
 
 void AcceptorSocket::connect() {
 	listen();
 }
 
+void AcceptorSocket::setStatsGroup(std::shared_ptr<SocketStatsGroup> group) {
+	statsGroup = std::move(group);
+}
+
+std::unique_ptr<Socket> AcceptorSocket::trackAccepted(std::unique_ptr<Socket> socket) {
+	if (socket != nullptr && statsGroup != nullptr) {
+		socket->setStatsGroup(statsGroup);
+	}
+
+	return socket;
+}
+
 }
@@ -0,0 +1,259 @@
+#include <cstdint>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <utility>
+
+#include "APG/net/SocketStats.hpp"
+
+namespace APG {
+
+constexpr const uint32_t SocketStats::LATENCY_BUCKET_COUNT;
+constexpr const uint32_t SocketStats::MAX_QUEUED_SENDS;
+
+namespace {
+
+uint32_t getLatencyBucket(uint64_t microseconds) {
+	uint32_t bucket = 0u;
+
+	while (microseconds != 0u && bucket < SocketStats::LATENCY_BUCKET_COUNT - 1u) {
+		microseconds >>= 1u;
+		++bucket;
+	}
+
+	return bucket;
+}
+
+}
+
+void SocketStats::Snapshot::merge(const Snapshot &other) {
+	connections += other.connections;
+	bytesSent += other.bytesSent;
+	bytesReceived += other.bytesReceived;
+	messagesSent += other.messagesSent;
+	messagesReceived += other.messagesReceived;
+	sendCalls += other.sendCalls;
+	receiveCalls += other.receiveCalls;
+	partialSends += other.partialSends;
+	wouldBlocks += other.wouldBlocks;
+	sendQueueDepth += other.sendQueueDepth;
+	maxSendQueueDepth = std::max(maxSendQueueDepth, other.maxSendQueueDepth);
+
+	for (uint32_t i = 0u; i < LATENCY_BUCKET_COUNT; ++i) {
+		sendLatency[i] += other.sendLatency[i];
+	}
+}
+
+uint64_t SocketStats::Snapshot::getSendLatencyCount() const {
+	uint64_t count = 0u;
+
+	for (const auto bucket : sendLatency) {
+		count += bucket;
+	}
+
+	return count;
+}
+
+uint64_t SocketStats::Snapshot::getSendLatencyPercentile(double percentile) const {
+	const auto count = getSendLatencyCount();
+
+	if (count == 0u) {
+		return 0u;
+	}
+
+	const auto clamped = std::min(100.0, std::max(0.0, percentile));
+	const auto rank = std::max<uint64_t>(1u, static_cast<uint64_t>(clamped / 100.0 * static_cast<double>(count) + 0.5));
+
+	uint64_t seen = 0u;
+
+	for (uint32_t i = 0u; i < LATENCY_BUCKET_COUNT; ++i) {
+		seen += sendLatency[i];
+
+		if (seen >= rank) {
+			return uint64_t { 1u } << i;
+		}
+	}
+
+	return uint64_t { 1u } << (LATENCY_BUCKET_COUNT - 1u);
+}
+
+std::string SocketStats::Snapshot::toString() const {
+	std::ostringstream ss;
+
+	ss << "connections=" << connections
+	        << " bytesSent=" << bytesSent
+	        << " bytesReceived=" << bytesReceived
+	        << " messagesSent=" << messagesSent
+	        << " messagesReceived=" << messagesReceived
+	        << " sendCalls=" << sendCalls
+	        << " receiveCalls=" << receiveCalls
+	        << " partialSends=" << partialSends
+	        << " wouldBlocks=" << wouldBlocks
+	        << " sendQueueDepth=" << sendQueueDepth
+	        << " maxSendQueueDepth=" << maxSendQueueDepth
+	        << " sends=" << getSendLatencyCount()
+	        << " sendLatencyP50us=" << getSendLatencyPercentile(50.0)
+	        << " sendLatencyP99us=" << getSendLatencyPercentile(99.0)
+	        << " sendLatencyP999us=" << getSendLatencyPercentile(99.9);
+
+	return ss.str();
+}
+
+void SocketStats::Snapshot::log(spdlog::logger &logger, const std::string &label) const {
+	logger.info("{}: {}", label, toString());
+}
+
+bool SocketStats::Snapshot::appendToFile(const std::string &path, const std::string &label) const {
+	std::ofstream out(path, std::ios::out | std::ios::app);
+
+	if (!out) {
+		return false;
+	}
+
+	const auto now = std::chrono::duration_cast<std::chrono::milliseconds>(
+	        std::chrono::system_clock::now().time_since_epoch()).count();
+
+	out << now << ' ' << label << ' ' << toString() << '\n';
+
+	return static_cast<bool>(out.flush());
+}
+
+SocketStats::SocketStats() {
+	for (auto &bucket : sendLatency) {
+		bucket.store(0u, std::memory_order_relaxed);
+	}
+}
+
+SocketStats::Snapshot SocketStats::snapshot() const {
+	Snapshot snapshot;
+
+	snapshot.connections = 1u;
+	snapshot.bytesSent = bytesSent.load(std::memory_order_relaxed);
+	snapshot.bytesReceived = bytesReceived.load(std::memory_order_relaxed);
+	snapshot.messagesSent = messagesSent.load(std::memory_order_relaxed);
+	snapshot.messagesReceived = messagesReceived.load(std::memory_order_relaxed);
+	snapshot.sendCalls = sendCalls.load(std::memory_order_relaxed);
+	snapshot.receiveCalls = receiveCalls.load(std::memory_order_relaxed);
+	snapshot.partialSends = partialSends.load(std::memory_order_relaxed);
+	snapshot.wouldBlocks = wouldBlocks.load(std::memory_order_relaxed);
+	snapshot.sendQueueDepth = sendQueueDepth.load(std::memory_order_relaxed);
+	snapshot.maxSendQueueDepth = maxSendQueueDepth.load(std::memory_order_relaxed);
+
+	for (uint32_t i = 0u; i < LATENCY_BUCKET_COUNT; ++i) {
+		snapshot.sendLatency[i] = sendLatency[i].load(std::memory_order_relaxed);
+	}
+
+	return snapshot;
+}
+
+void SocketStats::reset() {
+	for (auto counter : {&bytesSent, &bytesReceived, &messagesSent, &messagesReceived, &sendCalls, &receiveCalls,
+	        &partialSends, &wouldBlocks}) {
+		counter->store(0u, std::memory_order_relaxed);
+	}
+
+	for (auto &bucket : sendLatency) {
+		bucket.store(0u, std::memory_order_relaxed);
+	}
+
+	// the queue is still there, so its depth and anything waiting in it are kept
+	maxSendQueueDepth.store(sendQueueDepth.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+void SocketStats::setSendQueueDepth(uint64_t depth) {
+	sendQueueDepth.store(depth, std::memory_order_relaxed);
+
+	if (depth > maxSendQueueDepth.load(std::memory_order_relaxed)) {
+		maxSendQueueDepth.store(depth, std::memory_order_relaxed);
+	}
+}
+
+void SocketStats::recordSendLatency(clock::time_point started, clock::time_point finished) {
+	const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(finished - started).count();
+
+	add(sendLatency[getLatencyBucket(elapsed > 0 ? static_cast<uint64_t>(elapsed) : 0u)], 1u);
+}
+
+void SocketStats::markQueued(uint32_t length, clock::time_point started) {
+	if (length == 0u) {
+		return;
+	}
+
+	queuedTotal += length;
+
+	// the bytes still count towards the totals, so later sends are matched to the right offsets
+	if (queuedSendsCount == MAX_QUEUED_SENDS) {
+		return;
+	}
+
+	queuedSends[(queuedSendsStart + queuedSendsCount) % MAX_QUEUED_SENDS] = std::make_pair(queuedTotal, started);
+	++queuedSendsCount;
+}
+
+void SocketStats::markDequeued(uint32_t length) {
+	dequeuedTotal += length;
+
+	if (queuedSendsCount == 0u) {
+		return;
+	}
+
+	const auto now = clock::now();
+
+	while (queuedSendsCount != 0u && queuedSends[queuedSendsStart].first <= dequeuedTotal) {
+		recordSendLatency(queuedSends[queuedSendsStart].second, now);
+
+		queuedSendsStart = (queuedSendsStart + 1u) % MAX_QUEUED_SENDS;
+		--queuedSendsCount;
+	}
+}
+
+void SocketStats::discardQueued() {
+	queuedSendsStart = 0u;
+	queuedSendsCount = 0u;
+	dequeuedTotal = queuedTotal;
+}
+
+void SocketStatsGroup::attach(const SocketStats *stats) {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (attached.insert(stats).second) {
+		++totalConnections;
+	}
+}
+
+void SocketStatsGroup::detach(const SocketStats *stats) {
+	auto closed = stats->snapshot();
+
+	// a closed socket no longer counts as a connection or has anything queued
+	closed.connections = 0u;
+	closed.sendQueueDepth = 0u;
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (attached.erase(stats) != 0u) {
+		detached.merge(closed);
+	}
+}
+
+SocketStats::Snapshot SocketStatsGroup::snapshot() const {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	auto total = detached;
+
+	for (const auto stats : attached) {
+		total.merge(stats->snapshot());
+	}
+
+	return total;
+}
+
+uint64_t SocketStatsGroup::getTotalConnections() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return totalConnections;
+}
+
+}
@@ -0,0 +1,382 @@
+#include <cstdint>
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <utility>
+
+#include "APG/net/TimingWheel.hpp"
+#include "APG/internal/Assert.hpp"
+
+namespace APG {
+
+constexpr const TimingWheel::timer_id TimingWheel::INVALID_TIMER;
+constexpr const uint32_t TimingWheel::NONE;
+constexpr const uint32_t TimingWheel::NEAR_BITS;
+constexpr const uint32_t TimingWheel::NEAR_SLOTS;
+constexpr const uint32_t TimingWheel::FAR_BITS;
+constexpr const uint32_t TimingWheel::FAR_SLOTS;
+constexpr const uint32_t TimingWheel::FAR_LEVELS;
+constexpr const uint32_t TimingWheel::SLOT_COUNT;
+constexpr const uint32_t TimingWheel::FIRING_SLOT;
+
+namespace {
+
+constexpr uint32_t levelShift(uint32_t level) {
+	return 8u + 6u * level;
+}
+
+}
+
+TimingWheel::TimingWheel(std::chrono::milliseconds tickLength, clock::time_point start) :
+		tickLength{tickLength},
+		start{start} {
+	REQUIRE(tickLength.count() > 0, "Timing wheel ticks must be at least a millisecond long.");
+
+	slotHeads.fill(NONE);
+	slotTails.fill(NONE);
+	levelCounts.fill(0u);
+}
+
+TimingWheel::timer_id TimingWheel::schedule(std::chrono::milliseconds delay, timer_callback callback) {
+	return scheduleAt(clock::now() + delay, std::move(callback));
+}
+
+TimingWheel::timer_id TimingWheel::scheduleAt(clock::time_point deadline, timer_callback callback) {
+	const auto index = allocateNode();
+	auto &node = nodes[index];
+
+	// the current tick has already been processed, so a timer which is already due fires in the next one
+	node.expiry = std::max(toTickRoundingUp(deadline), currentTick + 1u);
+	node.callback = std::move(callback);
+
+	if (nextEventValid) {
+		nextEvent = std::min(nextEvent, node.expiry);
+	}
+
+	place(index);
+
+	return makeID(index);
+}
+
+bool TimingWheel::cancel(timer_id id) {
+	const auto index = findNode(id);
+
+	if (index == NONE) {
+		return false;
+	}
+
+	unlink(index);
+	freeNode(index);
+
+	return true;
+}
+
+bool TimingWheel::isScheduled(timer_id id) const {
+	return findNode(id) != NONE;
+}
+
+uint32_t TimingWheel::advance(clock::time_point now) {
+	// a callback which ends up advancing the wheel again would clobber the batch being fired
+	if (advancing) {
+		return 0u;
+	}
+
+	advancing = true;
+
+	const auto target = toTickRoundingDown(now);
+
+	uint32_t fired = 0u;
+
+	while (currentTick < target) {
+		// nothing to cascade or fire, so skip straight there
+		if (timerCount == 0u) {
+			currentTick = target;
+			break;
+		}
+
+		// if the near level is empty nothing happens until the next cascade, and if the far levels above it are
+		// empty too, nothing happens until the next cascade into them
+		if (levelCounts[0] == 0u) {
+			uint32_t emptyLevels = 1u;
+
+			while (emptyLevels < FAR_LEVELS && levelCounts[emptyLevels] == 0u) {
+				++emptyLevels;
+			}
+
+			const auto shift = levelShift(emptyLevels - 1u);
+			const auto nextEvent = ((currentTick >> shift) + 1u) << shift;
+
+			if (nextEvent > target) {
+				currentTick = target;
+				break;
+			}
+
+			currentTick = nextEvent - 1u;
+		}
+
+		const auto tick = ++currentTick;
+
+		// each level is cascaded as the one below it wraps around, before the timers for this tick are fired
+		for (uint32_t level = 0u; level < FAR_LEVELS; ++level) {
+			if ((tick & ((uint64_t { 1u } << levelShift(level)) - 1u)) != 0u) {
+				break;
+			}
+
+			cascade(level, static_cast<uint32_t>((tick >> levelShift(level)) & (FAR_SLOTS - 1u)));
+		}
+
+		fired += fireSlot(static_cast<uint32_t>(tick & (NEAR_SLOTS - 1u)));
+	}
+
+	advancing = false;
+
+	return fired;
+}
+
+int TimingWheel::getMillisecondsUntilNextTimer(clock::time_point now) {
+	if (timerCount == 0u) {
+		return -1;
+	}
+
+	// cancelling timers can only make the cached event earlier than it needs to be, which is harmless, but once it
+	// has passed it has to be found again
+	if (!nextEventValid || nextEvent <= currentTick) {
+		nextEvent = findNextEvent();
+		nextEventValid = true;
+	}
+
+	const auto deadline = start + nextEvent * std::chrono::duration_cast<clock::duration>(tickLength);
+
+	if (deadline <= now) {
+		return 0;
+	}
+
+	const auto remaining = std::chrono::duration_cast<std::chrono::microseconds>(deadline - now).count();
+	const auto milliseconds = (remaining + 999) / 1000;
+
+	return static_cast<int>(std::min<int64_t>(milliseconds, std::numeric_limits<int>::max()));
+}
+
+uint64_t TimingWheel::toTickRoundingUp(clock::time_point time) const {
+	if (time <= start) {
+		return 0u;
+	}
+
+	const auto elapsed = (time - start).count();
+	const auto tick = std::chrono::duration_cast<clock::duration>(tickLength).count();
+
+	return static_cast<uint64_t>((elapsed + tick - 1) / tick);
+}
+
+uint64_t TimingWheel::toTickRoundingDown(clock::time_point time) const {
+	if (time <= start) {
+		return 0u;
+	}
+
+	return static_cast<uint64_t>((time - start).count()
+	        / std::chrono::duration_cast<clock::duration>(tickLength).count());
+}
+
+uint32_t TimingWheel::allocateNode() {
+	uint32_t index;
+
+	if (freeList != NONE) {
+		index = freeList;
+		freeList = nodes[index].next;
+	} else {
+		REQUIRE(nodes.size() < NONE, "Too many timers in timing wheel.");
+
+		index = static_cast<uint32_t>(nodes.size());
+		nodes.emplace_back();
+	}
+
+	nodes[index].prev = nodes[index].next = NONE;
+	++timerCount;
+
+	return index;
+}
+
+void TimingWheel::freeNode(uint32_t index) {
+	auto &node = nodes[index];
+
+	node.callback = nullptr;
+	node.slot = NONE;
+
+	if (++node.generation == 0u) {
+		node.generation = 1u;
+	}
+
+	node.prev = NONE;
+	node.next = freeList;
+	freeList = index;
+
+	--timerCount;
+}
+
+void TimingWheel::link(uint32_t index, uint32_t slot) {
+	auto &node = nodes[index];
+
+	node.slot = slot;
+	node.next = NONE;
+
+	if (slot != FIRING_SLOT) {
+		++levelCounts[getLevel(slot)];
+	}
+	node.prev = slotTails[slot];
+
+	if (slotTails[slot] != NONE) {
+		nodes[slotTails[slot]].next = index;
+	} else {
+		slotHeads[slot] = index;
+	}
+
+	slotTails[slot] = index;
+}
+
+void TimingWheel::unlink(uint32_t index) {
+	auto &node = nodes[index];
+	const auto slot = node.slot;
+
+	if (slot != FIRING_SLOT) {
+		--levelCounts[getLevel(slot)];
+	}
+
+	if (node.prev != NONE) {
+		nodes[node.prev].next = node.next;
+	} else {
+		slotHeads[slot] = node.next;
+	}
+
+	if (node.next != NONE) {
+		nodes[node.next].prev = node.prev;
+	} else {
+		slotTails[slot] = node.prev;
+	}
+
+	node.prev = node.next = NONE;
+}
+
+void TimingWheel::place(uint32_t index) {
+	const auto expiry = nodes[index].expiry;
+	const auto delta = expiry - currentTick;
+
+	if (delta < NEAR_SLOTS) {
+		link(index, static_cast<uint32_t>(expiry & (NEAR_SLOTS - 1u)));
+		return;
+	}
+
+	for (uint32_t level = 0u; level < FAR_LEVELS; ++level) {
+		const auto shift = levelShift(level);
+
+		if (delta < (uint64_t { 1u } << (shift + FAR_BITS))) {
+			link(index, NEAR_SLOTS + level * FAR_SLOTS + static_cast<uint32_t>((expiry >> shift) & (FAR_SLOTS - 1u)));
+			return;
+		}
+	}
+
+	// beyond the wheel's range; parked in the furthest slot and placed again each time it's cascaded
+	const auto lastLevel = FAR_LEVELS - 1u;
+	const auto parked = currentTick + (uint64_t { 1u } << (levelShift(lastLevel) + FAR_BITS)) - 1u;
+
+	link(index, NEAR_SLOTS + lastLevel * FAR_SLOTS
+	        + static_cast<uint32_t>((parked >> levelShift(lastLevel)) & (FAR_SLOTS - 1u)));
+}
+
+void TimingWheel::cascade(uint32_t level, uint32_t slotInLevel) {
+	const auto slot = NEAR_SLOTS + level * FAR_SLOTS + slotInLevel;
+
+	auto index = slotHeads[slot];
+	slotHeads[slot] = slotTails[slot] = NONE;
+
+	while (index != NONE) {
+		const auto next = nodes[index].next;
+
+		--levelCounts[level + 1u];
+		place(index);
+
+		index = next;
+	}
+}
+
+uint32_t TimingWheel::fireSlot(uint32_t slot) {
+	if (slotHeads[slot] == NONE) {
+		return 0u;
+	}
+
+	// the whole batch is moved aside first, so timers scheduled by callbacks can't end up in it
+	slotHeads[FIRING_SLOT] = slotHeads[slot];
+	slotTails[FIRING_SLOT] = slotTails[slot];
+	slotHeads[slot] = slotTails[slot] = NONE;
+
+	for (auto index = slotHeads[FIRING_SLOT]; index != NONE; index = nodes[index].next) {
+		nodes[index].slot = FIRING_SLOT;
+		--levelCounts[0];
+	}
+
+	nextEventValid = false;
+
+	uint32_t fired = 0u;
+
+	while (slotHeads[FIRING_SLOT] != NONE) {
+		const auto index = slotHeads[FIRING_SLOT];
+
+		auto callback = std::move(nodes[index].callback);
+
+		unlink(index);
+		freeNode(index);
+
+		callback();
+		++fired;
+	}
+
+	return fired;
+}
+
+uint64_t TimingWheel::findNextEvent() const {
+	auto earliest = std::numeric_limits<uint64_t>::max();
+
+	// slots in the near level each hold a single tick, so the first one used holds the earliest near timer
+	for (uint64_t tick = currentTick + 1u; tick <= currentTick + NEAR_SLOTS; ++tick) {
+		if (slotHeads[tick & (NEAR_SLOTS - 1u)] != NONE) {
+			earliest = tick;
+			break;
+		}
+	}
+
+	// far slots are in time order starting after the current one; rather than search the first one used in each
+	// level for its earliest timer, wake up when it's cascaded and look again then
+	for (uint32_t level = 0u; level < FAR_LEVELS; ++level) {
+		const auto shift = levelShift(level);
+		const auto block = currentTick >> shift;
+
+		for (uint64_t offset = 1u; offset <= FAR_SLOTS; ++offset) {
+			const auto slot = NEAR_SLOTS + level * FAR_SLOTS + static_cast<uint32_t>((block + offset) & (FAR_SLOTS - 1u));
+
+			if (slotHeads[slot] != NONE) {
+				earliest = std::min(earliest, (block + offset) << shift);
+				break;
+			}
+		}
+	}
+
+	return earliest;
+}
+
+uint32_t TimingWheel::findNode(timer_id id) const {
+	const auto index = static_cast<uint32_t>(id & 0xFFFFFFFFu);
+
+	if (index >= nodes.size()) {
+		return NONE;
+	}
+
+	const auto &node = nodes[index];
+
+	if (node.slot == NONE || node.generation != static_cast<uint32_t>(id >> 32u)) {
+		return NONE;
+	}
+
+	return index;
+}
+
+}
@@ -0,0 +1,1136 @@
+#ifndef APG_NO_NATIVE
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "APG/net/UDPEndpoint.hpp"
+#include "APG/net/NativeSocket.hpp"
+
+namespace APG {
+
+namespace {
+
+enum class PacketType : uint8_t {
+	CONNECT_REQUEST = 0,
+	CONNECT_ACCEPT = 1,
+	DISCONNECT = 2,
+	DATA = 3
+};
+
+// 'APGU'; packets which don't start with this are ignored
+constexpr const uint32_t PROTOCOL_ID = 0x55475041u;
+
+// connection requests are padded so that replying to a spoofed request doesn't amplify traffic
+constexpr const uint32_t CONNECT_REQUEST_SIZE = 64u;
+
+constexpr const uint32_t MESSAGE_HEADER_SIZE = 6u;
+constexpr const uint32_t FRAGMENT_HEADER_SIZE = 4u;
+
+constexpr const uint8_t MESSAGE_FLAG_FRAGMENTED = 1u << 0u;
+
+// reliable messages more than this far ahead of the oldest unacknowledged message on their channel aren't sent,
+// so the receiver's duplicate detection window can't be overrun
+constexpr const uint16_t RELIABLE_WINDOW = 512u;
+
+// limits on what each connection can make us hold for incomplete or out of order messages. A well behaved peer
+// only reaches them by sending far more large reliable messages than it can get acknowledged
+constexpr const uint32_t MAX_REASSEMBLIES = 64u;
+constexpr const uint32_t MAX_BUFFERED_BYTES = 32u * UDPEndpoint::MAX_MESSAGE_SIZE;
+
+// limits how much a single update can send to one connection when resending a large backlog
+constexpr const uint32_t MAX_RELIABLE_PACKETS_PER_UPDATE = 64u;
+
+constexpr const uint32_t DISCONNECT_REDUNDANCY = 3u;
+
+using seconds = std::chrono::duration<float>;
+
+constexpr const float CONNECT_TIMEOUT = 5.0f;
+constexpr const float CONNECT_RESEND_INTERVAL = 0.1f;
+constexpr const float CONNECTION_TIMEOUT = 10.0f;
+constexpr const float KEEPALIVE_INTERVAL = 0.25f;
+constexpr const float REASSEMBLY_TIMEOUT = 5.0f;
+constexpr const float MIN_RESEND_DELAY = 0.05f;
+constexpr const float MAX_RESEND_DELAY = 1.0f;
+
+bool sequenceGreaterThan(uint16_t s1, uint16_t s2) {
+	return ((s1 > s2) && (s1 - s2 <= 32768)) || ((s1 < s2) && (s2 - s1 > 32768));
+}
+
+float secondsBetween(UDPConnection::clock::time_point from, UDPConnection::clock::time_point to) {
+	return std::chrono::duration_cast<seconds>(to - from).count();
+}
+
+class PacketReader {
+public:
+	explicit PacketReader(const uint8_t *data, uint32_t length) :
+			data{data},
+			length{length} {
+	}
+
+	template<typename T> bool read(T &value) {
+		if (remaining() < sizeof(T)) {
+			return false;
+		}
+
+		std::memcpy(&value, data + position, sizeof(T));
+		position += sizeof(T);
+		return true;
+	}
+
+	const uint8_t *skip(uint32_t count) {
+		if (remaining() < count) {
+			return nullptr;
+		}
+
+		const auto start = data + position;
+		position += count;
+		return start;
+	}
+
+	uint32_t remaining() const {
+		return length - position;
+	}
+
+private:
+	const uint8_t *data;
+	uint32_t length;
+	uint32_t position = 0u;
+};
+
+}
+
+constexpr const uint32_t UDPEndpoint::MAX_PACKET_SIZE;
+constexpr const uint32_t UDPEndpoint::FRAGMENT_SIZE;
+constexpr const uint32_t UDPEndpoint::MAX_FRAGMENTS;
+constexpr const uint32_t UDPEndpoint::MAX_MESSAGE_SIZE;
+constexpr const uint32_t UDPConnection::CHANNEL_COUNT;
+constexpr const uint32_t UDPConnection::SEQUENCE_BUFFER_SIZE;
+
+UDPConnection::UDPConnection(UDPEndpoint *endpoint, const sockaddr_storage &address_, socklen_t addressLength_) :
+		endpoint{endpoint},
+		address(address_),
+		addressLength{addressLength_},
+		createdAt{clock::now()},
+		lastReceivedAt{createdAt},
+		lastSentAt{createdAt},
+		sentPackets(SEQUENCE_BUFFER_SIZE),
+		receivedPackets(SEQUENCE_BUFFER_SIZE, -1),
+		receivedUnorderedIDs(SEQUENCE_BUFFER_SIZE, -1) {
+	nextMessageIDs.fill(0u);
+
+	// sequence 0 is never sent before the first wrap, so a remote which hasn't received anything (and so sends
+	// an ack of 0) can't acknowledge a packet by accident
+	localSequence = 1u;
+
+	char ip[INET6_ADDRSTRLEN] = {0};
+
+	if (address.ss_family == AF_INET) {
+		const auto s = reinterpret_cast<const sockaddr_in *>(&address);
+		remotePort = ntohs(s->sin_port);
+		::inet_ntop(AF_INET, &s->sin_addr, ip, INET6_ADDRSTRLEN);
+	} else if (address.ss_family == AF_INET6) {
+		const auto s = reinterpret_cast<const sockaddr_in6 *>(&address);
+		remotePort = ntohs(s->sin6_port);
+		::inet_ntop(AF_INET6, &s->sin6_addr, ip, INET6_ADDRSTRLEN);
+	}
+
+	remoteHost = ip;
+}
+
+bool UDPConnection::send(UDPChannel channel, const BufferView &message) {
+	if (state == State::DISCONNECTED) {
+		endpoint->logger->warn("Can't send on a closed UDP connection to {}.", remoteHost);
+		return false;
+	}
+
+	if (message.length > UDPEndpoint::MAX_MESSAGE_SIZE) {
+		endpoint->logger->error("UDP message of {} bytes is larger than the maximum of {} bytes.", message.length,
+		        UDPEndpoint::MAX_MESSAGE_SIZE);
+		return false;
+	}
+
+	const auto channelIndex = static_cast<uint32_t>(channel);
+
+	OutgoingMessage outgoing;
+	outgoing.channel = channel;
+	outgoing.id = nextMessageIDs[channelIndex]++;
+	outgoing.data.assign(message.begin(), message.end());
+	outgoing.fragmentCount = static_cast<uint16_t>(
+	        std::max(1u, (message.length + UDPEndpoint::FRAGMENT_SIZE - 1u) / UDPEndpoint::FRAGMENT_SIZE));
+
+	if (channel == UDPChannel::UNRELIABLE) {
+		unreliableOutgoing.emplace_back(std::move(outgoing));
+		return true;
+	}
+
+	outgoing.fragmentAcked.assign(outgoing.fragmentCount, 0u);
+	outgoing.fragmentSentAt.assign(outgoing.fragmentCount, clock::time_point());
+
+	const auto key = makeMessageKey(channel, outgoing.id);
+
+	reliableOutgoing.emplace_back(std::move(outgoing));
+	reliableIndex[key] = std::prev(reliableOutgoing.end());
+
+	return true;
+}
+
+void UDPConnection::disconnect() {
+	if (state == State::DISCONNECTED) {
+		return;
+	}
+
+	if (state == State::CONNECTED) {
+		endpoint->sendDisconnect(*this);
+	}
+
+	endpoint->closeConnection(*this);
+}
+
+void UDPConnection::processAcks(uint16_t ack, uint32_t ackBits, clock::time_point now) {
+	for (int32_t i = -1; i < 32; ++i) {
+		if (i >= 0 && (ackBits & (1u << i)) == 0u) {
+			continue;
+		}
+
+		const auto sequence = static_cast<uint16_t>(i < 0 ? ack : ack - 1 - i);
+		auto &sent = sentPackets[sequence % SEQUENCE_BUFFER_SIZE];
+
+		if (!sent.valid || sent.acked || sent.sequence != sequence) {
+			continue;
+		}
+
+		sent.acked = true;
+
+		const auto sample = secondsBetween(sent.sentAt, now);
+		roundTripTime += (sample - roundTripTime) * 0.1f;
+
+		for (const auto &fragment : sent.fragments) {
+			acknowledgeFragment(fragment);
+		}
+	}
+}
+
+void UDPConnection::acknowledgeFragment(const FragmentRef &fragment) {
+	const auto found = reliableIndex.find(fragment.messageKey);
+
+	if (found == reliableIndex.end()) {
+		return;
+	}
+
+	auto &message = *found->second;
+
+	if (message.fragmentAcked[fragment.fragment] != 0u) {
+		return;
+	}
+
+	message.fragmentAcked[fragment.fragment] = 1u;
+
+	if (++message.fragmentsAcked == message.fragmentCount) {
+		reliableOutgoing.erase(found->second);
+		reliableIndex.erase(found);
+	}
+}
+
+bool UDPConnection::recordReceivedPacket(uint16_t sequence) {
+	if (receivedAnyPacket && sequenceGreaterThan(remoteSequence, sequence)
+	        && static_cast<uint16_t>(remoteSequence - sequence) >= SEQUENCE_BUFFER_SIZE) {
+		// too old to tell whether it's a duplicate
+		return false;
+	}
+
+	auto &slot = receivedPackets[sequence % SEQUENCE_BUFFER_SIZE];
+
+	if (slot == sequence) {
+		return false;
+	}
+
+	slot = sequence;
+
+	if (!receivedAnyPacket || sequenceGreaterThan(sequence, remoteSequence)) {
+		remoteSequence = sequence;
+		receivedAnyPacket = true;
+	}
+
+	return true;
+}
+
+uint32_t UDPConnection::buildAckBits() const {
+	uint32_t ackBits = 0u;
+
+	if (!receivedAnyPacket) {
+		return ackBits;
+	}
+
+	for (uint32_t i = 0u; i < 32u; ++i) {
+		const auto sequence = static_cast<uint16_t>(remoteSequence - 1u - i);
+
+		if (receivedPackets[sequence % SEQUENCE_BUFFER_SIZE] == sequence) {
+			ackBits |= (1u << i);
+		}
+	}
+
+	return ackBits;
+}
+
+bool UDPConnection::alreadyReceived(UDPChannel channel, uint16_t messageID) const {
+	switch (channel) {
+	case UDPChannel::UNRELIABLE:
+		return false;
+
+	case UDPChannel::RELIABLE_UNORDERED:
+		return receivedUnorderedIDs[messageID % SEQUENCE_BUFFER_SIZE] == messageID;
+
+	case UDPChannel::RELIABLE_ORDERED:
+		return sequenceGreaterThan(nextOrderedID, messageID) || orderedStash.find(messageID) != orderedStash.end();
+	}
+
+	return false;
+}
+
+void UDPConnection::receiveFragment(UDPChannel channel, uint16_t messageID, uint16_t fragment,
+        uint16_t fragmentCount, const uint8_t *data, uint16_t length, clock::time_point now) {
+	if (alreadyReceived(channel, messageID)) {
+		return;
+	}
+
+	// the sender never gets further ahead than this (see UDPEndpoint::sendDataPackets), so anything beyond it
+	// is bogus and mustn't be buffered
+	if (channel == UDPChannel::RELIABLE_ORDERED
+	        && static_cast<uint16_t>(messageID - nextOrderedID) >= RELIABLE_WINDOW) {
+		endpoint->logger->trace("Ignored UDP message {} from {}, outside the receive window.", messageID, remoteHost);
+		return;
+	}
+
+	if (fragmentCount == 1u) {
+		receiveMessage(channel, messageID, data, length);
+		return;
+	}
+
+	// only the last fragment may be short, and none may be empty; checked before anything is allocated for them
+	if (length == 0u || (fragment != fragmentCount - 1u && length != UDPEndpoint::FRAGMENT_SIZE)) {
+		return;
+	}
+
+	const auto key = makeMessageKey(channel, messageID);
+	auto found = reassemblies.find(key);
+
+	if (found == reassemblies.end()) {
+		const auto size = static_cast<uint32_t>(fragmentCount) * UDPEndpoint::FRAGMENT_SIZE;
+
+		if (reassemblies.size() >= MAX_REASSEMBLIES || bufferedBytes + size > MAX_BUFFERED_BYTES) {
+			bufferLimitReached(channel);
+			return;
+		}
+
+		found = reassemblies.emplace(key, Reassembly()).first;
+		bufferedBytes += size;
+
+		auto &started = found->second;
+		started.fragmentCount = fragmentCount;
+		started.data.resize(size);
+		started.received.assign(fragmentCount, 0u);
+		started.startedAt = now;
+	}
+
+	auto &reassembly = found->second;
+
+	if (reassembly.fragmentCount != fragmentCount || reassembly.received[fragment] != 0u) {
+		return;
+	}
+
+	const auto offset = static_cast<uint32_t>(fragment) * UDPEndpoint::FRAGMENT_SIZE;
+	std::memcpy(reassembly.data.data() + offset, data, length);
+
+	reassembly.received[fragment] = 1u;
+	++reassembly.fragmentsReceived;
+
+	if (fragment == fragmentCount - 1u) {
+		reassembly.length = offset + length;
+	}
+
+	if (reassembly.fragmentsReceived == reassembly.fragmentCount) {
+		auto message = std::move(reassembly.data);
+		const auto messageLength = reassembly.length;
+
+		bufferedBytes -= static_cast<uint32_t>(message.size());
+		reassemblies.erase(found);
+
+		receiveMessage(channel, messageID, message.data(), messageLength);
+	}
+}
+
+void UDPConnection::receiveMessage(UDPChannel channel, uint16_t messageID, const uint8_t *data, uint32_t length) {
+	const auto deliver = [this, channel](const uint8_t *messageData, uint32_t messageLength) {
+		if (endpoint->messageCallback) {
+			endpoint->messageCallback(*this, channel, BufferView(messageData, messageLength));
+		}
+	};
+
+	switch (channel) {
+	case UDPChannel::UNRELIABLE:
+		deliver(data, length);
+		break;
+
+	case UDPChannel::RELIABLE_UNORDERED:
+		receivedUnorderedIDs[messageID % SEQUENCE_BUFFER_SIZE] = messageID;
+		deliver(data, length);
+		break;
+
+	case UDPChannel::RELIABLE_ORDERED:
+		if (messageID != nextOrderedID) {
+			if (bufferedBytes + length > MAX_BUFFERED_BYTES) {
+				bufferLimitReached(channel);
+			} else if (orderedStash.emplace(messageID, byte_vector(data, data + length)).second) {
+				bufferedBytes += length;
+			}
+
+			break;
+		}
+
+		deliver(data, length);
+		++nextOrderedID;
+
+		while (true) {
+			const auto next = orderedStash.find(nextOrderedID);
+
+			if (next == orderedStash.end()) {
+				break;
+			}
+
+			const auto stashed = std::move(next->second);
+			orderedStash.erase(next);
+			bufferedBytes -= static_cast<uint32_t>(stashed.size());
+
+			deliver(stashed.data(), static_cast<uint32_t>(stashed.size()));
+			++nextOrderedID;
+		}
+
+		break;
+	}
+}
+
+void UDPConnection::bufferLimitReached(UDPChannel channel) {
+	if (channel == UDPChannel::UNRELIABLE) {
+		endpoint->logger->trace("Dropped an unreliable UDP message from {}, receive limits reached.", remoteHost);
+		return;
+	}
+
+	// the packet carrying this has already been acknowledged, so dropping it would silently lose the message
+	endpoint->logger->warn("UDP connection to {}:{} sent more incomplete or out of order data than can be buffered.",
+	        remoteHost, remotePort);
+	disconnect();
+}
+
+UDPEndpoint::UDPEndpoint(uint16_t port, bool acceptConnections) :
+		acceptConnections{acceptConnections},
+		packet(MAX_PACKET_SIZE),
+		receiveBuffer(MAX_PACKET_SIZE),
+		random{std::random_device()()},
+		logger{spdlog::get("APG")} {
+	// prefer a dual stack IPv6 socket, which can talk to both IPv4 and IPv6 endpoints
+	internalSocket = ::socket(AF_INET6, SOCK_DGRAM, IPPROTO_UDP);
+
+	if (internalSocket != -1) {
+#ifdef _WIN32
+		const char opt = 0;
+#else
+		const int opt = 0;
+#endif
+
+		sockaddr_in6 bindAddress;
+		std::memset(&bindAddress, 0, sizeof(bindAddress));
+		bindAddress.sin6_family = AF_INET6;
+		bindAddress.sin6_port = htons(port);
+		bindAddress.sin6_addr = in6addr_any;
+
+		if (::setsockopt(internalSocket, IPPROTO_IPV6, IPV6_V6ONLY, &opt, sizeof(opt)) != 0
+		        || ::bind(internalSocket, reinterpret_cast<sockaddr *>(&bindAddress), sizeof(bindAddress)) != 0) {
+			logger->trace("Couldn't bind dual stack UDP socket, falling back to IPv4: {}",
+			        NativeSocketUtil::getErrorMessage(errno));
+			NativeSocketUtil::closeSocket(internalSocket);
+			internalSocket = -1;
+		} else {
+			socketFamily = AF_INET6;
+		}
+	}
+
+	if (internalSocket == -1) {
+		internalSocket = ::socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+
+		sockaddr_in bindAddress;
+		std::memset(&bindAddress, 0, sizeof(bindAddress));
+		bindAddress.sin_family = AF_INET;
+		bindAddress.sin_port = htons(port);
+		bindAddress.sin_addr.s_addr = htonl(INADDR_ANY);
+
+		if (internalSocket == -1
+		        || ::bind(internalSocket, reinterpret_cast<sockaddr *>(&bindAddress), sizeof(bindAddress)) != 0) {
+			logger->error("Couldn't create UDP socket on port {}: {}", port, NativeSocketUtil::getErrorMessage(errno));
+
+			if (internalSocket != -1) {
+				NativeSocketUtil::closeSocket(internalSocket);
+				internalSocket = -1;
+			}
+
+			error = true;
+			return;
+		}
+
+		socketFamily = AF_INET;
+	}
+
+	if (NativeSocketUtil::setNonBlocking(internalSocket) != 0) {
+		logger->error("Couldn't set non-blocking state for UDP socket: {}", NativeSocketUtil::getErrorMessage(errno));
+		error = true;
+	}
+}
+
+UDPEndpoint::~UDPEndpoint() {
+	for (auto &connection : connections) {
+		if (connection.second->state == UDPConnection::State::CONNECTED) {
+			sendDisconnect(*connection.second);
+		}
+	}
+
+#ifdef APG_HAS_EPOLL
+	detach();
+#endif
+
+	if (internalSocket != -1) {
+		NativeSocketUtil::closeSocket(internalSocket);
+	}
+}
+
+UDPConnection *UDPEndpoint::connect(const std::string &host, uint16_t port) {
+	if (internalSocket == -1) {
+		logger->error("Can't connect using a UDP endpoint which failed to initialise.");
+		return nullptr;
+	}
+
+	addrinfo hints;
+	std::memset(&hints, 0, sizeof(hints));
+	hints.ai_family = socketFamily;
+	hints.ai_socktype = SOCK_DGRAM;
+#ifdef AI_V4MAPPED
+	if (socketFamily == AF_INET6) {
+		hints.ai_flags = AI_V4MAPPED;
+	}
+#endif
+
+	addrinfo *tempAI;
+	const auto portString = std::to_string(port);
+
+	const int addrRet = ::getaddrinfo(host.c_str(), portString.c_str(), &hints, &tempAI);
+	if (addrRet != 0) {
+		logger->error("Couldn't resolve \"{}\" for UDP connection: {}", host, ::gai_strerror(addrRet));
+		return nullptr;
+	}
+
+	auto addrPtr = NativeSocketUtil::make_addrinfo_ptr(tempAI);
+
+	sockaddr_storage address;
+	std::memset(&address, 0, sizeof(address));
+	std::memcpy(&address, addrPtr->ai_addr, addrPtr->ai_addrlen);
+
+	const auto key = addressKey(address);
+	const auto existing = connections.find(key);
+
+	if (existing != connections.end() && existing->second->state != UDPConnection::State::DISCONNECTED) {
+		return existing->second.get();
+	}
+
+	auto connection = std::make_unique<UDPConnection>(this, address,
+	        static_cast<socklen_t>(addrPtr->ai_addrlen));
+
+	connection->initiator = true;
+
+	do {
+		connection->clientSalt = static_cast<uint32_t>(random());
+	} while (connection->clientSalt == 0u);
+
+	sendConnectRequest(*connection);
+
+	// the old connection might be the one whose disconnect callback is calling us
+	retireConnection(key);
+
+	const auto ret = connection.get();
+	connections[key] = std::move(connection);
+
+	return ret;
+}
+
+void UDPEndpoint::receive() {
+	if (internalSocket == -1) {
+		return;
+	}
+
+	while (true) {
+		sockaddr_storage address;
+		socklen_t addressLength = sizeof(address);
+		std::memset(&address, 0, sizeof(address));
+
+		const auto received = ::recvfrom(internalSocket, reinterpret_cast<char *>(receiveBuffer.data()),
+		        static_cast<int>(receiveBuffer.size()), 0, reinterpret_cast<sockaddr *>(&address), &addressLength);
+
+		if (received < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			if (errno != EAGAIN && errno != NativeSocketUtil::APGWOULDBLOCK) {
+				logger->trace("recvfrom failed on UDP endpoint: {}", NativeSocketUtil::getErrorMessage(errno));
+			}
+
+			break;
+		}
+
+		processPacket(address, addressLength, receiveBuffer.data(), static_cast<uint32_t>(received),
+		        clock::now());
+	}
+
+	finishCallbacks();
+}
+
+void UDPEndpoint::update() {
+	const auto now = clock::now();
+
+	for (auto &connection : connections) {
+		if (connection.second->state != UDPConnection::State::DISCONNECTED) {
+			updateConnection(*connection.second, now);
+		}
+	}
+
+	// callbacks can reconnect, which replaces the disconnected connection in the map
+	finishCallbacks();
+
+	for (auto it = connections.begin(); it != connections.end();) {
+		if (it->second->state == UDPConnection::State::DISCONNECTED) {
+			it = connections.erase(it);
+		} else {
+			++it;
+		}
+	}
+}
+
+#ifdef APG_HAS_EPOLL
+bool UDPEndpoint::attach(NativeEventLoop &loop) {
+	detach();
+
+	if (internalSocket == -1) {
+		return false;
+	}
+
+	if (!loop.addDescriptor(internalSocket, [this](uint32_t events) {
+		if (events & NativeEventLoop::EVENT_READABLE) {
+			receive();
+		}
+	})) {
+		return false;
+	}
+
+	eventLoop = &loop;
+	return true;
+}
+
+void UDPEndpoint::detach() {
+	if (eventLoop != nullptr) {
+		eventLoop->removeDescriptor(internalSocket);
+		eventLoop = nullptr;
+	}
+}
+#endif
+
+void UDPEndpoint::processPacket(const sockaddr_storage &address, socklen_t addressLength, const uint8_t *data,
+        uint32_t length, clock::time_point now) {
+	PacketReader reader(data, length);
+
+	uint32_t protocolID = 0u;
+	uint8_t type = 0u;
+
+	if (!reader.read(protocolID) || protocolID != PROTOCOL_ID || !reader.read(type)) {
+		return;
+	}
+
+	const auto found = connections.find(addressKey(address));
+	UDPConnection *connection = (found == connections.end()) ? nullptr : found->second.get();
+
+	switch (static_cast<PacketType>(type)) {
+	case PacketType::CONNECT_REQUEST: {
+		uint32_t clientSalt = 0u;
+
+		if (length >= CONNECT_REQUEST_SIZE && reader.read(clientSalt) && clientSalt != 0u) {
+			processConnectRequest(address, addressLength, clientSalt, now);
+		}
+
+		break;
+	}
+
+	case PacketType::CONNECT_ACCEPT: {
+		uint32_t clientSalt = 0u;
+		uint32_t serverSalt = 0u;
+
+		if (connection == nullptr || connection->state != UDPConnection::State::CONNECTING
+		        || !reader.read(clientSalt) || !reader.read(serverSalt) || clientSalt != connection->clientSalt) {
+			break;
+		}
+
+		connection->serverSalt = serverSalt;
+		connection->connectionID = clientSalt ^ serverSalt;
+		connection->state = UDPConnection::State::CONNECTED;
+		connection->lastReceivedAt = now;
+
+		logger->trace("UDP connection to {}:{} established.", connection->remoteHost, connection->remotePort);
+
+		if (connectCallback) {
+			connectCallback(*connection);
+		}
+
+		break;
+	}
+
+	case PacketType::DISCONNECT: {
+		uint32_t connectionID = 0u;
+
+		if (connection != nullptr && connection->state == UDPConnection::State::CONNECTED
+		        && reader.read(connectionID) && connectionID == connection->connectionID) {
+			closeConnection(*connection);
+		}
+
+		break;
+	}
+
+	case PacketType::DATA: {
+		uint32_t connectionID = 0u;
+
+		if (connection != nullptr && connection->state == UDPConnection::State::CONNECTED
+		        && reader.read(connectionID) && connectionID == connection->connectionID) {
+			connection->lastReceivedAt = now;
+
+			const auto rest = reader.remaining();
+			processData(*connection, reader.skip(rest), rest, now);
+		}
+
+		break;
+	}
+
+	default:
+		break;
+	}
+}
+
+void UDPEndpoint::processConnectRequest(const sockaddr_storage &address, socklen_t addressLength,
+        uint32_t clientSalt, clock::time_point now) {
+	const auto key = addressKey(address);
+	const auto found = connections.find(key);
+
+	if (found != connections.end()) {
+		auto &existing = *found->second;
+
+		if (existing.initiator && existing.state == UDPConnection::State::CONNECTING && acceptConnections) {
+			// we're connecting to each other at the same time; both ends compare salts the same way, so exactly
+			// one of them becomes the responder and the other's request completes
+			if (existing.clientSalt > clientSalt) {
+				return;
+			}
+
+			if (existing.clientSalt == clientSalt) {
+				do {
+					existing.clientSalt = static_cast<uint32_t>(random());
+				} while (existing.clientSalt == 0u);
+
+				sendConnectRequest(existing);
+				return;
+			}
+
+			// the connection returned by connect() is kept, so it's still valid for the caller
+			existing.initiator = false;
+			existing.clientSalt = clientSalt;
+
+			do {
+				existing.serverSalt = static_cast<uint32_t>(random());
+			} while (existing.serverSalt == 0u || existing.serverSalt == clientSalt);
+
+			existing.connectionID = clientSalt ^ existing.serverSalt;
+			existing.state = UDPConnection::State::CONNECTED;
+			existing.lastReceivedAt = now;
+
+			sendConnectAccept(existing);
+
+			logger->trace("Accepted UDP connection from {}:{} while connecting to it.", existing.remoteHost,
+			        existing.remotePort);
+
+			if (connectCallback) {
+				connectCallback(existing);
+			}
+
+			return;
+		}
+
+		if (existing.initiator) {
+			return;
+		}
+
+		if (existing.clientSalt == clientSalt) {
+			// our accept was lost
+			if (existing.state == UDPConnection::State::CONNECTED) {
+				sendConnectAccept(existing);
+			}
+
+			return;
+		}
+
+		// the remote endpoint restarted, so the old connection is dead
+		closeConnection(existing);
+		retireConnection(key);
+	}
+
+	if (!acceptConnections) {
+		return;
+	}
+
+	auto connection = std::make_unique<UDPConnection>(this, address, addressLength);
+
+	connection->clientSalt = clientSalt;
+
+	do {
+		connection->serverSalt = static_cast<uint32_t>(random());
+	} while (connection->serverSalt == 0u || connection->serverSalt == clientSalt);
+
+	connection->connectionID = clientSalt ^ connection->serverSalt;
+	connection->state = UDPConnection::State::CONNECTED;
+	connection->lastReceivedAt = now;
+
+	sendConnectAccept(*connection);
+
+	auto &ref = *connection;
+	connections[key] = std::move(connection);
+
+	logger->trace("Accepted UDP connection from {}:{}.", ref.remoteHost, ref.remotePort);
+
+	if (connectCallback) {
+		connectCallback(ref);
+	}
+}
+
+void UDPEndpoint::processData(UDPConnection &connection, const uint8_t *data, uint32_t length,
+        clock::time_point now) {
+	PacketReader reader(data, length);
+
+	uint16_t sequence = 0u;
+	uint16_t ack = 0u;
+	uint32_t ackBits = 0u;
+
+	if (!reader.read(sequence) || !reader.read(ack) || !reader.read(ackBits)) {
+		return;
+	}
+
+	if (!connection.recordReceivedPacket(sequence)) {
+		return;
+	}
+
+	connection.ackPending = true;
+	connection.processAcks(ack, ackBits, now);
+
+	while (reader.remaining() >= MESSAGE_HEADER_SIZE && connection.state == UDPConnection::State::CONNECTED) {
+		uint8_t channel = 0u;
+		uint8_t flags = 0u;
+		uint16_t messageID = 0u;
+		uint16_t messageLength = 0u;
+		uint16_t fragment = 0u;
+		uint16_t fragmentCount = 1u;
+
+		reader.read(channel);
+		reader.read(flags);
+		reader.read(messageID);
+		reader.read(messageLength);
+
+		if ((flags & MESSAGE_FLAG_FRAGMENTED) != 0u) {
+			if (!reader.read(fragment) || !reader.read(fragmentCount)) {
+				break;
+			}
+		}
+
+		const auto messageData = reader.skip(messageLength);
+
+		if (channel >= UDPConnection::CHANNEL_COUNT || messageData == nullptr || fragmentCount == 0u
+		        || fragmentCount > MAX_FRAGMENTS || fragment >= fragmentCount || messageLength > FRAGMENT_SIZE) {
+			logger->trace("Malformed UDP packet from {}.", connection.remoteHost);
+			break;
+		}
+
+		connection.receiveFragment(static_cast<UDPChannel>(channel), messageID, fragment, fragmentCount,
+		        messageData, messageLength, now);
+	}
+}
+
+void UDPEndpoint::updateConnection(UDPConnection &connection, clock::time_point now) {
+	if (connection.state == UDPConnection::State::CONNECTING) {
+		if (secondsBetween(connection.createdAt, now) > CONNECT_TIMEOUT) {
+			logger->warn("UDP connection to {}:{} timed out.", connection.remoteHost, connection.remotePort);
+			closeConnection(connection);
+		} else if (secondsBetween(connection.lastSentAt, now) >= CONNECT_RESEND_INTERVAL) {
+			sendConnectRequest(connection);
+		}
+
+		return;
+	}
+
+	if (secondsBetween(connection.lastReceivedAt, now) > CONNECTION_TIMEOUT) {
+		logger->warn("UDP connection to {}:{} timed out.", connection.remoteHost, connection.remotePort);
+		closeConnection(connection);
+		return;
+	}
+
+	// Fragments on reliable channels were acked and won't be resent, so only unreliable reassemblies can expire;
+	// reliable ones are bounded by MAX_REASSEMBLIES, MAX_BUFFERED_BYTES and the connection timeout.
+	for (auto it = connection.reassemblies.begin(); it != connection.reassemblies.end();) {
+		const auto channel = static_cast<UDPChannel>(it->first >> 16u);
+
+		if (channel == UDPChannel::UNRELIABLE && secondsBetween(it->second.startedAt, now) > REASSEMBLY_TIMEOUT) {
+			connection.bufferedBytes -= static_cast<uint32_t>(it->second.data.size());
+			it = connection.reassemblies.erase(it);
+		} else {
+			++it;
+		}
+	}
+
+	sendDataPackets(connection, now);
+}
+
+void UDPEndpoint::sendDataPackets(UDPConnection &connection, clock::time_point now) {
+	const auto resendDelay = std::min(MAX_RESEND_DELAY, std::max(MIN_RESEND_DELAY, connection.roundTripTime * 2.0f));
+
+	bool packetOpen = false;
+	uint32_t reliablePackets = 0u;
+
+	auto &sentPackets = connection.sentPackets;
+
+	const auto writeFragment = [&](const UDPConnection::OutgoingMessage &message, uint16_t fragment) {
+		const auto offset = static_cast<uint32_t>(fragment) * FRAGMENT_SIZE;
+		const auto fragmentLength = std::min(FRAGMENT_SIZE, static_cast<uint32_t>(message.data.size()) - offset);
+		const bool fragmented = message.fragmentCount > 1u;
+
+		const auto needed = MESSAGE_HEADER_SIZE + (fragmented ? FRAGMENT_HEADER_SIZE : 0u) + fragmentLength;
+
+		if (packetOpen && packet.size() + needed > MAX_PACKET_SIZE) {
+			finishDataPacket(connection, now);
+			packetOpen = false;
+		}
+
+		if (!packetOpen) {
+			beginDataPacket(connection, now);
+			packetOpen = true;
+		}
+
+		packet.put(static_cast<uint8_t>(message.channel));
+		packet.put(static_cast<uint8_t>(fragmented ? MESSAGE_FLAG_FRAGMENTED : 0u));
+		packet.putUInt16(message.id);
+		packet.putUInt16(static_cast<uint16_t>(fragmentLength));
+
+		if (fragmented) {
+			packet.putUInt16(fragment);
+			packet.putUInt16(message.fragmentCount);
+		}
+
+		packet.putBytes(message.data.data() + offset, fragmentLength);
+	};
+
+	// reliable messages first, oldest first, so resends aren't starved by new data
+	std::array<bool, UDPConnection::CHANNEL_COUNT> seenChannel;
+	std::array<uint16_t, UDPConnection::CHANNEL_COUNT> oldestUnacked;
+	seenChannel.fill(false);
+
+	for (auto &message : connection.reliableOutgoing) {
+		const auto channelIndex = static_cast<uint32_t>(message.channel);
+
+		if (!seenChannel[channelIndex]) {
+			seenChannel[channelIndex] = true;
+			oldestUnacked[channelIndex] = message.id;
+		}
+
+		if (static_cast<uint16_t>(message.id - oldestUnacked[channelIndex]) >= RELIABLE_WINDOW) {
+			continue;
+		}
+
+		const auto key = UDPConnection::makeMessageKey(message.channel, message.id);
+
+		for (uint16_t fragment = 0u; fragment < message.fragmentCount; ++fragment) {
+			if (message.fragmentAcked[fragment] != 0u) {
+				continue;
+			}
+
+			const auto lastSent = message.fragmentSentAt[fragment];
+
+			if (lastSent != UDPConnection::clock::time_point() && secondsBetween(lastSent, now) < resendDelay) {
+				continue;
+			}
+
+			const auto sequenceBefore = connection.localSequence;
+			writeFragment(message, fragment);
+
+			message.fragmentSentAt[fragment] = now;
+			sentPackets[connection.localSequence % UDPConnection::SEQUENCE_BUFFER_SIZE].fragments.push_back(
+			        UDPConnection::FragmentRef{key, fragment});
+
+			if (connection.localSequence != sequenceBefore && ++reliablePackets >= MAX_RELIABLE_PACKETS_PER_UPDATE) {
+				break;
+			}
+		}
+
+		if (reliablePackets >= MAX_RELIABLE_PACKETS_PER_UPDATE) {
+			break;
+		}
+	}
+
+	for (const auto &message : connection.unreliableOutgoing) {
+		for (uint16_t fragment = 0u; fragment < message.fragmentCount; ++fragment) {
+			writeFragment(message, fragment);
+		}
+	}
+
+	connection.unreliableOutgoing.clear();
+
+	if (packetOpen) {
+		finishDataPacket(connection, now);
+	} else if (connection.ackPending || secondsBetween(connection.lastSentAt, now) >= KEEPALIVE_INTERVAL) {
+		// nothing to send, but the remote needs our acks or to know we're still here
+		beginDataPacket(connection, now);
+		finishDataPacket(connection, now);
+	}
+}
+
+void UDPEndpoint::beginDataPacket(UDPConnection &connection, clock::time_point now) {
+	auto &sent = connection.sentPackets[connection.localSequence % UDPConnection::SEQUENCE_BUFFER_SIZE];
+	sent.sequence = connection.localSequence;
+	sent.valid = true;
+	sent.acked = false;
+	sent.sentAt = now;
+	sent.fragments.clear();
+
+	packet.clear();
+	packet.putUInt32(PROTOCOL_ID);
+	packet.put(static_cast<uint8_t>(PacketType::DATA));
+	packet.putUInt32(connection.connectionID);
+	packet.putUInt16(connection.localSequence);
+	packet.putUInt16(connection.receivedAnyPacket ? connection.remoteSequence : 0u);
+	packet.putUInt32(connection.buildAckBits());
+}
+
+void UDPEndpoint::finishDataPacket(UDPConnection &connection, clock::time_point now) {
+	sendPacket(connection);
+
+	++connection.localSequence;
+	connection.lastSentAt = now;
+	connection.ackPending = false;
+}
+
+void UDPEndpoint::sendConnectRequest(UDPConnection &connection) {
+	packet.clear();
+	packet.putUInt32(PROTOCOL_ID);
+	packet.put(static_cast<uint8_t>(PacketType::CONNECT_REQUEST));
+	packet.putUInt32(connection.clientSalt);
+
+	while (packet.size() < CONNECT_REQUEST_SIZE) {
+		packet.put(static_cast<uint8_t>(0u));
+	}
+
+	sendPacket(connection);
+	connection.lastSentAt = clock::now();
+}
+
+void UDPEndpoint::sendConnectAccept(UDPConnection &connection) {
+	packet.clear();
+	packet.putUInt32(PROTOCOL_ID);
+	packet.put(static_cast<uint8_t>(PacketType::CONNECT_ACCEPT));
+	packet.putUInt32(connection.clientSalt);
+	packet.putUInt32(connection.serverSalt);
+
+	sendPacket(connection);
+	connection.lastSentAt = clock::now();
+}
+
+void UDPEndpoint::sendDisconnect(UDPConnection &connection) {
+	packet.clear();
+	packet.putUInt32(PROTOCOL_ID);
+	packet.put(static_cast<uint8_t>(PacketType::DISCONNECT));
+	packet.putUInt32(connection.connectionID);
+
+	// there's no ack for a disconnect, so send a few in case some are lost
+	for (uint32_t i = 0u; i < DISCONNECT_REDUNDANCY; ++i) {
+		sendPacket(connection);
+	}
+}
+
+void UDPEndpoint::sendPacket(const UDPConnection &connection) {
+	const auto view = packet.view();
+
+	const auto sent = ::sendto(internalSocket, reinterpret_cast<const char *>(view.data), view.length, 0,
+	        reinterpret_cast<const sockaddr *>(&connection.address), connection.addressLength);
+
+	// UDP is unreliable anyway, so a full socket buffer is treated like a lost packet
+	if (sent < 0 && errno != EAGAIN && errno != NativeSocketUtil::APGWOULDBLOCK) {
+		logger->trace("sendto failed for {}: {}", connection.remoteHost, NativeSocketUtil::getErrorMessage(errno));
+	}
+}
+
+void UDPEndpoint::closeConnection(UDPConnection &connection) {
+	if (connection.state == UDPConnection::State::DISCONNECTED) {
+		return;
+	}
+
+	connection.state = UDPConnection::State::DISCONNECTED;
+	closedConnections.emplace_back(&connection);
+}
+
+void UDPEndpoint::retireConnection(const std::string &key) {
+	const auto found = connections.find(key);
+
+	if (found != connections.end()) {
+		retiredConnections.emplace_back(std::move(found->second));
+		connections.erase(found);
+	}
+}
+
+void UDPEndpoint::finishCallbacks() {
+	// a callback can close more connections, so the list can grow as it's walked
+	for (size_t i = 0u; i < closedConnections.size(); ++i) {
+		const auto connection = closedConnections[i];
+
+		if (disconnectCallback) {
+			disconnectCallback(*connection);
+		}
+	}
+
+	closedConnections.clear();
+	retiredConnections.clear();
+}
+
+std::string UDPEndpoint::addressKey(const sockaddr_storage &address) {
+	std::string key(1u, static_cast<char>(address.ss_family));
+
+	if (address.ss_family == AF_INET) {
+		const auto s = reinterpret_cast<const sockaddr_in *>(&address);
+		key.append(reinterpret_cast<const char *>(&s->sin_addr), sizeof(s->sin_addr));
+		key.append(reinterpret_cast<const char *>(&s->sin_port), sizeof(s->sin_port));
+	} else if (address.ss_family == AF_INET6) {
+		const auto s = reinterpret_cast<const sockaddr_in6 *>(&address);
+		key.append(reinterpret_cast<const char *>(&s->sin6_addr), sizeof(s->sin6_addr));
+		key.append(reinterpret_cast<const char *>(&s->sin6_port), sizeof(s->sin6_port));
+		key.append(reinterpret_cast<const char *>(&s->sin6_scope_id), sizeof(s->sin6_scope_id));
+	}
+
+	return key;
+}
+
+}
+
+#endif
@@ -0,0 +1,85 @@
+#include <cstdint>
+
+#include "APG/s11n/Binary.hpp"
+
+namespace APG {
+
+uint32_t BinaryWriter::beginStruct() {
+	const auto lengthPos = buffer.getWritePos();
+
+	// most structs are shorter than 128 bytes, so their length fits in the one byte reserved here
+	buffer.put(static_cast<uint8_t>(0u));
+
+	return lengthPos;
+}
+
+void BinaryWriter::endStruct(uint32_t lengthPos) {
+	const auto end = buffer.getWritePos();
+	const auto length = end - lengthPos - 1u;
+
+	uint8_t prefix[ByteBuffer::MAX_VARINT32_SIZE];
+	const auto prefixLength = ByteBuffer::encodeVarint(length, prefix);
+
+	buffer.put(prefix[0], lengthPos);
+
+	if (prefixLength > 1u) {
+		buffer.insertBytes(prefix + 1u, prefixLength - 1u, lengthPos + 1u);
+	}
+
+	buffer.setWritePos(end + prefixLength - 1u);
+}
+
+bool BinaryReader::beginStruct(uint32_t &structVersion, uint32_t &end) {
+	if (!ok) {
+		return false;
+	}
+
+	uint32_t length = 0u;
+
+	if (!buffer.getVarUInt32(structVersion) || !buffer.getVarUInt32(length)) {
+		fail("truncated struct header");
+		return false;
+	}
+
+	if (length > getRemaining()) {
+		fail("truncated struct");
+		return false;
+	}
+
+	end = buffer.getReadPos() + length;
+	return true;
+}
+
+void BinaryReader::endStruct(uint32_t end) {
+	if (!ok) {
+		return;
+	}
+
+	if (buffer.getReadPos() > end) {
+		fail("struct fields overran their length");
+		return;
+	}
+
+	buffer.setReadPos(end);
+}
+
+bool BinaryReader::readCount(uint32_t &count, size_t minimumSize) {
+	if (!ok) {
+		return false;
+	}
+
+	if (!buffer.getVarUInt32(count)) {
+		fail("malformed length");
+		return false;
+	}
+
+	// checked before resizing, so a corrupt length can't allocate more than the data could possibly hold
+	if (static_cast<uint64_t>(count) * minimumSize > getRemaining()) {
+		fail("length larger than remaining data");
+		return false;
+	}
+
+	return true;
+}
+
+}
@@ -1,4 +1,40 @@
+#include <cstddef>
+
+#include <rapidjson/error/en.h>
+
 #include "APG/s11n/JSON.hpp"
 
 namespace APG {
+
+constexpr const size_t JSONCommon::ARENA_CHUNK_SIZE;
+
+JSONCommon::JSONCommon(JSONFormat format) :
+		        compactWriter { buffer },
+		        prettyWriter { buffer },
+		        arenaChunk { new char[ARENA_CHUNK_SIZE] },
+		        arena { arenaChunk.get(), ARENA_CHUNK_SIZE },
+		        document { &arena },
+		        format { format },
+		        logger { spdlog::get("APG") } {
+}
+
+rapidjson::Document &JSONCommon::parseDocument(const char *json) {
+	// every value in the old document was allocated from the arena, so dropping them and clearing the arena
+	// recycles all of their memory at once
+	document.SetNull();
+	arena.Clear();
+
+	document.Parse(json);
+
+	if (document.HasParseError()) {
+		logParseError(document.GetParseError(), document.GetErrorOffset());
+	}
+
+	return document;
+}
+
+void JSONCommon::logParseError(rapidjson::ParseErrorCode code, size_t offset) {
+	logger->warn("Couldn't parse JSON at offset {}: {}", offset, rapidjson::GetParseError_En(code));
+}
+
 }
@@ -11,8 +11,6 @@
 
 namespace APG {
 
-std::unordered_map<std::string, std::shared_ptr<Tileset>> GLTmxRenderer::tmxTilesets;
-
 GLTmxRenderer::GLTmxRenderer(Tmx::Map *const map, SpriteBatch *const batch) :
 		GLTmxRenderer(std::unique_ptr<Tmx::Map>(map), batch) {
 }
@@ -60,10 +58,10 @@ void GLTmxRenderer::renderLayerImpl(const Tmx::TileLayer *layer) {
 	}
 }
 
-void GLTmxRenderer::renderObjectGroupImpl(const std::vector<TiledObject> &objects) {
-	for (const auto &obj : objects) {
-		batch->draw(obj.sprite, obj.position.x, obj.position.y);
-	}
+void GLTmxRenderer::renderObjectGroupImpl(const TiledObjectGroup &objects) {
+	forEachVisibleObject(objects, [this](const TiledObject &obj) {
+		batch->draw(obj.sprite, position.x + obj.position.x, position.y + obj.position.y);
+	});
 }
 
 }
@@ -90,14 +90,12 @@ void PackedTmxRenderer::loadTilesets() {
 
 				const auto &frames = tile->GetFrames();
 				std::vector<SpriteBase *> framePointers;
+				std::vector<float> frameDurations;
 				framePointers.reserve(frames.size());
-				const float totalDuration = tile->GetTotalDuration() / 1000.0f;
+				frameDurations.reserve(frames.size());
 
 				for (const auto &frame : frames) {
 					const auto gid = mapTileset->GetFirstGid() + frame.GetTileID();
-					const auto duration = frame.GetDuration();
-
-					// TODO: Proper frame length handling (AnimSprite refactor)
 
 					if (sprites.find(gid) == sprites.end()) {
 						logger->error("Couldn't find sprite frame {} for animation", gid);
@@ -105,9 +103,17 @@ void PackedTmxRenderer::loadTilesets() {
 					}
 
 					framePointers.emplace_back(sprites[gid]);
+					// durations are stored in ms, convert to seconds
+					frameDurations.emplace_back(frame.GetDuration() / 1000.0f);
+				}
+
+				if (framePointers.empty()) {
+					logger->error("Animated tile {} has no loadable frames", mapTileset->GetFirstGid() + tile->GetId());
+					continue;
 				}
 
-				loadedAnimatedSprites.emplace_front(totalDuration, framePointers, AnimationMode::LOOP);
+				const auto handle = animations.add(framePointers, frameDurations, AnimationMode::LOOP);
+				loadedAnimatedSprites.emplace_front(&animations, handle);
 				sprites[mapTileset->GetFirstGid() + tile->GetId()] = &(loadedAnimatedSprites.front());
 			}
 
@@ -133,14 +139,12 @@ void PackedTmxRenderer::loadObjects() {
 			objects.emplace_back(obj->GetName(), obj->GetX(), obj->GetY() - map->GetTileHeight(), sprites[gid]);
 		}
 
-		objectGroups.emplace(group->GetName(), objects);
+		objectGroups.emplace(group->GetName(), TiledObjectGroup(std::move(objects)));
 	}
 }
 
 void PackedTmxRenderer::update(float deltaTime) {
-	for (auto &animation : loadedAnimatedSprites) {
-		animation.update(deltaTime);
-	}
+	animations.updateAll(deltaTime);
 }
 
 void PackedTmxRenderer::renderAll() {
@@ -208,10 +212,10 @@ void PackedTmxRenderer::renderLayer(Tmx::TileLayer *layer) {
 	}
 }
 
-void PackedTmxRenderer::renderObjectGroup(const std::vector<TiledObject> &objects) {
-	for (const auto &obj : objects) {
+void PackedTmxRenderer::renderObjectGroup(const TiledObjectGroup &objects) {
+	forEachObjectInViewport(objects, position, viewportPosition, viewportSize, [this](const TiledObject &obj) {
 		batch->draw(obj.sprite, position.x + obj.position.x, position.y + obj.position.y);
-	}
+	});
 }
 
 PackedTexture *PackedTmxRenderer::getPackedTexture() {
@@ -226,6 +230,11 @@ void PackedTmxRenderer::setPosition(glm::vec2 position) {
 	this->position = std::move(position);
 }
 
+void PackedTmxRenderer::setViewport(glm::vec2 topLeft, glm::vec2 size) {
+	viewportPosition = std::move(topLeft);
+	viewportSize = std::move(size);
+}
+
 int PackedTmxRenderer::getPixelWidth() const {
 	return map->GetWidth() * map->GetTileWidth();
 }
@@ -234,10 +243,10 @@ int PackedTmxRenderer::getPixelHeight() const {
 	return map->GetHeight() * map->GetTileHeight();
 }
 
-std::vector<TiledObject> PackedTmxRenderer::getObjectGroup(const std::string &groupName) const {
+const TiledObjectGroup *PackedTmxRenderer::getObjectGroup(const std::string &groupName) const {
 	auto it = objectGroups.find(groupName);
 
-	return it == objectGroups.end() ? std::vector<TiledObject>() : it->second;
+	return it == objectGroups.end() ? nullptr : &(it->second);
 }
 
 const Tmx::Map *PackedTmxRenderer::getMap() const {
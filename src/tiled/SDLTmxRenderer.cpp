@@ -1,7 +1,12 @@
 #ifndef APG_NO_SDL
 
+#include <cstdint>
+
+#include <algorithm>
 #include <string>
 #include <sstream>
+#include <utility>
+#include <vector>
 
 #include "Tmx.h"
 
@@ -15,7 +20,16 @@
 
 namespace APG {
 
-std::unordered_map<std::string, std::shared_ptr<Tileset>> SDLTmxRenderer::tmxTilesets;
+namespace {
+
+int32_t floorDiv(int32_t numerator, int32_t denominator) {
+	const auto quotient = numerator / denominator;
+	return (numerator % denominator != 0 && numerator < 0) ? quotient - 1 : quotient;
+}
+
+}
+
+constexpr const int32_t SDLTmxRenderer::CHUNK_SIZE_TILES;
 
 SDLTmxRenderer::SDLTmxRenderer(Tmx::Map *const map, const SXXDL::renderer_ptr &renderer) :
 		SDLTmxRenderer(std::unique_ptr<Tmx::Map>(map), renderer) {
@@ -24,13 +38,15 @@ SDLTmxRenderer::SDLTmxRenderer(Tmx::Map *const map, const SXXDL::renderer_ptr &r
 
 SDLTmxRenderer::SDLTmxRenderer(std::unique_ptr<Tmx::Map> &&map, const SXXDL::renderer_ptr &renderer) :
 		TmxRenderer(std::move(map)),
-		renderer{renderer} {
+		renderer{renderer},
+		tileBatch{renderer} {
 	setupTilesets();
 }
 
 SDLTmxRenderer::SDLTmxRenderer(const std::string &fileName, const SXXDL::renderer_ptr &renderer) :
 		TmxRenderer(fileName),
-		renderer{renderer} {
+		renderer{renderer},
+		tileBatch{renderer} {
 	setupTilesets();
 }
 
@@ -43,52 +59,264 @@ void SDLTmxRenderer::setupTilesets() {
 				SXXDL::make_sdl_texture_ptr(
 						SDL_CreateTextureFromSurface(renderer.get(), tileset->getPreservedSurface())));
 	}
+
+	chunkCaching = (SDL_RenderTargetSupported(renderer.get()) == SDL_TRUE);
+
+	if (!chunkCaching) {
+		logger->info("Renderer doesn't support render targets; SDLTmxRenderer will draw tiles individually.");
+	}
 }
 
 void SDLTmxRenderer::renderLayerImpl(const Tmx::TileLayer *layer) {
-	const auto tile_width = map->GetTileWidth();
-	const auto tile_height = map->GetTileHeight();
+	if (!layer->IsVisible()) {
+		return;
+	}
 
-	auto src_rect = SDL_Rect{0, 0, tile_width, tile_height};
-	auto dst_rect = SDL_Rect{0, 0, tile_width, tile_height};
+	const int32_t tileWidth = map->GetTileWidth();
+	const int32_t tileHeight = map->GetTileHeight();
 
-	if (layer->IsVisible()) {
-		for (int y = 0; y < layer->GetHeight(); y++) {
-			for (int x = 0; x < layer->GetWidth(); x++) {
+	const auto originX = static_cast<int32_t>(position.x);
+	const auto originY = static_cast<int32_t>(position.y);
 
-				const unsigned int tile_id = layer->GetTileId(x, y);
-				const auto tileset_index = layer->GetTileTilesetIndex(x, y);
+	// rendering coordinates are relative to the viewport, so the visible area is (0, 0) to (w, h)
+	SDL_Rect viewport;
+	SDL_RenderGetViewport(renderer.get(), &viewport);
 
-				if (tileset_index == -1) {
-					continue;
-				}
+	const auto firstX = std::max(0, floorDiv(-originX, tileWidth));
+	const auto firstY = std::max(0, floorDiv(-originY, tileHeight));
+	const auto lastX = std::min(layer->GetWidth() - 1, floorDiv(viewport.w - 1 - originX, tileWidth));
+	const auto lastY = std::min(layer->GetHeight() - 1, floorDiv(viewport.h - 1 - originY, tileHeight));
 
-				const auto &current_tileset = tilesets[tileset_index];
-				const auto &sdl_tileset = sdlTextures[tileset_index];
+	if (firstX > lastX || firstY > lastY) {
+		return;
+	}
 
-				const int tileset_x = tile_id % current_tileset->getWidthInTiles();
-				const int tileset_y = tile_id / current_tileset->getWidthInTiles();
+	if (!chunkCaching) {
+		drawTiles(layer, firstX, firstY, lastX, lastY, originX, originY);
+		return;
+	}
 
-				const auto spacing = current_tileset->getSpacing();
+	auto &cache = getLayerCache(layer);
 
-				src_rect.x = tileset_x * (tile_width + spacing);
-				src_rect.y = tileset_y * (tile_height + spacing);
+	const auto chunkPixelWidth = CHUNK_SIZE_TILES * tileWidth;
+	const auto chunkPixelHeight = CHUNK_SIZE_TILES * tileHeight;
 
-				dst_rect.x = (int) position.x + x * tile_width;
-				dst_rect.y = (int) position.y + y * tile_height;
+	for (int32_t chunkY = firstY / CHUNK_SIZE_TILES; chunkY <= lastY / CHUNK_SIZE_TILES; ++chunkY) {
+		for (int32_t chunkX = firstX / CHUNK_SIZE_TILES; chunkX <= lastX / CHUNK_SIZE_TILES; ++chunkX) {
+			const auto chunkIndex = chunkY * cache.chunksX + chunkX;
 
-				if (SDL_RenderCopy(renderer.get(), sdl_tileset.get(), &src_rect, &dst_rect) < 0) {
-					logger->error(
-							"Couldn't render in tmx renderer; failed at tile {}, tileset \"{}\"", tile_id,
-							current_tileset->getFileName());
+			if (cache.dirty[chunkIndex]) {
+				if (!redrawChunk(layer, cache, chunkX, chunkY)) {
+					logger->error("Couldn't render chunk to texture in tmx renderer, disabling chunk caching: {}",
+								  SDL_GetError());
+					setChunkCaching(false);
+					drawTiles(layer, firstX, firstY, lastX, lastY, originX, originY);
 					return;
 				}
 			}
+
+			const auto &chunk = cache.chunks[chunkIndex];
+
+			// chunks with no tiles in them don't get a texture
+			if (chunk == nullptr) {
+				continue;
+			}
+
+			const SDL_Rect dstRect{originX + chunkX * chunkPixelWidth, originY + chunkY * chunkPixelHeight,
+								   chunkPixelWidth, chunkPixelHeight};
+
+			if (SDL_RenderCopy(renderer.get(), chunk.get(), nullptr, &dstRect) < 0) {
+				logger->error("Couldn't render chunk ({}, {}) in tmx renderer: {}", chunkX, chunkY, SDL_GetError());
+				return;
+			}
+		}
+	}
+}
+
+void SDLTmxRenderer::invalidateTile(const Tmx::TileLayer *layer, int32_t x, int32_t y) {
+	const auto found = layerCaches.find(layer);
+
+	if (found == layerCaches.end()) {
+		return;
+	}
+
+	auto &cache = found->second;
+	const auto chunkX = x / CHUNK_SIZE_TILES;
+	const auto chunkY = y / CHUNK_SIZE_TILES;
+
+	if (x < 0 || y < 0 || chunkX >= cache.chunksX || chunkY >= cache.chunksY) {
+		return;
+	}
+
+	cache.dirty[chunkY * cache.chunksX + chunkX] = true;
+}
+
+void SDLTmxRenderer::invalidateLayer(const Tmx::TileLayer *layer) {
+	const auto found = layerCaches.find(layer);
+
+	if (found != layerCaches.end()) {
+		std::fill(found->second.dirty.begin(), found->second.dirty.end(), true);
+	}
+}
+
+void SDLTmxRenderer::invalidateAll() {
+	for (auto &cache : layerCaches) {
+		std::fill(cache.second.dirty.begin(), cache.second.dirty.end(), true);
+	}
+}
+
+void SDLTmxRenderer::setChunkCaching(bool enabled) {
+	if (enabled && SDL_RenderTargetSupported(renderer.get()) != SDL_TRUE) {
+		logger->warn("Can't enable chunk caching in SDLTmxRenderer; render targets aren't supported.");
+		enabled = false;
+	}
+
+	chunkCaching = enabled;
+
+	if (!chunkCaching) {
+		layerCaches.clear();
+	}
+}
+
+SDLTmxRenderer::LayerCache &SDLTmxRenderer::getLayerCache(const Tmx::TileLayer *layer) {
+	const auto found = layerCaches.find(layer);
+
+	if (found != layerCaches.end()) {
+		return found->second;
+	}
+
+	LayerCache cache;
+	cache.chunksX = (layer->GetWidth() + CHUNK_SIZE_TILES - 1) / CHUNK_SIZE_TILES;
+	cache.chunksY = (layer->GetHeight() + CHUNK_SIZE_TILES - 1) / CHUNK_SIZE_TILES;
+
+	const auto chunkCount = static_cast<size_t>(cache.chunksX * cache.chunksY);
+	cache.chunks.reserve(chunkCount);
+	for (size_t i = 0; i < chunkCount; ++i) {
+		cache.chunks.emplace_back(SXXDL::make_sdl_texture_ptr(nullptr));
+	}
+
+	cache.dirty.assign(chunkCount, true);
+
+	return layerCaches.emplace(layer, std::move(cache)).first->second;
+}
+
+bool SDLTmxRenderer::redrawChunk(const Tmx::TileLayer *layer, LayerCache &cache, int32_t chunkX, int32_t chunkY) {
+	const auto chunkIndex = chunkY * cache.chunksX + chunkX;
+	auto &chunk = cache.chunks[chunkIndex];
+
+	const auto firstX = chunkX * CHUNK_SIZE_TILES;
+	const auto firstY = chunkY * CHUNK_SIZE_TILES;
+	const auto lastX = std::min(firstX + CHUNK_SIZE_TILES, layer->GetWidth()) - 1;
+	const auto lastY = std::min(firstY + CHUNK_SIZE_TILES, layer->GetHeight()) - 1;
+
+	bool hasTiles = false;
+	for (int32_t y = firstY; y <= lastY && !hasTiles; ++y) {
+		for (int32_t x = firstX; x <= lastX; ++x) {
+			if (layer->GetTileTilesetIndex(x, y) != -1) {
+				hasTiles = true;
+				break;
+			}
 		}
 	}
+
+	cache.dirty[chunkIndex] = false;
+
+	if (!hasTiles) {
+		chunk = SXXDL::make_sdl_texture_ptr(nullptr);
+		return true;
+	}
+
+	const int32_t tileWidth = map->GetTileWidth();
+	const int32_t tileHeight = map->GetTileHeight();
+
+	if (chunk == nullptr) {
+		chunk = SXXDL::make_sdl_texture_ptr(
+				SDL_CreateTexture(renderer.get(), SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET,
+								  CHUNK_SIZE_TILES * tileWidth, CHUNK_SIZE_TILES * tileHeight));
+
+		if (chunk == nullptr) {
+			return false;
+		}
+
+		SDL_SetTextureBlendMode(chunk.get(), SDL_BLENDMODE_BLEND);
+	}
+
+	const auto previousTarget = SDL_GetRenderTarget(renderer.get());
+
+	Uint8 r, g, b, a;
+	SDL_GetRenderDrawColor(renderer.get(), &r, &g, &b, &a);
+
+	if (SDL_SetRenderTarget(renderer.get(), chunk.get()) < 0) {
+		return false;
+	}
+
+	SDL_SetRenderDrawColor(renderer.get(), 0, 0, 0, 0);
+	SDL_RenderClear(renderer.get());
+
+	// tiles in a layer never overlap, so copy them into the chunk as-is; blending here as well as when the chunk is
+	// composited would apply each tile's alpha twice
+	std::vector<SDL_BlendMode> tilesetBlendModes(sdlTextures.size(), SDL_BLENDMODE_NONE);
+	for (size_t i = 0; i < sdlTextures.size(); ++i) {
+		SDL_GetTextureBlendMode(sdlTextures[i].get(), &tilesetBlendModes[i]);
+		SDL_SetTextureBlendMode(sdlTextures[i].get(), SDL_BLENDMODE_NONE);
+	}
+
+	const auto drawn = drawTiles(layer, firstX, firstY, lastX, lastY, -firstX * tileWidth, -firstY * tileHeight);
+
+	for (size_t i = 0; i < sdlTextures.size(); ++i) {
+		SDL_SetTextureBlendMode(sdlTextures[i].get(), tilesetBlendModes[i]);
+	}
+
+	SDL_SetRenderDrawColor(renderer.get(), r, g, b, a);
+	SDL_SetRenderTarget(renderer.get(), previousTarget);
+
+	return drawn;
+}
+
+bool SDLTmxRenderer::drawTiles(const Tmx::TileLayer *layer, int32_t firstX, int32_t firstY, int32_t lastX,
+							   int32_t lastY, int32_t offsetX, int32_t offsetY) {
+	const int32_t tile_width = map->GetTileWidth();
+	const int32_t tile_height = map->GetTileHeight();
+
+	auto src_rect = SDL_Rect{0, 0, tile_width, tile_height};
+	auto dst_rect = SDL_Rect{0, 0, tile_width, tile_height};
+
+	for (int32_t y = firstY; y <= lastY; y++) {
+		for (int32_t x = firstX; x <= lastX; x++) {
+			const unsigned int tile_id = layer->GetTileId(x, y);
+			const auto tileset_index = layer->GetTileTilesetIndex(x, y);
+
+			if (tileset_index == -1) {
+				continue;
+			}
+
+			const auto &current_tileset = tilesets[tileset_index];
+			const auto &sdl_tileset = sdlTextures[tileset_index];
+
+			const int tileset_x = tile_id % current_tileset->getWidthInTiles();
+			const int tileset_y = tile_id / current_tileset->getWidthInTiles();
+
+			const auto spacing = current_tileset->getSpacing();
+
+			src_rect.x = tileset_x * (tile_width + spacing);
+			src_rect.y = tileset_y * (tile_height + spacing);
+
+			dst_rect.x = offsetX + x * tile_width;
+			dst_rect.y = offsetY + y * tile_height;
+
+			tileBatch.add(sdl_tileset.get(), src_rect, dst_rect);
+		}
+	}
+
+	if (!tileBatch.flush()) {
+		logger->error("Couldn't render tiles in tmx renderer: {}", SDL_GetError());
+		return false;
+	}
+
+	return true;
 }
 
-void SDLTmxRenderer::renderObjectGroupImpl(const std::vector<TiledObject> &objects) {
+void SDLTmxRenderer::renderObjectGroupImpl(const TiledObjectGroup &objects) {
 	logger->critical("SDL renderer cannot render object groups");
 	throw std::runtime_error("SDL renderer cannot render object groups");
 }
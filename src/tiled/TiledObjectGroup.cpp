@@ -0,0 +1,164 @@
+#include <cstdint>
+#include <cmath>
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "APG/graphics/SpriteBase.hpp"
+#include "APG/tiled/TiledObjectGroup.hpp"
+
+namespace APG {
+
+constexpr const float TiledObjectGroup::DEFAULT_CELL_SIZE;
+
+TiledObjectGroup::TiledObjectGroup(std::vector<TiledObject> objects_, float cellSize_) :
+		objects{std::move(objects_)},
+		cellSize{cellSize_ > 0.0f ? cellSize_ : DEFAULT_CELL_SIZE},
+		invCellSize{1.0f / cellSize} {
+	buildGrid();
+	buildNameIndex();
+}
+
+size_t TiledObjectGroup::queryRect(const glm::vec2 &topLeft, const glm::vec2 &size,
+								   std::vector<const TiledObject *> &out) const {
+	const auto previousSize = out.size();
+
+	forEachInRect(topLeft, size, [&out](const TiledObject &object) {
+		out.emplace_back(&object);
+	});
+
+	return out.size() - previousSize;
+}
+
+size_t TiledObjectGroup::queryRadius(const glm::vec2 &centre, float radius,
+									 std::vector<const TiledObject *> &out) const {
+	const auto previousSize = out.size();
+	const auto radiusSquared = radius * radius;
+
+	const glm::vec2 topLeft{centre.x - radius, centre.y - radius};
+	const glm::vec2 size{radius * 2.0f, radius * 2.0f};
+
+	const auto base = objects.data();
+
+	forEachInRect(topLeft, size, [&](const TiledObject &object) {
+		const auto &objectSize = objectSizes[&object - base];
+
+		// distance from the centre to the closest point on the object's bounds
+		const auto dx = centre.x - std::max(object.position.x, std::min(centre.x, object.position.x + objectSize.x));
+		const auto dy = centre.y - std::max(object.position.y, std::min(centre.y, object.position.y + objectSize.y));
+
+		if (dx * dx + dy * dy <= radiusSquared) {
+			out.emplace_back(&object);
+		}
+	});
+
+	return out.size() - previousSize;
+}
+
+size_t TiledObjectGroup::queryName(const std::string &name, std::vector<const TiledObject *> &out) const {
+	const auto range = std::equal_range(nameIndex.begin(), nameIndex.end(), name, NameComparator{objects});
+
+	for (auto it = range.first; it != range.second; ++it) {
+		out.emplace_back(&objects[*it]);
+	}
+
+	return static_cast<size_t>(std::distance(range.first, range.second));
+}
+
+const TiledObject *TiledObjectGroup::findByName(const std::string &name) const {
+	const auto it = std::lower_bound(nameIndex.begin(), nameIndex.end(), name, NameComparator{objects});
+
+	if (it == nameIndex.end() || objects[*it].name != name) {
+		return nullptr;
+	}
+
+	return &objects[*it];
+}
+
+void TiledObjectGroup::buildGrid() {
+	cellStarts.clear();
+	cellObjects.clear();
+	objectSizes.clear();
+
+	if (objects.empty()) {
+		cellsX = cellsY = 0;
+		return;
+	}
+
+	glm::vec2 maxCorner{objects.front().position.x, objects.front().position.y};
+	origin = maxCorner;
+	maxObjectSize = glm::vec2{0.0f, 0.0f};
+
+	for (const auto &object : objects) {
+		origin.x = std::min(origin.x, object.position.x);
+		origin.y = std::min(origin.y, object.position.y);
+		maxCorner.x = std::max(maxCorner.x, object.position.x);
+		maxCorner.y = std::max(maxCorner.y, object.position.y);
+
+		if (object.sprite != nullptr) {
+			maxObjectSize.x = std::max(maxObjectSize.x, static_cast<float>(object.sprite->getWidth()));
+			maxObjectSize.y = std::max(maxObjectSize.y, static_cast<float>(object.sprite->getHeight()));
+		}
+	}
+
+	// grow the cells for very sparse groups rather than allocating a huge, mostly empty grid
+	const auto extent = std::max(maxCorner.x - origin.x, maxCorner.y - origin.y);
+	if (extent * invCellSize >= static_cast<float>(MAX_CELLS_PER_AXIS)) {
+		cellSize = extent / static_cast<float>(MAX_CELLS_PER_AXIS - 1);
+		invCellSize = 1.0f / cellSize;
+	}
+
+	cellsX = static_cast<int32_t>(std::floor((maxCorner.x - origin.x) * invCellSize)) + 1;
+	cellsY = static_cast<int32_t>(std::floor((maxCorner.y - origin.y) * invCellSize)) + 1;
+
+	const auto cellCount = static_cast<size_t>(cellsX) * static_cast<size_t>(cellsY);
+
+	std::vector<uint32_t> objectCells;
+	objectCells.reserve(objects.size());
+
+	cellStarts.assign(cellCount + 1, 0u);
+
+	// counting sort of the object indices by cell, which keeps objects in the same cell in map file order
+	for (const auto &object : objects) {
+		const auto cell = clampCell(object.position.y - origin.y, cellsY) * cellsX
+						  + clampCell(object.position.x - origin.x, cellsX);
+		objectCells.emplace_back(static_cast<uint32_t>(cell));
+		++cellStarts[cell + 1];
+	}
+
+	for (size_t i = 1; i <= cellCount; ++i) {
+		cellStarts[i] += cellStarts[i - 1];
+	}
+
+	std::vector<uint32_t> insertPositions(cellStarts.begin(), cellStarts.end() - 1);
+	cellObjects.resize(objects.size());
+
+	for (uint32_t i = 0; i < objects.size(); ++i) {
+		cellObjects[insertPositions[objectCells[i]]++] = i;
+	}
+
+	objectSizes.reserve(objects.size());
+
+	for (const auto &object : objects) {
+		if (object.sprite != nullptr) {
+			objectSizes.emplace_back(static_cast<float>(object.sprite->getWidth()),
+									 static_cast<float>(object.sprite->getHeight()));
+		} else {
+			objectSizes.emplace_back(0.0f, 0.0f);
+		}
+	}
+}
+
+void TiledObjectGroup::buildNameIndex() {
+	nameIndex.resize(objects.size());
+
+	for (uint32_t i = 0; i < objects.size(); ++i) {
+		nameIndex[i] = i;
+	}
+
+	std::stable_sort(nameIndex.begin(), nameIndex.end(), NameComparator{objects});
+}
+
+}
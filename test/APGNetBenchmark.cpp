@@ -0,0 +1,500 @@
+/*
+ * Loopback throughput and latency benchmark for APG's socket implementations.
+ *
+ * For every backend, message size and connection count, a server thread accepts the connections and echoes
+ * everything it receives, while one client thread per connection sends a message, waits for all of it to come
+ * back and repeats. Round trips completed in the first tenth of each run are treated as warm-up and not counted.
+ *
+ * Reported bytes are payload bytes echoed back to clients, i.e. one direction only.
+ *
+ * Usage: NetBenchmark [--output results.json] [--duration seconds] [--sizes 64,1024,16384]
+ *                     [--connections 1,8,32] [--backends native,sdl] [--port 23500]
+ *
+ * Results are written as JSON to --output, or to stdout if it isn't given.
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <rapidjson/prettywriter.h>
+#include <rapidjson/stringbuffer.h>
+
+#include "spdlog/spdlog.h"
+#include "spdlog/sinks/stdout_color_sinks.h"
+
+#include "APG/net/Socket.hpp"
+
+#ifndef APG_NO_NATIVE
+#include "APG/net/NativeSocket.hpp"
+#endif
+
+#ifndef APG_NO_SDL
+#include "APG/SDL.hpp"
+#include "APG/net/SDLSocket.hpp"
+#endif
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+constexpr const uint32_t RECEIVE_CHUNK_SIZE = 64u * 1024u;
+constexpr const uint32_t ACTIVITY_WAIT_MILLISECONDS = 100u;
+constexpr const uint32_t RESPONSE_TIMEOUT_MILLISECONDS = 5000u;
+constexpr const float ACCEPT_TIMEOUT_SECONDS = 5.0f;
+
+struct Backend {
+	std::string name;
+	std::function<std::unique_ptr<APG::AcceptorSocket>(uint16_t port)> makeAcceptor;
+	std::function<std::unique_ptr<APG::Socket>(uint16_t port)> makeSocket;
+};
+
+struct Options {
+	std::string outputPath;
+	double durationSeconds = 2.0;
+	std::vector<uint32_t> messageSizes { 64u, 1024u, 16384u };
+	std::vector<uint32_t> connectionCounts { 1u, 8u, 32u };
+	std::vector<std::string> backends { "native", "sdl" };
+	uint16_t port = 23500u;
+};
+
+struct Result {
+	std::string backend;
+	uint32_t messageSize = 0u;
+	uint32_t connectionCount = 0u;
+
+	uint64_t messages = 0u;
+	uint64_t bytes = 0u;
+	double seconds = 0.0;
+
+	// round trip times of every counted message, in nanoseconds
+	std::vector<uint64_t> roundTrips;
+
+	uint32_t errors = 0u;
+};
+
+std::vector<uint32_t> parseList(const std::string &str) {
+	std::vector<uint32_t> ret;
+	std::stringstream ss(str);
+	std::string item;
+
+	while (std::getline(ss, item, ',')) {
+		if (!item.empty()) {
+			ret.emplace_back(static_cast<uint32_t>(std::stoul(item)));
+		}
+	}
+
+	return ret;
+}
+
+std::vector<std::string> parseNames(const std::string &str) {
+	std::vector<std::string> ret;
+	std::stringstream ss(str);
+	std::string item;
+
+	while (std::getline(ss, item, ',')) {
+		if (!item.empty()) {
+			ret.emplace_back(item);
+		}
+	}
+
+	return ret;
+}
+
+bool parseOptions(int argc, char **argv, Options &options) {
+	for (int i = 1; i < argc; ++i) {
+		const std::string arg(argv[i]);
+
+		if (i + 1 >= argc) {
+			std::cerr << "Missing value for " << arg << "\n";
+			return false;
+		}
+
+		const std::string value(argv[++i]);
+
+		if (arg == "--output") {
+			options.outputPath = value;
+		} else if (arg == "--duration") {
+			options.durationSeconds = std::stod(value);
+		} else if (arg == "--sizes") {
+			options.messageSizes = parseList(value);
+		} else if (arg == "--connections") {
+			options.connectionCounts = parseList(value);
+		} else if (arg == "--backends") {
+			options.backends = parseNames(value);
+		} else if (arg == "--port") {
+			options.port = static_cast<uint16_t>(std::stoul(value));
+		} else {
+			std::cerr << "Unknown option " << arg << "\n";
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/**
+ * Sends everything in the socket's buffer, including anything which had to be queued.
+ */
+bool sendAll(APG::Socket &socket) {
+	if (socket.send() < 0 || socket.hasError()) {
+		return false;
+	}
+
+	while (socket.getSendQueueSize() > 0u) {
+		if (socket.flushSendQueue() < 0 || socket.hasError()) {
+			return false;
+		}
+
+		std::this_thread::yield();
+	}
+
+	return true;
+}
+
+void runEchoServer(std::unique_ptr<APG::Socket> socket, const std::atomic<bool> &running) {
+	while (running.load(std::memory_order_relaxed)) {
+		if (!socket->waitForActivity(ACTIVITY_WAIT_MILLISECONDS)) {
+			continue;
+		}
+
+		// activity with nothing to read means the client disconnected
+		if (socket->recv(RECEIVE_CHUNK_SIZE) <= 0 || socket->hasError()) {
+			break;
+		}
+
+		// everything received is still in the buffer, so sending it echoes it back
+		if (!sendAll(*socket)) {
+			break;
+		}
+
+		socket->clear();
+	}
+}
+
+void runClient(APG::Socket &socket, uint32_t messageSize, clock_type::time_point countFrom,
+        clock_type::time_point endTime, Result &result, std::mutex &resultMutex) {
+	std::vector<uint8_t> payload(messageSize);
+
+	for (uint32_t i = 0u; i < messageSize; ++i) {
+		payload[i] = static_cast<uint8_t>(i);
+	}
+
+	std::vector<uint64_t> roundTrips;
+	uint64_t messages = 0u;
+	bool failed = false;
+
+	while (clock_type::now() < endTime) {
+		const auto sendTime = clock_type::now();
+
+		socket.clear();
+		socket.putBytes(payload.data(), messageSize);
+
+		if (!sendAll(socket)) {
+			failed = true;
+			break;
+		}
+
+		socket.clear();
+
+		uint32_t received = 0u;
+
+		while (received < messageSize) {
+			if (!socket.waitForActivity(RESPONSE_TIMEOUT_MILLISECONDS)) {
+				failed = true;
+				break;
+			}
+
+			const int count = socket.recv(std::min(RECEIVE_CHUNK_SIZE, messageSize - received));
+
+			if (count <= 0 || socket.hasError()) {
+				failed = true;
+				break;
+			}
+
+			received += static_cast<uint32_t>(count);
+		}
+
+		if (failed) {
+			break;
+		}
+
+		if (sendTime >= countFrom) {
+			roundTrips.emplace_back(
+			        std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now() - sendTime).count());
+			++messages;
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(resultMutex);
+
+	result.messages += messages;
+	result.bytes += messages * messageSize;
+	result.roundTrips.insert(result.roundTrips.end(), roundTrips.begin(), roundTrips.end());
+
+	if (failed) {
+		++result.errors;
+	}
+}
+
+Result runCase(const Backend &backend, uint32_t messageSize, uint32_t connectionCount, double durationSeconds,
+        uint16_t port) {
+	auto logger = spdlog::get("APG");
+
+	Result result;
+	result.backend = backend.name;
+	result.messageSize = messageSize;
+	result.connectionCount = connectionCount;
+
+	auto acceptor = backend.makeAcceptor(port);
+
+	if (acceptor == nullptr || acceptor->hasError() || !acceptor->isConnected()) {
+		logger->error("Couldn't listen on port {} for {} benchmark.", port, backend.name);
+		result.errors = connectionCount;
+		return result;
+	}
+
+	std::atomic<bool> running { true };
+	std::vector<std::thread> echoThreads;
+
+	std::thread acceptThread([&]() {
+		for (uint32_t i = 0u; i < connectionCount; ++i) {
+			auto socket = acceptor->acceptSocket(ACCEPT_TIMEOUT_SECONDS);
+
+			if (socket == nullptr) {
+				break;
+			}
+
+			echoThreads.emplace_back(runEchoServer, std::move(socket), std::cref(running));
+		}
+	});
+
+	std::vector<std::unique_ptr<APG::Socket>> clients;
+
+	for (uint32_t i = 0u; i < connectionCount; ++i) {
+		auto socket = backend.makeSocket(port);
+
+		if (socket == nullptr || socket->hasError() || !socket->isConnected()) {
+			++result.errors;
+			continue;
+		}
+
+		clients.emplace_back(std::move(socket));
+	}
+
+	acceptThread.join();
+
+	const auto duration = std::chrono::duration_cast<clock_type::duration>(
+	        std::chrono::duration<double>(durationSeconds));
+	const auto startTime = clock_type::now();
+	const auto countFrom = startTime + duration / 10;
+	const auto endTime = startTime + duration;
+
+	std::mutex resultMutex;
+	std::vector<std::thread> clientThreads;
+
+	for (auto &client : clients) {
+		clientThreads.emplace_back(runClient, std::ref(*client), messageSize, countFrom, endTime, std::ref(result),
+		        std::ref(resultMutex));
+	}
+
+	for (auto &thread : clientThreads) {
+		thread.join();
+	}
+
+	result.seconds = std::chrono::duration<double>(clock_type::now() - countFrom).count();
+
+	clients.clear();
+	running.store(false, std::memory_order_relaxed);
+
+	for (auto &thread : echoThreads) {
+		thread.join();
+	}
+
+	return result;
+}
+
+double percentileMicroseconds(const std::vector<uint64_t> &sorted, double percentile) {
+	if (sorted.empty()) {
+		return 0.0;
+	}
+
+	const auto index = std::min(sorted.size() - 1u, static_cast<size_t>(percentile * sorted.size()));
+	return sorted[index] / 1000.0;
+}
+
+std::string toJSON(const Options &options, std::vector<Result> &results) {
+	rapidjson::StringBuffer buffer;
+	rapidjson::PrettyWriter<rapidjson::StringBuffer> writer(buffer);
+
+	writer.StartObject();
+
+	writer.Key("benchmark");
+	writer.String("APGNetBenchmark");
+
+	writer.Key("durationSeconds");
+	writer.Double(options.durationSeconds);
+
+	writer.Key("results");
+	writer.StartArray();
+
+	for (auto &result : results) {
+		std::sort(result.roundTrips.begin(), result.roundTrips.end());
+
+		const double seconds = result.seconds > 0.0 ? result.seconds : 1.0;
+
+		writer.StartObject();
+
+		writer.Key("backend");
+		writer.String(result.backend.c_str());
+
+		writer.Key("messageSize");
+		writer.Uint(result.messageSize);
+
+		writer.Key("connections");
+		writer.Uint(result.connectionCount);
+
+		writer.Key("messages");
+		writer.Uint64(result.messages);
+
+		writer.Key("bytes");
+		writer.Uint64(result.bytes);
+
+		writer.Key("seconds");
+		writer.Double(result.seconds);
+
+		writer.Key("messagesPerSecond");
+		writer.Double(result.messages / seconds);
+
+		writer.Key("bytesPerSecond");
+		writer.Double(result.bytes / seconds);
+
+		writer.Key("roundTripMicroseconds");
+		writer.StartObject();
+		writer.Key("p50");
+		writer.Double(percentileMicroseconds(result.roundTrips, 0.5));
+		writer.Key("p99");
+		writer.Double(percentileMicroseconds(result.roundTrips, 0.99));
+		writer.Key("p999");
+		writer.Double(percentileMicroseconds(result.roundTrips, 0.999));
+		writer.Key("max");
+		writer.Double(result.roundTrips.empty() ? 0.0 : result.roundTrips.back() / 1000.0);
+		writer.EndObject();
+
+		writer.Key("errors");
+		writer.Uint(result.errors);
+
+		writer.EndObject();
+	}
+
+	writer.EndArray();
+	writer.EndObject();
+
+	return std::string(buffer.GetString(), buffer.GetSize());
+}
+
+std::vector<Backend> getBackends() {
+	std::vector<Backend> backends;
+
+#ifndef APG_NO_NATIVE
+	backends.push_back(Backend { "native", [](uint16_t port) -> std::unique_ptr<APG::AcceptorSocket> {
+		return std::make_unique<APG::NativeDualAcceptorSocket>(port, true);
+	}, [](uint16_t port) -> std::unique_ptr<APG::Socket> {
+		return std::make_unique<APG::NativeSocket>("127.0.0.1", port, true);
+	} });
+#endif
+
+#ifndef APG_NO_SDL
+	backends.push_back(Backend { "sdl", [](uint16_t port) -> std::unique_ptr<APG::AcceptorSocket> {
+		return std::make_unique<APG::SDLAcceptorSocket>(port, true);
+	}, [](uint16_t port) -> std::unique_ptr<APG::Socket> {
+		return std::make_unique<APG::SDLSocket>("127.0.0.1", port, true);
+	} });
+#endif
+
+	return backends;
+}
+
+}
+
+int main(int argc, char **argv) {
+	auto logger = spdlog::get("APG") == nullptr ? spdlog::stdout_color_mt("APG") : spdlog::get("APG");
+	spdlog::set_level(spdlog::level::warn);
+
+	Options options;
+
+	if (!parseOptions(argc, argv, options)) {
+		return EXIT_FAILURE;
+	}
+
+#ifndef APG_NO_NATIVE
+	APG::NativeSocket::nativeSocketInit();
+#endif
+
+#ifndef APG_NO_SDL
+	if (SDLNet_Init() == -1) {
+		logger->critical("Couldn't initialise SDL2_net: {}", SDLNet_GetError());
+		return EXIT_FAILURE;
+	}
+#endif
+
+	std::vector<Result> results;
+
+	// each case gets its own port, so listeners aren't held up by connections from the last case closing
+	uint16_t port = options.port;
+
+	for (const auto &backend : getBackends()) {
+		if (std::find(options.backends.begin(), options.backends.end(), backend.name) == options.backends.end()) {
+			continue;
+		}
+
+		for (const auto messageSize : options.messageSizes) {
+			for (const auto connectionCount : options.connectionCounts) {
+				std::cerr << "Running " << backend.name << " with " << connectionCount << " connections of "
+				        << messageSize << " byte messages...\n";
+
+				results.emplace_back(runCase(backend, messageSize, connectionCount, options.durationSeconds, port++));
+			}
+		}
+	}
+
+	const auto json = toJSON(options, results);
+
+	if (options.outputPath.empty()) {
+		std::cout << json << std::endl;
+	} else {
+		std::ofstream output(options.outputPath);
+
+		if (!output) {
+			logger->critical("Couldn't open {} to write benchmark results.", options.outputPath);
+			return EXIT_FAILURE;
+		}
+
+		output << json << std::endl;
+	}
+
+#ifndef APG_NO_SDL
+	SDLNet_Quit();
+#endif
+
+#ifndef APG_NO_NATIVE
+	APG::NativeSocket::nativeSocketCleanup();
+#endif
+
+	return EXIT_SUCCESS;
+}